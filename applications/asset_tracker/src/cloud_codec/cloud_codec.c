@@ -17,6 +17,8 @@
 #endif /* CONFIG_BSD_LIBRARY */
 #include <date_time.h>
 
+#include <json_writer.h>
+#include <net/cloud_encoder.h>
 #include "cJSON.h"
 #include "cJSON_os.h"
 #include "cloud_codec.h"
@@ -203,6 +205,7 @@ static CMD_NEW_GROUP(group_command, CLOUD_CMD_GROUP_COMMAND, CMD_ARRAY(
 struct cmd *cmd_groups[] = { &group_cfg_set, &group_get, &group_data,
 			      &group_command };
 static cloud_cmd_cb_t cloud_command_cb;
+static enum cloud_encoding data_encoding = CLOUD_ENCODING_JSON;
 struct cloud_command cmd_parsed;
 
 static const char *const channel_type_str[] = {
@@ -276,47 +279,22 @@ static int cloud_set_chan_cfg_item(const enum cloud_channel channel,
 				   const enum sensor_chan_cfg_item_type type,
 				   const double value);
 
-static int json_add_obj(cJSON *parent, const char *str, cJSON *item)
+static int encode(json_writer_encode_t encoder, void *ctx,
+		  struct cloud_msg *output)
 {
-	cJSON_AddItemToObject(parent, str, item);
-
-	return 0;
-}
-
-static int json_add_str(cJSON *parent, const char *str, const char *item)
-{
-	cJSON *json_str;
-
-	json_str = cJSON_CreateString(item);
-	if (json_str == NULL) {
-		return -ENOMEM;
-	}
-
-	return json_add_obj(parent, str, json_str);
-}
-
-static int json_add_number(cJSON *parent, const char *str, double item)
-{
-	cJSON *json_num;
+	int err;
+	char *buffer;
+	size_t len;
 
-	json_num = cJSON_CreateNumber(item);
-	if (json_num == NULL) {
-		return -ENOMEM;
+	err = json_writer_encode_alloc(encoder, ctx, &buffer, &len);
+	if (err) {
+		return err;
 	}
 
-	return json_add_obj(parent, str, json_num);
-}
-
-static int json_add_bool(cJSON *parent, const char *str, const bool value)
-{
-	cJSON *json_bool;
-
-	json_bool = cJSON_CreateBool(value);
-	if (json_bool == NULL) {
-		return -ENOMEM;
-	}
+	output->buf = buffer;
+	output->len = len;
 
-	return json_add_obj(parent, str, json_bool);
+	return 0;
 }
 
 static cJSON *json_object_decode(cJSON *obj, const char *str)
@@ -335,12 +313,38 @@ static bool json_value_string_compare(cJSON *obj, const char *const str)
 	return (strcmp(json_str, str) == 0);
 }
 
+struct data_ctx {
+	const struct cloud_channel_data *channel;
+	enum cloud_cmd_group group;
+	int64_t ts;
+};
+
+static int data_encode(struct cloud_encoder *enc, void *ctx)
+{
+	const struct data_ctx *data = ctx;
+
+	cloud_encoder_obj_start(enc, NULL);
+	cloud_encoder_str(enc, CMD_CHAN_KEY_STR,
+			  channel_type_str[data->channel->type]);
+	cloud_encoder_str(enc, CMD_DATA_TYPE_KEY_STR, data->channel->data.buf);
+	cloud_encoder_str(enc, CMD_GROUP_KEY_STR, cmd_group_str[data->group]);
+	cloud_encoder_int(enc, DATA_TS, data->ts);
+	cloud_encoder_obj_end(enc);
+
+	return 0;
+}
+
+void cloud_codec_encoding_set(enum cloud_encoding encoding)
+{
+	data_encoding = encoding;
+}
+
 int cloud_encode_data(const struct cloud_channel_data *channel,
 		      const enum cloud_cmd_group group,
 		      struct cloud_msg *output)
 {
 	int ret;
-	int64_t data_ts = channel->ts;
+	struct data_ctx ctx;
 
 	if (channel == NULL || channel->data.buf == NULL ||
 	    channel->data.len == 0 || output == NULL ||
@@ -348,41 +352,22 @@ int cloud_encode_data(const struct cloud_channel_data *channel,
 		return -EINVAL;
 	}
 
-	cJSON *root_obj = cJSON_CreateObject();
-	if (root_obj == NULL) {
-		cJSON_Delete(root_obj);
-		return -ENOMEM;
-	}
+	ctx.channel = channel;
+	ctx.group = group;
+	ctx.ts = channel->ts;
 
 	/** Convert sample uptime to unix time ms. If this function fails the
 	 *  uptime is cleared and an empty timestamp value is encoded.
 	 */
-	ret = date_time_uptime_to_unix_time_ms(&data_ts);
+	ret = date_time_uptime_to_unix_time_ms(&ctx.ts);
 	if (ret) {
 		LOG_WRN("date_time_uptime_to_unix_time_ms, error: %d", ret);
 		LOG_WRN("Clearing timestamp");
-		date_time_timestamp_clear(&data_ts);
+		date_time_timestamp_clear(&ctx.ts);
 	}
 
-	ret = json_add_str(root_obj, CMD_CHAN_KEY_STR,
-			   channel_type_str[channel->type]);
-	ret += json_add_str(root_obj, CMD_DATA_TYPE_KEY_STR, channel->data.buf);
-	ret += json_add_str(root_obj, CMD_GROUP_KEY_STR, cmd_group_str[group]);
-	ret += json_add_number(root_obj, DATA_TS, data_ts);
-	if (ret != 0) {
-		cJSON_Delete(root_obj);
-		return -ENOMEM;
-	}
-
-	char *buffer;
-
-	buffer = cJSON_PrintUnformatted(root_obj);
-	cJSON_Delete(root_obj);
-
-	output->buf = buffer;
-	output->len = strlen(buffer);
-
-	return 0;
+	return cloud_encoder_encode_alloc(data_encoding, data_encode, &ctx,
+					  &output->buf, &output->len);
 }
 
 int cloud_encode_env_sensors_data(const env_sensor_data_t *sensor_data,
@@ -503,24 +488,29 @@ int cloud_encode_light_sensor_data(const struct light_sensor_data *sensor_data,
 }
 #endif /* CONFIG_LIGHT_SENSOR */
 
-int cloud_encode_config_data(struct cloud_msg *output)
+static int config_data_encode(struct json_writer *w, void *ctx)
 {
-	__ASSERT_NO_MSG(output != NULL);
+	const enum cloud_cmd_state *gps_state = ctx;
+
+	json_writer_obj_start(w, NULL);
+	json_writer_obj_start(w, "state");
+	json_writer_obj_start(w, "reported");
+	json_writer_obj_start(w, "config");
+	json_writer_obj_start(w, channel_type_str[CLOUD_CHANNEL_GPS]);
+	json_writer_bool(w, cmd_type_str[CLOUD_CMD_ENABLE],
+			 *gps_state == CLOUD_CMD_STATE_TRUE);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
 
-	cJSON *chan_obj = cJSON_CreateObject();
-	cJSON *state_obj = cJSON_CreateObject();
-	cJSON *reported_obj = cJSON_CreateObject();
-	cJSON *config_obj = cJSON_CreateObject();
-	cJSON *root_obj = cJSON_CreateObject();
-	int ret = 0;
-	char *buffer;
+	return 0;
+}
 
-	if (chan_obj == NULL || state_obj == NULL ||
-	    reported_obj == NULL || config_obj == NULL ||
-		root_obj == NULL) {
-		ret = -ENOMEM;
-		goto cleanup;
-	}
+int cloud_encode_config_data(struct cloud_msg *output)
+{
+	__ASSERT_NO_MSG(output != NULL);
 
 	/* Currently, the only value that can be changed from
 	 * the device is GPS enable, so it is the only
@@ -529,74 +519,37 @@ int cloud_encode_config_data(struct cloud_msg *output)
 	enum cloud_cmd_state gps_state =
 		cloud_get_channel_enable_state(CLOUD_CHANNEL_GPS);
 
-	if (gps_state != CLOUD_CMD_STATE_UNDEFINED) {
-		ret = json_add_bool(chan_obj, cmd_type_str[CLOUD_CMD_ENABLE],
-				gps_state == CLOUD_CMD_STATE_TRUE);
-		if (ret != 0) {
-			ret = -ENOMEM;
-			goto cleanup;
-		}
-	}
+	output->buf = NULL;
+	output->len = 0;
 
-	/* No items in chan_obj is not an error, there
+	/* No items in the config is not an error, there
 	 * is just nothing to report
 	 */
-	if (cJSON_GetArraySize(chan_obj) == 0) {
-		goto cleanup;
+	if (gps_state == CLOUD_CMD_STATE_UNDEFINED) {
+		return 0;
 	}
 
-	cJSON_AddItemToObject(config_obj, channel_type_str[CLOUD_CHANNEL_GPS],
-			      chan_obj);
-	cJSON_AddItemToObject(reported_obj, "config", config_obj);
-	cJSON_AddItemToObject(state_obj, "reported", reported_obj);
-	cJSON_AddItemToObject(root_obj, "state", state_obj);
-
-	buffer = cJSON_PrintUnformatted(root_obj);
-	cJSON_Delete(root_obj);
-	output->buf = buffer;
-	output->len = strlen(buffer);
-
-	return 0;
-
-cleanup:
-	output->buf = NULL;
-	output->len = 0;
-	cJSON_Delete(chan_obj);
-	cJSON_Delete(state_obj);
-	cJSON_Delete(reported_obj);
-	cJSON_Delete(config_obj);
-	cJSON_Delete(root_obj);
-
-	return ret;
+	return encode(config_data_encode, &gps_state, output);
 }
 
-int cloud_encode_device_status_data(
-	void *modem_param,
-	const char *const ui[], const uint32_t ui_count,
-	const char *const fota[], const uint32_t fota_count,
-	const uint16_t fota_version,
-	struct cloud_msg *output)
-{
-	__ASSERT_NO_MSG((ui != NULL) || !ui_count);
-	__ASSERT_NO_MSG((fota != NULL) || !fota_count);
-	__ASSERT_NO_MSG(output != NULL);
+struct device_status_ctx {
+	void *modem_param;
+	const char *const *ui;
+	uint32_t ui_count;
+	const char *const *fota;
+	uint32_t fota_count;
+	uint16_t fota_version;
+};
 
-	cJSON *root_obj = cJSON_CreateObject();
-	cJSON *state_obj = cJSON_CreateObject();
-	cJSON *reported_obj = cJSON_CreateObject();
-	cJSON *device_obj = cJSON_CreateObject();
+static int device_status_encode(struct json_writer *w, void *ctx)
+{
+	const struct device_status_ctx *status = ctx;
 	char dev_str[] = CLOUD_CHANNEL_STR_DEVICE_INFO;
-	const char *channel_type;
-	int ret = 0;
-
-	if (root_obj == NULL || state_obj == NULL ||
-	    reported_obj == NULL || device_obj == NULL) {
-		cJSON_Delete(root_obj);
-		cJSON_Delete(state_obj);
-		cJSON_Delete(reported_obj);
-		cJSON_Delete(device_obj);
-		return -ENOMEM;
-	}
+	size_t item_cnt = 0;
+
+	json_writer_obj_start(w, NULL);
+	json_writer_obj_start(w, "state");
+	json_writer_obj_start(w, "reported");
 
 	/* Workaround for deleting "DEVICE" objects (with uppercase key) if
 	 * it already exists in the digital twin.
@@ -605,68 +558,66 @@ int cloud_encode_device_status_data(
 	 * the size of the digital twin document if the "DEVICE" is not
 	 * deleted at the same time.
 	 */
-	cJSON *dummy_obj = cJSON_CreateNull();
-
-	if (dummy_obj == NULL) {
-		/* Dummy creation failed, but we'll let it do so
-		 * silently as it's not a functionally critical error.
-		 */
-	} else {
-		ret += json_add_obj(reported_obj, dev_str, dummy_obj);
-	}
+	json_writer_null(w, dev_str);
 
 	/* Convert to lowercase for shadow */
 	for (int i = 0; dev_str[i]; ++i) {
 		dev_str[i] = tolower(dev_str[i]);
 	}
-	channel_type = dev_str;
 
-	size_t item_cnt = 0;
+	json_writer_obj_start(w, dev_str);
 
 #ifdef CONFIG_MODEM_INFO
-	if (modem_param) {
+	if (status->modem_param) {
 		int val;
 
-		val = modem_info_json_object_encode((struct modem_param_info *)
-			modem_param, device_obj);
+		val = modem_info_json_write((struct modem_param_info *)
+			status->modem_param, w);
 		if (val > 0) {
 			item_cnt = (size_t)val;
 		}
 	}
 #endif
 
-	if (service_info_json_object_encode(ui, ui_count,
-					    fota, fota_count,
-					    fota_version,
-					    device_obj) == 0) {
+	if (service_info_json_write(status->ui, status->ui_count,
+				    status->fota, status->fota_count,
+				    status->fota_version, w) == 0) {
 		++item_cnt;
 	}
 
-	if (item_cnt != 0) {
-		ret += json_add_obj(reported_obj, channel_type, device_obj);
-		ret += json_add_obj(state_obj, "reported", reported_obj);
-		ret += json_add_obj(root_obj, "state", state_obj);
-	} else {
-		ret = -ECHILD;
-	}
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
 
-	if (ret != 0) {
-		cJSON_Delete(root_obj);
-		cJSON_Delete(state_obj);
-		cJSON_Delete(reported_obj);
-		cJSON_Delete(device_obj);
+	if (w->err || item_cnt == 0) {
 		return -EAGAIN;
 	}
 
-	char *buffer;
+	return 0;
+}
 
-	buffer = cJSON_PrintUnformatted(root_obj);
-	cJSON_Delete(root_obj);
+int cloud_encode_device_status_data(
+	void *modem_param,
+	const char *const ui[], const uint32_t ui_count,
+	const char *const fota[], const uint32_t fota_count,
+	const uint16_t fota_version,
+	struct cloud_msg *output)
+{
+	__ASSERT_NO_MSG((ui != NULL) || !ui_count);
+	__ASSERT_NO_MSG((fota != NULL) || !fota_count);
+	__ASSERT_NO_MSG(output != NULL);
 
-	output->buf = buffer;
-	output->len = strlen(buffer);
+	struct device_status_ctx ctx = {
+		.modem_param = modem_param,
+		.ui = ui,
+		.ui_count = ui_count,
+		.fota = fota,
+		.fota_count = fota_count,
+		.fota_version = fota_version,
+	};
 
-	return 0;
+	return encode(device_status_encode, &ctx, output);
 }
 
 static int cloud_decode_modem_params(cJSON *const data_obj,
@@ -193,6 +193,15 @@ struct cloud_command {
 
 typedef void (*cloud_cmd_cb_t)(struct cloud_command *cmd);
 
+/**
+ * @brief Set the encoding of the data sent with @ref cloud_encode_data.
+ *
+ * Configuration and device status updates are always encoded as JSON.
+ *
+ * @param encoding Encoding used by the cloud backend.
+ */
+void cloud_codec_encoding_set(enum cloud_encoding encoding);
+
 /**
  * @brief Encode cloud data.
  *
@@ -11,6 +11,7 @@
 
 #include "ui.h"
 #include "gps_controller.h"
+#include "gps_scheduler.h"
 
 #include <logging/log.h>
 LOG_MODULE_REGISTER(gps_control, CONFIG_ASSET_TRACKER_LOG_LEVEL);
@@ -24,12 +25,159 @@ static struct k_delayed_work start_work;
 static struct k_delayed_work stop_work;
 static int gps_reporting_interval_seconds;
 
+#if defined(CONFIG_GPS_CONTROL_SCHEDULER)
+static gps_event_handler_t app_handler;
+static struct gps_sched sched;
+static bool sched_is_init;
+static K_MUTEX_DEFINE(sched_mutex);
+static struct k_work search_end_work;
+static atomic_t search_timed_out;
+
+static const struct gps_sched_cfg sched_cfg = {
+	.interval = CONFIG_GPS_CONTROL_FIX_CHECK_INTERVAL,
+	.overdue = CONFIG_GPS_CONTROL_FIX_CHECK_OVERDUE,
+	.idle_delay = CONFIG_GPS_CONTROL_SCHEDULER_IDLE_DELAY,
+	.rrc_wait = CONFIG_GPS_CONTROL_SCHEDULER_RRC_WAIT,
+	.psm_wait = CONFIG_GPS_CONTROL_SCHEDULER_PSM_WAIT,
+};
+
+static int64_t uptime_s(void)
+{
+	return k_uptime_get() / MSEC_PER_SEC;
+}
+
+/* LTE events can come before the GPS controller is initialized, so the
+ * scheduler is initialized on first use.
+ */
+static void sched_lock(void)
+{
+	k_mutex_lock(&sched_mutex, K_FOREVER);
+
+	if (!sched_is_init) {
+		gps_sched_init(&sched, &sched_cfg);
+		sched_is_init = true;
+	}
+}
+
+static void sched_unlock(void)
+{
+	k_mutex_unlock(&sched_mutex);
+}
+
+/* Submits the start work for when the next search is due. Call with the
+ * scheduler locked. Returns the seconds until the search, or -1 if none is
+ * scheduled.
+ */
+static int64_t schedule_search(void)
+{
+	int64_t now = uptime_s();
+	int64_t next;
+
+	if (!atomic_get(&gps_is_enabled)) {
+		return -1;
+	}
+
+	next = gps_sched_next(&sched, now);
+	if (next == GPS_SCHED_SEARCHING) {
+		return -1;
+	}
+
+	LOG_DBG("Next GPS search in %lld seconds", next - now);
+	k_delayed_work_submit_to_queue(app_work_q, &start_work,
+				       K_SECONDS(next - now));
+
+	return next - now;
+}
+
+/* Returns true if a search is to be started now. Otherwise, the start work
+ * is submitted for when it is due.
+ */
+static bool search_is_due(void)
+{
+	int64_t now = uptime_s();
+	bool due;
+
+	sched_lock();
+	if (!atomic_get(&gps_is_enabled)) {
+		/* Stopped after the start work was submitted */
+		due = false;
+	} else {
+		due = (gps_sched_next(&sched, now) == now);
+		if (!due) {
+			(void)schedule_search();
+		}
+	}
+	sched_unlock();
+
+	return due;
+}
+
+static void search_end(bool fix)
+{
+	sched_lock();
+	if (sched.searching) {
+		gps_sched_search_end(&sched, fix, uptime_s());
+		atomic_set(&search_timed_out, !fix);
+		k_work_submit_to_queue(app_work_q, &search_end_work);
+	}
+	sched_unlock();
+}
+
+static void search_end_work_fn(struct k_work *work)
+{
+	ARG_UNUSED(work);
+	int64_t next;
+	int err;
+
+	/* The GPS is stopped after a fix in single fix mode, but not always
+	 * after a timeout.
+	 */
+	if (atomic_clear(&search_timed_out)) {
+		err = gps_stop(gps_dev);
+		if (err) {
+			LOG_ERR("Failed to stop GPS, error: %d", err);
+		}
+	}
+
+	sched_lock();
+	LOG_INF("GPS searches: %u, fixes: %u, mean time to fix: %lld s, "
+		"searching %lld%% of the time",
+		sched.searches, sched.fixes,
+		sched.fixes ? sched.fix_time / sched.fixes : 0,
+		sched.search_time * 100 / MAX(uptime_s(), 1));
+	next = schedule_search();
+	sched_unlock();
+
+	if (next >= 0) {
+		LOG_INF("Next GPS search in %lld seconds, unless motion or "
+			"LTE activity moves it", next);
+	}
+}
+
+static void gps_event_handler(const struct device *dev, struct gps_event *evt)
+{
+	switch (evt->type) {
+	case GPS_EVT_NMEA_FIX:
+		search_end(true);
+		break;
+	case GPS_EVT_SEARCH_TIMEOUT:
+		search_end(false);
+		break;
+	default:
+		break;
+	}
+
+	app_handler(dev, evt);
+}
+#endif /* CONFIG_GPS_CONTROL_SCHEDULER */
+
 static void start(struct k_work *work)
 {
 	ARG_UNUSED(work);
 	int err;
 	struct gps_config gps_cfg = {
-		.nav_mode = GPS_NAV_MODE_PERIODIC,
+		.nav_mode = IS_ENABLED(CONFIG_GPS_CONTROL_SCHEDULER) ?
+			GPS_NAV_MODE_SINGLE_FIX : GPS_NAV_MODE_PERIODIC,
 		.power_mode = GPS_POWER_MODE_DISABLED,
 		.timeout = CONFIG_GPS_CONTROL_FIX_TRY_TIME,
 		.interval = CONFIG_GPS_CONTROL_FIX_TRY_TIME +
@@ -42,6 +190,12 @@ static void start(struct k_work *work)
 		return;
 	}
 
+#if defined(CONFIG_GPS_CONTROL_SCHEDULER)
+	if (!search_is_due()) {
+		return;
+	}
+#endif
+
 #ifdef CONFIG_GPS_CONTROL_PSM_ENABLE_ON_START
 	LOG_INF("Enabling PSM");
 
@@ -53,16 +207,34 @@ static void start(struct k_work *work)
 	}
 #endif /* CONFIG_GPS_CONTROL_PSM_ENABLE_ON_START */
 
+#if defined(CONFIG_GPS_CONTROL_SCHEDULER)
+	/* Before starting, as the fix can come at once */
+	sched_lock();
+	gps_sched_search_start(&sched, uptime_s());
+	sched_unlock();
+#endif
+
 	err = gps_start(gps_dev, &gps_cfg);
 	if (err) {
 		LOG_ERR("Failed to enable GPS, error: %d", err);
+#if defined(CONFIG_GPS_CONTROL_SCHEDULER)
+		sched_lock();
+		gps_sched_search_cancel(&sched);
+		atomic_set(&gps_is_enabled, 0);
+		sched_unlock();
+#else
+		atomic_set(&gps_is_enabled, 0);
+#endif
 		return;
 	}
 
-	atomic_set(&gps_is_enabled, 1);
 	gps_control_set_active(true);
 	ui_led_set_pattern(UI_LED_GPS_SEARCHING);
 
+#if defined(CONFIG_GPS_CONTROL_SCHEDULER)
+	LOG_INF("GPS started, searching for up to %d seconds",
+		CONFIG_GPS_CONTROL_FIX_TRY_TIME);
+#else
 	LOG_INF("GPS started successfully. Searching for satellites ");
 	LOG_INF("to get position fix. This may take several minutes.");
 	LOG_INF("The device will attempt to get a fix for %d seconds, ",
@@ -75,6 +247,7 @@ static void start(struct k_work *work)
 		CONFIG_GPS_CONTROL_FIX_CHECK_INTERVAL);
 #endif
 #endif
+#endif /* CONFIG_GPS_CONTROL_SCHEDULER */
 }
 
 static void stop(struct k_work *work)
@@ -102,9 +275,22 @@ static void stop(struct k_work *work)
 		LOG_ERR("Failed to disable GPS, error: %d", err);
 		return;
 	}
+
+#if defined(CONFIG_GPS_CONTROL_SCHEDULER)
+	/* Under the lock, so that motion and LTE events do not submit the
+	 * start work again.
+	 */
+	sched_lock();
+	atomic_set(&gps_is_enabled, 0);
+	k_delayed_work_cancel(&start_work);
+	gps_sched_search_cancel(&sched);
+	sched_unlock();
+#else
 	k_delayed_work_cancel(&start_work);
 	atomic_set(&gps_is_enabled, 0);
+#endif
 	gps_control_set_active(false);
+
 	LOG_INF("GPS operation was stopped");
 }
 
@@ -125,6 +311,7 @@ bool gps_control_set_active(bool active)
 
 void gps_control_start(uint32_t delay_ms)
 {
+	atomic_set(&gps_is_enabled, 1);
 	k_delayed_work_submit_to_queue(app_work_q, &start_work,
 				       K_MSEC(delay_ms));
 }
@@ -140,6 +327,42 @@ int gps_control_get_gps_reporting_interval(void)
 	return gps_reporting_interval_seconds;
 }
 
+void gps_control_on_motion(void)
+{
+#if defined(CONFIG_GPS_CONTROL_SCHEDULER)
+	sched_lock();
+	gps_sched_motion(&sched, uptime_s());
+	(void)schedule_search();
+	sched_unlock();
+#endif
+}
+
+void gps_control_on_lte_evt(const struct lte_lc_evt *const evt)
+{
+#if defined(CONFIG_GPS_CONTROL_SCHEDULER)
+	sched_lock();
+
+	switch (evt->type) {
+	case LTE_LC_EVT_RRC_UPDATE:
+		gps_sched_rrc(&sched,
+			      evt->rrc_mode == LTE_LC_RRC_MODE_CONNECTED,
+			      uptime_s());
+		(void)schedule_search();
+		break;
+	case LTE_LC_EVT_PSM_UPDATE:
+		gps_sched_psm(&sched, evt->psm_cfg.active_time);
+		(void)schedule_search();
+		break;
+	default:
+		break;
+	}
+
+	sched_unlock();
+#else
+	ARG_UNUSED(evt);
+#endif
+}
+
 /** @brief Configures and starts the GPS device. */
 int gps_control_init(struct k_work_q *work_q, gps_event_handler_t handler)
 {
@@ -163,6 +386,12 @@ int gps_control_init(struct k_work_q *work_q, gps_event_handler_t handler)
 		return -ENODEV;
 	}
 
+#if defined(CONFIG_GPS_CONTROL_SCHEDULER)
+	app_handler = handler;
+	handler = gps_event_handler;
+	k_work_init(&search_end_work, search_end_work_fn);
+#endif
+
 	err = gps_init(gps_dev, handler);
 	if (err) {
 		LOG_ERR("Could not initialize GPS, error: %d", err);
@@ -13,6 +13,7 @@
 #define GPS_CONTROLLER_H__
 
 #include <zephyr.h>
+#include <modem/lte_lc.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -34,6 +35,12 @@ int gps_control_get_gps_reporting_interval(void);
 
 bool gps_control_set_active(bool active);
 
+/**@brief Notify that motion was detected, for the GPS search scheduling. */
+void gps_control_on_motion(void);
+
+/**@brief Forward LTE events, for the GPS search scheduling. */
+void gps_control_on_lte_evt(const struct lte_lc_evt *const evt);
+
 #ifdef __cplusplus
 }
 #endif
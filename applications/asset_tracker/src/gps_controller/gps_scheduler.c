@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <string.h>
+#include <sys/util.h>
+
+#include "gps_scheduler.h"
+
+/* Timed out searches in a row after which the interval stops growing */
+#define BACKOFF_MAX	8
+
+void gps_sched_init(struct gps_sched *sched, const struct gps_sched_cfg *cfg)
+{
+	memset(sched, 0, sizeof(*sched));
+	sched->cfg = *cfg;
+	sched->last_fix = -1;
+	sched->last_start = -1;
+	sched->last_end = -1;
+	sched->last_motion = -1;
+}
+
+void gps_sched_motion(struct gps_sched *sched, int64_t now)
+{
+	sched->last_motion = now;
+}
+
+void gps_sched_rrc(struct gps_sched *sched, bool connected, int64_t now)
+{
+	sched->rrc_connected = connected;
+	sched->rrc_change = now;
+}
+
+void gps_sched_psm(struct gps_sched *sched, int active_time)
+{
+	sched->active_time = MAX(active_time, 0);
+}
+
+void gps_sched_search_start(struct gps_sched *sched, int64_t now)
+{
+	sched->searching = true;
+	sched->last_start = now;
+	sched->searches++;
+}
+
+void gps_sched_search_end(struct gps_sched *sched, bool fix, int64_t now)
+{
+	if (!sched->searching) {
+		return;
+	}
+
+	sched->searching = false;
+	sched->last_end = now;
+	sched->search_time += now - sched->last_start;
+
+	if (fix) {
+		sched->last_fix = now;
+		sched->fixes++;
+		sched->fix_time += now - sched->last_start;
+		sched->failed = 0;
+	} else if (sched->failed < BACKOFF_MAX) {
+		sched->failed++;
+	}
+}
+
+void gps_sched_search_cancel(struct gps_sched *sched)
+{
+	sched->searching = false;
+}
+
+int64_t gps_sched_next(const struct gps_sched *sched, int64_t now)
+{
+	int64_t interval;
+	int64_t due;
+	int64_t idle;
+
+	if (sched->searching) {
+		return GPS_SCHED_SEARCHING;
+	}
+
+	if (sched->last_end < 0) {
+		due = now;
+	} else {
+		interval = MIN((int64_t)sched->cfg.interval << sched->failed,
+			       (int64_t)sched->cfg.overdue);
+		due = sched->last_end + interval;
+	}
+
+	/* Not moved since the last fix, so the position is still known */
+	if (sched->last_fix >= 0 && sched->last_motion < sched->last_fix) {
+		due = MAX(due, sched->last_fix + sched->cfg.overdue);
+	}
+
+	/* The GPS only runs when LTE is idle. With PSM, wait for the active
+	 * time to end too, as the modem listens for paging in it.
+	 */
+	if (sched->rrc_connected) {
+		idle = sched->rrc_change + sched->cfg.rrc_wait;
+	} else {
+		idle = sched->rrc_change + sched->cfg.idle_delay +
+		       MIN(sched->active_time, sched->cfg.psm_wait);
+	}
+
+	return MAX(MAX(due, idle), now);
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**@file
+ *
+ * @brief   GPS search scheduling for asset tracker
+ *
+ * Decides when the next GPS search is started, from the motion of the
+ * device, the age of the last fix and the LTE activity. All times are
+ * uptime in seconds. The scheduler only keeps state, and is driven by the
+ * GPS controller.
+ */
+
+#ifndef GPS_SCHEDULER_H__
+#define GPS_SCHEDULER_H__
+
+#include <zephyr/types.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Returned by @ref gps_sched_next while a search is ongoing. */
+#define GPS_SCHED_SEARCHING -1
+
+struct gps_sched_cfg {
+	/* Time between the end of a search and the next one when moving */
+	uint32_t interval;
+	/* Longest time between fixes when not moving */
+	uint32_t overdue;
+	/* Time after LTE has gone idle before a search is started */
+	uint32_t idle_delay;
+	/* Longest time to wait for LTE to go idle */
+	uint32_t rrc_wait;
+	/* Longest time to wait for the PSM active time to end */
+	uint32_t psm_wait;
+};
+
+struct gps_sched {
+	struct gps_sched_cfg cfg;
+	/* Times of the last events, or -1 if there has been none */
+	int64_t last_fix;
+	int64_t last_start;
+	int64_t last_end;
+	int64_t last_motion;
+	/* Time of the last RRC mode change */
+	int64_t rrc_change;
+	/* PSM active time granted by the network, 0 if PSM is not used */
+	uint32_t active_time;
+	/* Searches in a row that have timed out */
+	uint8_t failed;
+	bool rrc_connected;
+	bool searching;
+
+	/* Statistics */
+	uint32_t searches;
+	uint32_t fixes;
+	/* Total time searching, and time from start to fix */
+	int64_t search_time;
+	int64_t fix_time;
+};
+
+/**@brief Initializes the scheduler. The first search is due at once. */
+void gps_sched_init(struct gps_sched *sched, const struct gps_sched_cfg *cfg);
+
+/**@brief Motion of the device was detected. */
+void gps_sched_motion(struct gps_sched *sched, int64_t now);
+
+/**@brief The LTE RRC mode changed. */
+void gps_sched_rrc(struct gps_sched *sched, bool connected, int64_t now);
+
+/**@brief The PSM parameters changed.
+ *
+ * @param active_time Active time in seconds, or negative if PSM is disabled.
+ */
+void gps_sched_psm(struct gps_sched *sched, int active_time);
+
+/**@brief A search was started. */
+void gps_sched_search_start(struct gps_sched *sched, int64_t now);
+
+/**@brief A search ended.
+ *
+ * @param fix True if a position fix was obtained, false on a timeout.
+ */
+void gps_sched_search_end(struct gps_sched *sched, bool fix, int64_t now);
+
+/**@brief A search was stopped before it ended. */
+void gps_sched_search_cancel(struct gps_sched *sched);
+
+/**@brief Gets the time the next search is to be started.
+ *
+ * A search is due @c interval seconds after the last one, doubling after
+ * each search that times out, up to @c overdue seconds. If the device has
+ * not moved since the last fix, the search is skipped until the fix is
+ * @c overdue seconds old. The search is then held off while LTE is active,
+ * since the GPS can not run at the same time.
+ *
+ * @return Time of the next search, not before @p now, or
+ *         GPS_SCHED_SEARCHING if a search is ongoing.
+ */
+int64_t gps_sched_next(const struct gps_sched *sched, int64_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GPS_SCHEDULER_H__ */
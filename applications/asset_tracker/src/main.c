@@ -25,6 +25,12 @@
 #if defined(CONFIG_NRF_CLOUD_AGPS)
 #include <net/nrf_cloud_agps.h>
 #endif
+#if defined(CONFIG_CLOUD_QUEUE)
+#include <net/cloud_queue.h>
+#endif
+#if defined(CONFIG_CLOUD_STATE_CACHE)
+#include <net/cloud_state_cache.h>
+#endif
 
 #if defined(CONFIG_LWM2M_CARRIER)
 #include <lwm2m_carrier.h>
@@ -126,6 +132,9 @@ static int64_t gps_last_search_start_time;
 static atomic_t carrier_requested_disconnect;
 static atomic_t cloud_connect_attempts;
 
+/* Set when the message queue can store sensor data while disconnected */
+static bool cloud_queue_ready;
+
 #if defined(CONFIG_MOTION)
 /* Flag used for flip detection */
 static bool flip_mode_enabled = true;
@@ -184,6 +193,18 @@ static K_SEM_DEFINE(cloud_ready_to_connect, 0, 1);
 static struct k_delayed_work rsrp_work;
 #endif /* CONFIG_MODEM_INFO */
 
+#if defined(CONFIG_CLOUD_STATE_CACHE)
+/* Device status members that were last reported, so that only the ones
+ * that changed are sent.
+ */
+CLOUD_STATE_CACHE_DEFINE(device_status_cache, 32);
+
+/* Set to send the whole device status next time. The cache is only used
+ * from device_status_send(), on application_work_q.
+ */
+static atomic_t device_status_full;
+#endif
+
 enum error_type {
 	ERROR_CLOUD,
 	ERROR_BSD_RECOVERABLE,
@@ -208,6 +229,8 @@ static void device_status_send(struct k_work *work);
 static void cycle_cloud_connection(struct k_work *work);
 static void set_gps_enable(const bool enable);
 static bool data_send_enabled(void);
+static bool sensor_data_enabled(void);
+static int sensor_msg_send(struct cloud_msg *msg);
 static void connection_evt_handler(const struct cloud_event *const evt);
 static void no_sim_go_offline(struct k_work *work);
 
@@ -666,8 +689,11 @@ static void gps_handler(const struct device *dev, struct gps_event *evt)
 	case GPS_EVT_SEARCH_TIMEOUT:
 		LOG_INF("GPS_EVT_SEARCH_TIMEOUT");
 		gps_control_set_active(false);
+#if !defined(CONFIG_GPS_CONTROL_SCHEDULER)
+		/* Otherwise logged by the GPS controller */
 		LOG_INF("GPS will be attempted again in %d seconds",
 			gps_control_get_gps_reporting_interval());
+#endif
 		break;
 	case GPS_EVT_PVT:
 		/* Don't spam logs */
@@ -693,14 +719,18 @@ static void gps_handler(const struct device *dev, struct gps_event *evt)
 			gps_cloud_data.tag = 0x1;
 		}
 
-		int64_t gps_time_from_start_to_fix_seconds = (k_uptime_get() -
-				gps_last_search_start_time) / 1000;
 		ui_led_set_pattern(UI_LED_GPS_FIX);
 		gps_control_set_active(false);
+#if !defined(CONFIG_GPS_CONTROL_SCHEDULER)
+		int64_t gps_time_from_start_to_fix_seconds = (k_uptime_get() -
+				gps_last_search_start_time) / 1000;
+
+		/* Otherwise logged by the GPS controller */
 		LOG_INF("GPS will be started in %lld seconds",
 			CONFIG_GPS_CONTROL_FIX_TRY_TIME -
 			gps_time_from_start_to_fix_seconds +
 			gps_control_get_gps_reporting_interval());
+#endif
 
 		k_work_submit_to_queue(&application_work_q,
 				       &send_gps_data_work);
@@ -764,7 +794,8 @@ static void button_send(bool pressed)
 #endif
 
 #if defined(CONFIG_MOTION)
-#if IS_ENABLED(CONFIG_GPS_START_ON_MOTION)
+#if IS_ENABLED(CONFIG_GPS_START_ON_MOTION) && \
+	!IS_ENABLED(CONFIG_GPS_CONTROL_SCHEDULER)
 
 static void motion_trigger_gps(motion_data_t  motion_data)
 {
@@ -832,7 +863,9 @@ static void motion_handler(motion_data_t  motion_data)
 				       &motion_data_send_work);
 	}
 
-#if IS_ENABLED(CONFIG_GPS_START_ON_MOTION)
+#if IS_ENABLED(CONFIG_GPS_CONTROL_SCHEDULER)
+	gps_control_on_motion();
+#elif IS_ENABLED(CONFIG_GPS_START_ON_MOTION)
 	motion_trigger_gps(motion_data);
 #endif
 }
@@ -841,7 +874,7 @@ static void motion_data_send(struct k_work *work)
 {
 	ARG_UNUSED(work);
 
-	if (!flip_mode_enabled || !data_send_enabled() ||
+	if (!flip_mode_enabled || !sensor_data_enabled() ||
 	    gps_control_is_active()) {
 		return;
 	}
@@ -854,7 +887,7 @@ static void motion_data_send(struct k_work *work)
 	int err = 0;
 
 	if (cloud_encode_motion_data(&last_motion_data, &msg) == 0) {
-		err = cloud_send(cloud_backend, &msg);
+		err = sensor_msg_send(&msg);
 		cloud_release_data(&msg);
 		if (err) {
 			LOG_ERR("Transmisison of motion data failed: %d", err);
@@ -938,6 +971,10 @@ static void cloud_cmd_handler(struct cloud_command *cmd)
 					       &motion_data_send_work);
 #endif
 		} else if (cmd->channel == CLOUD_CHANNEL_DEVICE_INFO) {
+#if defined(CONFIG_CLOUD_STATE_CACHE)
+			/* Send all of it when asked for */
+			atomic_set(&device_status_full, 1);
+#endif
 			k_work_submit_to_queue(&application_work_q,
 					       &device_status_work);
 		} else if (cmd->channel == CLOUD_CHANNEL_LTE_LINK_RSRP) {
@@ -1082,15 +1119,42 @@ static void device_status_send(struct k_work *work)
 					      &msg);
 	if (ret) {
 		LOG_ERR("Unable to encode cloud data: %d", ret);
-	} else {
-		/* Transmits the data to the cloud. */
-		ret = cloud_send(cloud_backend, &msg);
-		cloud_release_data(&msg);
+		return;
+	}
+
+#if defined(CONFIG_CLOUD_STATE_CACHE)
+	if (atomic_cas(&device_status_full, 1, 0)) {
+		cloud_state_cache_reset(&device_status_cache);
+	}
+
+	ret = cloud_state_cache_delta(&device_status_cache, msg.buf, msg.len,
+				      msg.buf, msg.len + 1);
+	if (ret <= 0) {
 		if (ret) {
-			LOG_ERR("sensor_data_send failed: %d", ret);
-			cloud_error_handler(ret);
+			LOG_ERR("Unable to reduce device status: %d", ret);
+		} else {
+			LOG_DBG("Device status unchanged");
 		}
+
+		cloud_release_data(&msg);
+		return;
+	}
+
+	msg.len = ret;
+#endif
+
+	/* Transmits the data to the cloud. */
+	ret = cloud_send(cloud_backend, &msg);
+	cloud_release_data(&msg);
+	if (ret) {
+		LOG_ERR("sensor_data_send failed: %d", ret);
+		cloud_error_handler(ret);
+		return;
 	}
+
+#if defined(CONFIG_CLOUD_STATE_CACHE)
+	cloud_state_cache_ack(&device_status_cache);
+#endif
 }
 
 /**@brief Send device config to the cloud. */
@@ -1144,7 +1208,7 @@ static void env_data_send(void)
 		.endpoint.type = CLOUD_EP_MSG
 	};
 
-	if (!data_send_enabled()) {
+	if (!sensor_data_enabled()) {
 		return;
 	}
 
@@ -1158,7 +1222,7 @@ static void env_data_send(void)
 	if (env_sensors_get_temperature(&env_data) == 0) {
 		if (cloud_is_send_allowed(CLOUD_CHANNEL_TEMP, env_data.value) &&
 		    cloud_encode_env_sensors_data(&env_data, &msg) == 0) {
-			err = cloud_send(cloud_backend, &msg);
+			err = sensor_msg_send(&msg);
 			cloud_release_data(&msg);
 			if (err) {
 				goto error;
@@ -1170,7 +1234,7 @@ static void env_data_send(void)
 		if (cloud_is_send_allowed(CLOUD_CHANNEL_HUMID,
 					  env_data.value) &&
 		    cloud_encode_env_sensors_data(&env_data, &msg) == 0) {
-			err = cloud_send(cloud_backend, &msg);
+			err = sensor_msg_send(&msg);
 			cloud_release_data(&msg);
 			if (err) {
 				goto error;
@@ -1182,7 +1246,7 @@ static void env_data_send(void)
 		if (cloud_is_send_allowed(CLOUD_CHANNEL_AIR_PRESS,
 					  env_data.value) &&
 		    cloud_encode_env_sensors_data(&env_data, &msg) == 0) {
-			err = cloud_send(cloud_backend, &msg);
+			err = sensor_msg_send(&msg);
 			cloud_release_data(&msg);
 			if (err) {
 				goto error;
@@ -1194,7 +1258,7 @@ static void env_data_send(void)
 		if (cloud_is_send_allowed(CLOUD_CHANNEL_AIR_QUAL,
 					  env_data.value) &&
 		    cloud_encode_env_sensors_data(&env_data, &msg) == 0) {
-			err = cloud_send(cloud_backend, &msg);
+			err = sensor_msg_send(&msg);
 			cloud_release_data(&msg);
 			if (err) {
 				goto error;
@@ -1217,7 +1281,7 @@ void light_sensor_data_send(void)
 	struct cloud_msg msg = { .qos = CLOUD_QOS_AT_MOST_ONCE,
 				 .endpoint.type = CLOUD_EP_MSG };
 
-	if (!data_send_enabled() || gps_control_is_active()) {
+	if (!sensor_data_enabled() || gps_control_is_active()) {
 		return;
 	}
 
@@ -1242,7 +1306,7 @@ void light_sensor_data_send(void)
 		return;
 	}
 
-	err = cloud_send(cloud_backend, &msg);
+	err = sensor_msg_send(&msg);
 	cloud_release_data(&msg);
 
 	if (err) {
@@ -1262,7 +1326,7 @@ static void sensor_data_send(struct cloud_channel_data *data)
 			.endpoint.type = CLOUD_EP_MSG
 		};
 
-	if (!data_send_enabled() || gps_control_is_active()) {
+	if (!sensor_data_enabled() || gps_control_is_active()) {
 		return;
 	}
 
@@ -1270,7 +1334,7 @@ static void sensor_data_send(struct cloud_channel_data *data)
 	if (err) {
 		LOG_ERR("Unable to encode cloud data: %d", err);
 	} else {
-		err = cloud_send(cloud_backend, &msg);
+		err = sensor_msg_send(&msg);
 		cloud_release_data(&msg);
 		if (err) {
 			LOG_ERR("%s failed, data was not sent: %d", __func__,
@@ -1291,6 +1355,23 @@ static bool data_send_enabled(void)
 		   CLOUD_ASSOCIATION_STATE_READY);
 }
 
+/**@brief Check if sensor data can be sent, or stored until it can be sent. */
+static bool sensor_data_enabled(void)
+{
+	return cloud_queue_ready || data_send_enabled();
+}
+
+/**@brief Send sensor data, through the message queue if it is ready. */
+static int sensor_msg_send(struct cloud_msg *msg)
+{
+#if defined(CONFIG_CLOUD_QUEUE)
+	if (cloud_queue_ready) {
+		return cloud_queue_send(msg);
+	}
+#endif
+	return cloud_send(cloud_backend, msg);
+}
+
 /**@brief Callback for sensor attached event from nRF Cloud. */
 void sensors_start(void)
 {
@@ -1402,7 +1483,14 @@ void cloud_event_handler(const struct cloud_backend *const backend,
 		boot_write_img_confirmed();
 #endif
 		atomic_set(&cloud_association, CLOUD_ASSOCIATION_STATE_READY);
+#if defined(CONFIG_CLOUD_STATE_CACHE)
+		/* The device status may have been lost while disconnected */
+		atomic_set(&device_status_full, 1);
+#endif
 		k_work_submit_to_queue(&application_work_q, &sensors_start_work);
+#if defined(CONFIG_CLOUD_QUEUE)
+		cloud_queue_link_set(true);
+#endif
 		break;
 	case CLOUD_EVT_ERROR:
 		LOG_INF("CLOUD_EVT_ERROR");
@@ -1479,6 +1567,10 @@ void connection_evt_handler(const struct cloud_event *const evt)
 		LOG_INF("CLOUD_EVT_DISCONNECTED: %d", evt->data.err);
 		ui_led_set_pattern(UI_LTE_CONNECTED);
 
+#if defined(CONFIG_CLOUD_QUEUE)
+		cloud_queue_link_set(false);
+#endif
+
 		switch (evt->data.err) {
 		case CLOUD_DISCONNECT_INVALID_REQUEST:
 			LOG_INF("Cloud connection closed.");
@@ -1609,6 +1701,19 @@ static void cloud_api_init(void)
 		cloud_error_handler(ret);
 	}
 
+	cloud_codec_encoding_set(cloud_backend->config->encoding);
+
+#if defined(CONFIG_CLOUD_QUEUE)
+	ret = cloud_queue_init(cloud_backend);
+	if (ret) {
+		/* Sensor data is only sent while connected */
+		LOG_ERR("Cloud message queue could not be initialized, error: %d",
+			ret);
+	} else {
+		cloud_queue_ready = true;
+	}
+#endif
+
 	ret = cloud_decode_init(cloud_cmd_handler);
 	if (ret) {
 		LOG_ERR("Cloud command decoder could not be initialized, error: %d",
@@ -1823,6 +1928,8 @@ static void no_sim_go_offline(struct k_work *work)
 #if defined(CONFIG_LTE_LINK_CONTROL)
 static void lte_handler(const struct lte_lc_evt *const evt)
 {
+	gps_control_on_lte_evt(evt);
+
 	switch (evt->type) {
 	case LTE_LC_EVT_NW_REG_STATUS:
 
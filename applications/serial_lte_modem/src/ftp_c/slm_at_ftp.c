@@ -10,9 +10,9 @@
 #include <net/tls_credentials.h>
 #include <net/net_ip.h>
 #include <net/ftp_client.h>
-#include <sys/ring_buffer.h>
 #include "slm_util.h"
 #include "slm_at_host.h"
+#include "slm_passthrough.h"
 #include "slm_at_ftp.h"
 
 LOG_MODULE_REGISTER(ftp, CONFIG_SLM_LOG_LEVEL);
@@ -23,6 +23,7 @@ LOG_MODULE_REGISTER(ftp, CONFIG_SLM_LOG_LEVEL);
 #define FTP_MAX_PASSWORD	32
 #define FTP_MAX_OPTION		32
 #define FTP_MAX_FILEPATH	128
+#define FTP_DATA_BUF_SIZE	NET_IPV4_MTU
 
 #define AT_FTP_STR		"AT#XFTP"
 
@@ -97,8 +98,6 @@ static ftp_op_list_t ftp_op_list[FTP_OP_MAX] = {
 	{FTP_OP_PUT, "put", do_ftp_put},
 };
 
-RING_BUF_DECLARE(ftp_data_buf, CONFIG_AT_CMD_RESPONSE_MAX_LEN / 2);
-
 /* global functions defined in different files */
 void rsp_send(const uint8_t *str, size_t len);
 
@@ -107,50 +106,71 @@ extern struct at_param_list at_param_list;
 extern char rsp_buf[CONFIG_AT_CMD_RESPONSE_MAX_LEN];
 extern struct k_work_q slm_work_q;
 
+static uint8_t data_buf[FTP_DATA_BUF_SIZE];
+static bool data_sent;
+
 void ftp_ctrl_callback(const uint8_t *msg, uint16_t len)
 {
+	/* Separate the data from the reply that follows it */
+	if (data_sent) {
+		rsp_send("\r\n", 2);
+		data_sent = false;
+	}
 	rsp_send((uint8_t *)msg, len);
 }
 
-static int ftp_data_save(uint8_t *data, uint32_t length)
+/* Data is sent as it is received, so the transfer goes at the speed of the
+ * slower of the network and the UART.
+ */
+void ftp_data_callback(const uint8_t *msg, uint16_t len)
 {
-	if (ring_buf_space_get(&ftp_data_buf) < length) {
-		return -1; /* RX overrun */
+	if (slm_util_hex_check((uint8_t *)msg, len)) {
+		int ret;
+		uint16_t size;
+
+		for (uint16_t offset = 0; offset < len; offset += size) {
+			size = MIN(len - offset, (sizeof(rsp_buf) - 1) / 2);
+			ret = slm_util_htoa(msg + offset, size, rsp_buf,
+					    sizeof(rsp_buf));
+			if (ret < 0) {
+				LOG_WRN("hex convert error: %d", ret);
+				return;
+			}
+			rsp_send(rsp_buf, ret);
+		}
+	} else {
+		rsp_send((uint8_t *)msg, len);
 	}
-
-	return ring_buf_put(&ftp_data_buf, data, length);
+	data_sent = true;
 }
 
-static int ftp_data_send(void)
+static int ftp_put_passthrough_send(const uint8_t *data, size_t len)
 {
-	uint32_t sz_send = 0;
-
-	if (ring_buf_is_empty(&ftp_data_buf) == 0) {
-		sz_send = ring_buf_get(&ftp_data_buf, rsp_buf, sizeof(rsp_buf));
-		rsp_send(rsp_buf, sz_send);
-		rsp_send("\r\n", 2);
-	}
+	int ret = ftp_put_data(data, len);
 
-	return sz_send;
+	return (ret < 0) ? ret : len;
 }
 
-void ftp_data_callback(const uint8_t *msg, uint16_t len)
+static void ftp_put_end_fn(struct k_work *work)
 {
-	if (slm_util_hex_check((uint8_t *)msg, len)) {
-		int ret;
-		int size = len * 2;
+	int ret;
 
-		ret = slm_util_htoa(msg, len, rsp_buf, size);
-		if (ret > 0) {
-			ftp_data_save(rsp_buf, ret);
-		} else {
-			LOG_WRN("hex convert error: %d", ret);
-		}
-	} else {
-		ftp_data_save((uint8_t *)msg, len);
+	ARG_UNUSED(work);
+
+	ret = ftp_put_end();
+	if (ret != FTP_CODE_226) {
+		LOG_WRN("Put failed: %d", ret);
 	}
 }
 
+static K_WORK_DEFINE(put_end_work, ftp_put_end_fn);
+
+/* Called when the escape sequence is received */
+static void ftp_put_passthrough_exit(void)
+{
+	k_work_submit_to_queue(&slm_work_q, &put_end_work);
+}
+
 /* AT#XFTP="open",<username>,<password>,<hostname>[,<port>[,<sec_tag>]] */
 /* similar to ftp://<user>:<password>@<host>:<port> */
 static int do_ftp_open(void)
@@ -291,14 +311,9 @@ static int do_ftp_ls(void)
 		target[sz_target] = '\0';
 	}
 
-	ring_buf_reset(&ftp_data_buf);
+	data_sent = false;
 	ret = ftp_list(options, target);
-	if (ret == FTP_CODE_226) {
-		ftp_data_send();
-		return 0;
-	} else {
-		return -1;
-	}
+	return (ret == FTP_CODE_226) ? 0 : -1;
 }
 
 /* AT#XFTP="cd",<folder> */
@@ -423,12 +438,13 @@ static int do_ftp_delete(void)
 	return (ret == FTP_CODE_250) ? 0 : -1;
 }
 
-/* AT#XFTP="get",<file> */
+/* AT#XFTP="get",<file>[,<offset>] */
 static int do_ftp_get(void)
 {
 	int ret;
 	char file[FTP_MAX_FILEPATH];
 	int sz_file = FTP_MAX_FILEPATH;
+	uint32_t offset = 0;
 	int param_count;
 
 	/* Parse AT command */
@@ -441,18 +457,34 @@ static int do_ftp_get(void)
 		return ret;
 	}
 	file[sz_file] = '\0';
+	if (param_count > 3) {
+		ret = at_params_int_get(&at_param_list, 3, &offset);
+		if (ret) {
+			return ret;
+		}
+	}
 
-	ring_buf_reset(&ftp_data_buf);
-	ret = ftp_get(file);
-	if (ret == FTP_CODE_226) {
-		ftp_data_send();
-		return 0;
-	} else {
+	data_sent = false;
+	ret = ftp_get_start(file, offset);
+	if (!FTP_PRELIMINARY_POS(ret)) {
 		return -1;
 	}
+	do {
+		ret = ftp_get_data(data_buf, sizeof(data_buf));
+		if (ret > 0) {
+			ftp_data_callback(data_buf, ret);
+		}
+	} while (ret > 0);
+	if (ret < 0) {
+		LOG_WRN("Get failed: %d", ret);
+	}
+
+	ret = ftp_get_end();
+	return (ret == FTP_CODE_226) ? 0 : -1;
 }
 
-/* AT#XFTP="put",<file>[<datatype>,<data>] */
+/* AT#XFTP="put",<file>[,<offset>] */
+/* AT#XFTP="put",<file>,<datatype>,<data> */
 static int do_ftp_put(void)
 {
 	int ret;
@@ -495,11 +527,32 @@ static int do_ftp_put(void)
 		} else {
 			ret = ftp_put(file, data, size);
 		}
+
+		return (ret == FTP_CODE_226) ? 0 : -1;
+	}
+
+	/* Data follows in pass-through mode, until the escape sequence */
+	if (param_count > 3) {
+		uint32_t offset;
+
+		ret = at_params_int_get(&at_param_list, 3, &offset);
+		if (ret) {
+			return ret;
+		}
+		ret = ftp_put_start(file, offset);
 	} else {
-		ret = ftp_put(file, NULL, 0);
+		ret = ftp_put_start(file, 0);
+	}
+	if (!FTP_PRELIMINARY_POS(ret)) {
+		return -1;
+	}
+	ret = slm_passthrough_enter(ftp_put_passthrough_send,
+				    ftp_put_passthrough_exit);
+	if (ret) {
+		(void)ftp_put_end();
 	}
 
-	return (ret == FTP_CODE_226) ? 0 : -1;
+	return ret;
 }
 
 /**@brief API to handle FTP AT command
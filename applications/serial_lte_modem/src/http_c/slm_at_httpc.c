@@ -13,6 +13,8 @@
 #include <nrf_socket.h>
 #include "slm_at_httpc.h"
 #include "slm_util.h"
+#include "slm_uart.h"
+#include "slm_passthrough.h"
 
 LOG_MODULE_REGISTER(httpc, CONFIG_SLM_LOG_LEVEL);
 
@@ -22,20 +24,22 @@ LOG_MODULE_REGISTER(httpc, CONFIG_SLM_LOG_LEVEL);
 #define HTTPC_HEADER_LEN	512
 #define HTTPC_REQ_LEN		(HTTPC_METHOD_LEN + HTTPC_RES_LEN \
 				+ HTTPC_HEADER_LEN + 3)
-#define HTTPC_FRAG_SIZE		NET_IPV4_MTU
 #define HTTPC_BUF_LEN		1024
 #if HTTPC_REQ_LEN > HTTPC_BUF_LEN
 # error "Please specify larger HTTPC_BUF_LEN"
 #endif
 #define HTTPC_REQ_TO_S		10
 
-/* Buffers for HTTP client. */
+/* Buffers for HTTP client. The request strings are kept here until they
+ * are sent, and the response is then received into it, a buffer at a time.
+ */
 static uint8_t data_buf[HTTPC_BUF_LEN];
 
 /**@brief List of supported AT commands. */
 enum slm_httpc_at_cmd_type {
 	AT_HTTPC_CONNECT,
 	AT_HTTPC_REQUEST,
+	AT_HTTPC_RESPONSE,
 	AT_HTTPC_MAX
 };
 
@@ -48,11 +52,13 @@ enum slm_httpccon_operation {
 /** forward declaration of cmd handlers **/
 static int handle_AT_HTTPC_CONNECT(enum at_cmd_type cmd_type);
 static int handle_AT_HTTPC_REQUEST(enum at_cmd_type cmd_type);
+static int handle_AT_HTTPC_RESPONSE(enum at_cmd_type cmd_type);
 
 /**@brief SLM AT Command list type. */
 static slm_at_cmd_list_t http_at_list[AT_HTTPC_MAX] = {
 	{AT_HTTPC_CONNECT, "AT#XHTTPCCON", handle_AT_HTTPC_CONNECT},
 	{AT_HTTPC_REQUEST, "AT#XHTTPCREQ", handle_AT_HTTPC_REQUEST},
+	{AT_HTTPC_RESPONSE, "AT#XHTTPCRSP", handle_AT_HTTPC_RESPONSE},
 };
 
 static struct slm_httpc_ctx {
@@ -64,10 +70,11 @@ static struct slm_httpc_ctx {
 	char *method_str;		/* request method */
 	char *resource;			/* resource */
 	char *headers;			/* headers */
-	char *payload;			/* payload chunk */
 	size_t pl_len;			/* payload length */
-	size_t pl_to_send;		/* payload to send to server */
-	ssize_t pl_sent;		/* payload sent to server */
+	size_t pl_sent;			/* payload sent to server */
+	int pl_err;			/* payload send error */
+	uint32_t rsp_window;		/* response window, 0 if not used */
+	atomic_t rsp_credit;		/* response bytes the host allows */
 	bool rsp_completed;		/* inticator of completed response */
 } httpc;
 
@@ -83,7 +90,10 @@ extern char rsp_buf[CONFIG_AT_CMD_RESPONSE_MAX_LEN];
 static K_THREAD_STACK_DEFINE(httpc_thread_stack, THREAD_STACK_SIZE);
 
 static K_SEM_DEFINE(http_req_sem, 0, 1);
+/* Given when the payload has been sent, or sending it failed */
 static K_SEM_DEFINE(http_data_sem, 0, 1);
+/* Given when the host allows more response data */
+static K_SEM_DEFINE(http_credit_sem, 0, 1);
 
 static int socket_sectag_set(int fd, int sec_tag)
 {
@@ -113,6 +123,18 @@ static int socket_sectag_set(int fd, int sec_tag)
 		return -errno;
 	}
 
+	if (IS_ENABLED(CONFIG_SLM_TLS_SESSION_CACHE)) {
+		int cache = TLS_SESSION_CACHE_ENABLED;
+
+		err = setsockopt(fd, SOL_TLS, TLS_SESSION_CACHE,
+				 &cache, sizeof(cache));
+		if (err) {
+			/* Not fatal, the handshake is only longer */
+			LOG_WRN("Failed to enable TLS session cache, errno %d",
+				errno);
+		}
+	}
+
 	return 0;
 }
 
@@ -268,35 +290,74 @@ static int server_connect(const char *host, int sec_tag)
 	return fd;
 }
 
+/* Returns how much of len bytes the host allows to be sent, waiting until
+ * it allows some. Returns 0 if disconnected meanwhile.
+ */
+static size_t rsp_credit_take(size_t len)
+{
+	atomic_val_t credit;
+
+	if (httpc.rsp_window == 0) {
+		return len;
+	}
+
+	while ((credit = atomic_get(&httpc.rsp_credit)) == 0) {
+		if (httpc.fd == INVALID_SOCKET) {
+			return 0;
+		}
+		LOG_DBG("wait for response window");
+		k_sem_take(&http_credit_sem, K_FOREVER);
+	}
+	len = MIN(len, (size_t)credit);
+	atomic_sub(&httpc.rsp_credit, len);
+
+	return len;
+}
+
+static void rsp_data_send(const uint8_t *data, size_t len, bool more)
+{
+	char hdr[sizeof("#XHTTPCRSP:4294967295,1\r\n")];
+	struct slm_uart_vec vec[2];
+
+	sprintf(hdr, "#XHTTPCRSP:%zu,%d\r\n", len, more ? 1 : 0);
+	vec[0].data = hdr;
+	vec[0].len = strlen(hdr);
+	vec[1].data = data;
+	vec[1].len = len;
+	slm_uart_tx_writev(vec, ARRAY_SIZE(vec));
+}
+
+/* The response is received into data_buf. The HTTP client calls back when
+ * it is full, and when the response is complete, with the data received
+ * since the last call. While the host has not opened the window, the
+ * callback waits, so the socket is not read, which holds off the server.
+ */
 static void response_cb(struct http_response *rsp,
 			enum http_final_call final_data,
 			void *user_data)
 {
-	static size_t data_received;
+	size_t offset = 0;
+	size_t len;
+	bool more;
 
-	if (rsp->data_len > HTTPC_BUF_LEN) {
-		/* Increase HTTPC_BUF_LEN in case of overflow */
-		LOG_WRN("HTTP parser buffer overflow!");
-		return;
+	if (final_data == HTTP_DATA_FINAL && rsp->data_len == 0) {
+		rsp_data_send(NULL, 0, false);
 	}
-
-	data_received += rsp->data_len;
-	if (final_data == HTTP_DATA_MORE) {
-		LOG_DBG("Partial data received (%zd bytes)", rsp->data_len);
-		if (data_received == HTTPC_BUF_LEN) {
-			sprintf(rsp_buf, "#XHTTPCRSP:%d,1\r\n",
-				HTTPC_BUF_LEN);
-			rsp_send(rsp_buf, strlen(rsp_buf));
-			rsp_send(data_buf, HTTPC_BUF_LEN);
-			data_received = 0;
+	while (offset < rsp->data_len) {
+		len = rsp_credit_take(rsp->data_len - offset);
+		if (len == 0) {
+			LOG_WRN("Disconnected, dropping response");
+			break;
 		}
-	} else if (final_data == HTTP_DATA_FINAL) {
-		LOG_DBG("All the data received (%zd bytes)", data_received);
-		sprintf(rsp_buf, "#XHTTPCRSP:%d,0\r\n", data_received);
-		rsp_send(rsp_buf, strlen(rsp_buf));
-		rsp_send(data_buf, data_received);
+		more = (final_data == HTTP_DATA_MORE ||
+			offset + len < rsp->data_len);
+		rsp_data_send(data_buf + offset, len, more);
+		offset += len;
+	}
+	LOG_DBG("%zu bytes of response sent", offset);
+
+	if (final_data == HTTP_DATA_FINAL) {
 		httpc.rsp_completed = true;
-		data_received = 0;
 	}
 }
 
@@ -319,56 +380,82 @@ static int headers_cb(int sock, struct http_request *req, void *user_data)
 	return len;
 }
 
-static int payload_cb(int sock, struct http_request *req, void *user_data)
+/* Called from the pass-through thread with payload received from the UART.
+ * Data after the payload is dropped.
+ */
+static int payload_send(const uint8_t *data, size_t len)
 {
-	size_t total_sent = 0;
+	size_t to_send = MIN(len, httpc.pl_len - httpc.pl_sent);
+	size_t offset = 0;
+	ssize_t ret;
 
-	if (httpc.pl_len > 0) {
-		sprintf(rsp_buf, "#XHTTPCREQ:1\r\n");
-		rsp_send(rsp_buf, strlen(rsp_buf));
-		do {
-			/* Wait until payload is ready */
-			LOG_DBG("wait until payload is ready");
-			k_sem_take(&http_req_sem, K_FOREVER);
-			if (httpc.pl_len == 0) {
-				LOG_INF("abort sending payload");
-				httpc.pl_sent = 0;
-				return -ECONNABORTED;
-			}
-			if (total_sent + httpc.pl_to_send > httpc.pl_len) {
-				LOG_WRN("send unexpected payload");
-				httpc.pl_to_send = httpc.pl_len - total_sent;
-			}
-			while (httpc.pl_sent < httpc.pl_to_send) {
-				ssize_t ret;
-
-				ret = send(sock, httpc.payload + httpc.pl_sent,
-					   MIN(httpc.pl_to_send - httpc.pl_sent,
-					   HTTPC_FRAG_SIZE), 0);
-				if (ret < 0) {
-					LOG_ERR("send fail: %d", ret);
-					httpc.pl_len = 0;
-					httpc.pl_sent = 0;
-					k_sem_give(&http_data_sem);
-					return -errno;
-				}
-				LOG_DBG("send %d bytes payload", ret);
-				httpc.pl_sent += ret;
-				total_sent += ret;
-			}
-			if (total_sent == httpc.pl_len) {
-				httpc.pl_len = 0;
-			}
+	while (httpc.pl_err == 0 && offset < to_send) {
+		ret = send(httpc.fd, data + offset, to_send - offset, 0);
+		if (ret < 0) {
+			LOG_ERR("send fail: %d", -errno);
+			httpc.pl_err = -errno;
 			k_sem_give(&http_data_sem);
-		} while (total_sent < httpc.pl_len);
-		sprintf(rsp_buf, "#XHTTPCREQ:0\r\n");
-		rsp_send(rsp_buf, strlen(rsp_buf));
-	} else {
+			break;
+		}
+		LOG_DBG("send %d bytes payload", ret);
+		offset += ret;
+	}
+	httpc.pl_sent += offset;
+	if (httpc.pl_err == 0 && httpc.pl_sent == httpc.pl_len) {
+		k_sem_give(&http_data_sem);
+	}
+
+	return len;
+}
+
+/* The payload is sent to the server straight from the pass-through buffer,
+ * as it is received from the UART.
+ */
+static int payload_cb(int sock, struct http_request *req, void *user_data)
+{
+	size_t sent = 0;
+	int err;
+
+	if (httpc.pl_len == 0) {
 		sprintf(rsp_buf, "#XHTTPCREQ:0\r\n");
 		rsp_send(rsp_buf, strlen(rsp_buf));
+		return 0;
+	}
+
+	httpc.pl_sent = 0;
+	httpc.pl_err = 0;
+	k_sem_reset(&http_data_sem);
+	err = slm_passthrough_enter(payload_send, NULL);
+	if (err) {
+		LOG_ERR("Fail to enter pass-through mode: %d", err);
+		httpc.pl_len = 0;
+		return err;
+	}
+	sprintf(rsp_buf, "#XHTTPCREQ:1\r\n");
+	rsp_send(rsp_buf, strlen(rsp_buf));
+
+	/* Wait until payload is sent, as long as it is coming */
+	while (k_sem_take(&http_data_sem, K_SECONDS(HTTPC_REQ_TO_S)) != 0) {
+		if (httpc.pl_sent == sent) {
+			LOG_ERR("No payload received");
+			httpc.pl_err = -ETIMEDOUT;
+			break;
+		}
+		sent = httpc.pl_sent;
+	}
+	slm_passthrough_exit();
+
+	err = httpc.pl_err;
+	sent = httpc.pl_sent;
+	httpc.pl_len = 0;
+	if (err) {
+		return err;
 	}
+	LOG_DBG("%d bytes payload sent", sent);
+	sprintf(rsp_buf, "#XHTTPCREQ:0\r\n");
+	rsp_send(rsp_buf, strlen(rsp_buf));
 
-	return total_sent;
+	return sent;
 }
 
 static int do_http_connect(void)
@@ -407,9 +494,11 @@ static int do_http_disconnect(void)
 	}
 	if (httpc.pl_len > 0) {
 		LOG_ERR("Exit request");
-		httpc.pl_len = 0;
-		k_sem_give(&http_req_sem);
+		httpc.pl_err = -ECONNABORTED;
+		k_sem_give(&http_data_sem);
 	}
+	/* Stop waiting for the response window */
+	k_sem_give(&http_credit_sem);
 	sprintf(rsp_buf, "#XHTTPCCON:0\r\n");
 	rsp_send(rsp_buf, strlen(rsp_buf));
 
@@ -463,6 +552,7 @@ static int do_http_request(void)
 	req.recv_buf_len = HTTPC_BUF_LEN;
 	req.payload_cb =  payload_cb;
 	req.optional_headers_cb = headers_cb;
+	httpc.rsp_completed = false;
 	err = http_client_req(httpc.fd, &req, timeout, "");
 	if (err < 0) {
 		/* Socket send/recv error */
@@ -579,7 +669,7 @@ static int handle_AT_HTTPC_CONNECT(enum at_cmd_type cmd_type)
 
 
 /**@brief handle AT#XHTTPCREQ commands
- *  AT#XHTTPCREQ=<method>,<resource>,<header>[,<payload_length>]
+ *  AT#XHTTPCREQ=<method>,<resource>,<header>[,<payload_length>[,<rsp_window>]]
  *  AT#XHTTPCREQ? READ command not supported
  *  AT#XHTTPCREQ=?
  */
@@ -636,6 +726,7 @@ static int handle_AT_HTTPC_REQUEST(enum at_cmd_type cmd_type)
 		}
 		data_buf[offset + headers_sz] = '\0';
 		httpc.headers = data_buf + offset;
+		httpc.pl_len = 0;
 		if (param_count >= 5) {
 			err = at_params_int_get(&at_param_list, 4,
 						  &httpc.pl_len);
@@ -643,6 +734,17 @@ static int handle_AT_HTTPC_REQUEST(enum at_cmd_type cmd_type)
 				return err;
 			}
 		}
+		httpc.rsp_window = 0;
+		if (param_count >= 6) {
+			err = at_params_int_get(&at_param_list, 5,
+						&httpc.rsp_window);
+			if (err != 0) {
+				httpc.pl_len = 0;
+				return err;
+			}
+		}
+		atomic_set(&httpc.rsp_credit, httpc.rsp_window);
+		k_sem_reset(&http_credit_sem);
 		/* start sending request */
 		k_sem_give(&http_req_sem);
 		break;
@@ -657,9 +759,54 @@ static int handle_AT_HTTPC_REQUEST(enum at_cmd_type cmd_type)
 	return err;
 }
 
+/**@brief handle AT#XHTTPCRSP commands
+ *  AT#XHTTPCRSP=<length>
+ *  AT#XHTTPCRSP? READ command not supported
+ *  AT#XHTTPCRSP=?
+ */
+static int handle_AT_HTTPC_RESPONSE(enum at_cmd_type cmd_type)
+{
+	int err = -EINVAL;
+	uint32_t length;
+
+	switch (cmd_type) {
+	case AT_CMD_TYPE_SET_COMMAND:
+		if (at_params_valid_count_get(&at_param_list) < 2) {
+			return -EINVAL;
+		}
+		err = at_params_int_get(&at_param_list, 1, &length);
+		if (err < 0) {
+			LOG_ERR("Fail to get length: %d", err);
+			return err;
+		}
+		if (httpc.rsp_window == 0) {
+			LOG_ERR("Response window not used.");
+			return -EINVAL;
+		}
+		/* Allow at most one window of data not yet read by host */
+		if (atomic_add(&httpc.rsp_credit, length) + length >
+		    httpc.rsp_window) {
+			atomic_set(&httpc.rsp_credit, httpc.rsp_window);
+		}
+		k_sem_give(&http_credit_sem);
+		break;
+
+	case AT_CMD_TYPE_TEST_COMMAND:
+		sprintf(rsp_buf, "#XHTTPCRSP: <length>\r\n");
+		rsp_send(rsp_buf, strlen(rsp_buf));
+		err = 0;
+		break;
+
+	default:
+		break;
+	}
+
+	return err;
+}
+
 /**@brief API to handle HTTP AT commands
  */
-int slm_at_httpc_parse(const char *at_cmd, size_t length)
+int slm_at_httpc_parse(const char *at_cmd)
 {
 	int ret = -ENOENT;
 	enum at_cmd_type type;
@@ -678,22 +825,7 @@ int slm_at_httpc_parse(const char *at_cmd, size_t length)
 		}
 	}
 
-	/* Return if no payload to send */
-	if (ret != -ENOENT || (httpc.pl_len == 0)) {
-		return ret;
-	}
-	/* Process input data as payload */
-	httpc.payload = (char *)at_cmd;
-	httpc.pl_to_send = length;
-	httpc.pl_sent = 0;
-	/* start sending payload */
-	k_sem_give(&http_req_sem);
-	/* Don't go any further until send returns */
-	k_sem_take(&http_data_sem, K_FOREVER);
-	if (httpc.pl_sent <= 0) {
-		return -EINVAL;
-	}
-	return 0;
+	return ret;
 }
 
 static void httpc_thread_fn(void *arg1, void *arg2, void *arg3)
@@ -19,14 +19,12 @@
 /**
  * @brief HTTPC AT command parser.
  *
- * @param at_cmd AT command or data string.
- * @param length AT command or data string length.
+ * @param at_cmd AT command string.
  *
  * @retval 0 If the operation was successful.
- *           Otherwise, negative code means error.
- *           Otherwise, positive code means data is sent in passthrough mode.
+ *           Otherwise, a (negative) error code is returned.
  */
-int slm_at_httpc_parse(const char *at_cmd, size_t length);
+int slm_at_httpc_parse(const char *at_cmd);
 
 /**
  * @brief Initialize HTTPC AT command parser.
@@ -11,6 +11,8 @@
 #include <net/socket.h>
 #include <random/rand32.h>
 #include "slm_util.h"
+#include "slm_poll.h"
+#include "slm_uart.h"
 #include "slm_native_tls.h"
 #include "slm_at_mqtt.h"
 
@@ -22,6 +24,8 @@ LOG_MODULE_REGISTER(mqtt, CONFIG_SLM_LOG_LEVEL);
 #define MQTT_MAX_USERNAME_LEN	64
 #define MQTT_MAX_PASSWORD_LEN	64
 #define MQTT_MESSAGE_BUFFER_LEN	NET_IPV4_MTU
+#define MQTT_PUB_INFLIGHT_MAX	CONFIG_SLM_MQTT_PUB_INFLIGHT_MAX
+#define MQTT_PUB_RETRY_MS	(CONFIG_SLM_MQTT_PUB_RETRY_TIME * MSEC_PER_SEC)
 
 #define INVALID_FDS -1
 
@@ -31,6 +35,12 @@ enum slm_mqttcon_operation {
 	AT_MQTTCON_CONNECT
 };
 
+/**@brief MQTT publish modes. */
+enum slm_mqttpub_mode {
+	AT_MQTTPUB_SYNC,
+	AT_MQTTPUB_ASYNC
+};
+
 /**@brief MQTT subscribe operations. */
 enum slm_mqttsub_operation {
 	AT_MQTTSUB_UNSUB,
@@ -80,11 +90,6 @@ void rsp_send(const uint8_t *str, size_t len);
 extern struct at_param_list at_param_list;
 extern char rsp_buf[CONFIG_AT_CMD_RESPONSE_MAX_LEN];
 
-#define THREAD_STACK_SIZE	KB(2)
-#define THREAD_PRIORITY		K_LOWEST_APPLICATION_THREAD_PRIO
-
-static K_THREAD_STACK_DEFINE(mqtt_thread_stack, THREAD_STACK_SIZE);
-
 /* Buffers for MQTT client. */
 static uint8_t rx_buffer[MQTT_MESSAGE_BUFFER_LEN];
 static uint8_t tx_buffer[MQTT_MESSAGE_BUFFER_LEN];
@@ -96,14 +101,36 @@ static struct mqtt_client client;
 /* MQTT Broker details. */
 static struct sockaddr_storage broker;
 
-/* Connected flag */
-static K_SEM_DEFINE(mqtt_connected, 0, 1);
-
 /* File descriptor */
-static struct pollfd fds = {
-	.fd = INVALID_FDS,
+static int mqtt_fd = INVALID_FDS;
+
+/*
+ * Messages published with the async flag are copied into the queue and
+ * sent from the system work queue, so the host can publish the next one
+ * without waiting for the broker. Messages with QoS 1 or 2 stay queued
+ * until the broker acknowledges them, and are sent again if it does not.
+ */
+struct pub_msg {
+	sys_snode_t node;
+	int64_t sent_time;	/* Uptime when last sent, 0 if not sent. */
+	uint16_t message_id;
+	uint8_t qos;
+	uint8_t retain;
+	uint16_t topic_len;
+	uint16_t msg_len;
+	uint8_t data[];		/* Topic followed by message. */
 };
 
+K_HEAP_DEFINE(pub_heap, CONFIG_SLM_MQTT_PUB_QUEUE_SIZE);
+static sys_slist_t pub_queue;
+static uint16_t pub_queued;
+static uint16_t pub_inflight;
+static uint16_t pub_next_id;
+
+static K_MUTEX_DEFINE(pub_mutex);
+
+static struct k_delayed_work pub_work;
+
 static int do_mqtt_disconnect(void);
 
 /**@brief Function to read the published payload.
@@ -117,6 +144,28 @@ static int publish_get_payload(struct mqtt_client *c, size_t length)
 	return mqtt_readall_publish_payload(c, payload_buf, length);
 }
 
+/**@brief Function to send a received message in one piece.
+ */
+static void publish_send(int type, const struct mqtt_topic *topic,
+			 const uint8_t *data, int len)
+{
+	struct slm_uart_vec vec[5];
+
+	sprintf(rsp_buf, "#XMQTTMSG: %d,%d,%d\r\n",
+		type, topic->topic.size, len);
+	vec[0].data = rsp_buf;
+	vec[0].len = strlen(rsp_buf);
+	vec[1].data = topic->topic.utf8;
+	vec[1].len = topic->topic.size;
+	vec[2].data = "\r\n";
+	vec[2].len = 2;
+	vec[3].data = data;
+	vec[3].len = len;
+	vec[4].data = "\r\n";
+	vec[4].len = 2;
+	slm_uart_tx_writev(vec, ARRAY_SIZE(vec));
+}
+
 /**@brief Function to handle received publish event.
  */
 static int handle_mqtt_publish_evt(struct mqtt_client *const c,
@@ -141,33 +190,219 @@ static int handle_mqtt_publish_evt(struct mqtt_client *const c,
 		if (ret < 0) {
 			return ret;
 		}
-		sprintf(rsp_buf, "#XMQTTMSG: %d,%d,%d\r\n",
-			DATATYPE_HEXADECIMAL,
-			evt->param.publish.message.topic.topic.size,
-			ret);
-		rsp_send(rsp_buf, strlen(rsp_buf));
-		rsp_send(evt->param.publish.message.topic.topic.utf8,
-			evt->param.publish.message.topic.topic.size);
-		rsp_send("\r\n", 2);
-		rsp_send(data_hex, ret);
-		rsp_send("\r\n", 2);
+		publish_send(DATATYPE_HEXADECIMAL,
+			     &evt->param.publish.message.topic,
+			     data_hex, ret);
 	} else {
-		sprintf(rsp_buf, "#XMQTTMSG: %d,%d,%d\r\n",
-			DATATYPE_PLAINTEXT,
-			evt->param.publish.message.topic.topic.size,
-			evt->param.publish.message.payload.len);
-		rsp_send(rsp_buf, strlen(rsp_buf));
-		rsp_send(evt->param.publish.message.topic.topic.utf8,
-			evt->param.publish.message.topic.topic.size);
-		rsp_send("\r\n", 2);
-		rsp_send(payload_buf,
-			evt->param.publish.message.payload.len);
-		rsp_send("\r\n", 2);
+		publish_send(DATATYPE_PLAINTEXT,
+			     &evt->param.publish.message.topic,
+			     payload_buf,
+			     evt->param.publish.message.payload.len);
 	}
 
 	return 0;
 }
 
+/**@brief Function to get the ID of the next published message, so that
+ * IDs of queued and other messages do not clash.
+ */
+static uint16_t pub_id_next(void)
+{
+	uint16_t id;
+
+	k_mutex_lock(&pub_mutex, K_FOREVER);
+	/* Message ID 0 is not allowed */
+	if (++pub_next_id == 0) {
+		pub_next_id = 1;
+	}
+	id = pub_next_id;
+	k_mutex_unlock(&pub_mutex);
+
+	return id;
+}
+
+/**@brief Function to remove a message from the publish queue.
+ * Called with pub_mutex held.
+ */
+static void pub_remove(struct pub_msg *msg, struct pub_msg *prev)
+{
+	sys_slist_remove(&pub_queue, prev ? &prev->node : NULL, &msg->node);
+	if (msg->sent_time != 0) {
+		pub_inflight--;
+	}
+	pub_queued--;
+	k_heap_free(&pub_heap, msg);
+}
+
+/**@brief Function to release a queued message acknowledged by broker.
+ */
+static void pub_ack(uint16_t message_id)
+{
+	struct pub_msg *msg;
+	struct pub_msg *prev = NULL;
+
+	k_mutex_lock(&pub_mutex, K_FOREVER);
+	SYS_SLIST_FOR_EACH_CONTAINER(&pub_queue, msg, node) {
+		if (msg->sent_time != 0 && msg->message_id == message_id) {
+			pub_remove(msg, prev);
+			/* Room for one more in flight */
+			k_delayed_work_submit(&pub_work, K_NO_WAIT);
+			break;
+		}
+		prev = msg;
+	}
+	k_mutex_unlock(&pub_mutex);
+}
+
+/**@brief Function to drop all queued messages. Called with pub_mutex held.
+ */
+static void pub_remove_all(void)
+{
+	struct pub_msg *msg;
+
+	while ((msg = SYS_SLIST_PEEK_HEAD_CONTAINER(&pub_queue, msg,
+						    node)) != NULL) {
+		pub_remove(msg, NULL);
+	}
+}
+
+/**@brief Function to send a queued message. Called with pub_mutex held.
+ */
+static int pub_send(struct pub_msg *msg, bool dup)
+{
+	struct mqtt_publish_param param;
+
+	param.message.topic.qos = msg->qos;
+	param.message.topic.topic.utf8 = msg->data;
+	param.message.topic.topic.size = msg->topic_len;
+	param.message.payload.data = msg->data + msg->topic_len;
+	param.message.payload.len = msg->msg_len;
+	param.message_id = msg->message_id;
+	param.dup_flag = dup ? 1 : 0;
+	param.retain_flag = msg->retain;
+
+	return mqtt_publish(&client, &param);
+}
+
+/**@brief Function to send queued messages, and to send again those not
+ * acknowledged in time.
+ */
+static void pub_work_fn(struct k_work *work)
+{
+	struct pub_msg *msg;
+	struct pub_msg *next;
+	struct pub_msg *prev = NULL;
+	int64_t now = k_uptime_get();
+	int64_t oldest = 0;
+	bool dup;
+	int err;
+
+	ARG_UNUSED(work);
+
+	k_mutex_lock(&pub_mutex, K_FOREVER);
+	if (!ctx.connected) {
+		/* Connection lost, the messages can not be sent anymore */
+		if (pub_queued) {
+			LOG_WRN("Dropped %u queued publishes", pub_queued);
+		}
+		pub_remove_all();
+		k_mutex_unlock(&pub_mutex);
+		return;
+	}
+	SYS_SLIST_FOR_EACH_CONTAINER_SAFE(&pub_queue, msg, next, node) {
+		dup = (msg->sent_time != 0);
+		if (!dup && pub_inflight >= MQTT_PUB_INFLIGHT_MAX) {
+			/* Sent when an acknowledgment makes room */
+			break;
+		}
+		if (!dup || now - msg->sent_time >= MQTT_PUB_RETRY_MS) {
+			err = pub_send(msg, dup);
+			if (err) {
+				/* Tried again after the retry time */
+				LOG_WRN("Queued publish %u failed: %d",
+					msg->message_id, err);
+				if (oldest == 0) {
+					oldest = now;
+				}
+				break;
+			}
+			if (msg->qos == MQTT_QOS_0_AT_MOST_ONCE) {
+				pub_remove(msg, prev);
+				continue;
+			}
+			if (!dup) {
+				pub_inflight++;
+			}
+			msg->sent_time = now;
+		}
+
+		if (oldest == 0 || msg->sent_time < oldest) {
+			oldest = msg->sent_time;
+		}
+		prev = msg;
+	}
+	k_mutex_unlock(&pub_mutex);
+
+	if (!ctx.connected) {
+		/* Disconnected while sending */
+		k_delayed_work_submit(&pub_work, K_NO_WAIT);
+	} else if (oldest != 0) {
+		k_delayed_work_submit(&pub_work,
+			K_MSEC(MAX(oldest + MQTT_PUB_RETRY_MS - now, 0)));
+	}
+}
+
+/**@brief Function to copy a message into the publish queue.
+ */
+static int pub_enqueue(uint16_t qos, uint16_t retain,
+		       const uint8_t *topic, size_t topic_len,
+		       const uint8_t *msg, size_t msg_len)
+{
+	struct pub_msg *pub;
+
+	if (qos > MQTT_QOS_2_EXACTLY_ONCE || retain > 1) {
+		return -EINVAL;
+	}
+	if (!ctx.connected) {
+		return -ENOTCONN;
+	}
+
+	pub = k_heap_alloc(&pub_heap, sizeof(*pub) + topic_len + msg_len,
+			   K_NO_WAIT);
+	if (pub == NULL) {
+		LOG_WRN("Publish queue full");
+		return -ENOBUFS;
+	}
+	pub->sent_time = 0;
+	pub->qos = (uint8_t)qos;
+	pub->retain = (uint8_t)retain;
+	pub->topic_len = topic_len;
+	pub->msg_len = msg_len;
+	memcpy(pub->data, topic, topic_len);
+	memcpy(pub->data + topic_len, msg, msg_len);
+
+	pub->message_id = pub_id_next();
+
+	k_mutex_lock(&pub_mutex, K_FOREVER);
+	sys_slist_append(&pub_queue, &pub->node);
+	pub_queued++;
+	k_mutex_unlock(&pub_mutex);
+
+	k_delayed_work_submit(&pub_work, K_NO_WAIT);
+
+	return 0;
+}
+
+/**@brief Function to drop all queued messages.
+ */
+static void pub_flush(void)
+{
+	k_delayed_work_cancel(&pub_work);
+	k_mutex_lock(&pub_mutex, K_FOREVER);
+	pub_remove_all();
+	k_mutex_unlock(&pub_mutex);
+}
+
 /**@brief MQTT client event handler
  */
 void mqtt_evt_handler(struct mqtt_client *const c,
@@ -181,10 +416,18 @@ void mqtt_evt_handler(struct mqtt_client *const c,
 		if (evt->result != 0) {
 			ctx.connected = false;
 		}
+		/* Send the messages queued while waiting for CONNACK, or drop
+		 * them if refused
+		 */
+		k_delayed_work_submit(&pub_work, K_NO_WAIT);
 		break;
 
 	case MQTT_EVT_DISCONNECT:
 		ctx.connected = false;
+		/* The queue is dropped from the work queue, since this can be
+		 * called from mqtt_publish() in pub_work_fn()
+		 */
+		k_delayed_work_submit(&pub_work, K_NO_WAIT);
 		break;
 
 	case MQTT_EVT_PUBLISH:
@@ -195,6 +438,7 @@ void mqtt_evt_handler(struct mqtt_client *const c,
 		if (evt->result == 0) {
 			LOG_DBG("PUBACK packet id: %u\n",
 					evt->param.puback.message_id);
+			pub_ack(evt->param.puback.message_id);
 		}
 		break;
 
@@ -203,6 +447,7 @@ void mqtt_evt_handler(struct mqtt_client *const c,
 			break;
 		}
 		LOG_DBG("PUBREC packet id: %u", evt->param.pubrec.message_id);
+		pub_ack(evt->param.pubrec.message_id);
 		{
 			struct mqtt_pubrel_param param = {
 				.message_id = evt->param.pubrel.message_id
@@ -262,44 +507,48 @@ void mqtt_evt_handler(struct mqtt_client *const c,
 	rsp_send(rsp_buf, strlen(rsp_buf));
 }
 
-static void mqtt_thread_fn(void *arg1, void *arg2, void *arg3)
+/* MQTT client socket, polled in the poll thread */
+static void mqtt_handler(int fd, int revents, void *arg)
 {
 	int err;
 
-	while (1) {
-		/* Don't go any further until MQTT is connected */
-		k_sem_take(&mqtt_connected, K_FOREVER);
-		while (ctx.connected) {
-			err = poll(&fds, 1, mqtt_keepalive_time_left(&client));
-			if (err < 0) {
-				LOG_ERR("ERROR: poll %d", errno);
-				break;
-			}
-			err = mqtt_live(&client);
-			if ((err != 0) && (err != -EAGAIN)) {
-				LOG_ERR("ERROR: mqtt_live %d", err);
-				break;
-			}
-			if ((fds.revents & POLLIN) == POLLIN) {
-				err = mqtt_input(&client);
-				if (err != 0) {
-					LOG_ERR("ERROR: mqtt_input %d", err);
-					mqtt_abort(&client);
-					break;
-				}
-			}
-			if ((fds.revents & POLLERR) == POLLERR) {
-				LOG_ERR("POLLERR");
-				mqtt_abort(&client);
-				break;
-			}
-			if ((fds.revents & POLLNVAL) == POLLNVAL) {
-				LOG_ERR("POLLNVAL");
-				mqtt_abort(&client);
-				break;
-			}
+	ARG_UNUSED(arg);
+
+	err = mqtt_live(&client);
+	if ((err != 0) && (err != -EAGAIN)) {
+		LOG_ERR("ERROR: mqtt_live %d", err);
+		goto stop;
+	}
+	if ((revents & POLLIN) == POLLIN) {
+		err = mqtt_input(&client);
+		if (err != 0) {
+			LOG_ERR("ERROR: mqtt_input %d", err);
+			mqtt_abort(&client);
+			goto stop;
 		}
 	}
+	if ((revents & POLLERR) == POLLERR) {
+		LOG_ERR("POLLERR");
+		mqtt_abort(&client);
+		goto stop;
+	}
+	if ((revents & POLLNVAL) == POLLNVAL) {
+		LOG_ERR("POLLNVAL");
+		mqtt_abort(&client);
+		goto stop;
+	}
+	if (!ctx.connected) {
+		goto stop;
+	}
+
+	/* Call again in time to keep the connection alive */
+	(void)slm_poll_timeout_set(fd, mqtt_keepalive_time_left(&client));
+	return;
+
+stop:
+	(void)slm_poll_remove(fd);
+	ctx.connected = false;
+	k_delayed_work_submit(&pub_work, K_NO_WAIT);
 }
 
 /**@brief Resolves the configured hostname and
@@ -424,6 +673,9 @@ static int client_init(void)
 		tls_config->sec_tag_count = 1;
 		tls_config->sec_tag_list = (int *)&ctx.sec_tag;
 		tls_config->hostname = ctx.url;
+		tls_config->session_cache =
+			IS_ENABLED(CONFIG_SLM_TLS_SESSION_CACHE) ?
+			TLS_SESSION_CACHE_ENABLED : TLS_SESSION_CACHE_DISABLED;
 		client.transport.type = MQTT_TRANSPORT_SECURE;
 	} else {
 		client.transport.type = MQTT_TRANSPORT_NON_SECURE;
@@ -432,22 +684,20 @@ static int client_init(void)
 	return err;
 }
 
-/**@brief Initialize the file descriptor structure used by poll.
+/**@brief Initialize the file descriptor used by poll.
  */
 static int fds_init(struct mqtt_client *c)
 {
 	if (c->transport.type == MQTT_TRANSPORT_NON_SECURE) {
-		fds.fd = c->transport.tcp.sock;
+		mqtt_fd = c->transport.tcp.sock;
 	} else {
 #if defined(CONFIG_MQTT_LIB_TLS)
-		fds.fd = c->transport.tls.sock;
+		mqtt_fd = c->transport.tls.sock;
 #else
 		return -ENOTSUP;
 #endif
 	}
 
-	fds.events = POLLIN;
-
 	return 0;
 }
 
@@ -496,7 +746,16 @@ static int do_mqtt_connect(void)
 
 	/** start polling now for CONNACK */
 	ctx.connected = true;
-	k_sem_give(&mqtt_connected);
+	err = slm_poll_add(mqtt_fd, POLLIN, mqtt_handler, NULL);
+	if (err != 0) {
+		LOG_ERR("ERROR: slm_poll_add %d", err);
+		mqtt_abort(&client);
+		ctx.connected = false;
+		slm_at_mqtt_uninit();
+		return err;
+	}
+	(void)slm_poll_timeout_set(mqtt_fd,
+				   mqtt_keepalive_time_left(&client));
 
 	return 0;
 }
@@ -505,6 +764,8 @@ static int do_mqtt_disconnect(void)
 {
 	int err;
 
+	/* Stop polling before the socket is closed */
+	(void)slm_poll_remove(mqtt_fd);
 	err = mqtt_disconnect(&client);
 	if (err) {
 		LOG_ERR("ERROR: mqtt_disconnect %d", err);
@@ -545,7 +806,7 @@ static int do_mqtt_publish(uint16_t qos, uint16_t retain,
 	param.message.topic.topic.size = topic_len;
 	param.message.payload.data = msg;
 	param.message.payload.len = msg_len;
-	param.message_id = sys_rand32_get();
+	param.message_id = pub_id_next();
 	param.dup_flag = 0;
 
 	return mqtt_publish(&client, &param);
@@ -703,8 +964,8 @@ static int handle_at_mqtt_connect(enum at_cmd_type cmd_type)
 }
 
 /**@brief handle AT#XMQTTPUB commands
- *  AT#XMQTTPUB=<topic>,<datatype>,<msg>,<qos>,<retain>
- *  AT#XMQTTPUB? READ command not supported
+ *  AT#XMQTTPUB=<topic>,<datatype>,<msg>,<qos>,<retain>[,<async>]
+ *  AT#XMQTTPUB?
  *  AT#XMQTTPUB=?
  */
 static int handle_at_mqtt_publish(enum at_cmd_type cmd_type)
@@ -712,6 +973,7 @@ static int handle_at_mqtt_publish(enum at_cmd_type cmd_type)
 	int err = -EINVAL;
 
 	uint16_t qos, retain, datatype;
+	uint16_t mode = AT_MQTTPUB_SYNC;
 	uint8_t topic[MQTT_MAX_TOPIC_LEN];
 	size_t topic_sz = MQTT_MAX_TOPIC_LEN;
 	uint8_t msg[MQTT_MESSAGE_BUFFER_LEN];
@@ -719,7 +981,7 @@ static int handle_at_mqtt_publish(enum at_cmd_type cmd_type)
 
 	switch (cmd_type) {
 	case AT_CMD_TYPE_SET_COMMAND:
-		if (at_params_valid_count_get(&at_param_list) != 6) {
+		if (at_params_valid_count_get(&at_param_list) < 6) {
 			return -EINVAL;
 		}
 		err = at_params_string_get(&at_param_list, 1, topic, &topic_sz);
@@ -744,17 +1006,35 @@ static int handle_at_mqtt_publish(enum at_cmd_type cmd_type)
 		if (err < 0) {
 			return err;
 		}
+		if (at_params_valid_count_get(&at_param_list) > 6) {
+			err = at_params_short_get(&at_param_list, 6, &mode);
+			if (err < 0) {
+				return err;
+			}
+			if (mode > AT_MQTTPUB_ASYNC) {
+				return -EINVAL;
+			}
+		}
 		if (datatype == DATATYPE_HEXADECIMAL) {
 			size_t data_len = msg_sz / 2;
 			uint8_t data_hex[data_len];
 
 			data_len = slm_util_atoh(msg, msg_sz,
 						data_hex, data_len);
-			if (data_len > 0) {
+			if (data_len == 0) {
+				err = -EINVAL;
+			} else if (mode == AT_MQTTPUB_ASYNC) {
+				err = pub_enqueue(qos, retain,
+						  topic, topic_sz,
+						  data_hex, data_len);
+			} else {
 				err = do_mqtt_publish(qos, retain,
 							topic, topic_sz,
 							data_hex, data_len);
 			}
+		} else if (mode == AT_MQTTPUB_ASYNC) {
+			err = pub_enqueue(qos, retain, topic, topic_sz,
+					  msg, msg_sz);
 		} else {
 			err = do_mqtt_publish(qos, retain,
 						topic, topic_sz,
@@ -765,9 +1045,18 @@ static int handle_at_mqtt_publish(enum at_cmd_type cmd_type)
 		}
 		break;
 
+	case AT_CMD_TYPE_READ_COMMAND:
+		k_mutex_lock(&pub_mutex, K_FOREVER);
+		sprintf(rsp_buf, "#XMQTTPUB: %d,%d\r\n",
+			pub_queued, pub_inflight);
+		k_mutex_unlock(&pub_mutex);
+		rsp_send(rsp_buf, strlen(rsp_buf));
+		err = 0;
+		break;
+
 	case AT_CMD_TYPE_TEST_COMMAND:
 		sprintf(rsp_buf, "#XMQTTPUB: <topic>, (0, 1), <msg>,"
-					" (0, 1, 2), (0, 1)\r\n");
+					" (0, 1, 2), (0, 1), (0, 1)\r\n");
 		rsp_send(rsp_buf, strlen(rsp_buf));
 		err = 0;
 		break;
@@ -900,17 +1189,17 @@ void slm_at_mqtt_clac(void)
 
 int slm_at_mqtt_init(void)
 {
+	k_delayed_work_init(&pub_work, pub_work_fn);
+
 	return 0;
 }
 
 int slm_at_mqtt_uninit(void)
 {
+	pub_flush();
 	client.broker = NULL;
-	fds.fd = INVALID_FDS;
+	(void)slm_poll_remove(mqtt_fd);
+	mqtt_fd = INVALID_FDS;
 
 	return 0;
 }
-
-K_THREAD_DEFINE(mqtt_thread, K_THREAD_STACK_SIZEOF(mqtt_thread_stack),
-		mqtt_thread_fn, NULL, NULL, NULL,
-		THREAD_PRIORITY, 0, 0);
@@ -18,6 +18,8 @@
 LOG_MODULE_REGISTER(at_host, CONFIG_SLM_LOG_LEVEL);
 
 #include "slm_util.h"
+#include "slm_uart.h"
+#include "slm_passthrough.h"
 #include "slm_at_host.h"
 #include "slm_at_tcp_proxy.h"
 #include "slm_at_udp_proxy.h"
@@ -58,7 +60,7 @@ LOG_MODULE_REGISTER(at_host, CONFIG_SLM_LOG_LEVEL);
 
 #define AT_MAX_CMD_LEN	CONFIG_AT_CMD_RESPONSE_MAX_LEN
 #define UART_RX_BUF_NUM	2
-#define UART_RX_LEN	256
+#define UART_RX_LEN	CONFIG_SLM_UART_RX_BUF_SIZE
 #define UART_RX_TIMEOUT 1
 
 /** @brief Termination Modes. */
@@ -81,14 +83,15 @@ static enum term_modes term_mode;
 static const struct device *uart_dev;
 static uint8_t at_buf[AT_MAX_CMD_LEN];
 static size_t at_buf_len;
+static size_t cmd_len;
+static bool inside_quotes;
 static struct k_work cmd_send_work;
 static const char termination[3] = { '\0', '\r', '\n' };
+/* Characters that uart_rx_handler() takes one at a time */
+static uint8_t rx_special[] = { 0x08, 0x7F, '"', '\n' };
 
 static uint8_t uart_rx_buf[UART_RX_BUF_NUM][UART_RX_LEN];
 static uint8_t *next_buf = uart_rx_buf[1];
-static uint8_t *uart_tx_buf;
-
-static K_SEM_DEFINE(tx_done, 0, 1);
 
 /* global functions defined in different files */
 void enter_idle(void);
@@ -102,25 +105,26 @@ void slm_at_host_uninit(void);
 
 void rsp_send(const uint8_t *str, size_t len)
 {
-	int ret;
+	LOG_HEXDUMP_DBG(str, len, "TX");
 
-	k_sem_take(&tx_done, K_FOREVER);
+	slm_uart_tx_write(str, len);
+}
 
-	uart_tx_buf = k_malloc(len);
-	if (uart_tx_buf == NULL) {
-		LOG_WRN("No ram buffer");
-		k_sem_give(&tx_done);
-		return;
-	}
+static int uart_rx_start(void)
+{
+	next_buf = uart_rx_buf[1];
 
-	LOG_HEXDUMP_DBG(str, len, "TX");
+	return uart_rx_enable(uart_dev, uart_rx_buf[0],
+			      sizeof(uart_rx_buf[0]), UART_RX_TIMEOUT);
+}
+
+/* Called when pass-through mode has room for more data */
+static void uart_rx_resume(void)
+{
+	int err = uart_rx_start();
 
-	memcpy(uart_tx_buf, str, len);
-	ret = uart_tx(uart_dev, uart_tx_buf, len, SYS_FOREVER_MS);
-	if (ret) {
-		LOG_WRN("uart_tx failed: %d", ret);
-		k_free(uart_tx_buf);
-		k_sem_give(&tx_done);
+	if (err) {
+		LOG_ERR("UART RX failed: %d", err);
 	}
 }
 
@@ -478,7 +482,7 @@ static void cmd_send(struct k_work *work)
 #endif
 
 #if defined(CONFIG_SLM_HTTPC)
-	err = slm_at_httpc_parse(at_buf, at_buf_len);
+	err = slm_at_httpc_parse(at_buf);
 	if (err == 0) {
 		rsp_send(OK_STR, sizeof(OK_STR) - 1);
 		goto done;
@@ -516,18 +520,16 @@ static void cmd_send(struct k_work *work)
 	}
 
 done:
-	err = uart_rx_enable(uart_dev, uart_rx_buf[0],
-				sizeof(uart_rx_buf[0]), UART_RX_TIMEOUT);
+	err = uart_rx_start();
 	if (err) {
 		LOG_ERR("UART RX failed: %d", err);
 		rsp_send(FATAL_STR, sizeof(FATAL_STR) - 1);
 	}
 }
 
-static void uart_rx_handler(uint8_t character)
+/* Returns true if the character completed a command */
+static bool uart_rx_handler(uint8_t character)
 {
-	static bool inside_quotes;
-	static size_t cmd_len;
 	size_t pos;
 
 	cmd_len += 1;
@@ -550,11 +552,11 @@ static void uart_rx_handler(uint8_t character)
 		if (cmd_len > AT_MAX_CMD_LEN) {
 			LOG_ERR("Buffer overflow, dropping '%c'\n", character);
 			cmd_len = AT_MAX_CMD_LEN;
-			return;
+			return false;
 		} else if (cmd_len < 1) {
 			LOG_ERR("Invalid AT command length: %d", cmd_len);
 			cmd_len = 0;
-			return;
+			return false;
 		}
 
 		at_buf[pos] = character;
@@ -562,7 +564,7 @@ static void uart_rx_handler(uint8_t character)
 	}
 
 	if (inside_quotes) {
-		return;
+		return false;
 	}
 
 	/* Check if the character marks line termination. */
@@ -593,12 +595,57 @@ static void uart_rx_handler(uint8_t character)
 		break;
 	}
 
-	return;
+	return false;
 send:
 	uart_rx_disable(uart_dev);
 	k_work_submit(&cmd_send_work);
 	at_buf_len = cmd_len;
 	cmd_len = 0;
+	return true;
+}
+
+/* Copies characters that are not special to uart_rx_handler() */
+static void uart_rx_copy(const uint8_t *data, size_t len)
+{
+	size_t room = AT_MAX_CMD_LEN - cmd_len;
+
+	if (len > room) {
+		LOG_ERR("Buffer overflow, dropping %d bytes", len - room);
+		len = room;
+	}
+
+	memcpy(at_buf + cmd_len, data, len);
+	cmd_len += len;
+}
+
+static void uart_rx_data(const uint8_t *data, size_t len)
+{
+	size_t plain;
+
+	while (len > 0) {
+		/* In NULL termination mode every character ends a command */
+		if (term_mode == MODE_NULL_TERM) {
+			plain = 0;
+		} else {
+			plain = slm_util_find_any(data, len, rx_special,
+						  sizeof(rx_special));
+		}
+		if (plain > 0) {
+			uart_rx_copy(data, plain);
+			data += plain;
+			len -= plain;
+			continue;
+		}
+
+		/* The rest is dropped when a command is complete, as RX is
+		 * disabled until the command has been handled.
+		 */
+		if (uart_rx_handler(*data)) {
+			break;
+		}
+		data++;
+		len--;
+	}
 }
 
 static void uart_callback(const struct device *dev, struct uart_event *evt,
@@ -607,28 +654,35 @@ static void uart_callback(const struct device *dev, struct uart_event *evt,
 	ARG_UNUSED(dev);
 
 	int err;
-	static uint16_t pos;
 
 	ARG_UNUSED(user_data);
 
 	switch (evt->type) {
 	case UART_TX_DONE:
-		k_free(uart_tx_buf);
-		k_sem_give(&tx_done);
+		slm_uart_tx_done();
 		break;
 	case UART_TX_ABORTED:
-		k_free(uart_tx_buf);
-		k_sem_give(&tx_done);
+		slm_uart_tx_done();
 		LOG_INF("TX_ABORTED");
 		break;
 	case UART_RX_RDY:
-		for (int i = pos; i < (pos + evt->data.rx.len); i++) {
-			uart_rx_handler(evt->data.rx.buf[i]);
+		if (slm_passthrough_active()) {
+			slm_passthrough_rx(evt->data.rx.buf +
+					   evt->data.rx.offset,
+					   evt->data.rx.len);
+		} else {
+			uart_rx_data(evt->data.rx.buf + evt->data.rx.offset,
+				     evt->data.rx.len);
 		}
-		pos += evt->data.rx.len;
 		break;
 	case UART_RX_BUF_REQUEST:
-		pos = 0;
+		/* Let reception stop when pass-through data can not be
+		 * sent fast enough
+		 */
+		if (slm_passthrough_rx_hold()) {
+			LOG_DBG("RX held");
+			break;
+		}
 		err = uart_rx_buf_rsp(uart_dev, next_buf,
 					sizeof(uart_rx_buf[0]));
 		if (err) {
@@ -643,6 +697,7 @@ static void uart_callback(const struct device *dev, struct uart_event *evt,
 		break;
 	case UART_RX_DISABLED:
 		LOG_DBG("RX_DISABLED");
+		slm_passthrough_rx_stopped();
 		break;
 	default:
 		break;
@@ -689,8 +744,12 @@ int slm_at_host_init(void)
 	device_set_power_state(uart_dev, DEVICE_PM_ACTIVE_STATE,
 				NULL, NULL);
 	term_mode = CONFIG_SLM_AT_HOST_TERMINATION;
-	err = uart_rx_enable(uart_dev, uart_rx_buf[0],
-				sizeof(uart_rx_buf[0]), UART_RX_TIMEOUT);
+	if (term_mode == MODE_CR) {
+		rx_special[ARRAY_SIZE(rx_special) - 1] = '\r';
+	}
+	slm_uart_tx_init(uart_dev);
+	slm_passthrough_init(uart_rx_resume);
+	err = uart_rx_start();
 	if (err) {
 		LOG_ERR("Cannot enable rx: %d", err);
 		return -EFAULT;
@@ -763,7 +822,6 @@ int slm_at_host_init(void)
 	}
 #endif
 	k_work_init(&cmd_send_work, cmd_send);
-	k_sem_give(&tx_done);
 	rsp_send(SLM_SYNC_STR, sizeof(SLM_SYNC_STR)-1);
 
 	LOG_DBG("at_host init done");
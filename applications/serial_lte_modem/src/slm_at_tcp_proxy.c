@@ -11,18 +11,17 @@
 #include <modem/modem_info.h>
 #include <sys/ring_buffer.h>
 #include "slm_util.h"
+#include "slm_poll.h"
+#include "slm_uart.h"
+#include "slm_passthrough.h"
 #include "slm_native_tls.h"
 #include "slm_at_host.h"
 #include "slm_at_tcp_proxy.h"
 
 LOG_MODULE_REGISTER(tcp_proxy, CONFIG_SLM_LOG_LEVEL);
 
-#define THREAD_STACK_SIZE	(KB(3) + NET_IPV4_MTU)
-#define THREAD_PRIORITY		K_LOWEST_APPLICATION_THREAD_PRIO
 #define DATA_HEX_MAX_SIZE	(2 * NET_IPV4_MTU)
-
-/* max 2, listening and incoming sockets */
-#define MAX_POLL_FD		2
+#define CONN_TIME_MS		(CONFIG_SLM_TCP_CONN_TIME * MSEC_PER_SEC)
 
 /* Some features need future modem firmware support */
 #define SLM_TCP_PROXY_FUTURE_FEATURE	0
@@ -34,7 +33,8 @@ enum slm_tcp_proxy_operation {
 	AT_SERVER_START,
 	AT_CLIENT_CONNECT = AT_SERVER_START,
 	AT_SERVER_START_WITH_DATAMODE,
-	AT_CLIENT_CONNECT_WITH_DATAMODE = AT_SERVER_START_WITH_DATAMODE
+	AT_CLIENT_CONNECT_WITH_DATAMODE = AT_SERVER_START_WITH_DATAMODE,
+	AT_CLIENT_CONNECT_WITH_PASSTHROUGH
 };
 
 /**@brief Proxy roles. */
@@ -68,9 +68,8 @@ static slm_at_cmd_list_t tcp_proxy_at_list[AT_TCP_PROXY_MAX] = {
 
 RING_BUF_DECLARE(data_buf, CONFIG_AT_CMD_RESPONSE_MAX_LEN / 2);
 static uint8_t data_hex[DATA_HEX_MAX_SIZE];
-static struct k_thread tcp_thread;
-static K_THREAD_STACK_DEFINE(tcp_thread_stack, THREAD_STACK_SIZE);
-K_TIMER_DEFINE(conn_timer, NULL, NULL);
+/* Received in the poll thread */
+static uint8_t rx_data[NET_IPV4_MTU];
 
 static struct sockaddr_in remote;
 static struct tcp_proxy_t {
@@ -79,9 +78,8 @@ static struct tcp_proxy_t {
 	int sock_peer;		/* Socket descriptor for peer. */
 	int role;		/* Client or Server proxy */
 	bool datamode;		/* Data mode flag*/
+	bool passthrough;	/* Pass-through mode flag */
 } proxy;
-static struct pollfd fds[MAX_POLL_FD];
-static int nfds;
 
 /* global functions defined in different files */
 void rsp_send(const uint8_t *str, size_t len);
@@ -91,9 +89,10 @@ extern struct at_param_list at_param_list;
 extern struct modem_param_info modem_param;
 extern char rsp_buf[CONFIG_AT_CMD_RESPONSE_MAX_LEN];
 
-/** forward declaration of thread function **/
-static void tcpcli_thread_func(void *p1, void *p2, void *p3);
-static void tcpsvr_thread_func(void *p1, void *p2, void *p3);
+/** forward declaration of poll handlers **/
+static void tcpcli_handler(int fd, int revents, void *ctx);
+static void tcpsvr_handler(int fd, int revents, void *ctx);
+static void tcpsvr_peer_handler(int fd, int revents, void *ctx);
 
 static int do_tcp_server_start(uint16_t port)
 {
@@ -197,10 +196,11 @@ static int do_tcp_server_start(uint16_t port)
 		goto exit;
 	}
 
-	k_thread_create(&tcp_thread, tcp_thread_stack,
-			K_THREAD_STACK_SIZEOF(tcp_thread_stack),
-			tcpsvr_thread_func, NULL, NULL, NULL,
-			THREAD_PRIORITY, K_USER, K_NO_WAIT);
+	ring_buf_reset(&data_buf);
+	ret = slm_poll_add(proxy.sock, POLLIN, tcpsvr_handler, NULL);
+	if (ret < 0) {
+		goto exit;
+	}
 	proxy.role = AT_TCP_ROLE_SERVER;
 	sprintf(rsp_buf, "#XTCPSVR: %d started\r\n", proxy.sock);
 	rsp_send(rsp_buf, strlen(rsp_buf));
@@ -225,17 +225,47 @@ exit:
 	return ret;
 }
 
-static int do_tcp_server_stop(void)
+static void tcpsvr_peer_close(void)
+{
+	(void)slm_poll_remove(proxy.sock_peer);
+	if (close(proxy.sock_peer) < 0) {
+		LOG_WRN("close(%d) fail: %d", proxy.sock_peer, -errno);
+	}
+	proxy.sock_peer = INVALID_SOCKET;
+}
+
+static void tcpsvr_terminate(int error)
 {
+	int ret;
+
+	(void)slm_poll_remove(proxy.sock);
 	if (proxy.sock_peer != INVALID_SOCKET) {
-		close(proxy.sock_peer);
+		tcpsvr_peer_close();
+	}
+	ret = close(proxy.sock);
+	if (ret < 0) {
+		LOG_WRN("close(%d) fail: %d", proxy.sock, -errno);
+	}
+#if defined(CONFIG_SLM_NATIVE_TLS)
+	if (proxy.sec_tag != INVALID_SEC_TAG) {
+		ret = slm_tls_unloadcrdl(proxy.sec_tag);
+		if (ret < 0) {
+			LOG_ERR("Fail to unload credential: %d", ret);
+		}
 	}
+#endif
+	slm_at_tcp_proxy_init();
+	sprintf(rsp_buf, "#XTCPSVR: %d stopped\r\n", error);
+	rsp_send(rsp_buf, strlen(rsp_buf));
+}
 
+static int do_tcp_server_stop(void)
+{
 	if (proxy.sock == INVALID_SOCKET) {
 		LOG_WRN("Proxy server is not running");
 		return -EINVAL;
 	}
-	close(proxy.sock);
+	tcpsvr_terminate(0);
 
 	return 0;
 }
@@ -266,6 +296,14 @@ static int do_tcp_client_connect(const char *url, uint16_t port)
 			ret = -errno;
 			goto exit;
 		}
+		if (IS_ENABLED(CONFIG_SLM_TLS_SESSION_CACHE)) {
+			int cache = TLS_SESSION_CACHE_ENABLED;
+
+			if (setsockopt(proxy.sock, SOL_TLS, TLS_SESSION_CACHE,
+				       &cache, sizeof(cache)) != 0) {
+				LOG_WRN("set session cache failed: %d", -errno);
+			}
+		}
 	}
 
 	/* Connect to remote host */
@@ -310,10 +348,11 @@ static int do_tcp_client_connect(const char *url, uint16_t port)
 		goto exit;
 	}
 
-	k_thread_create(&tcp_thread, tcp_thread_stack,
-			K_THREAD_STACK_SIZEOF(tcp_thread_stack),
-			tcpcli_thread_func, NULL, NULL, NULL,
-			THREAD_PRIORITY, K_USER, K_NO_WAIT);
+	ring_buf_reset(&data_buf);
+	ret = slm_poll_add(proxy.sock, POLLIN, tcpcli_handler, NULL);
+	if (ret < 0) {
+		goto exit;
+	}
 
 	proxy.role = AT_TCP_ROLE_CLIENT;
 	sprintf(rsp_buf, "#XTCPCLI: %d connected\r\n", proxy.sock);
@@ -332,13 +371,27 @@ exit:
 	return ret;
 }
 
+static void tcpcli_terminate(int error)
+{
+	if (proxy.passthrough) {
+		slm_passthrough_exit();
+	}
+	(void)slm_poll_remove(proxy.sock);
+	if (close(proxy.sock) < 0) {
+		LOG_WRN("close(%d) fail: %d", proxy.sock, -errno);
+	}
+	slm_at_tcp_proxy_init();
+	sprintf(rsp_buf, "#XTCPCLI: %d disconnected\r\n", error);
+	rsp_send(rsp_buf, strlen(rsp_buf));
+}
+
 static int do_tcp_client_disconnect(void)
 {
 	if (proxy.sock == INVALID_SOCKET) {
 		LOG_WRN("Client is not running");
 		return -EINVAL;
 	}
-	close(proxy.sock);
+	tcpcli_terminate(0);
 
 	return 0;
 }
@@ -355,7 +408,6 @@ static int do_tcp_send(const uint8_t *data, int datalen)
 	} else if (proxy.role == AT_TCP_ROLE_SERVER &&
 		   proxy.sock_peer != INVALID_SOCKET) {
 		sock = proxy.sock_peer;
-		k_timer_stop(&conn_timer);
 	} else {
 		LOG_ERR("Not connected yet");
 		return -EINVAL;
@@ -385,9 +437,7 @@ static int do_tcp_send(const uint8_t *data, int datalen)
 		rsp_send(rsp_buf, strlen(rsp_buf));
 		/* restart activity timer */
 		if (proxy.role == AT_TCP_ROLE_SERVER) {
-			k_timer_start(&conn_timer,
-				      K_SECONDS(CONFIG_SLM_TCP_CONN_TIME),
-				      K_NO_WAIT);
+			(void)slm_poll_timeout_set(sock, CONN_TIME_MS);
 		}
 		return 0;
 	} else {
@@ -407,7 +457,6 @@ static int do_tcp_send_datamode(const uint8_t *data, int datalen)
 	} else if (proxy.role == AT_TCP_ROLE_SERVER &&
 		   proxy.sock_peer != INVALID_SOCKET) {
 		sock = proxy.sock_peer;
-		k_timer_stop(&conn_timer);
 	} else {
 		LOG_ERR("Not connected yet");
 		return -EINVAL;
@@ -425,13 +474,36 @@ static int do_tcp_send_datamode(const uint8_t *data, int datalen)
 
 	/* restart activity timer */
 	if (proxy.role == AT_TCP_ROLE_SERVER) {
-		k_timer_start(&conn_timer, K_SECONDS(CONFIG_SLM_TCP_CONN_TIME),
-			K_NO_WAIT);
+		(void)slm_poll_timeout_set(sock, CONN_TIME_MS);
+	}
+
+	return offset;
+}
+
+/* Called from the pass-through thread */
+static int tcp_passthrough_send(const uint8_t *data, size_t len)
+{
+	int ret;
+	size_t offset = 0;
+
+	while (offset < len) {
+		ret = send(proxy.sock, data + offset, len - offset, 0);
+		if (ret < 0) {
+			LOG_ERR("send() failed: %d", -errno);
+			return offset > 0 ? offset : -errno;
+		}
+		offset += ret;
 	}
 
 	return offset;
 }
 
+/* Called when the escape sequence is received */
+static void tcp_passthrough_exit(void)
+{
+	proxy.passthrough = false;
+}
+
 static int tcp_data_save(uint8_t *data, uint32_t length)
 {
 	if (ring_buf_space_get(&data_buf) < length) {
@@ -472,245 +544,163 @@ static void tcp_data_handle(uint8_t *data, uint32_t length)
 
 }
 
-int tcpsvr_input(int infd)
+static void tcp_data_recv(int fd)
 {
 	int ret;
 
-	if (fds[infd].fd == proxy.sock) {
-		socklen_t len;
-		char peer_addr[INET_ADDRSTRLEN];
-
-		len = sizeof(struct sockaddr_in);
-		ret = accept(proxy.sock,
-				(struct sockaddr *)&remote, &len);
-		if (ret < 0) {
-			LOG_ERR("accept() failed: %d", -errno);
-			return -errno;
-		}
-		if (nfds >= MAX_POLL_FD) {
-			LOG_WRN("Full. Close connection.");
-			close(ret);
-			return -ECONNREFUSED;
-		}
-		/* Accept incoming connection */
-		LOG_DBG("accept(): %d", ret);
-		if (inet_ntop(AF_INET, &remote.sin_addr, peer_addr,
-			INET_ADDRSTRLEN) != NULL) {
-			sprintf(rsp_buf, "#XTCPSVR: %s connected\r\n",
-				peer_addr);
-			rsp_send(rsp_buf, strlen(rsp_buf));
-		}
-		proxy.sock_peer = ret;
-		LOG_DBG("New connection - %d",
-			proxy.sock_peer);
-		fds[nfds].fd = proxy.sock_peer;
-		fds[nfds].events = POLLIN;
-		nfds++;
-		/* Start a one-shot timer to close the connection */
-		k_timer_start(&conn_timer,
-			      K_SECONDS(CONFIG_SLM_TCP_CONN_TIME),
-			      K_NO_WAIT);
-	} else {
-		char data[NET_IPV4_MTU];
+	if (proxy.datamode || proxy.passthrough) {
+		uint8_t *space;
+		size_t size;
 
-		k_timer_stop(&conn_timer);
-		ret = recv(fds[infd].fd, data, NET_IPV4_MTU, 0);
+		/* Receive straight into the UART transmit buffer */
+		space = slm_uart_tx_claim(&size);
+		ret = recv(fd, space, size, 0);
+		slm_uart_tx_commit(MAX(ret, 0));
 		if (ret < 0) {
 			LOG_WRN("recv() error: %d", -errno);
-			goto recv_done;
-		}
-		if (ret == 0) {
-			goto recv_done;
 		}
-		tcp_data_handle(data, ret);
-recv_done:
-		/* Restart conn timer */
-		LOG_DBG("restart timer: POLLIN");
-		k_timer_start(&conn_timer,
-			      K_SECONDS(CONFIG_SLM_TCP_CONN_TIME),
-			      K_NO_WAIT);
+		return;
 	}
 
-	return ret;
+	ret = recv(fd, rx_data, sizeof(rx_data), 0);
+	if (ret < 0) {
+		LOG_WRN("recv() error: %d", -errno);
+		return;
+	}
+	if (ret == 0) {
+		return;
+	}
+	tcp_data_handle(rx_data, ret);
 }
 
-/* TCP server thread */
-static void tcpsvr_thread_func(void *p1, void *p2, void *p3)
+/* TCP server listening socket, polled in the poll thread */
+static void tcpsvr_handler(int fd, int revents, void *ctx)
 {
-	int ret, current_size;
+	socklen_t len;
+	char peer_addr[INET_ADDRSTRLEN];
+	int ret;
 
-	ARG_UNUSED(p1);
-	ARG_UNUSED(p2);
-	ARG_UNUSED(p3);
+	ARG_UNUSED(ctx);
 
-	fds[0].fd = proxy.sock;
-	fds[0].events = POLLIN;
-	nfds = 1;
-	ring_buf_reset(&data_buf);
-	while (true) {
-		if (k_timer_status_get(&conn_timer) > 0) {
-			k_timer_stop(&conn_timer);
-			LOG_INF("Connecion timeout");
-			sprintf(rsp_buf, "#XTCPSVR: %d timeout\r\n", -ETIME);
-			rsp_send(rsp_buf, strlen(rsp_buf));
-			close(proxy.sock_peer);
-			proxy.sock_peer = INVALID_SOCKET;
-			nfds--;
-		}
-		ret = poll(fds, nfds, MSEC_PER_SEC * CONFIG_SLM_TCP_POLL_TIME);
-		if (ret < 0) {  /* IO error */
-			LOG_WRN("poll() error: %d", -errno);
-			ret = -EIO;
-			goto exit;
-		}
-		if (ret == 0) {  /* timeout */
-			LOG_DBG("poll() timeout");
-			continue;
-		}
-		current_size = nfds;
-		for (int i = 0; i < current_size; i++) {
-			LOG_DBG("Poll events 0x%08x", fds[i].revents);
-			if ((fds[i].revents & POLLERR) == POLLERR) {
-				LOG_ERR("POLLERR: %d", i);
-				if (fds[i].fd == proxy.sock) {
-					ret = -EIO;
-					goto exit;
-				}
-				sprintf(rsp_buf, "#XTCPSVR: %d"
-					" disconnected\r\n", -EIO);
-				rsp_send(rsp_buf, strlen(rsp_buf));
-				k_timer_stop(&conn_timer);
-				close(proxy.sock_peer);
-				proxy.sock_peer = INVALID_SOCKET;
-				nfds--;
-				continue;
-			}
-			if ((fds[i].revents & POLLHUP) == POLLHUP) {
-				LOG_WRN("POLLHUP: %d", i);
-				if (fds[i].fd == proxy.sock) {
-					ret = -ENETDOWN;
-					goto exit;
-				}
-				sprintf(rsp_buf, "#XTCPSVR: %d"
-					" disconnected\r\n", -ECONNRESET);
-				rsp_send(rsp_buf, strlen(rsp_buf));
-				k_timer_stop(&conn_timer);
-				close(proxy.sock_peer);
-				proxy.sock_peer = INVALID_SOCKET;
-				nfds--;
-				continue;
-			}
-			if ((fds[i].revents & POLLNVAL) == POLLNVAL) {
-				LOG_WRN("POLLNVAL: %d", i);
-				if (fds[i].fd == proxy.sock) {
-					ret = 0;
-					goto exit;
-				}
-				sprintf(rsp_buf, "#XTCPSVR: %d"
-					" disconnected\r\n", -ECONNABORTED);
-				rsp_send(rsp_buf, strlen(rsp_buf));
-				k_timer_stop(&conn_timer);
-				/* Socket was closed before */
-				proxy.sock_peer = INVALID_SOCKET;
-				nfds--;
-				continue;
-			}
-			if ((fds[i].revents & POLLIN) == POLLIN) {
-				ret = tcpsvr_input(i);
-				if (ret < 0) {
-					LOG_WRN("tcpsvr_input error: %d", ret);
-				}
-			}
-		}
+	if ((revents & POLLERR) == POLLERR) {
+		LOG_ERR("POLLERR: %d", fd);
+		tcpsvr_terminate(-EIO);
+		return;
 	}
-exit:
-	if (proxy.sock_peer != INVALID_SOCKET) {
-		k_timer_stop(&conn_timer);
-		ret = close(proxy.sock_peer);
-		if (ret < 0) {
-			LOG_WRN("close(%d) fail: %d", proxy.sock_peer, -errno);
-		}
+	if ((revents & POLLHUP) == POLLHUP) {
+		LOG_WRN("POLLHUP: %d", fd);
+		tcpsvr_terminate(-ENETDOWN);
+		return;
 	}
-	if (proxy.sock != INVALID_SOCKET) {
-		ret = close(proxy.sock);
-		if (ret < 0) {
-			LOG_WRN("close(%d) fail: %d", proxy.sock, -errno);
-		}
+	if ((revents & POLLNVAL) == POLLNVAL) {
+		LOG_WRN("POLLNVAL: %d", fd);
+		tcpsvr_terminate(0);
+		return;
 	}
-#if defined(CONFIG_SLM_NATIVE_TLS)
-	if (proxy.sec_tag != INVALID_SEC_TAG) {
-		ret = slm_tls_unloadcrdl(proxy.sec_tag);
-		if (ret < 0) {
-			LOG_ERR("Fail to unload credential: %d", ret);
-		}
+	if ((revents & POLLIN) != POLLIN) {
+		return;
+	}
+
+	len = sizeof(struct sockaddr_in);
+	ret = accept(proxy.sock, (struct sockaddr *)&remote, &len);
+	if (ret < 0) {
+		LOG_ERR("accept() failed: %d", -errno);
+		return;
+	}
+	if (proxy.sock_peer != INVALID_SOCKET) {
+		LOG_WRN("Full. Close connection.");
+		close(ret);
+		return;
+	}
+	if (slm_poll_add(ret, POLLIN, tcpsvr_peer_handler, NULL) < 0) {
+		close(ret);
+		return;
+	}
+	/* Accept incoming connection */
+	LOG_DBG("accept(): %d", ret);
+	proxy.sock_peer = ret;
+	/* Close the connection when it is idle for too long */
+	(void)slm_poll_timeout_set(proxy.sock_peer, CONN_TIME_MS);
+	if (inet_ntop(AF_INET, &remote.sin_addr, peer_addr,
+		INET_ADDRSTRLEN) != NULL) {
+		sprintf(rsp_buf, "#XTCPSVR: %s connected\r\n", peer_addr);
+		rsp_send(rsp_buf, strlen(rsp_buf));
 	}
-#endif
-	slm_at_tcp_proxy_init();
-	sprintf(rsp_buf, "#XTCPSVR: %d stopped\r\n", ret);
-	rsp_send(rsp_buf, strlen(rsp_buf));
 }
 
-/* TCP client thread */
-static void tcpcli_thread_func(void *p1, void *p2, void *p3)
+/* TCP server incoming socket, polled in the poll thread */
+static void tcpsvr_peer_handler(int fd, int revents, void *ctx)
 {
-	int ret;
+	ARG_UNUSED(ctx);
 
-	ARG_UNUSED(p1);
-	ARG_UNUSED(p2);
-	ARG_UNUSED(p3);
+	if (revents == 0) {
+		LOG_INF("Connecion timeout");
+		sprintf(rsp_buf, "#XTCPSVR: %d timeout\r\n", -ETIME);
+		rsp_send(rsp_buf, strlen(rsp_buf));
+		tcpsvr_peer_close();
+		return;
+	}
+	if ((revents & POLLERR) == POLLERR) {
+		LOG_ERR("POLLERR: %d", fd);
+		sprintf(rsp_buf, "#XTCPSVR: %d disconnected\r\n", -EIO);
+		rsp_send(rsp_buf, strlen(rsp_buf));
+		tcpsvr_peer_close();
+		return;
+	}
+	if ((revents & POLLHUP) == POLLHUP) {
+		LOG_WRN("POLLHUP: %d", fd);
+		sprintf(rsp_buf, "#XTCPSVR: %d disconnected\r\n",
+			-ECONNRESET);
+		rsp_send(rsp_buf, strlen(rsp_buf));
+		tcpsvr_peer_close();
+		return;
+	}
+	if ((revents & POLLNVAL) == POLLNVAL) {
+		LOG_WRN("POLLNVAL: %d", fd);
+		sprintf(rsp_buf, "#XTCPSVR: %d disconnected\r\n",
+			-ECONNABORTED);
+		rsp_send(rsp_buf, strlen(rsp_buf));
+		/* Socket was closed before */
+		(void)slm_poll_remove(fd);
+		proxy.sock_peer = INVALID_SOCKET;
+		return;
+	}
+	if ((revents & POLLIN) == POLLIN) {
+		tcp_data_recv(fd);
+	}
+}
 
-	fds[0].fd = proxy.sock;
-	fds[0].events = POLLIN;
-	ring_buf_reset(&data_buf);
-	while (true) {
-		ret = poll(&fds[0], 1, MSEC_PER_SEC * CONFIG_SLM_TCP_POLL_TIME);
-		if (ret < 0) {  /* IO error */
-			LOG_WRN("poll() error: %d", ret);
-			ret = -EIO;
-			goto exit;
-		}
-		if (ret == 0) {  /* timeout */
-			continue;
-		}
-		LOG_DBG("Poll events 0x%08x", fds[0].revents);
-		if ((fds[0].revents & POLLERR) == POLLERR) {
-			LOG_ERR("POLLERR");
-			ret = -EIO;
-			goto exit;
-		}
-		if ((fds[0].revents & POLLNVAL) == POLLNVAL) {
-			LOG_INF("TCP client disconnected.");
-			proxy.sock = INVALID_SOCKET;
-			goto exit;
-		}
-		if ((fds[0].revents & POLLHUP) == POLLHUP) {
-			LOG_INF("Peer disconnect: %d", fds[0].fd);
-			goto exit;
-		}
-		if ((fds[0].revents & POLLIN) == POLLIN) {
-			char data[NET_IPV4_MTU];
+/* TCP client socket, polled in the poll thread */
+static void tcpcli_handler(int fd, int revents, void *ctx)
+{
+	ARG_UNUSED(ctx);
 
-			ret = recv(fds[0].fd, data, NET_IPV4_MTU, 0);
-			if (ret < 0) {
-				LOG_WRN("recv() error: %d", -errno);
-				continue;
-			}
-			if (ret == 0) {
-				continue;
-			}
-			tcp_data_handle(data, ret);
-		}
+	if ((revents & POLLERR) == POLLERR) {
+		LOG_ERR("POLLERR");
+		tcpcli_terminate(-EIO);
+		return;
 	}
-exit:
-	if (proxy.sock != INVALID_SOCKET) {
-		ret = close(proxy.sock);
-		if (ret < 0) {
-			LOG_WRN("close(%d) fail: %d", proxy.sock, -errno);
+	if ((revents & POLLNVAL) == POLLNVAL) {
+		LOG_INF("TCP client disconnected.");
+		if (proxy.passthrough) {
+			slm_passthrough_exit();
 		}
+		/* Socket was closed before */
+		(void)slm_poll_remove(fd);
+		slm_at_tcp_proxy_init();
+		sprintf(rsp_buf, "#XTCPCLI: %d disconnected\r\n",
+			-ECONNABORTED);
+		rsp_send(rsp_buf, strlen(rsp_buf));
+		return;
+	}
+	if ((revents & POLLHUP) == POLLHUP) {
+		LOG_INF("Peer disconnect: %d", fd);
+		tcpcli_terminate(0);
+		return;
+	}
+	if ((revents & POLLIN) == POLLIN) {
+		tcp_data_recv(fd);
 	}
-	slm_at_tcp_proxy_init();
-	sprintf(rsp_buf, "#XTCPCLI: %d disconnected\r\n", ret);
-	rsp_send(rsp_buf, strlen(rsp_buf));
 }
 
 /**@brief handle AT#XTCPSVR commands
@@ -800,7 +790,8 @@ static int handle_at_tcp_client(enum at_cmd_type cmd_type)
 			return err;
 		}
 		if (op == AT_CLIENT_CONNECT ||
-		    op == AT_CLIENT_CONNECT_WITH_DATAMODE) {
+		    op == AT_CLIENT_CONNECT_WITH_DATAMODE ||
+		    op == AT_CLIENT_CONNECT_WITH_PASSTHROUGH) {
 			uint16_t port;
 			char url[TCPIP_MAX_URL];
 			int size = TCPIP_MAX_URL;
@@ -828,6 +819,17 @@ static int handle_at_tcp_client(enum at_cmd_type cmd_type)
 			    op == AT_CLIENT_CONNECT_WITH_DATAMODE) {
 				proxy.datamode = true;
 			}
+			if (err == 0 &&
+			    op == AT_CLIENT_CONNECT_WITH_PASSTHROUGH) {
+				err = slm_passthrough_enter(
+					tcp_passthrough_send,
+					tcp_passthrough_exit);
+				if (err) {
+					(void)do_tcp_client_disconnect();
+					return err;
+				}
+				proxy.passthrough = true;
+			}
 		} else if (op == AT_CLIENT_DISCONNECT) {
 			err = do_tcp_client_disconnect();
 		} break;
@@ -846,9 +848,10 @@ static int handle_at_tcp_client(enum at_cmd_type cmd_type)
 
 	case AT_CMD_TYPE_TEST_COMMAND:
 		sprintf(rsp_buf,
-			"#XTCPCLI: (%d, %d, %d),<url>,<port>,<sec_tag>\r\n",
+			"#XTCPCLI: (%d, %d, %d, %d),<url>,<port>,<sec_tag>\r\n",
 			AT_CLIENT_DISCONNECT, AT_CLIENT_CONNECT,
-			AT_CLIENT_CONNECT_WITH_DATAMODE);
+			AT_CLIENT_CONNECT_WITH_DATAMODE,
+			AT_CLIENT_CONNECT_WITH_PASSTHROUGH);
 		rsp_send(rsp_buf, strlen(rsp_buf));
 		err = 0;
 		break;
@@ -991,11 +994,8 @@ int slm_at_tcp_proxy_init(void)
 	proxy.sock_peer = INVALID_SOCKET;
 	proxy.role = INVALID_ROLE;
 	proxy.datamode = false;
+	proxy.passthrough = false;
 	proxy.sec_tag = INVALID_SEC_TAG;
-	nfds = 0;
-	for (int i = 0; i < MAX_POLL_FD; i++) {
-		fds[i].fd = INVALID_SOCKET;
-	}
 
 	return 0;
 }
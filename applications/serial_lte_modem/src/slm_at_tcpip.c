@@ -243,6 +243,15 @@ static int do_socket_open(uint8_t type, uint8_t role, int sec_tag)
 			ret = -errno;
 			goto error_exit;
 		}
+		if (IS_ENABLED(CONFIG_SLM_TLS_SESSION_CACHE) &&
+		    role == AT_SOCKET_ROLE_CLIENT) {
+			int cache = TLS_SESSION_CACHE_ENABLED;
+
+			if (setsockopt(client.sock, SOL_TLS, TLS_SESSION_CACHE,
+				       &cache, sizeof(cache)) != 0) {
+				LOG_WRN("set session cache failed: %d", -errno);
+			}
+		}
 	}
 
 	client.role = role;
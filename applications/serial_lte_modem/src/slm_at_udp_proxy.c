@@ -11,13 +11,14 @@
 #include <modem/modem_info.h>
 #include <net/tls_credentials.h>
 #include "slm_util.h"
+#include "slm_poll.h"
+#include "slm_uart.h"
+#include "slm_passthrough.h"
 #include "slm_at_host.h"
 #include "slm_at_udp_proxy.h"
 
 LOG_MODULE_REGISTER(udp_proxy, CONFIG_SLM_LOG_LEVEL);
 
-#define THREAD_STACK_SIZE	(KB(1) + NET_IPV4_MTU)
-#define THREAD_PRIORITY		K_LOWEST_APPLICATION_THREAD_PRIO
 #define DATA_HEX_MAX_SIZE	(2 * NET_IPV4_MTU)
 
 /*
@@ -35,7 +36,8 @@ enum slm_udp_proxy_operation {
 	AT_SERVER_START,
 	AT_CLIENT_CONNECT = AT_SERVER_START,
 	AT_SERVER_START_WITH_DATAMODE,
-	AT_CLIENT_CONNECT_WITH_DATAMODE = AT_SERVER_START_WITH_DATAMODE
+	AT_CLIENT_CONNECT_WITH_DATAMODE = AT_SERVER_START_WITH_DATAMODE,
+	AT_CLIENT_CONNECT_WITH_PASSTHROUGH
 };
 
 /**@brief List of supported AT commands. */
@@ -59,13 +61,13 @@ static slm_at_cmd_list_t udp_proxy_at_list[AT_UDP_PROXY_MAX] = {
 };
 
 static uint8_t data_hex[DATA_HEX_MAX_SIZE];
-static struct k_thread udp_thread;
-static K_THREAD_STACK_DEFINE(udp_thread_stack, THREAD_STACK_SIZE);
-static k_tid_t udp_thread_id;
+/* Received in the poll thread */
+static uint8_t rx_data[NET_IPV4_MTU];
 
 static struct sockaddr_in remote;
 static int udp_sock;
 static bool udp_datamode;
+static bool udp_passthrough;
 
 /* global functions defined in different files */
 void rsp_send(const uint8_t *str, size_t len);
@@ -75,8 +77,8 @@ extern struct at_param_list at_param_list;
 extern struct modem_param_info modem_param;
 extern char rsp_buf[CONFIG_AT_CMD_RESPONSE_MAX_LEN];
 
-/** forward declaration of thread function **/
-static void udp_thread_func(void *p1, void *p2, void *p3);
+/** forward declaration of poll handler **/
+static void udp_handler(int fd, int revents, void *ctx);
 
 static int do_udp_server_start(uint16_t port)
 {
@@ -131,10 +133,13 @@ static int do_udp_server_start(uint16_t port)
 		return -errno;
 	}
 
-	udp_thread_id = k_thread_create(&udp_thread, udp_thread_stack,
-			K_THREAD_STACK_SIZEOF(udp_thread_stack),
-			udp_thread_func, NULL, NULL, NULL,
-			THREAD_PRIORITY, K_USER, K_NO_WAIT);
+	ret = slm_poll_add(udp_sock, POLLIN, udp_handler, NULL);
+	if (ret < 0) {
+		sprintf(rsp_buf, "#XUDPSVR: %d\r\n", ret);
+		rsp_send(rsp_buf, strlen(rsp_buf));
+		close(udp_sock);
+		return ret;
+	}
 
 	sprintf(rsp_buf, "#XUDPSVR: %d started\r\n", udp_sock);
 	rsp_send(rsp_buf, strlen(rsp_buf));
@@ -148,6 +153,7 @@ static int do_udp_server_stop(int error)
 	int ret = 0;
 
 	if (udp_sock != INVALID_SOCKET) {
+		(void)slm_poll_remove(udp_sock);
 		ret = close(udp_sock);
 		if (ret < 0) {
 			LOG_WRN("close() failed: %d", -errno);
@@ -194,6 +200,14 @@ static int do_udp_client_connect(const char *url, uint16_t port, int sec_tag)
 			close(udp_sock);
 			return -errno;
 		}
+		if (IS_ENABLED(CONFIG_SLM_TLS_SESSION_CACHE)) {
+			int cache = TLS_SESSION_CACHE_ENABLED;
+
+			if (setsockopt(udp_sock, SOL_TLS, TLS_SESSION_CACHE,
+				       &cache, sizeof(cache)) != 0) {
+				LOG_WRN("set session cache failed: %d", -errno);
+			}
+		}
 	}
 
 	/* Connect to remote host */
@@ -240,10 +254,13 @@ static int do_udp_client_connect(const char *url, uint16_t port, int sec_tag)
 		return -errno;
 	}
 
-	udp_thread_id = k_thread_create(&udp_thread, udp_thread_stack,
-			K_THREAD_STACK_SIZEOF(udp_thread_stack),
-			udp_thread_func, NULL, NULL, NULL,
-			THREAD_PRIORITY, K_USER, K_NO_WAIT);
+	ret = slm_poll_add(udp_sock, POLLIN, udp_handler, NULL);
+	if (ret < 0) {
+		sprintf(rsp_buf, "#XUDPCLI: %d\r\n", ret);
+		rsp_send(rsp_buf, strlen(rsp_buf));
+		close(udp_sock);
+		return ret;
+	}
 
 	sprintf(rsp_buf, "#XUDPCLI: %d connected\r\n", udp_sock);
 	rsp_send(rsp_buf, strlen(rsp_buf));
@@ -255,7 +272,11 @@ static int do_udp_client_disconnect(void)
 {
 	int ret = 0;
 
+	if (udp_passthrough) {
+		slm_passthrough_exit();
+	}
 	if (udp_sock != INVALID_SOCKET) {
+		(void)slm_poll_remove(udp_sock);
 		ret = close(udp_sock);
 		if (ret < 0) {
 			LOG_WRN("close() failed: %d", -errno);
@@ -324,75 +345,87 @@ static int do_udp_send_datamode(const uint8_t *data, int datalen)
 	return offset;
 }
 
-static void udp_thread_func(void *p1, void *p2, void *p3)
+/* Called from the pass-through thread, sends one datagram */
+static int udp_passthrough_send(const uint8_t *data, size_t len)
+{
+	int ret = send(udp_sock, data, len, 0);
+
+	if (ret < 0) {
+		LOG_ERR("send() failed: %d", -errno);
+		return -errno;
+	}
+
+	return ret;
+}
+
+/* Called when the escape sequence is received */
+static void udp_passthrough_exit(void)
+{
+	udp_passthrough = false;
+}
+
+/* Sends the notification and the data in one piece */
+static void udp_data_send(int type, const uint8_t *data, int len)
+{
+	struct slm_uart_vec vec[3];
+
+	sprintf(rsp_buf, "#XUDPRECV: %d, %d\r\n", type, len);
+	vec[0].data = rsp_buf;
+	vec[0].len = strlen(rsp_buf);
+	vec[1].data = data;
+	vec[1].len = len;
+	vec[2].data = "\r\n";
+	vec[2].len = 2;
+	slm_uart_tx_writev(vec, ARRAY_SIZE(vec));
+}
+
+/* UDP socket, polled in the poll thread */
+static void udp_handler(int fd, int revents, void *ctx)
 {
 	int ret;
 	int size = sizeof(struct sockaddr_in);
-	struct pollfd fds;
-	char data[NET_IPV4_MTU];
 
-	ARG_UNUSED(p1);
-	ARG_UNUSED(p2);
-	ARG_UNUSED(p3);
+	ARG_UNUSED(ctx);
 
-	fds.fd = udp_sock;
-	fds.events = POLLIN;
+	if ((revents & (POLLERR | POLLNVAL)) != 0 && udp_passthrough) {
+		slm_passthrough_exit();
+		udp_passthrough = false;
+	}
+	if ((revents & POLLERR) == POLLERR) {
+		LOG_DBG("Socket error");
+		(void)slm_poll_remove(fd);
+		return;
+	}
+	if ((revents & POLLNVAL) == POLLNVAL) {
+		LOG_DBG("Socket closed");
+		(void)slm_poll_remove(fd);
+		return;
+	}
+	if ((revents & POLLIN) != POLLIN) {
+		return;
+	}
 
-	do {
-		ret = poll(&fds, 1, MSEC_PER_SEC * CONFIG_SLM_UDP_POLL_TIME);
-		if (ret < 0) {  /* IO error */
-			LOG_WRN("poll() error: %d", ret);
-			continue;
-		}
-		if (ret == 0) {  /* timeout */
-			continue;
-		}
-		LOG_DBG("Poll events 0x%08x", fds.revents);
-		if ((fds.revents & POLLERR) == POLLERR) {
-			LOG_DBG("Socket error");
-			return;
-		}
-		if ((fds.revents & POLLNVAL) == POLLNVAL) {
-			LOG_DBG("Socket closed");
-			return;
-		}
-		if ((fds.revents & POLLIN) != POLLIN) {
-			continue;
-		} else {
-			ret = recvfrom(udp_sock, data, NET_IPV4_MTU, 0,
-				(struct sockaddr *)&remote, &size);
-		}
-		if (ret < 0) {
-			LOG_WRN("recv() error: %d", -errno);
-			continue;
-		}
-		if (ret == 0) {
-			continue;
-		}
-		if (udp_datamode) {
-			rsp_send(data, ret);
-		} else if (slm_util_hex_check(data, ret)) {
-			ret = slm_util_htoa(data, ret, data_hex,
-				DATA_HEX_MAX_SIZE);
-			if (ret > 0) {
-				sprintf(rsp_buf, "#XUDPRECV: %d, %d\r\n",
-					DATATYPE_HEXADECIMAL, ret);
-				rsp_send(rsp_buf, strlen(rsp_buf));
-				rsp_send(data_hex, ret);
-				rsp_send("\r\n", 2);
-			} else {
-				LOG_WRN("hex convert error: %d", ret);
-			}
+	ret = recvfrom(fd, rx_data, sizeof(rx_data), 0,
+		(struct sockaddr *)&remote, &size);
+	if (ret < 0) {
+		LOG_WRN("recv() error: %d", -errno);
+		return;
+	}
+	if (ret == 0) {
+		return;
+	}
+	if (udp_datamode || udp_passthrough) {
+		rsp_send(rx_data, ret);
+	} else if (slm_util_hex_check(rx_data, ret)) {
+		ret = slm_util_htoa(rx_data, ret, data_hex, DATA_HEX_MAX_SIZE);
+		if (ret > 0) {
+			udp_data_send(DATATYPE_HEXADECIMAL, data_hex, ret);
 		} else {
-			sprintf(rsp_buf, "#XUDPRECV: %d, %d\r\n",
-				DATATYPE_PLAINTEXT, ret);
-			rsp_send(rsp_buf, strlen(rsp_buf));
-			rsp_send(data, ret);
-			rsp_send("\r\n", 2);
+			LOG_WRN("hex convert error: %d", ret);
 		}
-	} while (true);
-
-	LOG_DBG("Quit receive thread");
+	} else {
+		udp_data_send(DATATYPE_PLAINTEXT, rx_data, ret);
+	}
 }
 
 /**@brief handle AT#XUDPSVR commands
@@ -490,7 +523,8 @@ static int handle_at_udp_client(enum at_cmd_type cmd_type)
 			return err;
 		}
 		if (op == AT_CLIENT_CONNECT ||
-		    op == AT_CLIENT_CONNECT_WITH_DATAMODE) {
+		    op == AT_CLIENT_CONNECT_WITH_DATAMODE ||
+		    op == AT_CLIENT_CONNECT_WITH_PASSTHROUGH) {
 			uint16_t port;
 			char url[TCPIP_MAX_URL];
 			int size = TCPIP_MAX_URL;
@@ -517,6 +551,17 @@ static int handle_at_udp_client(enum at_cmd_type cmd_type)
 			    op == AT_CLIENT_CONNECT_WITH_DATAMODE) {
 				udp_datamode = true;
 			}
+			if (err == 0 &&
+			    op == AT_CLIENT_CONNECT_WITH_PASSTHROUGH) {
+				err = slm_passthrough_enter(
+					udp_passthrough_send,
+					udp_passthrough_exit);
+				if (err) {
+					(void)do_udp_client_disconnect();
+					return err;
+				}
+				udp_passthrough = true;
+			}
 		} else if (op == AT_CLIENT_DISCONNECT) {
 			if (udp_sock < 0) {
 				LOG_WRN("Client is not connected");
@@ -539,9 +584,10 @@ static int handle_at_udp_client(enum at_cmd_type cmd_type)
 
 	case AT_CMD_TYPE_TEST_COMMAND:
 		sprintf(rsp_buf,
-			"#XUDPCLI: (%d, %d, %d),<url>,<port>,<sec_tag>\r\n",
+			"#XUDPCLI: (%d, %d, %d, %d),<url>,<port>,<sec_tag>\r\n",
 			AT_CLIENT_DISCONNECT, AT_CLIENT_CONNECT,
-			AT_CLIENT_CONNECT_WITH_DATAMODE);
+			AT_CLIENT_CONNECT_WITH_DATAMODE,
+			AT_CLIENT_CONNECT_WITH_PASSTHROUGH);
 		rsp_send(rsp_buf, strlen(rsp_buf));
 		err = 0;
 		break;
@@ -647,6 +693,7 @@ int slm_at_udp_proxy_init(void)
 {
 	udp_sock = INVALID_SOCKET;
 	udp_datamode = false;
+	udp_passthrough = false;
 	remote.sin_family = AF_UNSPEC;
 	remote.sin_port = INVALID_PORT;
 
@@ -660,7 +707,7 @@ int slm_at_udp_proxy_uninit(void)
 	int ret;
 
 	if (udp_sock != INVALID_SOCKET) {
-		k_thread_abort(udp_thread_id);
+		(void)slm_poll_remove(udp_sock);
 		ret = close(udp_sock);
 		if (ret < 0) {
 			LOG_WRN("close() failed: %d", -errno);
@@ -0,0 +1,343 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <logging/log.h>
+#include <zephyr.h>
+#include <sys/ring_buffer.h>
+#include "slm_uart.h"
+#include "slm_passthrough.h"
+
+LOG_MODULE_REGISTER(slm_passthrough, CONFIG_SLM_LOG_LEVEL);
+
+#define THREAD_STACK_SIZE	CONFIG_SLM_PASSTHROUGH_STACK_SIZE
+#define THREAD_PRIORITY		K_LOWEST_APPLICATION_THREAD_PRIO
+#define BUF_SIZE		CONFIG_SLM_PASSTHROUGH_BUF_SIZE
+#define GUARD_TIME_MS		CONFIG_SLM_PASSTHROUGH_GUARD_TIME
+
+#define ESC_CHAR	'+'
+#define ESC_LEN		3
+#define XON		0x11
+#define XOFF		0x13
+
+/* Stop receiving while there is room for less than two UART buffers, as
+ * one more can be received after that. Start again when half of the
+ * buffer is free.
+ */
+#define HOLD_SPACE	(2 * CONFIG_SLM_UART_RX_BUF_SIZE)
+#define RESUME_SPACE	(BUF_SIZE / 2)
+
+BUILD_ASSERT(HOLD_SPACE < RESUME_SPACE,
+	     "Pass-through buffer too small for the UART receive buffers");
+
+/*
+ * The UART callback copies received data into the ring, and the
+ * pass-through thread sends it from there. The escape sequence is three
+ * escape characters with no data for the guard time before and after; the
+ * characters are held back until it is known whether they are data. It is
+ * not looked for when there is no exit handler. The ring indexes are only
+ * changed with interrupts locked.
+ */
+
+RING_BUF_DECLARE(pt_ring, BUF_SIZE);
+
+static const uint8_t esc_seq[ESC_LEN] = { ESC_CHAR, ESC_CHAR, ESC_CHAR };
+
+static slm_passthrough_send_t pt_send;	/* NULL when not sending */
+static slm_passthrough_exit_t pt_exit;
+static slm_passthrough_resume_t pt_resume;
+static bool pt_active;		/* Received data is passed through. */
+static uint8_t esc_count;	/* Escape characters held back. */
+static uint32_t rx_last;	/* Uptime when data was last received. */
+static bool rx_held;		/* No buffer was given to the UART. */
+static bool rx_stopped;		/* Reception stopped while held. */
+static bool xoff_sent;
+
+static K_MUTEX_DEFINE(pt_mutex);
+/* Given when there is data to send, or reception may be started */
+static K_SEM_DEFINE(pt_data, 0, 1);
+
+static void esc_work_fn(struct k_work *work);
+static void flow_work_fn(struct k_work *work);
+static void esc_timer_fn(struct k_timer *timer);
+
+static K_WORK_DEFINE(esc_work, esc_work_fn);
+static K_WORK_DEFINE(flow_work, flow_work_fn);
+static K_TIMER_DEFINE(esc_timer, esc_timer_fn, NULL);
+
+/* Called with interrupts locked */
+static void rx_put(const uint8_t *data, size_t len)
+{
+	uint32_t put;
+
+	if (len == 0) {
+		return;
+	}
+
+	put = ring_buf_put(&pt_ring, data, len);
+	if (put < len) {
+		LOG_WRN("Buffer overrun, dropping %d bytes", len - put);
+	}
+	k_sem_give(&pt_data);
+
+	if (IS_ENABLED(CONFIG_SLM_PASSTHROUGH_XONXOFF) && !xoff_sent &&
+	    ring_buf_space_get(&pt_ring) < HOLD_SPACE) {
+		xoff_sent = true;
+		k_work_submit(&flow_work);
+	}
+}
+
+/* Starts reception again, and sends XON, when there is room */
+static void rx_resume_check(void)
+{
+	bool resume = false;
+	bool xon = false;
+	unsigned int key = irq_lock();
+	bool room = ring_buf_space_get(&pt_ring) >= RESUME_SPACE;
+
+	if (rx_stopped && (room || !pt_active)) {
+		rx_held = false;
+		rx_stopped = false;
+		resume = true;
+	}
+	if (xoff_sent && (room || !pt_active)) {
+		xoff_sent = false;
+		xon = true;
+	}
+	irq_unlock(key);
+
+	if (resume && pt_resume != NULL) {
+		pt_resume();
+	}
+	if (xon) {
+		k_work_submit(&flow_work);
+	}
+}
+
+/* Called with the mutex held */
+static void tx_drain(void)
+{
+	uint8_t *data;
+	uint32_t len;
+	unsigned int key;
+	int ret;
+
+	while (pt_send != NULL) {
+		key = irq_lock();
+		len = ring_buf_get_claim(&pt_ring, &data, BUF_SIZE);
+		irq_unlock(key);
+		if (len == 0) {
+			break;
+		}
+
+		ret = pt_send(data, len);
+		if (ret <= 0) {
+			LOG_WRN("Send failed: %d, dropping %d bytes", ret, len);
+			ret = len;
+		}
+
+		key = irq_lock();
+		ring_buf_get_finish(&pt_ring, ret);
+		irq_unlock(key);
+
+		rx_resume_check();
+	}
+}
+
+static void esc_timer_fn(struct k_timer *timer)
+{
+	unsigned int key = irq_lock();
+
+	ARG_UNUSED(timer);
+
+	/* No data followed the escape sequence */
+	if (pt_active && esc_count == ESC_LEN) {
+		pt_active = false;
+		esc_count = 0;
+		k_work_submit(&esc_work);
+	}
+	irq_unlock(key);
+}
+
+static void esc_work_fn(struct k_work *work)
+{
+	static const uint8_t ok_str[] = "OK\r\n";
+
+	ARG_UNUSED(work);
+
+	k_mutex_lock(&pt_mutex, K_FOREVER);
+	if (pt_send != NULL) {
+		/* Data received before the escape sequence is still sent */
+		tx_drain();
+		pt_send = NULL;
+		if (pt_exit != NULL) {
+			pt_exit();
+		}
+	}
+	k_mutex_unlock(&pt_mutex);
+
+	LOG_INF("Left pass-through mode");
+	slm_uart_tx_write(ok_str, sizeof(ok_str) - 1);
+	k_sem_give(&pt_data);
+}
+
+static void flow_work_fn(struct k_work *work)
+{
+	uint8_t flow;
+
+	ARG_UNUSED(work);
+
+	flow = xoff_sent ? XOFF : XON;
+	slm_uart_tx_write(&flow, 1);
+}
+
+void slm_passthrough_init(slm_passthrough_resume_t resume)
+{
+	pt_resume = resume;
+}
+
+int slm_passthrough_enter(slm_passthrough_send_t send,
+			  slm_passthrough_exit_t exit)
+{
+	unsigned int key;
+
+	if (send == NULL) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&pt_mutex, K_FOREVER);
+	if (pt_send != NULL) {
+		k_mutex_unlock(&pt_mutex);
+		return -EBUSY;
+	}
+	pt_send = send;
+	pt_exit = exit;
+
+	key = irq_lock();
+	ring_buf_reset(&pt_ring);
+	esc_count = 0;
+	rx_last = k_uptime_get_32();
+	xoff_sent = false;
+	pt_active = true;
+	irq_unlock(key);
+	k_mutex_unlock(&pt_mutex);
+
+	LOG_INF("Entered pass-through mode");
+
+	return 0;
+}
+
+void slm_passthrough_exit(void)
+{
+	unsigned int key;
+
+	k_mutex_lock(&pt_mutex, K_FOREVER);
+	if (pt_send == NULL) {
+		k_mutex_unlock(&pt_mutex);
+		return;
+	}
+	pt_send = NULL;
+
+	key = irq_lock();
+	pt_active = false;
+	esc_count = 0;
+	ring_buf_reset(&pt_ring);
+	irq_unlock(key);
+	k_timer_stop(&esc_timer);
+	k_mutex_unlock(&pt_mutex);
+
+	LOG_INF("Left pass-through mode");
+	k_sem_give(&pt_data);
+}
+
+bool slm_passthrough_active(void)
+{
+	return pt_active;
+}
+
+void slm_passthrough_rx(const uint8_t *data, size_t len)
+{
+	uint32_t now = k_uptime_get_32();
+	bool quiet = (now - rx_last) >= GUARD_TIME_MS;
+	unsigned int key = irq_lock();
+	size_t count = 0;
+
+	rx_last = now;
+	if (!pt_active) {
+		goto exit;
+	}
+
+	if (esc_count == ESC_LEN) {
+		/* Data followed the escape sequence within the guard time */
+		k_timer_stop(&esc_timer);
+	} else if (pt_exit != NULL && (esc_count > 0 || quiet)) {
+		while (count < len && esc_count + count < ESC_LEN &&
+		       data[count] == ESC_CHAR) {
+			count++;
+		}
+	}
+	if (count > 0 && count == len) {
+		esc_count += count;
+		if (esc_count == ESC_LEN) {
+			k_timer_start(&esc_timer, K_MSEC(GUARD_TIME_MS),
+				      K_NO_WAIT);
+		}
+		goto exit;
+	}
+
+	/* Not an escape sequence, so what was held back is data */
+	rx_put(esc_seq, esc_count);
+	esc_count = 0;
+	rx_put(data, len);
+
+exit:
+	irq_unlock(key);
+}
+
+bool slm_passthrough_rx_hold(void)
+{
+	unsigned int key;
+
+	if (IS_ENABLED(CONFIG_SLM_PASSTHROUGH_XONXOFF)) {
+		return false;
+	}
+
+	key = irq_lock();
+	rx_held = pt_active && ring_buf_space_get(&pt_ring) < HOLD_SPACE;
+	irq_unlock(key);
+
+	return rx_held;
+}
+
+void slm_passthrough_rx_stopped(void)
+{
+	unsigned int key = irq_lock();
+
+	if (rx_held) {
+		rx_stopped = true;
+		k_sem_give(&pt_data);
+	}
+	irq_unlock(key);
+}
+
+static void pt_thread_fn(void *p1, void *p2, void *p3)
+{
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	while (true) {
+		k_sem_take(&pt_data, K_FOREVER);
+
+		k_mutex_lock(&pt_mutex, K_FOREVER);
+		tx_drain();
+		k_mutex_unlock(&pt_mutex);
+
+		rx_resume_check();
+	}
+}
+
+K_THREAD_DEFINE(slm_passthrough_thread, THREAD_STACK_SIZE,
+		pt_thread_fn, NULL, NULL, NULL,
+		THREAD_PRIORITY, 0, 0);
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef SLM_PASSTHROUGH_
+#define SLM_PASSTHROUGH_
+
+/**@file slm_passthrough.h
+ *
+ * @brief Transparent pass-through mode for serial LTE modem
+ * @{
+ */
+
+#include <zephyr/types.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @brief Pass-through send handler type
+ *
+ * Called from the pass-through thread with data received from the UART.
+ *
+ * @return Number of bytes sent, or a negative error code
+ */
+typedef int (*slm_passthrough_send_t)(const uint8_t *data, size_t len);
+
+/**@brief Called when pass-through mode is left with the escape sequence. */
+typedef void (*slm_passthrough_exit_t)(void);
+
+/**@brief Called to start UART reception again after it was held. */
+typedef void (*slm_passthrough_resume_t)(void);
+
+/**
+ * @brief Initialize pass-through mode
+ *
+ * @param[in] resume Starts UART reception when there is room again
+ */
+void slm_passthrough_init(slm_passthrough_resume_t resume);
+
+/**
+ * @brief Enter pass-through mode
+ *
+ * Data received from the UART is no longer parsed as AT commands, and is
+ * given to @p send instead, until the escape sequence is received or
+ * @ref slm_passthrough_exit is called.
+ *
+ * @param[in] send Handler that sends the data
+ * @param[in] exit Handler called when the escape sequence is received, or
+ *                 NULL if all data, including the escape sequence, is to be
+ *                 sent until @ref slm_passthrough_exit is called
+ *
+ * @retval 0 If the operation was successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int slm_passthrough_enter(slm_passthrough_send_t send,
+			  slm_passthrough_exit_t exit);
+
+/**
+ * @brief Leave pass-through mode, when the connection is closed or all
+ *        data expected has been received
+ *
+ * Data that has not been sent is dropped. Does nothing if pass-through
+ * mode is not active.
+ */
+void slm_passthrough_exit(void);
+
+/**@brief Check if pass-through mode is active. */
+bool slm_passthrough_active(void);
+
+/**
+ * @brief Handle data received from the UART
+ *
+ * Call from the UART callback, on UART_RX_RDY.
+ *
+ * @param[in] data Received data
+ * @param[in] len Length of data
+ */
+void slm_passthrough_rx(const uint8_t *data, size_t len);
+
+/**
+ * @brief Check if UART reception must stop
+ *
+ * Call from the UART callback, on UART_RX_BUF_REQUEST. When true is
+ * returned, no buffer must be given, so that reception stops when the
+ * current buffer is full. With hardware flow control, the sender is then
+ * held off. Reception is started again with the resume handler.
+ *
+ * @retval true If the receive buffer is nearly full.
+ */
+bool slm_passthrough_rx_hold(void);
+
+/**
+ * @brief Notify that UART reception has stopped
+ *
+ * Call from the UART callback, on UART_RX_DISABLED.
+ */
+void slm_passthrough_rx_stopped(void);
+
+/** @} */
+
+#endif /* SLM_PASSTHROUGH_ */
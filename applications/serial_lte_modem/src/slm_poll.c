@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <logging/log.h>
+#include <zephyr.h>
+#include <net/socket.h>
+#include "slm_util.h"
+#include "slm_poll.h"
+
+LOG_MODULE_REGISTER(slm_poll, CONFIG_SLM_LOG_LEVEL);
+
+#define THREAD_STACK_SIZE	CONFIG_SLM_POLL_STACK_SIZE
+#define THREAD_PRIORITY		K_LOWEST_APPLICATION_THREAD_PRIO
+#define MAX_POLL_FD		CONFIG_SLM_POLL_MAX_FDS
+
+/*
+ * One thread polls the sockets of all services and calls their handlers,
+ * instead of one thread per service. The offloaded sockets can not be
+ * mixed with an event socket in poll(), so the poll time-out bounds how
+ * long a socket registered from another thread waits to be polled.
+ */
+
+static struct slm_poll_entry {
+	int fd;			/* Socket descriptor. */
+	short events;		/* Poll events. */
+	slm_poll_handler_t handler; /* Handler, NULL if the entry is free. */
+	void *ctx;		/* Handler context. */
+	int timeout;		/* Idle time-out, negative for none. */
+	int64_t deadline;	/* Uptime when the time-out expires. */
+	uint32_t seq;		/* Changed whenever the entry is used. */
+} entries[MAX_POLL_FD];
+
+/* Sockets of the current pass, and the entries they were taken from */
+static struct pollfd fds[MAX_POLL_FD];
+static struct {
+	uint8_t index;
+	uint32_t seq;
+} polled[MAX_POLL_FD];
+static uint32_t next_seq;
+
+static K_MUTEX_DEFINE(poll_mutex);
+/* Wakes up the poll thread when there was nothing to poll */
+static K_SEM_DEFINE(poll_added, 0, 1);
+
+static struct slm_poll_entry *entry_find(int fd)
+{
+	for (int i = 0; i < MAX_POLL_FD; i++) {
+		if (entries[i].handler != NULL && entries[i].fd == fd) {
+			return &entries[i];
+		}
+	}
+
+	return NULL;
+}
+
+int slm_poll_add(int fd, short events, slm_poll_handler_t handler,
+		 void *ctx)
+{
+	struct slm_poll_entry *entry = NULL;
+	int ret = 0;
+
+	if (fd < 0 || handler == NULL) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&poll_mutex, K_FOREVER);
+	if (entry_find(fd) != NULL) {
+		ret = -EEXIST;
+		goto exit;
+	}
+	for (int i = 0; i < MAX_POLL_FD; i++) {
+		if (entries[i].handler == NULL) {
+			entry = &entries[i];
+			break;
+		}
+	}
+	if (entry == NULL) {
+		LOG_WRN("No room to poll socket %d", fd);
+		ret = -ENOMEM;
+		goto exit;
+	}
+
+	entry->fd = fd;
+	entry->events = events;
+	entry->handler = handler;
+	entry->ctx = ctx;
+	entry->timeout = -1;
+	entry->seq = ++next_seq;
+	k_sem_give(&poll_added);
+	LOG_DBG("Polling socket %d", fd);
+
+exit:
+	k_mutex_unlock(&poll_mutex);
+
+	return ret;
+}
+
+int slm_poll_remove(int fd)
+{
+	struct slm_poll_entry *entry;
+	int ret = 0;
+
+	k_mutex_lock(&poll_mutex, K_FOREVER);
+	entry = entry_find(fd);
+	if (entry != NULL) {
+		entry->handler = NULL;
+		entry->fd = INVALID_SOCKET;
+		LOG_DBG("Stopped polling socket %d", fd);
+	} else {
+		ret = -ENOENT;
+	}
+	k_mutex_unlock(&poll_mutex);
+
+	return ret;
+}
+
+int slm_poll_timeout_set(int fd, int timeout)
+{
+	struct slm_poll_entry *entry;
+	int ret = 0;
+
+	k_mutex_lock(&poll_mutex, K_FOREVER);
+	entry = entry_find(fd);
+	if (entry != NULL) {
+		entry->timeout = timeout;
+		entry->deadline = k_uptime_get() + timeout;
+	} else {
+		ret = -ENOENT;
+	}
+	k_mutex_unlock(&poll_mutex);
+
+	return ret;
+}
+
+/* Fills in the sockets to poll, and the time until the first time-out */
+static int poll_prepare(int *timeout)
+{
+	int64_t now = k_uptime_get();
+	int count = 0;
+
+	*timeout = CONFIG_SLM_POLL_TIME;
+
+	k_mutex_lock(&poll_mutex, K_FOREVER);
+	for (int i = 0; i < MAX_POLL_FD; i++) {
+		struct slm_poll_entry *entry = &entries[i];
+
+		if (entry->handler == NULL) {
+			continue;
+		}
+
+		fds[count].fd = entry->fd;
+		fds[count].events = entry->events;
+		fds[count].revents = 0;
+		polled[count].index = i;
+		polled[count].seq = entry->seq;
+		count++;
+
+		if (entry->timeout >= 0) {
+			*timeout = MIN(*timeout,
+				       MAX(entry->deadline - now, 0));
+		}
+	}
+	k_mutex_unlock(&poll_mutex);
+
+	return count;
+}
+
+static void poll_dispatch(int count)
+{
+	int64_t now = k_uptime_get();
+
+	/* Handlers run with the mutex held, so that slm_poll_remove() does
+	 * not return while the handler of the socket is running.
+	 */
+	k_mutex_lock(&poll_mutex, K_FOREVER);
+	for (int i = 0; i < count; i++) {
+		struct slm_poll_entry *entry = &entries[polled[i].index];
+		int revents = fds[i].revents;
+
+		/* Skip sockets unregistered by an earlier handler */
+		if (entry->handler == NULL || entry->seq != polled[i].seq) {
+			continue;
+		}
+		if (revents == 0 &&
+		    (entry->timeout < 0 || now < entry->deadline)) {
+			continue;
+		}
+		if (entry->timeout >= 0) {
+			entry->deadline = now + entry->timeout;
+		}
+
+		LOG_DBG("Poll events 0x%08x on %d", revents, entry->fd);
+		entry->handler(entry->fd, revents, entry->ctx);
+	}
+	k_mutex_unlock(&poll_mutex);
+}
+
+static void poll_thread_fn(void *p1, void *p2, void *p3)
+{
+	int count, timeout, ret;
+
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	while (true) {
+		count = poll_prepare(&timeout);
+		if (count == 0) {
+			k_sem_take(&poll_added, K_FOREVER);
+			continue;
+		}
+
+		ret = poll(fds, count, timeout);
+		if (ret < 0) {
+			LOG_WRN("poll() error: %d", -errno);
+			k_sleep(K_MSEC(CONFIG_SLM_POLL_TIME));
+			continue;
+		}
+
+		poll_dispatch(count);
+	}
+}
+
+K_THREAD_DEFINE(slm_poll_thread, THREAD_STACK_SIZE,
+		poll_thread_fn, NULL, NULL, NULL,
+		THREAD_PRIORITY, 0, 0);
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef SLM_POLL_
+#define SLM_POLL_
+
+/**@file slm_poll.h
+ *
+ * @brief Socket poll loop shared by serial LTE modem services
+ * @{
+ */
+
+#include <zephyr/types.h>
+
+/**
+ * @brief Socket handler
+ *
+ * Called from the poll thread when a socket is ready, or with no events
+ * when its idle time-out expires. Handlers may register and unregister
+ * sockets, including their own.
+ *
+ * @param[in] fd Socket descriptor
+ * @param[in] revents Returned poll events, 0 if the socket timed out
+ * @param[in] ctx Context given when the socket was registered
+ */
+typedef void (*slm_poll_handler_t)(int fd, int revents, void *ctx);
+
+/**
+ * @brief Register a socket
+ *
+ * The socket is polled from the next pass of the poll loop, which starts
+ * within CONFIG_SLM_POLL_TIME milliseconds.
+ *
+ * @param[in] fd Socket descriptor
+ * @param[in] events Poll events to wait for, POLLERR, POLLHUP and POLLNVAL
+ *                   are always reported
+ * @param[in] handler Handler called when the socket is ready
+ * @param[in] ctx Context passed to the handler
+ *
+ * @return 0 if successful, -EEXIST if the socket is already registered,
+ *         -ENOMEM if CONFIG_SLM_POLL_MAX_FDS sockets are registered.
+ */
+int slm_poll_add(int fd, short events, slm_poll_handler_t handler,
+		 void *ctx);
+
+/**
+ * @brief Unregister a socket
+ *
+ * When this returns, the handler of the socket is not running, unless it is
+ * the caller, and it is not called for the socket again. The socket can
+ * then be closed.
+ *
+ * @param[in] fd Socket descriptor
+ *
+ * @return 0 if successful, -ENOENT if the socket is not registered.
+ */
+int slm_poll_remove(int fd);
+
+/**
+ * @brief Set the idle time-out of a socket
+ *
+ * The handler is called with no events when the socket has not been ready
+ * for the given time. The time-out restarts whenever the handler is called.
+ *
+ * @param[in] fd Socket descriptor
+ * @param[in] timeout Time-out in milliseconds, or a negative value for none
+ *
+ * @return 0 if successful, -ENOENT if the socket is not registered.
+ */
+int slm_poll_timeout_set(int fd, int timeout);
+
+/** @} */
+
+#endif /* SLM_POLL_ */
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <logging/log.h>
+#include <zephyr.h>
+#include <string.h>
+#include <drivers/uart.h>
+#include <sys/ring_buffer.h>
+#include "slm_uart.h"
+
+LOG_MODULE_REGISTER(slm_uart, CONFIG_SLM_LOG_LEVEL);
+
+/*
+ * Writers copy data into the ring under a mutex, and the UART sends it by
+ * DMA straight from the ring. Each transfer takes all the data up to the
+ * end of the ring, so a response is usually sent while the next one is
+ * written. The ring indexes are only changed with interrupts locked, as
+ * transfers end in the UART callback, in interrupt context. The data is
+ * copied into claimed space without the lock.
+ */
+
+RING_BUF_DECLARE(tx_ring, CONFIG_SLM_UART_TX_BUF_SIZE);
+
+static const struct device *uart_dev;
+static bool tx_busy;
+static uint32_t tx_len;
+
+static K_MUTEX_DEFINE(tx_mutex);
+/* Given when a transfer ends, and frees space */
+static K_SEM_DEFINE(tx_space, 0, 1);
+
+/* Called with interrupts locked */
+static void tx_start(void)
+{
+	uint8_t *data;
+	int err;
+
+	while (!tx_busy) {
+		tx_len = ring_buf_get_claim(&tx_ring, &data,
+					    CONFIG_SLM_UART_TX_BUF_SIZE);
+		if (tx_len == 0) {
+			return;
+		}
+
+		err = uart_tx(uart_dev, data, tx_len, SYS_FOREVER_MS);
+		if (err) {
+			/* Drop the data, so that writers do not wait for
+			 * a UART that is powered off.
+			 */
+			LOG_WRN("uart_tx failed: %d", err);
+			ring_buf_get_finish(&tx_ring, tx_len);
+			continue;
+		}
+		tx_busy = true;
+	}
+}
+
+/* Called with the mutex held */
+static uint8_t *tx_claim(size_t *size)
+{
+	uint8_t *data;
+	uint32_t claimed;
+	unsigned int key;
+
+	while (true) {
+		key = irq_lock();
+		claimed = ring_buf_put_claim(&tx_ring, &data,
+					     CONFIG_SLM_UART_TX_BUF_SIZE);
+		irq_unlock(key);
+		if (claimed > 0) {
+			break;
+		}
+		k_sem_take(&tx_space, K_FOREVER);
+	}
+	*size = claimed;
+
+	return data;
+}
+
+/* Called with the mutex held */
+static void tx_finish(size_t len)
+{
+	unsigned int key = irq_lock();
+
+	ring_buf_put_finish(&tx_ring, len);
+	tx_start();
+	irq_unlock(key);
+}
+
+/* Called with the mutex held */
+static void tx_put(const uint8_t *data, size_t len)
+{
+	uint8_t *space;
+	size_t size;
+
+	while (len > 0) {
+		space = tx_claim(&size);
+		size = MIN(size, len);
+		memcpy(space, data, size);
+		tx_finish(size);
+		data += size;
+		len -= size;
+	}
+}
+
+void slm_uart_tx_init(const struct device *dev)
+{
+	unsigned int key = irq_lock();
+
+	uart_dev = dev;
+	if (!tx_busy) {
+		ring_buf_reset(&tx_ring);
+	}
+	irq_unlock(key);
+}
+
+void slm_uart_tx_write(const uint8_t *data, size_t len)
+{
+	k_mutex_lock(&tx_mutex, K_FOREVER);
+	tx_put(data, len);
+	k_mutex_unlock(&tx_mutex);
+}
+
+void slm_uart_tx_writev(const struct slm_uart_vec *vec, size_t count)
+{
+	k_mutex_lock(&tx_mutex, K_FOREVER);
+	for (size_t i = 0; i < count; i++) {
+		tx_put(vec[i].data, vec[i].len);
+	}
+	k_mutex_unlock(&tx_mutex);
+}
+
+uint8_t *slm_uart_tx_claim(size_t *size)
+{
+	k_mutex_lock(&tx_mutex, K_FOREVER);
+
+	return tx_claim(size);
+}
+
+void slm_uart_tx_commit(size_t len)
+{
+	tx_finish(len);
+	k_mutex_unlock(&tx_mutex);
+}
+
+void slm_uart_tx_done(void)
+{
+	unsigned int key = irq_lock();
+
+	if (tx_busy) {
+		ring_buf_get_finish(&tx_ring, tx_len);
+		tx_busy = false;
+		k_sem_give(&tx_space);
+		tx_start();
+	}
+	irq_unlock(key);
+}
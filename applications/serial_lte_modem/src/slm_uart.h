@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef SLM_UART_
+#define SLM_UART_
+
+/**@file slm_uart.h
+ *
+ * @brief UART transmit buffer for serial LTE modem
+ * @{
+ */
+
+#include <zephyr/types.h>
+#include <stddef.h>
+#include <device.h>
+
+/**@brief Piece of data sent by @ref slm_uart_tx_writev. */
+struct slm_uart_vec {
+	const uint8_t *data;
+	size_t len;
+};
+
+/**
+ * @brief Initialize the transmit buffer
+ *
+ * Data is copied into a ring buffer of CONFIG_SLM_UART_TX_BUF_SIZE bytes,
+ * and sent from there by UART DMA while more data is written. The UART
+ * callback must call @ref slm_uart_tx_done when a transfer has ended.
+ *
+ * @param[in] dev UART device, using the asynchronous API
+ */
+void slm_uart_tx_init(const struct device *dev);
+
+/**
+ * @brief Send data
+ *
+ * Waits while the buffer is full.
+ *
+ * @param[in] data Data to send
+ * @param[in] len Length of data
+ */
+void slm_uart_tx_write(const uint8_t *data, size_t len);
+
+/**
+ * @brief Send data in pieces
+ *
+ * The pieces are sent one after the other, without data written from
+ * other threads in between.
+ *
+ * @param[in] vec Pieces of data
+ * @param[in] count Number of pieces
+ */
+void slm_uart_tx_writev(const struct slm_uart_vec *vec, size_t count);
+
+/**
+ * @brief Claim buffer space to write data to be sent into
+ *
+ * Waits until there is free space. Other threads can not send data until
+ * @ref slm_uart_tx_commit is called.
+ *
+ * @param[out] size Size of the claimed space, at least 1 byte
+ *
+ * @return Claimed space
+ */
+uint8_t *slm_uart_tx_claim(size_t *size);
+
+/**
+ * @brief Send data written into claimed space
+ *
+ * @param[in] len Length of the data, which can be 0
+ */
+void slm_uart_tx_commit(size_t len);
+
+/**
+ * @brief Notify that a transfer has ended
+ *
+ * Call on UART_TX_DONE and UART_TX_ABORTED. Starts sending the rest of the
+ * buffered data.
+ */
+void slm_uart_tx_done(void);
+
+/** @} */
+
+#endif /* SLM_UART_ */
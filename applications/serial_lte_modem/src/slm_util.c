@@ -143,3 +143,49 @@ bool check_for_ipv4(const char *address, uint8_t length)
 
 	return true;
 }
+
+#define BYTES_ONES	0x01010101U
+#define BYTES_HIGHS	0x80808080U
+/* Non-zero if one of the bytes of the word is zero */
+#define HAS_ZERO_BYTE(w) (((w) - BYTES_ONES) & ~(w) & BYTES_HIGHS)
+
+static bool byte_in_set(uint8_t byte, const uint8_t *set, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (byte == set[i]) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**@brief Find the first byte of data that is in a set
+ */
+size_t slm_util_find_any(const uint8_t *data, size_t len,
+			 const uint8_t *set, size_t count)
+{
+	size_t i;
+
+	/* Four bytes at a time, until a word holds one of the bytes */
+	for (i = 0; i + sizeof(uint32_t) <= len; i += sizeof(uint32_t)) {
+		uint32_t word;
+		uint32_t found = 0;
+
+		memcpy(&word, data + i, sizeof(word));
+		for (size_t j = 0; j < count; j++) {
+			found |= HAS_ZERO_BYTE(word ^ (set[j] * BYTES_ONES));
+		}
+		if (found) {
+			break;
+		}
+	}
+
+	for (; i < len; i++) {
+		if (byte_in_set(data[i], set, count)) {
+			return i;
+		}
+	}
+
+	return len;
+}
@@ -14,6 +14,7 @@
  */
 
 #include <zephyr/types.h>
+#include <stddef.h>
 #include <ctype.h>
 #include <stdbool.h>
 
@@ -92,6 +93,22 @@ int slm_util_atoh(const char *ascii, uint16_t ascii_len,
  */
 bool check_for_ipv4(const char *address, uint8_t length);
 
+/**@brief Find the first byte of data that is in a set
+ *
+ * The data is searched a word at a time, so this is faster than a loop
+ * over the bytes when the bytes of the set are rare.
+ *
+ * @param[in] data Data to search
+ * @param[in] len Length of data
+ * @param[in] set Bytes to search for
+ * @param[in] count Number of bytes in the set
+ *
+ * @return index of the first byte that is in the set, or len if there is
+ *         none.
+ */
+size_t slm_util_find_any(const uint8_t *data, size_t len,
+			 const uint8_t *set, size_t count);
+
 /** @} */
 
 #endif /* SLM_UTIL_ */
@@ -8,15 +8,117 @@
 #include "cJSON.h"
 #include <stdint.h>
 #include <zephyr.h>
+#include <sys/util.h>
 
 static cJSON_Hooks _cjson_hooks;
 
+#if defined(CONFIG_CJSON_ARENA)
+
+/* Alignment of arena allocations, enough for the double in a cJSON item */
+#define ARENA_ALIGN sizeof(double)
+
+static struct {
+	uint8_t buf[CONFIG_CJSON_ARENA_SIZE] __aligned(ARENA_ALIGN);
+	/* Thread of the current scope, allocations by others use the heap */
+	k_tid_t owner;
+	uint8_t nesting;
+	size_t used;
+	/* Offset of the last allocation, which can be given back */
+	size_t last;
+	size_t peak;
+	uint32_t overflows;
+} arena;
+
+static K_MUTEX_DEFINE(arena_mutex);
+
+static bool in_arena(const void *p_ptr)
+{
+	return (const uint8_t *)p_ptr >= arena.buf &&
+	       (const uint8_t *)p_ptr < arena.buf + sizeof(arena.buf);
+}
+
+/**@brief malloc() function definition. */
+static void *malloc_fn_hook(size_t sz)
+{
+	size_t size = ROUND_UP(sz, ARENA_ALIGN);
+	void *p_ptr;
+
+	if (arena.owner != k_current_get()) {
+		return k_malloc(sz);
+	}
+
+	if (size > sizeof(arena.buf) - arena.used) {
+		arena.overflows++;
+		return k_malloc(sz);
+	}
+
+	p_ptr = &arena.buf[arena.used];
+	arena.last = arena.used;
+	arena.used += size;
+	arena.peak = MAX(arena.peak, arena.used);
+
+	return p_ptr;
+}
+
+/**@brief free() function definition. */
+static void free_fn_hook(void *p_ptr)
+{
+	if (!in_arena(p_ptr)) {
+		k_free(p_ptr);
+		return;
+	}
+
+	/* Only the last allocation is given back, everything else is
+	 * released when the scope ends.
+	 */
+	if (p_ptr == &arena.buf[arena.last]) {
+		arena.used = arena.last;
+	}
+}
+
+void cJSON_ArenaBegin(void)
+{
+	(void)k_mutex_lock(&arena_mutex, K_FOREVER);
+
+	if (arena.nesting++ == 0) {
+		arena.owner = k_current_get();
+		arena.used = 0;
+		arena.last = 0;
+	}
+
+	cJSON_Init();
+}
+
+void cJSON_ArenaEnd(void)
+{
+	__ASSERT(arena.nesting > 0 && arena.owner == k_current_get(),
+		 "No arena scope in this thread");
+
+	if (--arena.nesting == 0) {
+		arena.owner = NULL;
+		arena.used = 0;
+	}
+
+	k_mutex_unlock(&arena_mutex);
+}
+
+void cJSON_ArenaStatsGet(struct cJSON_arena_stats *stats)
+{
+	stats->used = arena.used;
+	stats->peak = arena.peak;
+	stats->overflows = arena.overflows;
+}
+
+#else
+
 /**@brief malloc() function definition. */
 static void *malloc_fn_hook(size_t sz) { return k_malloc(sz); }
 
 /**@brief free() function definition. */
 static void free_fn_hook(void *p_ptr) { k_free(p_ptr); }
 
+#endif /* defined(CONFIG_CJSON_ARENA) */
+
 /**@brief Initialize cJSON by assigning function hooks. */
 void cJSON_Init(void)
 {
@@ -8,6 +8,7 @@
 #define cJSON_OS_H__
 
 #include <stdint.h>
+#include <stddef.h>
 
 /**
  * @brief Initialize cJSON with OS hooks.
@@ -21,4 +22,52 @@ void cJSON_Init(void);
  */
 void cJSON_FreeString(char *ptr);
 
+/**@brief cJSON arena statistics. */
+struct cJSON_arena_stats {
+	/** Bytes currently allocated from the arena. */
+	size_t used;
+	/** Largest number of bytes allocated from the arena in one scope. */
+	size_t peak;
+	/** Number of allocations that did not fit and used the heap. */
+	uint32_t overflows;
+};
+
+#if defined(CONFIG_CJSON_ARENA)
+
+/**
+ * @brief Start an arena scope.
+ *
+ * Until @ref cJSON_ArenaEnd is called, memory allocated by cJSON in the
+ * calling thread is taken from a static arena instead of the heap, and
+ * freeing it does nothing. Allocations that do not fit in the arena, and
+ * allocations made by other threads, use the heap as usual.
+ *
+ * Scopes are serialized between threads and may be nested within a
+ * thread. cJSON is set up with the OS hooks, as by @ref cJSON_Init.
+ */
+void cJSON_ArenaBegin(void);
+
+/**
+ * @brief End an arena scope, releasing all memory allocated from the arena
+ *        at once.
+ *
+ * Items parsed or created in the scope must have been deleted, or must not
+ * be used anymore.
+ */
+void cJSON_ArenaEnd(void);
+
+/**
+ * @brief Get arena statistics, for example to tune the arena size.
+ * @param stats OUT -- arena statistics
+ */
+void cJSON_ArenaStatsGet(struct cJSON_arena_stats *stats);
+
+#else
+
+static inline void cJSON_ArenaBegin(void) {}
+
+static inline void cJSON_ArenaEnd(void) {}
+
+#endif /* defined(CONFIG_CJSON_ARENA) */
+
 #endif /* cJSON_OS_H__ */
@@ -22,6 +22,11 @@ extern "C" {
 
 #define DFU_TARGET_IMAGE_TYPE_MCUBOOT 1
 #define DFU_TARGET_IMAGE_TYPE_MODEM_DELTA 2
+#define DFU_TARGET_IMAGE_TYPE_COMPRESSED 3
+#define DFU_TARGET_IMAGE_TYPE_DELTA 4
+
+/** Size of the SHA-256 digest given to @ref dfu_target_hash_expect. */
+#define DFU_TARGET_HASH_LEN 32
 
 enum dfu_target_evt_id {
 	DFU_TARGET_EVT_TIMEOUT,
@@ -74,6 +79,25 @@ int dfu_target_img_type(const void *const buf, size_t len);
  **/
 int dfu_target_init(int img_type, size_t file_size, dfu_target_callback_t cb);
 
+/**
+ * @brief Set the SHA-256 digest that the next image must match.
+ *
+ *	  The digest is computed over the fragments given to
+ *	  'dfu_target_write' as they are received, and checked by
+ *	  'dfu_target_done', so that a corrupted image is rejected before
+ *	  the upgrade is scheduled. If the image is resumed from an offset
+ *	  that was reached before a reset, the digest is not checked.
+ *
+ *	  Call this function before 'dfu_target_init'. It requires
+ *	  @option{CONFIG_DFU_TARGET_HASH}.
+ *
+ * @param[in] digest Expected digest of @ref DFU_TARGET_HASH_LEN bytes, or
+ *		     NULL to not verify the next image.
+ *
+ * @return 0 on success, -ENOTSUP if hash verification is not enabled.
+ **/
+int dfu_target_hash_expect(const uint8_t *digest);
+
 /**
  * @brief Get offset of the firmware upgrade
  *
@@ -102,6 +126,10 @@ int dfu_target_write(const void *const buf, size_t len);
  * @param[in] successful Indicate whether the process completed successfully or
  *			 was aborted.
  *
+ * @retval -EBADMSG The image does not match the digest given to
+ *		    'dfu_target_hash_expect'. The upgrade is aborted.
+ * @retval -EIO A digest was given to 'dfu_target_hash_expect', but the
+ *		image hash could not be computed. The upgrade is aborted.
  * @return 0 for an successful deinitialization or a negative error
  *	   code identicating reason of failure.
  **/
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef JSON_PATH_H__
+#define JSON_PATH_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <zephyr/types.h>
+
+/**
+ * @defgroup json_path JSON path extractor
+ * @{
+ * @brief Extracts values from JSON text without building an object tree.
+ *
+ * The JSON text is scanned once, and the values of a set of paths are
+ * returned as slices of the text itself. Nothing is copied or allocated,
+ * so the text must be kept while the values are used.
+ *
+ * A path is a sequence of member names separated by dots, for example
+ * "execution.jobDocument.location.host". The empty path is the top-level
+ * value. Paths can not lead through arrays, and member names that contain
+ * dots or escape sequences can not be matched.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum nesting of objects and arrays. */
+#define JSON_PATH_MAX_DEPTH 32
+
+/** @brief Type of an extracted value. */
+enum json_path_type {
+	/** The path was not found. */
+	JSON_PATH_NONE,
+	JSON_PATH_OBJECT,
+	JSON_PATH_ARRAY,
+	JSON_PATH_STRING,
+	JSON_PATH_NUMBER,
+	JSON_PATH_TRUE,
+	JSON_PATH_FALSE,
+	JSON_PATH_NULL,
+};
+
+/** @brief Value found in JSON text. */
+struct json_path_value {
+	/** Type of the value. */
+	enum json_path_type type;
+	/** Start of the value in the JSON text. For strings, this is the
+	 *  first character after the opening quote.
+	 */
+	const char *ptr;
+	/** Length of the value. Strings are given without the quotes, and
+	 *  escape sequences are kept as is.
+	 */
+	size_t len;
+};
+
+/** @brief Path to extract, and its value. */
+struct json_path_query {
+	/** Path of the value. */
+	const char *path;
+	/** The value, set by @ref json_path_extract. */
+	struct json_path_value value;
+	/** Internal, number of path elements matched. */
+	uint8_t matched;
+	/** Internal, number of path elements. */
+	uint8_t elements;
+};
+
+/** @brief Initializer for a query. */
+#define JSON_PATH_QUERY(_path) { .path = (_path) }
+
+/** @brief Extract the values of a set of paths.
+ *
+ *  If a member appears more than once, the first one is used. Text after
+ *  the top-level value is ignored.
+ *
+ *  @param[in]     json    JSON text, which does not need to be NUL
+ *                         terminated.
+ *  @param[in]     len     Length of the JSON text.
+ *  @param[in,out] queries Paths to extract. The type of the value of a path
+ *                         that was not found is @ref JSON_PATH_NONE.
+ *  @param[in]     count   Number of queries.
+ *
+ *  @return Number of paths found.
+ *  @retval -EBADMSG If the JSON text is not valid, or nested too deeply.
+ *  @retval -EINVAL If a path has too many elements.
+ */
+int json_path_extract(const char *json, size_t len,
+		      struct json_path_query *queries, size_t count);
+
+/** @brief Check if a path was found. */
+static inline bool json_path_found(const struct json_path_query *query)
+{
+	return query->value.type != JSON_PATH_NONE;
+}
+
+/** @brief Copy a string value, with escape sequences decoded.
+ *
+ *  The copy is truncated if it does not fit in the buffer, and is always
+ *  NUL terminated if the size is not zero.
+ *
+ *  @param[in]  value String value.
+ *  @param[out] buf   Output buffer.
+ *  @param[in]  size  Size of the output buffer.
+ *
+ *  @return Length of the decoded string, which is the size of the buffer or
+ *          more if the copy was truncated.
+ *  @retval -EINVAL If the value is not a string.
+ */
+int json_path_str_copy(const struct json_path_value *value, char *buf,
+		       size_t size);
+
+/** @brief Compare a string value with a string.
+ *
+ *  @return true if the value is a string equal to str once escape
+ *          sequences are decoded.
+ */
+bool json_path_str_eq(const struct json_path_value *value, const char *str);
+
+/** @brief Get an integer value.
+ *
+ *  @param[in]  value Number value.
+ *  @param[out] out   The integer.
+ *
+ *  @retval 0 If successful.
+ *  @retval -EINVAL If the value is not a number without fraction and
+ *                  exponent.
+ *  @retval -ERANGE If the value does not fit.
+ */
+int json_path_int(const struct json_path_value *value, int64_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+
+#endif /* JSON_PATH_H__ */
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef JSON_WRITER_H__
+#define JSON_WRITER_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <zephyr/types.h>
+
+/**
+ * @defgroup json_writer JSON writer
+ * @{
+ * @brief Streaming JSON encoder that writes directly into a buffer.
+ *
+ * Values are appended to the buffer as they are added, without building an
+ * object tree, and no memory is allocated. Errors are sticky: once a write
+ * has failed, the following ones are ignored and the error is reported by
+ * @ref json_writer_finish.
+ *
+ * The key parameter of the functions that add a value is the name of the
+ * member when the value is added to an object, and must be NULL when the
+ * value is added to an array or is the top-level value.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum nesting of objects and arrays. */
+#define JSON_WRITER_MAX_DEPTH 32
+
+/** @brief JSON writer instance. */
+struct json_writer {
+	/** Output buffer, NULL when only measuring. */
+	char *buf;
+	/** Size of the output buffer. */
+	size_t size;
+	/** Length of the JSON text written so far. */
+	size_t len;
+	/** First error encountered, or zero. */
+	int err;
+	/** Current nesting depth. */
+	uint8_t depth;
+	/** Bit per nesting level, set if the level holds a value. */
+	uint32_t nonempty;
+	/** Bit per nesting level, set if the level is an array. */
+	uint32_t arrays;
+};
+
+/** @brief Initialize a writer.
+ *
+ *  @param[out] w    Writer to initialize.
+ *  @param[in]  buf  Output buffer. If NULL, nothing is written and
+ *                   @ref json_writer_finish returns the length the JSON text
+ *                   would have.
+ *  @param[in]  size Size of the output buffer, including the room for the
+ *                   terminating NUL character.
+ */
+void json_writer_init(struct json_writer *w, char *buf, size_t size);
+
+/** @brief Start an object. */
+void json_writer_obj_start(struct json_writer *w, const char *key);
+
+/** @brief End the current object. */
+void json_writer_obj_end(struct json_writer *w);
+
+/** @brief Start an array. */
+void json_writer_arr_start(struct json_writer *w, const char *key);
+
+/** @brief End the current array. */
+void json_writer_arr_end(struct json_writer *w);
+
+/** @brief Add a string, escaped as needed. A NULL string is written as null.
+ */
+void json_writer_str(struct json_writer *w, const char *key,
+		     const char *value);
+
+/** @brief Add an integer. */
+void json_writer_int(struct json_writer *w, const char *key, int64_t value);
+
+/** @brief Add a number.
+ *
+ *  Integral values are written without a fraction, and values that can not
+ *  be represented in JSON, like NaN, are written as null.
+ */
+void json_writer_double(struct json_writer *w, const char *key, double value);
+
+/** @brief Add a boolean. */
+void json_writer_bool(struct json_writer *w, const char *key, bool value);
+
+/** @brief Add a null value. */
+void json_writer_null(struct json_writer *w, const char *key);
+
+/** @brief Add a value that already is JSON text, as is.
+ *
+ *  @param[in] w    Writer.
+ *  @param[in] key  Member name, or NULL.
+ *  @param[in] json JSON text of the value.
+ *  @param[in] len  Length of the JSON text.
+ */
+void json_writer_raw(struct json_writer *w, const char *key, const char *json,
+		     size_t len);
+
+/** @brief Complete the JSON text.
+ *
+ *  The output is NUL terminated if a buffer was given.
+ *
+ *  @param[in] w Writer.
+ *
+ *  @return Length of the JSON text, excluding the NUL character.
+ *  @retval -ENOMEM If the output did not fit in the buffer.
+ *  @retval -EINVAL If objects or arrays were not properly nested.
+ */
+int json_writer_finish(struct json_writer *w);
+
+/** @brief Encoder callback used by @ref json_writer_encode_alloc.
+ *
+ *  The callback is called twice and must produce the same output both
+ *  times.
+ *
+ *  @param[in] w   Writer to encode the JSON text with.
+ *  @param[in] ctx User context.
+ *
+ *  @return 0 if successful, a negative error code to abort encoding.
+ */
+typedef int (*json_writer_encode_t)(struct json_writer *w, void *ctx);
+
+/** @brief Encode into a buffer of the exact size needed.
+ *
+ *  The JSON text is measured in a first pass, and written into a buffer
+ *  allocated with k_malloc in a second pass. The buffer must be released
+ *  with k_free.
+ *
+ *  @param[in]  encode Encoder callback.
+ *  @param[in]  ctx    User context passed to the callback.
+ *  @param[out] out    The NUL terminated JSON text.
+ *  @param[out] len    Length of the JSON text.
+ *
+ *  @return 0 if successful, otherwise a negative error code.
+ */
+int json_writer_encode_alloc(json_writer_encode_t encode, void *ctx,
+			     char **out, size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+
+#endif /* JSON_WRITER_H__ */
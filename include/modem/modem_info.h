@@ -7,10 +7,15 @@
 #ifndef ZEPHYR_INCLUDE_MODEM_INFO_H_
 #define ZEPHYR_INCLUDE_MODEM_INFO_H_
 
+#ifdef CONFIG_JSON_WRITER
+#include <json_writer.h>
+#endif
+
 #ifdef CONFIG_CJSON_LIB
 #include <cJSON.h>
 #endif
 
+#include <toolchain.h>
 #include <modem/at_params.h>
 
 #ifdef __cplusplus
@@ -195,13 +200,14 @@ int modem_info_name_get(enum modem_info info, char *name);
  */
 enum at_param_type modem_info_type_get(enum modem_info info);
 
-#ifdef CONFIG_CJSON_LIB
+#ifdef CONFIG_JSON_WRITER
 /** @brief Encode the modem parameters.
  *
  * The data is added to the string buffer with JSON formatting.
  *
  * @param modem_param Pointer to the modem parameter structure.
- * @param buf         The buffer where the string will be written.
+ * @param buf         The buffer where the string will be written, of
+ *                    MODEM_INFO_JSON_STRING_SIZE bytes.
  *
  * @return Length of the string buffer data if the operation was
  *         successful.
@@ -211,10 +217,28 @@ int modem_info_json_string_encode(struct modem_param_info *modem_param,
 				  char *buf);
 
 
+/** @brief Encode the modem parameters.
+ *
+ * The networkInfo, simInfo and deviceInfo members are added to the JSON
+ * object that is currently open in the writer.
+ *
+ * @param modem_param Pointer to the modem parameter structure.
+ * @param w           The JSON writer where to write the data.
+ *
+ * @return Number of JSON objects added if the operation was successful.
+ *         Otherwise, a (negative) error code is returned.
+ */
+int modem_info_json_write(struct modem_param_info *modem_param,
+			  struct json_writer *w);
+
+#ifdef CONFIG_CJSON_LIB
 /** @brief Encode the modem parameters.
  *
  * The data is stored to a JSON object.
  *
+ * @deprecated Use @ref modem_info_json_write, which encodes the data
+ *             without building a cJSON object for it.
+ *
  * @param modem_param Pointer to the modem parameter structure.
  * @param root_obj    The JSON object where to store the data.
  *
@@ -222,8 +246,9 @@ int modem_info_json_string_encode(struct modem_param_info *modem_param,
  *         operation was successful.
  *         Otherwise, a (negative) error code is returned.
  */
-int modem_info_json_object_encode(struct modem_param_info *modem,
-				  cJSON *root_obj);
+__deprecated int modem_info_json_object_encode(
+	struct modem_param_info *modem_param, cJSON *root_obj);
+#endif
 #endif
 
 /** @brief Obtain the modem parameters.
@@ -44,7 +44,21 @@ enum aws_iot_topic_type {
 	 *  $aws/things/<thing-name>/shadow/delete, publishing an empty message
 	 *  to this topic deletes the device Shadow document.
 	 */
-	AWS_IOT_SHADOW_TOPIC_DELETE
+	AWS_IOT_SHADOW_TOPIC_DELETE,
+	/** Received on $aws/things/<thing-name>/shadow/get/accepted. */
+	AWS_IOT_SHADOW_TOPIC_GET_ACCEPTED,
+	/** Received on $aws/things/<thing-name>/shadow/get/rejected. */
+	AWS_IOT_SHADOW_TOPIC_GET_REJECTED,
+	/** Received on $aws/things/<thing-name>/shadow/update/accepted. */
+	AWS_IOT_SHADOW_TOPIC_UPDATE_ACCEPTED,
+	/** Received on $aws/things/<thing-name>/shadow/update/rejected. */
+	AWS_IOT_SHADOW_TOPIC_UPDATE_REJECTED,
+	/** Received on $aws/things/<thing-name>/shadow/update/delta. */
+	AWS_IOT_SHADOW_TOPIC_UPDATE_DELTA,
+	/** Received on $aws/things/<thing-name>/shadow/delete/accepted. */
+	AWS_IOT_SHADOW_TOPIC_DELETE_ACCEPTED,
+	/** Received on $aws/things/<thing-name>/shadow/delete/rejected. */
+	AWS_IOT_SHADOW_TOPIC_DELETE_REJECTED
 };
 
 /**@ AWS broker disconnect results. */
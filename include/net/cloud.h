@@ -91,6 +91,14 @@ enum cloud_endpoint_type {
 	CLOUD_EP_PRIV_END = INT16_MAX
 };
 
+/**@brief Encoding of the messages a device sends to the cloud. */
+enum cloud_encoding {
+	/** JSON text. */
+	CLOUD_ENCODING_JSON,
+	/** CBOR, see RFC 8949. */
+	CLOUD_ENCODING_CBOR,
+};
+
 /**@brief Cloud connect results. */
 enum cloud_connect_result {
 	CLOUD_CONNECT_RES_SUCCESS = 0,
@@ -195,6 +203,10 @@ struct cloud_backend_config {
 	void *user_data;
 	char *id;
 	size_t id_len;
+	/** Encoding of messages sent to the message endpoint, set by the
+	 *  backend when it is initialized. State updates are always JSON.
+	 */
+	enum cloud_encoding encoding;
 };
 
 /**@brief Structure for cloud backend. */
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef ZEPHYR_INCLUDE_CLOUD_ENCODER_H_
+#define ZEPHYR_INCLUDE_CLOUD_ENCODER_H_
+
+/**
+ * @brief Cloud message encoder
+ * @defgroup cloud_encoder Cloud message encoder
+ * @{
+ *
+ * Encodes device messages in the encoding selected for a cloud backend,
+ * from a single description of the message. Objects, arrays, strings,
+ * numbers, booleans and null are encoded as JSON, or as the corresponding
+ * CBOR maps, arrays and data items.
+ *
+ * The key parameter of the functions that add a value is the name of the
+ * member when the value is added to an object, and must be NULL when the
+ * value is added to an array or is the top-level value. Errors are sticky
+ * and reported by @ref cloud_encoder_finish.
+ */
+
+#include <zephyr.h>
+#include <net/cloud.h>
+#include <json_writer.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief CBOR writer state. */
+struct cloud_encoder_cbor {
+	/** Output buffer, NULL when only measuring. */
+	uint8_t *buf;
+	/** Size of the output buffer. */
+	size_t size;
+	/** Number of bytes encoded so far. */
+	size_t len;
+	/** First error encountered, or zero. */
+	int err;
+	/** Current nesting depth. */
+	uint8_t depth;
+	/** Bit per nesting level, set if the level is an array. */
+	uint32_t arrays;
+};
+
+/** @brief Cloud message encoder instance. */
+struct cloud_encoder {
+	/** Encoding of the output. */
+	enum cloud_encoding encoding;
+	union {
+		/** JSON writer, for @ref CLOUD_ENCODING_JSON. */
+		struct json_writer json;
+		/** CBOR writer, for @ref CLOUD_ENCODING_CBOR. */
+		struct cloud_encoder_cbor cbor;
+	};
+};
+
+/** @brief Initialize an encoder.
+ *
+ *  @param[out] enc      Encoder to initialize.
+ *  @param[in]  encoding Encoding of the output.
+ *  @param[in]  buf      Output buffer, or NULL to only measure the output.
+ *  @param[in]  size     Size of the output buffer. JSON output needs one
+ *                       byte more than its length, for the NUL character.
+ *
+ *  @retval 0 If successful.
+ *  @retval -ENOTSUP If the encoding is not enabled.
+ */
+int cloud_encoder_init(struct cloud_encoder *enc, enum cloud_encoding encoding,
+		       void *buf, size_t size);
+
+/** @brief Start an object. */
+void cloud_encoder_obj_start(struct cloud_encoder *enc, const char *key);
+
+/** @brief End the current object. */
+void cloud_encoder_obj_end(struct cloud_encoder *enc);
+
+/** @brief Start an array. */
+void cloud_encoder_arr_start(struct cloud_encoder *enc, const char *key);
+
+/** @brief End the current array. */
+void cloud_encoder_arr_end(struct cloud_encoder *enc);
+
+/** @brief Add a string. A NULL string is encoded as null. */
+void cloud_encoder_str(struct cloud_encoder *enc, const char *key,
+		       const char *value);
+
+/** @brief Add an integer. */
+void cloud_encoder_int(struct cloud_encoder *enc, const char *key,
+		       int64_t value);
+
+/** @brief Add a number. Integral values are encoded as integers. */
+void cloud_encoder_double(struct cloud_encoder *enc, const char *key,
+			  double value);
+
+/** @brief Add a boolean. */
+void cloud_encoder_bool(struct cloud_encoder *enc, const char *key,
+			bool value);
+
+/** @brief Add a null value. */
+void cloud_encoder_null(struct cloud_encoder *enc, const char *key);
+
+/** @brief Complete the message.
+ *
+ *  @return Length of the encoded message.
+ *  @retval -ENOMEM If the output did not fit in the buffer.
+ *  @retval -EINVAL If objects or arrays were not properly nested.
+ */
+int cloud_encoder_finish(struct cloud_encoder *enc);
+
+/** @brief Encoder callback used by @ref cloud_encoder_encode_alloc.
+ *
+ *  The callback is called twice and must produce the same output both
+ *  times.
+ */
+typedef int (*cloud_encoder_encode_t)(struct cloud_encoder *enc, void *ctx);
+
+/** @brief Encode a message into a buffer of the exact size needed.
+ *
+ *  The buffer is allocated with k_malloc and must be released with k_free.
+ *  JSON output is NUL terminated.
+ *
+ *  @param[in]  encoding Encoding of the message.
+ *  @param[in]  encode   Encoder callback.
+ *  @param[in]  ctx      User context passed to the callback.
+ *  @param[out] out      The encoded message.
+ *  @param[out] len      Length of the encoded message.
+ *
+ *  @return 0 if successful, otherwise a negative error code.
+ */
+int cloud_encoder_encode_alloc(enum cloud_encoding encoding,
+			       cloud_encoder_encode_t encode, void *ctx,
+			       char **out, size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* ZEPHYR_INCLUDE_CLOUD_ENCODER_H_ */
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef ZEPHYR_INCLUDE_CLOUD_QUEUE_H_
+#define ZEPHYR_INCLUDE_CLOUD_QUEUE_H_
+
+/**
+ * @brief Cloud message queue
+ * @defgroup cloud_queue Cloud message queue
+ * @{
+ *
+ * Store-and-forward queue for messages sent through the cloud API. Messages
+ * that can not be sent are stored in a flash circular buffer, and are sent
+ * when the link to the cloud is up again. Messages for the message endpoint
+ * are then combined into as few publishes as possible.
+ */
+
+#include <zephyr.h>
+#include <net/cloud.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Queue statistics. */
+struct cloud_queue_stats {
+	/** Number of messages that are waiting to be sent. */
+	uint32_t pending;
+	/** Number of messages stored in flash since initialization. */
+	uint32_t stored;
+	/** Number of stored messages sent since initialization. */
+	uint32_t sent;
+	/** Number of publishes used to send the stored messages. */
+	uint32_t publishes;
+	/** Number of stored messages dropped to make room for new ones. */
+	uint32_t dropped;
+};
+
+/** @brief Initialize the queue, and recover messages stored before a reset.
+ *
+ *  @param backend Cloud backend used to send the messages.
+ *
+ *  @retval 0 If successful.
+ *  @return A negative error code if the flash storage could not be used.
+ */
+int cloud_queue_init(const struct cloud_backend *backend);
+
+/** @brief Send a message, or store it until it can be sent.
+ *
+ *  The message is sent right away if the link is up and no earlier messages
+ *  are waiting, otherwise it is stored in flash. A message is also stored if
+ *  sending it fails. The caller keeps ownership of the message buffer.
+ *
+ *  The endpoint of the message is given by its type only.
+ *
+ *  @param msg Message to send.
+ *
+ *  @retval 0 If the message was sent or stored.
+ *  @retval -EINVAL If the endpoint has a name.
+ *  @retval -EMSGSIZE If the message is larger than
+ *                    CONFIG_CLOUD_QUEUE_BATCH_SIZE allows.
+ *  @return Another negative error code if the message could not be stored.
+ */
+int cloud_queue_send(const struct cloud_msg *msg);
+
+/** @brief Notify the queue that the link to the cloud is up or down.
+ *
+ *  When the link comes up, the stored messages are sent from the system
+ *  work queue.
+ *
+ *  @param up true if messages can be sent to the cloud.
+ */
+void cloud_queue_link_set(bool up);
+
+/** @brief Send the stored messages.
+ *
+ *  Messages for the message endpoint that follow each other in the queue
+ *  and have the same quality of service are combined into one publish, as
+ *  a JSON or CBOR array of the messages, in the encoding of the backend.
+ *
+ *  @retval 0 If all stored messages were sent.
+ *  @retval -ENOTCONN If the link is down.
+ *  @return Another negative error code if sending failed. The messages that
+ *          were not sent are kept.
+ */
+int cloud_queue_flush(void);
+
+/** @brief Get queue statistics.
+ *
+ *  @param[out] stats Statistics.
+ */
+void cloud_queue_stats_get(struct cloud_queue_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* ZEPHYR_INCLUDE_CLOUD_QUEUE_H_ */
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef ZEPHYR_INCLUDE_CLOUD_STATE_CACHE_H_
+#define ZEPHYR_INCLUDE_CLOUD_STATE_CACHE_H_
+
+/**
+ * @brief Reported state cache
+ * @defgroup cloud_state_cache Reported state cache
+ * @{
+ *
+ * Reduces reported state documents to the members that changed since the
+ * last update that was acknowledged, so that unchanged values are not sent
+ * to the device shadow again.
+ *
+ * The cache keeps a hash of the path and of the value of every member of
+ * the last acknowledged document, not the document itself. Arrays are
+ * compared and sent as a whole, since shadows replace arrays instead of
+ * merging them. Members that are left out of a document are not deleted
+ * from the shadow, so they are not tracked.
+ *
+ * A cache is used by one caller at a time.
+ */
+
+#include <zephyr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Hashes of the path and the value of a document member. */
+struct cloud_state_cache_entry {
+	uint32_t path;
+	uint32_t value;
+};
+
+/** @brief Reported state cache. */
+struct cloud_state_cache {
+	/** Members of the last acknowledged document. */
+	struct cloud_state_cache_entry *acked;
+	/** Members of the document waiting for acknowledgment. */
+	struct cloud_state_cache_entry *pending;
+	/** Number of entries in each table. */
+	uint16_t size;
+	/** Number of entries used in the acknowledged table. */
+	uint16_t acked_count;
+	/** Number of entries used in the pending table. */
+	uint16_t pending_count;
+	/** A document was acknowledged. */
+	bool valid;
+	/** A reduced document is waiting for acknowledgment. */
+	bool pending_ready;
+	/** The pending document is sent in full. */
+	bool pending_full;
+	/** Uptime of the last acknowledged full document, in milliseconds. */
+	int64_t full_time;
+};
+
+/** @brief Define a reported state cache.
+ *
+ *  @param _name    Name of the cache.
+ *  @param _entries Number of members the cache can track, counting each
+ *                  value and each array, but not objects.
+ */
+#define CLOUD_STATE_CACHE_DEFINE(_name, _entries)			    \
+	static struct cloud_state_cache_entry				    \
+		_name##_entries[2][_entries];				    \
+	static struct cloud_state_cache _name = {			    \
+		.acked = _name##_entries[0],				    \
+		.pending = _name##_entries[1],				    \
+		.size = (_entries),					    \
+	}
+
+/** @brief Reduce a reported state document to the members that changed.
+ *
+ *  The document is compared with the last acknowledged one. Members whose
+ *  value did not change are left out, and so are objects that are left
+ *  empty. The whole document is written instead if no document was
+ *  acknowledged yet, or if CONFIG_CLOUD_STATE_CACHE_RESYNC_INTERVAL seconds
+ *  have passed since the last full document. Members past the number the
+ *  cache can track are always written.
+ *
+ *  Call @ref cloud_state_cache_ack once the result has been sent, so that
+ *  the next document is compared with this one.
+ *
+ *  @param[in,out] cache Cache.
+ *  @param[in]     json  The whole document, a JSON object.
+ *  @param[in]     len   Length of the document.
+ *  @param[out]    buf   Output buffer, which is never written past len
+ *                       bytes and a NUL character. It may be the document
+ *                       itself.
+ *  @param[in]     size  Size of the output buffer.
+ *
+ *  @return Length of the reduced document, which is NUL terminated.
+ *  @retval 0 If nothing changed, and nothing needs to be sent.
+ *  @retval -EBADMSG If the document is not a valid JSON object, or is
+ *                   nested too deeply.
+ *  @retval -ENOMEM If the output buffer is too small.
+ */
+int cloud_state_cache_delta(struct cloud_state_cache *cache, const char *json,
+			    size_t len, char *buf, size_t size);
+
+/** @brief Mark the last reduced document as acknowledged.
+ *
+ *  @param[in,out] cache Cache.
+ */
+void cloud_state_cache_ack(struct cloud_state_cache *cache);
+
+/** @brief Forget the acknowledged document, so that the next one is sent in
+ *         full.
+ *
+ *  @param[in,out] cache Cache.
+ */
+void cloud_state_cache_reset(struct cloud_state_cache *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* ZEPHYR_INCLUDE_CLOUD_STATE_CACHE_H_ */
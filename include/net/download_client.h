@@ -28,6 +28,15 @@
 extern "C" {
 #endif
 
+#if defined(CONFIG_DOWNLOAD_CLIENT_COAP_WINDOW_SIZE)
+#define DOWNLOAD_CLIENT_COAP_WINDOW CONFIG_DOWNLOAD_CLIENT_COAP_WINDOW_SIZE
+#define DOWNLOAD_CLIENT_COAP_BLOCK_MAX \
+	(16 << CONFIG_DOWNLOAD_CLIENT_COAP_BLOCK_SIZE)
+#else
+#define DOWNLOAD_CLIENT_COAP_WINDOW 1
+#define DOWNLOAD_CLIENT_COAP_BLOCK_MAX 0
+#endif
+
 /**
  * @brief Download client event IDs.
  */
@@ -117,6 +126,28 @@ struct download_client_cfg {
 typedef int (*download_client_callback_t)(
 	const struct download_client_evt *event);
 
+/**
+ * @brief Outstanding CoAP block request.
+ */
+struct download_client_coap_req {
+	/** Block number, in units of the current block size. */
+	uint32_t num;
+	/** Uptime when the request was last sent, in milliseconds. */
+	uint32_t sent;
+	/** Retransmission timeout of the request, in milliseconds. */
+	uint32_t rto;
+	/** Payload length, once the block is received. */
+	uint16_t len;
+	/** Message ID. */
+	uint16_t id;
+	/** Token. */
+	uint8_t token[8];
+	/** Number of retransmissions. */
+	uint8_t retries;
+	/** Request state. */
+	uint8_t state;
+};
+
 /**
  * @brief Download client instance.
  */
@@ -155,6 +186,25 @@ struct download_client {
 	struct {
 		/** CoAP block context. */
 		struct coap_block_context block_ctx;
+		/** Largest block size the client may use, as a CoAP SZX. */
+		enum coap_block_size max_block_size;
+		/** Smoothed round-trip time, in milliseconds. */
+		uint32_t srtt;
+		/** Round-trip time variation, in milliseconds. */
+		uint32_t rttvar;
+		/** Retransmission timeout for new requests, in milliseconds. */
+		uint32_t rto;
+		/** Receive timeout currently set on the socket. */
+		int rcvtimeo;
+		/** Blocks received in a row without retransmission. */
+		uint16_t streak;
+		/** Outstanding block requests. */
+		struct download_client_coap_req req[DOWNLOAD_CLIENT_COAP_WINDOW];
+#if DOWNLOAD_CLIENT_COAP_WINDOW > 1
+		/** Blocks received out of order, one slot per request. */
+		uint8_t stash[DOWNLOAD_CLIENT_COAP_WINDOW *
+			      DOWNLOAD_CLIENT_COAP_BLOCK_MAX];
+#endif
 	} coap;
 
 	/** Internal thread ID. */
@@ -199,6 +249,7 @@ int download_client_connect(struct download_client *client, const char *host,
  *
  * The download is carried out in fragments of up to
  * @option{CONFIG_DOWNLOAD_CLIENT_HTTP_FRAG_SIZE} bytes for HTTP, or
+ * @option{CONFIG_DOWNLOAD_CLIENT_COAP_WINDOW_SIZE} blocks of
  * @option{CONFIG_DOWNLOAD_CLIENT_COAP_BLOCK_SIZE} bytes for CoAP,
  * which are delivered to the application
  * via @ref DOWNLOAD_CLIENT_EVT_FRAGMENT events.
@@ -21,6 +21,7 @@
 #include <zephyr.h>
 #include <zephyr/types.h>
 #include <net/download_client.h>
+#include <dfu/dfu_target.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -105,6 +106,21 @@ int fota_download_init(fota_download_callback_t client_callback);
 int fota_download_start(const char *host, const char *file, int sec_tag,
 			const char *apn, size_t fragment_size);
 
+/**@brief Set the SHA-256 digest of the file to download next.
+ *
+ * The digest applies to the next call to @ref fota_download_start. The
+ * downloaded image is hashed as it is received, and it is rejected with
+ * @ref FOTA_DOWNLOAD_ERROR_CAUSE_INVALID_UPDATE if it does not match,
+ * before the upgrade is scheduled.
+ *
+ * @param hash Digest of @ref DFU_TARGET_HASH_LEN bytes, or NULL to not
+ *             verify the download.
+ *
+ * @retval 0 If the digest was set.
+ * @retval -ENOTSUP If @option{CONFIG_DFU_TARGET_HASH} is not enabled.
+ */
+int fota_download_hash_set(const uint8_t *hash);
+
 #ifdef __cplusplus
 }
 #endif
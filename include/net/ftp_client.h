@@ -334,6 +334,7 @@ int ftp_rename(const char *old_name, const char *new_name);
 int ftp_delete(const char *file);
 
 /**@brief Get a file
+ * Received data is given to the data callback.
  *
  * @param file Target file name
  *
@@ -341,6 +342,37 @@ int ftp_delete(const char *file);
  */
 int ftp_get(const char *file);
 
+/**@brief Start getting a file
+ * Opens the data channel. The data is then read with @ref ftp_get_data,
+ * until it returns 0, and the transfer is completed with @ref ftp_get_end.
+ *
+ * @param file Target file name
+ * @param offset Offset in the file to start from, to resume an earlier
+ *               transfer. 0 to get the whole file
+ *
+ * @retval FTP_CODE_150 or FTP_CODE_125 if the transfer started,
+ *         other ftp_return_code or negative if error
+ */
+int ftp_get_start(const char *file, size_t offset);
+
+/**@brief Read data of a file being got
+ *
+ * @param buf Buffer for the data
+ * @param length Size of the buffer
+ *
+ * @retval Length of data read, 0 if all data has been read,
+ *         -EIO if the data channel failed or was closed before that,
+ *         or other negative if error
+ */
+int ftp_get_data(uint8_t *buf, size_t length);
+
+/**@brief End getting a file
+ * Closes the data channel, also if not all data has been read.
+ *
+ * @retval ftp_return_code or negative if error
+ */
+int ftp_get_end(void);
+
 /**@brief Put data to a file
  * If file does not exist, create the file
  *
@@ -350,8 +382,38 @@ int ftp_get(const char *file);
  *
  * @retval ftp_return_code or negative if error
  */
-int ftp_put(const char *file, const uint8_t *data, uint16_t length);
+int ftp_put(const char *file, const uint8_t *data, size_t length);
 
+/**@brief Start putting data to a file
+ * If file does not exist, create the file. Opens the data channel. The data
+ * is then sent with @ref ftp_put_data, in as many parts as needed, and the
+ * transfer is completed with @ref ftp_put_end.
+ *
+ * @param file Target file name
+ * @param offset Offset in the file to start from, to resume an earlier
+ *               transfer. 0 to replace the whole file
+ *
+ * @retval FTP_CODE_150 or FTP_CODE_125 if the transfer started,
+ *         other ftp_return_code or negative if error
+ */
+int ftp_put_start(const char *file, size_t offset);
+
+/**@brief Send data to a file being put
+ * Blocks until all data has been sent.
+ *
+ * @param data Data to be stored
+ * @param length Length of data to be stored
+ *
+ * @retval 0 If all data was sent, or negative if error
+ */
+int ftp_put_data(const uint8_t *data, size_t length);
+
+/**@brief End putting data to a file
+ * Closes the data channel.
+ *
+ * @retval ftp_return_code or negative if error
+ */
+int ftp_put_end(void);
 
 #ifdef __cplusplus
 }
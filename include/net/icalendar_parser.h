@@ -100,14 +100,46 @@ struct ical_parser_evt {
 typedef int (*icalendar_parser_callback_t)(
 	const struct ical_parser_evt *event);
 
+/** Maximum length of a property or component name kept by the parser. */
+#define ICAL_PARSER_NAME_SIZE 15
+
 /**
  * @brief iCalendar parser instance.
+ *
+ * Content lines are parsed a character at a time, and property values are
+ * copied straight into the component, so no data is buffered.
  */
 struct icalendar_parser {
-	/** Internal Buffer for parsing incoming data stream */
-	char buf[CONFIG_ICAL_PARSER_BUFFER_SIZE + 1];
-	/** Offset of unparsed data in buf. */
-	size_t offset;
+	/** Component being parsed. */
+	struct ical_parser_evt evt;
+	/** Name of the content line being parsed. */
+	char name[ICAL_PARSER_NAME_SIZE + 1];
+	/** Value of a BEGIN or END content line. */
+	char com_name[ICAL_PARSER_NAME_SIZE + 1];
+	/** Length of name. */
+	size_t name_len;
+	/** Where the property value goes, or NULL if it is not kept. */
+	char *value;
+	/** Length of the property value. */
+	size_t value_len;
+	/** Size of the property value buffer. */
+	size_t value_size;
+	/** Property of the content line being parsed. */
+	int prop;
+	/** Part of the content line being parsed. */
+	uint8_t state;
+	/** Nesting depth of components in the iCalendar object. */
+	uint8_t com_depth;
+	/** Line break received, the content line may be folded. */
+	bool eol;
+	/** In a quoted property parameter value. */
+	bool quoted;
+	/** The property has parameters. */
+	bool param;
+	/** The property value did not fit. */
+	bool overflow;
+	/** The component being parsed is reported. */
+	bool com_known;
 	/** begin of iCalendar object delimiter pair */
 	bool icalobject_begin;
 	/** Event handler. */
@@ -128,11 +160,16 @@ int ical_parser_init(struct icalendar_parser *ical,
 /**
  * @brief Parse the iCalendar data stream. Return the parsed bytes.
  *
+ * The data can be split into chunks of any size, such as the fragments
+ * given by the download client. An event is sent as soon as the end of a
+ * component is parsed. If the callback returns non-zero, parsing stops
+ * after that component, and can be continued with the rest of the data.
+ *
  * @param[in,out] ical iCalendar parser instance.
  * @param[in] data Input data to be parsed.
  * @param[in] len  Length of input data stream.
  *
- * @retval size_t  Parsed bytes.
+ * @retval size_t  Parsed bytes. Less than @p len if parsing was stopped.
  */
 size_t ical_parser_parse(struct icalendar_parser *ical,
 			const char *data, size_t len);
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef MQTT_TOPIC_TRIE_H__
+#define MQTT_TOPIC_TRIE_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <zephyr/types.h>
+
+/**
+ * @defgroup mqtt_topic_trie MQTT topic trie
+ * @{
+ * @brief Routes MQTT topics to handlers by matching them against a set of
+ *        topic filters.
+ *
+ * The topic filters are stored in a trie with one node per topic level, so
+ * a topic is matched in one pass over its levels, instead of comparing it
+ * with every filter. Filters can contain the single-level wildcard '+' and
+ * the multi-level wildcard '#', as described in the MQTT specification.
+ *
+ * The trie keeps pointers to the filters, which must be kept while the
+ * trie is used. Nodes are taken from a fixed array given by the user.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Value of a node that no filter ends in. */
+#define MQTT_TOPIC_TRIE_NO_VALUE (-1)
+
+/** @brief Trie node, for one level of one or more topic filters. */
+struct mqtt_topic_trie_node {
+	/** The topic level. */
+	const char *level;
+	/** Length of the topic level. */
+	uint16_t len;
+	/** Index of the first child, or zero if there is none. */
+	uint16_t child;
+	/** Index of the next sibling, or zero if there is none. */
+	uint16_t sibling;
+	/** Value of the filter that ends in this node, or
+	 *  @ref MQTT_TOPIC_TRIE_NO_VALUE.
+	 */
+	int16_t value;
+};
+
+/** @brief Topic trie. */
+struct mqtt_topic_trie {
+	/** Nodes, the first of which is the root. */
+	struct mqtt_topic_trie_node *nodes;
+	/** Number of nodes available. */
+	uint16_t size;
+	/** Number of nodes in use. */
+	uint16_t count;
+};
+
+/** @brief Define a topic trie.
+ *
+ *  @param _name  Name of the trie.
+ *  @param _nodes Number of nodes, which is at most the number of levels
+ *                of all filters, plus one for the root.
+ */
+#define MQTT_TOPIC_TRIE_DEFINE(_name, _nodes)				\
+	static struct mqtt_topic_trie_node _name##_nodes[_nodes];	\
+	static struct mqtt_topic_trie _name = {				\
+		.nodes = _name##_nodes,					\
+		.size = (_nodes),					\
+	}
+
+/** @brief Remove all filters.
+ *
+ *  @param trie Trie.
+ */
+void mqtt_topic_trie_clear(struct mqtt_topic_trie *trie);
+
+/** @brief Add a topic filter.
+ *
+ *  @param trie   Trie.
+ *  @param filter Topic filter, which is not copied.
+ *  @param len    Length of the topic filter.
+ *  @param value  Value returned for topics that match the filter, from 0 to
+ *                INT16_MAX.
+ *
+ *  @retval 0 If successful.
+ *  @retval -EINVAL If the filter or the value is not valid.
+ *  @retval -EEXIST If the filter was already added.
+ *  @retval -ENOMEM If there are not enough free nodes.
+ */
+int mqtt_topic_trie_add(struct mqtt_topic_trie *trie, const char *filter,
+			size_t len, int value);
+
+/** @brief Find the filter that matches a topic.
+ *
+ *  If several filters match, the most specific one is used. A level of the
+ *  topic is matched by the same level before '+', and by '+' before '#'.
+ *  Topics that start with '$' are not matched by filters that start with a
+ *  wildcard.
+ *
+ *  @param trie  Trie.
+ *  @param topic Topic name, which does not need to be NUL terminated.
+ *  @param len   Length of the topic name.
+ *
+ *  @return The value of the matching filter.
+ *  @retval -ENOENT If no filter matches the topic.
+ */
+int mqtt_topic_trie_match(const struct mqtt_topic_trie *trie,
+			  const char *topic, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+
+#endif /* MQTT_TOPIC_TRIE_H__ */
@@ -8,6 +8,7 @@
 #define NRF_CLOUD_H__
 
 #include <zephyr/types.h>
+#include <toolchain.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -35,7 +36,9 @@ enum nrf_cloud_evt_type {
 	NRF_CLOUD_EVT_SENSOR_ATTACHED,
 	/** The device received data from the cloud. */
 	NRF_CLOUD_EVT_RX_DATA,
-	/** The data sent to the cloud was acknowledged. */
+	/** The data sent to the cloud was acknowledged. The status of the
+	 * event is the tag of the data.
+	 */
 	NRF_CLOUD_EVT_SENSOR_DATA_ACK,
 	/** The transport was disconnected. */
 	NRF_CLOUD_EVT_TRANSPORT_DISCONNECTED,
@@ -192,9 +195,20 @@ int nrf_cloud_sensor_attach(const struct nrf_cloud_sa_param *param);
  * If the API succeeds, you can expect the
  * @ref NRF_CLOUD_EVT_SENSOR_DATA_ACK event.
  *
- * @param[in] param Sensor data.
+ * Up to CONFIG_NRF_CLOUD_DC_INFLIGHT_MAX messages can wait for their
+ * acknowledgment at the same time. Messages that are not acknowledged
+ * are sent again when the connection is reestablished with the session
+ * kept by the broker, and dropped otherwise.
+ *
+ * @param[in] param Sensor data. A tag of zero is replaced by a unique tag.
+ *                  The tags 1, 1234, 5678, 7890, 8765 and 9547 are used
+ *                  by the control channel.
  *
  * @retval 0 If successful.
+ * @retval -EAGAIN If too many messages are waiting for acknowledgment.
+ * @retval -EALREADY If a message with the same tag is waiting for
+ *                   acknowledgment.
+ * @retval -EINVAL If the tag is used by the control channel.
  *           Otherwise, a (negative) error code is returned.
  */
 int nrf_cloud_sensor_data_send(const struct nrf_cloud_sensor_data *param);
@@ -202,12 +216,37 @@ int nrf_cloud_sensor_data_send(const struct nrf_cloud_sensor_data *param);
 /**
  * @brief Update the device shadow with sensor data.
  *
- * @param[in] param Sensor data.
+ * @deprecated Use @ref nrf_cloud_shadow_json_update, which takes the data
+ *             as JSON text.
+ *
+ * @param[in] param Sensor data. The data pointer is a cJSON object, which
+ *                  is deleted by this function once it has been encoded.
  *
  * @retval 0 If successful.
  *           Otherwise, a (negative) error code is returned.
  */
-int nrf_cloud_shadow_update(const struct nrf_cloud_sensor_data *param);
+__deprecated int nrf_cloud_shadow_update(
+	const struct nrf_cloud_sensor_data *param);
+
+/**
+ * @brief Update the device shadow with JSON text.
+ *
+ * The text is reported in the shadow under the name of the sensor type as
+ * is.
+ *
+ * If CONFIG_NRF_CLOUD_SHADOW_DELTA is enabled, only the members of the data
+ * that changed since the last update are sent, and nothing is sent if none
+ * did. The first update after each connection is sent in full.
+ *
+ * @param[in] type Sensor type, the name of the shadow member.
+ * @param[in] json JSON text of the value.
+ * @param[in] len Length of the text.
+ *
+ * @retval 0 If successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_cloud_shadow_json_update(enum nrf_cloud_sensor type,
+				 const char *json, size_t len);
 
 /**
  * @brief Stream sensor data.
@@ -222,6 +261,37 @@ int nrf_cloud_shadow_update(const struct nrf_cloud_sensor_data *param);
  */
 int nrf_cloud_sensor_data_stream(const struct nrf_cloud_sensor_data *param);
 
+/**
+ * @brief Add sensor data to the batch.
+ *
+ * The sensor data is combined with the data of other calls, from any
+ * sensor, into one message. The batch is sent when the data of the next
+ * call does not fit in CONFIG_NRF_CLOUD_BATCH_SIZE bytes, or
+ * CONFIG_NRF_CLOUD_BATCH_LATENCY milliseconds after its first data was
+ * added, whichever happens first. If sending fails, the batch is kept and
+ * sent with the next batch.
+ *
+ * This API should only be called after receiving an
+ * @ref NRF_CLOUD_EVT_SENSOR_ATTACHED event. The tag of the sensor data is
+ * not used. If CONFIG_NRF_CLOUD_BATCH_RELIABLE is enabled, one
+ * @ref NRF_CLOUD_EVT_SENSOR_DATA_ACK event is received per batch.
+ *
+ * @param[in] param Sensor data.
+ *
+ * @retval 0 If successful.
+ * @retval -EMSGSIZE If the sensor data does not fit in a batch.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_cloud_sensor_data_batch(const struct nrf_cloud_sensor_data *param);
+
+/**
+ * @brief Send the batch of sensor data now.
+ *
+ * @retval 0 If successful, or if the batch is empty.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_cloud_sensor_data_batch_flush(void);
+
 /**
  * @brief Disconnect from the cloud.
  *
@@ -22,6 +22,16 @@ extern "C" {
  * @{
  */
 
+/**@brief Handler for A-GPS data that has been written to the GPS module.
+ *
+ * @param type Type of A-GPS data.
+ * @param data A-GPS data element, in the format used by the GPS module.
+ * @param data_len Size of the data element.
+ */
+typedef void (*nrf_cloud_agps_data_handler_t)(enum gps_agps_type type,
+					      const void *data,
+					      size_t data_len);
+
 /**@brief Requests specified A-GPS data from nRF Cloud.
  *
  * @param request Structure containing specified A-GPS data to be requested.
@@ -48,6 +58,14 @@ int nrf_cloud_agps_request_all(void);
  */
 int nrf_cloud_agps_process(const char *buf, size_t buf_len, const int *socket);
 
+/**@brief Sets a handler that is called with each A-GPS data element that
+ *	  @ref nrf_cloud_agps_process has written to the GPS module, for
+ *	  instance to cache it.
+ *
+ * @param handler Handler, or NULL to remove it.
+ */
+void nrf_cloud_agps_data_handler_set(nrf_cloud_agps_data_handler_t handler);
+
 /** @} */
 
 #ifdef __cplusplus
@@ -19,17 +19,20 @@
 #include <net/nrf_cloud_agps.h>
 #endif
 
+#include "agps_cache.h"
+
 LOG_MODULE_REGISTER(agps, CONFIG_AGPS_LOG_LEVEL);
 
 #if defined(CONFIG_AGPS_SRC_SUPL)
 /* Number of DNS lookup attempts */
 #define DNS_ATTEMPT_COUNT  3
 
-static const struct device *gps_dev;
-static int gnss_fd;
 static int supl_fd;
 #endif /* CONFIG_AGPS_SRC_SUPL */
 
+static const struct device *gps_dev;
+static int gnss_fd;
+
 static enum gps_agps_type type_lookup_socket2gps[] = {
 	[NRF_GNSS_AGPS_UTC_PARAMETERS]	= GPS_AGPS_UTC_PARAMETERS,
 	[NRF_GNSS_AGPS_EPHEMERIDES]	= GPS_AGPS_EPHEMERIDES,
@@ -44,13 +47,32 @@ static enum gps_agps_type type_lookup_socket2gps[] = {
 	[NRF_GNSS_AGPS_INTEGRITY]	= GPS_AGPS_INTEGRITY,
 };
 
+static nrf_gnss_agps_data_type_t type_lookup_gps2socket[] = {
+	[GPS_AGPS_UTC_PARAMETERS]	= NRF_GNSS_AGPS_UTC_PARAMETERS,
+	[GPS_AGPS_EPHEMERIDES]		= NRF_GNSS_AGPS_EPHEMERIDES,
+	[GPS_AGPS_ALMANAC]		= NRF_GNSS_AGPS_ALMANAC,
+	[GPS_AGPS_KLOBUCHAR_CORRECTION]
+				= NRF_GNSS_AGPS_KLOBUCHAR_IONOSPHERIC_CORRECTION,
+	[GPS_AGPS_NEQUICK_CORRECTION]
+				= NRF_GNSS_AGPS_NEQUICK_IONOSPHERIC_CORRECTION,
+	[GPS_AGPS_GPS_SYSTEM_CLOCK_AND_TOWS]
+				= NRF_GNSS_AGPS_GPS_SYSTEM_CLOCK_AND_TOWS,
+	[GPS_AGPS_LOCATION]		= NRF_GNSS_AGPS_LOCATION,
+	[GPS_AGPS_INTEGRITY]		= NRF_GNSS_AGPS_INTEGRITY,
+};
+
 /* Convert nrf_socket A-GPS type to GPS API type. */
 static inline enum gps_agps_type type_socket2gps(nrf_gnss_agps_data_type_t type)
 {
 	return type_lookup_socket2gps[type];
 }
 
-#if defined(CONFIG_AGPS_SRC_SUPL)
+/* Convert GPS API A-GPS type to nrf_socket type. */
+static inline nrf_gnss_agps_data_type_t type_gps2socket(enum gps_agps_type type)
+{
+	return type_lookup_gps2socket[type];
+}
+
 static int send_to_modem(void *data, size_t data_len,
 			 nrf_gnss_agps_data_type_t type)
 {
@@ -75,6 +97,34 @@ static int send_to_modem(void *data, size_t data_len,
 	return err;
 }
 
+/* Selects the app-provided socket, or the GPS driver, to write A-GPS data */
+static int modem_bind(int socket)
+{
+	if (socket) {
+		LOG_DBG("Using user-provided socket, fd %d", socket);
+
+		gps_dev = NULL;
+		gnss_fd = socket;
+	} else {
+		gps_dev = device_get_binding("NRF9160_GPS");
+		if (gps_dev == NULL) {
+			LOG_ERR("Could not get binding to nRF9160 GPS");
+			return -ENODEV;
+		}
+
+		LOG_DBG("Using GPS driver to input assistance data");
+	}
+
+	return 0;
+}
+
+static int cache_write(enum gps_agps_type type, void *data, size_t data_len)
+{
+	return send_to_modem(data, data_len, type_gps2socket(type));
+}
+
+#if defined(CONFIG_AGPS_SRC_SUPL)
+
 static int inject_agps_type(void *agps,
 			    size_t agps_size,
 			    nrf_gnss_agps_data_type_t type,
@@ -92,6 +142,10 @@ static int inject_agps_type(void *agps,
 
 	LOG_DBG("Injected AGPS data, type: %d, size: %d", type, agps_size);
 
+	if (IS_ENABLED(CONFIG_AGPS_CACHE)) {
+		agps_cache_store(type_socket2gps(type), agps, agps_size);
+	}
+
 	return 0;
 }
 
@@ -246,7 +300,7 @@ static ssize_t supl_read(void *buf, size_t nbytes, void *user_data)
 	return rc;
 }
 
-static int init_supl(int socket)
+static int init_supl(void)
 {
 	int err;
 	struct supl_api supl_api = {
@@ -263,21 +317,6 @@ static int init_supl(int socket)
 		return err;
 	}
 
-	if (socket) {
-		LOG_DBG("Using user-provided socket, fd %d", socket);
-
-		gps_dev = NULL;
-		gnss_fd = socket;
-	} else {
-		gps_dev = device_get_binding("NRF9160_GPS");
-		if (gps_dev == NULL) {
-			LOG_ERR("Could not get binding to nRF9160 GPS");
-			return -ENODEV;
-		}
-
-		LOG_DBG("Using GPS driver to input assistance data");
-	}
-
 	LOG_INF("SUPL is initialized");
 
 	return 0;
@@ -327,15 +366,44 @@ static int supl_start(const struct gps_agps_request request)
 
 #endif /* CONFIG_AGPS_SRC_SUPL */
 
+/* Returns true if any data is requested */
+static bool request_pending(const struct gps_agps_request *request)
+{
+	return request->sv_mask_ephe || request->sv_mask_alm ||
+	       request->utc || request->klobuchar || request->nequick ||
+	       request->system_time_tow || request->position ||
+	       request->integrity;
+}
+
 int gps_agps_request(struct gps_agps_request request, int socket)
 {
 	int err;
 
+	if (IS_ENABLED(CONFIG_AGPS_SRC_SUPL) || IS_ENABLED(CONFIG_AGPS_CACHE)) {
+		err = modem_bind(socket);
+		if (err) {
+			return err;
+		}
+	}
+
+	if (IS_ENABLED(CONFIG_AGPS_CACHE)) {
+		err = agps_cache_inject(&request, cache_write);
+		if (err < 0) {
+			LOG_WRN("Failed to inject cached A-GPS data, error: %d",
+				err);
+		}
+
+		if (!request_pending(&request)) {
+			LOG_INF("Requested A-GPS data injected from cache");
+			return 0;
+		}
+	}
+
 #if defined(CONFIG_AGPS_SRC_SUPL)
 	static bool supl_is_init;
 
 	if (!supl_is_init) {
-		err = init_supl(socket);
+		err = init_supl();
 		if (err) {
 			LOG_ERR("SUPL initialization failed, error: %d", err);
 			return err;
@@ -350,6 +418,10 @@ int gps_agps_request(struct gps_agps_request request, int socket)
 		return err;
 	}
 
+	if (IS_ENABLED(CONFIG_AGPS_CACHE)) {
+		(void)agps_cache_save();
+	}
+
 #elif defined(CONFIG_AGPS_SRC_NRF_CLOUD)
 	err = nrf_cloud_agps_request(request);
 	if (err) {
@@ -367,12 +439,20 @@ int gps_process_agps_data(const uint8_t *buf, size_t len)
 
 #if defined(CONFIG_AGPS_SRC_NRF_CLOUD) && defined(CONFIG_NRF_CLOUD_AGPS)
 
+	if (IS_ENABLED(CONFIG_AGPS_CACHE)) {
+		nrf_cloud_agps_data_handler_set(agps_cache_store);
+	}
+
 	err = nrf_cloud_agps_process(buf, len, NULL);
 	if (err) {
 		LOG_ERR("A-GPS failed, error: %d", err);
 	} else {
 		LOG_INF("A-GPS data successfully processed");
 	}
+
+	if (IS_ENABLED(CONFIG_AGPS_CACHE)) {
+		(void)agps_cache_save();
+	}
 #endif /* CONFIG_AGPS_SRC_NRF_CLOUD && CONFIG_NRF_CLOUD_AGPS */
 
 	return err;
@@ -0,0 +1,426 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <logging/log.h>
+#include <nrf_socket.h>
+#include <drivers/gps.h>
+
+#if defined(CONFIG_AGPS_CACHE_SETTINGS)
+#include <settings/settings.h>
+#include <date_time.h>
+#endif
+
+#include "agps_cache.h"
+
+LOG_MODULE_DECLARE(agps, CONFIG_AGPS_LOG_LEVEL);
+
+#define SV_COUNT		32
+#define MIN_TO_MS(min)		((int64_t)(min) * 60 * MSEC_PER_SEC)
+
+#define AGPS_SETTINGS_KEY	"agps"
+
+/* Data that is valid for the same time, and sent to the GPS module once */
+enum {
+	PARAM_UTC,
+	PARAM_KLOBUCHAR,
+	PARAM_NEQUICK,
+	PARAM_COUNT,
+};
+
+/* Uptime, in milliseconds, when each element was received. An element is
+ * only used if its bit is set in the mask.
+ */
+static struct {
+	uint32_t ephe_mask;
+	uint32_t alm_mask;
+	uint8_t param_mask;
+	int64_t ephe[SV_COUNT];
+	int64_t alm[SV_COUNT];
+	int64_t param[PARAM_COUNT];
+} times;
+
+static nrf_gnss_agps_data_ephemeris_t ephe[SV_COUNT];
+static nrf_gnss_agps_data_almanac_t alm[SV_COUNT];
+static struct {
+	nrf_gnss_agps_data_utc_t utc;
+	nrf_gnss_agps_data_klobuchar_t klobuchar;
+	nrf_gnss_agps_data_nequick_t nequick;
+} params;
+
+static K_MUTEX_DEFINE(cache_mutex);
+static bool cache_changed;
+
+static bool is_valid(int64_t time, int64_t now, uint32_t validity_min)
+{
+	return (now - time) < MIN_TO_MS(validity_min);
+}
+
+#if defined(CONFIG_AGPS_CACHE_SETTINGS)
+/* Unix time minus uptime when the cache was saved */
+static int64_t saved_offset;
+static bool loading;
+static bool loaded;
+static uint8_t loaded_keys;
+
+static const struct {
+	const char *key;
+	void *data;
+	size_t size;
+} entries[] = {
+	{ "offset", &saved_offset, sizeof(saved_offset) },
+	{ "time", &times, sizeof(times) },
+	{ "ephe", ephe, sizeof(ephe) },
+	{ "alm", alm, sizeof(alm) },
+	{ "param", &params, sizeof(params) },
+};
+
+static int settings_set(const char *key, size_t len, settings_read_cb read_cb,
+			void *cb_arg)
+{
+	int err;
+
+	/* Only loaded on the first request, when the time is known */
+	if (!loading) {
+		return 0;
+	}
+
+	for (int i = 0; i < ARRAY_SIZE(entries); i++) {
+		if (strcmp(key, entries[i].key)) {
+			continue;
+		}
+
+		if (len != entries[i].size) {
+			LOG_WRN("Cached A-GPS %s has wrong size", key);
+			return 0;
+		}
+
+		err = read_cb(cb_arg, entries[i].data, len);
+		if (err < 0) {
+			LOG_ERR("Failed to read cached A-GPS %s, error: %d",
+				key, err);
+			return err;
+		}
+
+		loaded_keys |= BIT(i);
+		break;
+	}
+
+	return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(agps_cache, AGPS_SETTINGS_KEY, NULL,
+			       settings_set, NULL, NULL);
+
+static void offset_times(int64_t *time, uint32_t mask, int64_t offset)
+{
+	for (int i = 0; mask; i++, mask >>= 1) {
+		if (mask & 1) {
+			time[i] += offset;
+		}
+	}
+}
+
+/* Loads the cache saved before the last reset. The saved times are converted
+ * from the uptime then to the uptime now, using the date and time.
+ */
+static void cache_load(void)
+{
+	int64_t offset;
+	int err;
+
+	err = date_time_now(&offset);
+	if (err) {
+		LOG_DBG("Time not known, cache not loaded");
+		return;
+	}
+	offset -= k_uptime_get();
+	loaded = true;
+
+	/* Data received since boot is newer */
+	if (times.ephe_mask || times.alm_mask || times.param_mask) {
+		return;
+	}
+
+	err = settings_subsys_init();
+	if (err) {
+		LOG_ERR("Failed to initialize settings, error: %d", err);
+		return;
+	}
+
+	loading = true;
+	loaded_keys = 0;
+	err = settings_load_subtree(AGPS_SETTINGS_KEY);
+	loading = false;
+
+	if (err || loaded_keys != BIT_MASK(ARRAY_SIZE(entries))) {
+		LOG_DBG("No A-GPS data saved");
+		memset(&times, 0, sizeof(times));
+		return;
+	}
+
+	offset = saved_offset - offset;
+	offset_times(times.ephe, times.ephe_mask, offset);
+	offset_times(times.alm, times.alm_mask, offset);
+	offset_times(times.param, times.param_mask, offset);
+
+	LOG_INF("A-GPS cache loaded from flash");
+}
+#endif /* CONFIG_AGPS_CACHE_SETTINGS */
+
+void agps_cache_store(enum gps_agps_type type, const void *data,
+		      size_t data_len)
+{
+	void *dst = NULL;
+	size_t size = 0;
+	int64_t *time = NULL;
+	uint32_t *mask = NULL;
+	uint32_t bit = 0;
+	uint8_t param = PARAM_COUNT;
+	uint8_t sv_id;
+
+	switch (type) {
+	case GPS_AGPS_EPHEMERIDES:
+		sv_id = ((const nrf_gnss_agps_data_ephemeris_t *)data)->sv_id;
+		if (sv_id < 1 || sv_id > SV_COUNT) {
+			return;
+		}
+		dst = &ephe[sv_id - 1];
+		size = sizeof(ephe[0]);
+		time = &times.ephe[sv_id - 1];
+		mask = &times.ephe_mask;
+		bit = BIT(sv_id - 1);
+		break;
+	case GPS_AGPS_ALMANAC:
+		sv_id = ((const nrf_gnss_agps_data_almanac_t *)data)->sv_id;
+		if (sv_id < 1 || sv_id > SV_COUNT) {
+			return;
+		}
+		dst = &alm[sv_id - 1];
+		size = sizeof(alm[0]);
+		time = &times.alm[sv_id - 1];
+		mask = &times.alm_mask;
+		bit = BIT(sv_id - 1);
+		break;
+	case GPS_AGPS_UTC_PARAMETERS:
+		dst = &params.utc;
+		size = sizeof(params.utc);
+		param = PARAM_UTC;
+		break;
+	case GPS_AGPS_KLOBUCHAR_CORRECTION:
+		dst = &params.klobuchar;
+		size = sizeof(params.klobuchar);
+		param = PARAM_KLOBUCHAR;
+		break;
+	case GPS_AGPS_NEQUICK_CORRECTION:
+		dst = &params.nequick;
+		size = sizeof(params.nequick);
+		param = PARAM_NEQUICK;
+		break;
+	default:
+		/* System time, location and integrity are not cached */
+		return;
+	}
+
+	if (data_len != size) {
+		LOG_WRN("A-GPS data type %d has wrong size: %d", type,
+			data_len);
+		return;
+	}
+
+	k_mutex_lock(&cache_mutex, K_FOREVER);
+
+	memcpy(dst, data, size);
+	if (param < PARAM_COUNT) {
+		times.param[param] = k_uptime_get();
+		times.param_mask |= BIT(param);
+	} else {
+		*time = k_uptime_get();
+		*mask |= bit;
+	}
+	cache_changed = true;
+
+	k_mutex_unlock(&cache_mutex);
+}
+
+/* Injects the valid elements of one type that are requested, and removes
+ * them from the request
+ */
+static int inject_svs(uint32_t *request_mask, enum gps_agps_type type,
+		      void *data, size_t size, int64_t *time, uint32_t *mask,
+		      uint32_t validity_min, int64_t now,
+		      agps_cache_write_t write)
+{
+	int count = 0;
+	int err;
+
+	for (int i = 0; i < SV_COUNT; i++) {
+		if (!(*request_mask & *mask & BIT(i))) {
+			continue;
+		}
+
+		if (!is_valid(time[i], now, validity_min)) {
+			*mask &= ~BIT(i);
+			continue;
+		}
+
+		err = write(type, (uint8_t *)data + i * size, size);
+		if (err) {
+			return err;
+		}
+
+		*request_mask &= ~BIT(i);
+		count++;
+	}
+
+	return count;
+}
+
+static int inject_param(enum gps_agps_type type, void *data, size_t size,
+			int param, int64_t now, agps_cache_write_t write)
+{
+	int err;
+
+	if (!(times.param_mask & BIT(param))) {
+		return 0;
+	}
+
+	if (!is_valid(times.param[param], now,
+		      CONFIG_AGPS_CACHE_PARAM_VALIDITY)) {
+		times.param_mask &= ~BIT(param);
+		return 0;
+	}
+
+	err = write(type, data, size);
+	if (err) {
+		return err;
+	}
+
+	return 1;
+}
+
+int agps_cache_inject(struct gps_agps_request *request,
+		      agps_cache_write_t write)
+{
+	int64_t now;
+	int count = 0;
+	int err;
+
+	k_mutex_lock(&cache_mutex, K_FOREVER);
+
+#if defined(CONFIG_AGPS_CACHE_SETTINGS)
+	if (!loaded) {
+		cache_load();
+	}
+#endif
+
+	now = k_uptime_get();
+
+	err = inject_svs(&request->sv_mask_ephe, GPS_AGPS_EPHEMERIDES,
+			 ephe, sizeof(ephe[0]), times.ephe, &times.ephe_mask,
+			 CONFIG_AGPS_CACHE_EPHE_VALIDITY, now, write);
+	if (err < 0) {
+		goto exit;
+	}
+	count += err;
+
+	err = inject_svs(&request->sv_mask_alm, GPS_AGPS_ALMANAC,
+			 alm, sizeof(alm[0]), times.alm, &times.alm_mask,
+			 CONFIG_AGPS_CACHE_ALM_VALIDITY, now, write);
+	if (err < 0) {
+		goto exit;
+	}
+	count += err;
+
+	if (request->utc) {
+		err = inject_param(GPS_AGPS_UTC_PARAMETERS, &params.utc,
+				   sizeof(params.utc), PARAM_UTC, now, write);
+		if (err < 0) {
+			goto exit;
+		}
+		request->utc = !err;
+		count += err;
+	}
+
+	if (request->klobuchar) {
+		err = inject_param(GPS_AGPS_KLOBUCHAR_CORRECTION,
+				   &params.klobuchar, sizeof(params.klobuchar),
+				   PARAM_KLOBUCHAR, now, write);
+		if (err < 0) {
+			goto exit;
+		}
+		request->klobuchar = !err;
+		count += err;
+	}
+
+	if (request->nequick) {
+		err = inject_param(GPS_AGPS_NEQUICK_CORRECTION,
+				   &params.nequick, sizeof(params.nequick),
+				   PARAM_NEQUICK, now, write);
+		if (err < 0) {
+			goto exit;
+		}
+		request->nequick = !err;
+		count += err;
+	}
+
+	err = count;
+	if (count) {
+		LOG_INF("%d A-GPS data elements injected from cache", count);
+	}
+
+exit:
+	k_mutex_unlock(&cache_mutex);
+
+	return err;
+}
+
+int agps_cache_save(void)
+{
+#if defined(CONFIG_AGPS_CACHE_SETTINGS)
+	char key[sizeof(AGPS_SETTINGS_KEY "/offset")];
+	int err = 0;
+
+	k_mutex_lock(&cache_mutex, K_FOREVER);
+
+	if (!cache_changed) {
+		goto exit;
+	}
+
+	/* The saved times can only be used after a reset if the date and time
+	 * is known. Saved again on the next update otherwise.
+	 */
+	if (date_time_now(&saved_offset)) {
+		LOG_DBG("Time not known, cache not saved");
+		goto exit;
+	}
+	saved_offset -= k_uptime_get();
+
+	for (int i = 0; i < ARRAY_SIZE(entries); i++) {
+		snprintk(key, sizeof(key), AGPS_SETTINGS_KEY "/%s",
+			 entries[i].key);
+		err = settings_save_one(key, entries[i].data, entries[i].size);
+		if (err) {
+			LOG_ERR("Failed to save A-GPS %s, error: %d",
+				entries[i].key, err);
+			goto exit;
+		}
+	}
+
+	/* Data from before the reset must not be loaded over newer data */
+	loaded = true;
+	cache_changed = false;
+	LOG_DBG("A-GPS cache saved");
+
+exit:
+	k_mutex_unlock(&cache_mutex);
+
+	return err;
+#else
+	return 0;
+#endif /* CONFIG_AGPS_CACHE_SETTINGS */
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef AGPS_CACHE_H_
+#define AGPS_CACHE_H_
+
+#include <zephyr/types.h>
+#include <drivers/gps.h>
+
+/**@brief Writes one A-GPS data element to the GPS module.
+ *
+ * @return 0 if successful, otherwise a (negative) error code.
+ */
+typedef int (*agps_cache_write_t)(enum gps_agps_type type, void *data,
+				  size_t data_len);
+
+/**@brief Stores an A-GPS data element that was written to the GPS module.
+ *
+ * Ephemerides and almanacs are stored per satellite. UTC parameters and
+ * ionospheric corrections replace the ones stored before. Other types are
+ * not cached, since they are only valid for a short time.
+ *
+ * @param type Type of A-GPS data.
+ * @param data A-GPS data element, in the format used by the GPS module.
+ * @param data_len Size of the data element.
+ */
+void agps_cache_store(enum gps_agps_type type, const void *data,
+		      size_t data_len);
+
+/**@brief Injects cached A-GPS data that is still valid.
+ *
+ * The data that is injected is removed from the request, so that only
+ * missing and expired data is left to be requested from the data source.
+ *
+ * @param request Data needed by the GPS module. Updated on return.
+ * @param write Function that writes the data to the GPS module.
+ *
+ * @return Number of elements injected, or a (negative) error code.
+ */
+int agps_cache_inject(struct gps_agps_request *request,
+		      agps_cache_write_t write);
+
+/**@brief Saves the cache to flash, if it has changed.
+ *
+ * Does nothing unless CONFIG_AGPS_CACHE_SETTINGS is enabled.
+ *
+ * @return 0 if successful, otherwise a (negative) error code.
+ */
+int agps_cache_save(void);
+
+#endif /* AGPS_CACHE_H_ */
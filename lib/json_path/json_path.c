@@ -0,0 +1,642 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <json_path.h>
+
+BUILD_ASSERT(JSON_PATH_MAX_DEPTH <= 32, "Nesting is tracked in a 32-bit mask");
+
+struct scanner {
+	const char *p;
+	const char *end;
+	struct json_path_query *queries;
+	size_t count;
+	uint8_t depth;
+	/* Bit per nesting level, set if the level is an array */
+	uint32_t arrays;
+};
+
+static bool is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static int hex_val(char c)
+{
+	if (is_digit(c)) {
+		return c - '0';
+	} else if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	} else if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+
+	return -1;
+}
+
+static void skip_ws(struct scanner *s)
+{
+	while (s->p < s->end &&
+	       (*s->p == ' ' || *s->p == '\t' || *s->p == '\n' ||
+		*s->p == '\r')) {
+		s->p++;
+	}
+}
+
+/* Scans a string from after the opening quote to after the closing one */
+static int scan_string(struct scanner *s, size_t *len)
+{
+	const char *start = s->p;
+
+	for (; s->p < s->end; s->p++) {
+		unsigned char c = *s->p;
+
+		if (c == '"') {
+			*len = s->p - start;
+			s->p++;
+			return 0;
+		}
+
+		if (c < 0x20) {
+			return -EBADMSG;
+		}
+
+		if (c != '\\') {
+			continue;
+		}
+
+		if (++s->p >= s->end) {
+			return -EBADMSG;
+		}
+
+		switch (*s->p) {
+		case '"':
+		case '\\':
+		case '/':
+		case 'b':
+		case 'f':
+		case 'n':
+		case 'r':
+		case 't':
+			break;
+		case 'u':
+			if (s->end - s->p < 5) {
+				return -EBADMSG;
+			}
+
+			for (int i = 1; i <= 4; i++) {
+				if (hex_val(s->p[i]) < 0) {
+					return -EBADMSG;
+				}
+			}
+
+			s->p += 4;
+			break;
+		default:
+			return -EBADMSG;
+		}
+	}
+
+	return -EBADMSG;
+}
+
+static int scan_digits(struct scanner *s)
+{
+	const char *start = s->p;
+
+	while (s->p < s->end && is_digit(*s->p)) {
+		s->p++;
+	}
+
+	return s->p > start ? 0 : -EBADMSG;
+}
+
+static int scan_number(struct scanner *s)
+{
+	if (*s->p == '-') {
+		s->p++;
+	}
+
+	if (s->p < s->end && *s->p == '0') {
+		s->p++;
+	} else if (scan_digits(s)) {
+		return -EBADMSG;
+	}
+
+	if (s->p < s->end && *s->p == '.') {
+		s->p++;
+		if (scan_digits(s)) {
+			return -EBADMSG;
+		}
+	}
+
+	if (s->p < s->end && (*s->p == 'e' || *s->p == 'E')) {
+		s->p++;
+		if (s->p < s->end && (*s->p == '+' || *s->p == '-')) {
+			s->p++;
+		}
+		if (scan_digits(s)) {
+			return -EBADMSG;
+		}
+	}
+
+	return 0;
+}
+
+static int scan_literal(struct scanner *s, const char *literal)
+{
+	size_t len = strlen(literal);
+
+	if (s->end - s->p < len || memcmp(s->p, literal, len) != 0) {
+		return -EBADMSG;
+	}
+
+	s->p += len;
+
+	return 0;
+}
+
+/* Compares a path element, counted from one, with a member name */
+static bool element_eq(const char *path, uint8_t element, const char *name,
+		       size_t len)
+{
+	while (--element) {
+		path = strchr(path, '.') + 1;
+	}
+
+	return strncmp(path, name, len) == 0 &&
+	       (path[len] == '.' || path[len] == '\0');
+}
+
+static void on_name(struct scanner *s, const char *name, size_t len)
+{
+	uint8_t level = s->depth;
+
+	for (size_t i = 0; i < s->count; i++) {
+		struct json_path_query *q = &s->queries[i];
+
+		/* The previous member at this level is done */
+		if (q->matched >= level) {
+			q->matched = level - 1;
+		}
+
+		if (q->matched == level - 1 && level <= q->elements &&
+		    element_eq(q->path, level, name, len)) {
+			q->matched = level;
+		}
+	}
+}
+
+static void on_value(struct scanner *s, enum json_path_type type,
+		     const char *ptr, size_t len)
+{
+	for (size_t i = 0; i < s->count; i++) {
+		struct json_path_query *q = &s->queries[i];
+
+		if (q->matched == s->depth && q->elements == s->depth &&
+		    q->value.type == JSON_PATH_NONE) {
+			q->value.type = type;
+			q->value.ptr = ptr;
+			q->value.len = len;
+		}
+	}
+}
+
+/* Called with the closing bracket of the innermost object or array */
+static void on_close(struct scanner *s)
+{
+	uint8_t level = s->depth - 1;
+
+	for (size_t i = 0; i < s->count; i++) {
+		struct json_path_query *q = &s->queries[i];
+
+		if (q->matched > level) {
+			q->matched = level;
+		}
+
+		/* Length of an object or array is known when it ends */
+		if (q->matched == level && q->elements == level &&
+		    (q->value.type == JSON_PATH_OBJECT ||
+		     q->value.type == JSON_PATH_ARRAY) &&
+		    q->value.len == 0) {
+			q->value.len = s->p + 1 - q->value.ptr;
+		}
+	}
+}
+
+static int scan_name(struct scanner *s)
+{
+	const char *name;
+	size_t len;
+	int err;
+
+	skip_ws(s);
+	if (s->p >= s->end || *s->p != '"') {
+		return -EBADMSG;
+	}
+
+	name = ++s->p;
+	err = scan_string(s, &len);
+	if (err) {
+		return err;
+	}
+
+	skip_ws(s);
+	if (s->p >= s->end || *s->p != ':') {
+		return -EBADMSG;
+	}
+
+	s->p++;
+	on_name(s, name, len);
+
+	return 0;
+}
+
+static int scan(struct scanner *s)
+{
+	const char *start;
+	bool array;
+	size_t len;
+	int err;
+
+	/* Each iteration scans a value, and what follows it up to the next
+	 * value.
+	 */
+	for (;;) {
+		skip_ws(s);
+		if (s->p >= s->end) {
+			return -EBADMSG;
+		}
+
+		start = s->p;
+
+		switch (*s->p) {
+		case '{':
+		case '[':
+			if (s->depth == JSON_PATH_MAX_DEPTH) {
+				return -EBADMSG;
+			}
+
+			array = (*s->p == '[');
+			on_value(s, array ? JSON_PATH_ARRAY : JSON_PATH_OBJECT,
+				 start, 0);
+
+			s->p++;
+			s->depth++;
+			WRITE_BIT(s->arrays, s->depth - 1, array);
+
+			skip_ws(s);
+			if (s->p < s->end && *s->p == (array ? ']' : '}')) {
+				on_close(s);
+				s->p++;
+				s->depth--;
+				break;
+			}
+
+			if (!array) {
+				err = scan_name(s);
+				if (err) {
+					return err;
+				}
+			}
+
+			continue;
+		case '"':
+			s->p++;
+			err = scan_string(s, &len);
+			if (err) {
+				return err;
+			}
+
+			on_value(s, JSON_PATH_STRING, start + 1, len);
+			break;
+		case 't':
+			err = scan_literal(s, "true");
+			if (err) {
+				return err;
+			}
+
+			on_value(s, JSON_PATH_TRUE, start, s->p - start);
+			break;
+		case 'f':
+			err = scan_literal(s, "false");
+			if (err) {
+				return err;
+			}
+
+			on_value(s, JSON_PATH_FALSE, start, s->p - start);
+			break;
+		case 'n':
+			err = scan_literal(s, "null");
+			if (err) {
+				return err;
+			}
+
+			on_value(s, JSON_PATH_NULL, start, s->p - start);
+			break;
+		default:
+			if (*s->p != '-' && !is_digit(*s->p)) {
+				return -EBADMSG;
+			}
+
+			err = scan_number(s);
+			if (err) {
+				return err;
+			}
+
+			on_value(s, JSON_PATH_NUMBER, start, s->p - start);
+			break;
+		}
+
+		/* Close the objects and arrays that end after the value */
+		for (;;) {
+			if (s->depth == 0) {
+				return 0;
+			}
+
+			skip_ws(s);
+			if (s->p >= s->end) {
+				return -EBADMSG;
+			}
+
+			array = s->arrays & BIT(s->depth - 1);
+
+			if (*s->p == ',') {
+				s->p++;
+
+				if (!array) {
+					err = scan_name(s);
+					if (err) {
+						return err;
+					}
+				}
+
+				break;
+			}
+
+			if (*s->p != (array ? ']' : '}')) {
+				return -EBADMSG;
+			}
+
+			on_close(s);
+			s->p++;
+			s->depth--;
+		}
+	}
+}
+
+static int path_elements(const char *path)
+{
+	int elements = 0;
+
+	if (*path == '\0') {
+		return 0;
+	}
+
+	for (elements = 1; *path; path++) {
+		if (*path == '.') {
+			elements++;
+		}
+	}
+
+	return elements;
+}
+
+int json_path_extract(const char *json, size_t len,
+		      struct json_path_query *queries, size_t count)
+{
+	struct scanner s = {
+		.p = json,
+		.end = json + len,
+		.queries = queries,
+		.count = count,
+	};
+	int elements;
+	int found = 0;
+	int err;
+
+	__ASSERT_NO_MSG(json != NULL);
+	__ASSERT_NO_MSG(queries != NULL || count == 0);
+
+	for (size_t i = 0; i < count; i++) {
+		elements = path_elements(queries[i].path);
+		if (elements > JSON_PATH_MAX_DEPTH) {
+			return -EINVAL;
+		}
+
+		queries[i].elements = elements;
+		queries[i].matched = 0;
+		queries[i].value.type = JSON_PATH_NONE;
+		queries[i].value.ptr = NULL;
+		queries[i].value.len = 0;
+	}
+
+	err = scan(&s);
+	if (err) {
+		return err;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (json_path_found(&queries[i])) {
+			found++;
+		}
+	}
+
+	return found;
+}
+
+static size_t utf8_encode(uint32_t cp, char *out)
+{
+	if (cp < 0x80) {
+		out[0] = cp;
+		return 1;
+	} else if (cp < 0x800) {
+		out[0] = 0xc0 | (cp >> 6);
+		out[1] = 0x80 | (cp & 0x3f);
+		return 2;
+	} else if (cp < 0x10000) {
+		out[0] = 0xe0 | (cp >> 12);
+		out[1] = 0x80 | ((cp >> 6) & 0x3f);
+		out[2] = 0x80 | (cp & 0x3f);
+		return 3;
+	}
+
+	out[0] = 0xf0 | (cp >> 18);
+	out[1] = 0x80 | ((cp >> 12) & 0x3f);
+	out[2] = 0x80 | ((cp >> 6) & 0x3f);
+	out[3] = 0x80 | (cp & 0x3f);
+	return 4;
+}
+
+static uint32_t hex4(const char *p)
+{
+	uint32_t val = 0;
+
+	for (int i = 0; i < 4; i++) {
+		val = (val << 4) | hex_val(p[i]);
+	}
+
+	return val;
+}
+
+/* Decodes the next character of a string value, which has been validated
+ * by the scanner, into at most four bytes.
+ */
+static size_t unescape(const char **p, const char *end, char *out)
+{
+	const char *c = *p;
+	uint32_t cp;
+	uint32_t low;
+
+	if (*c != '\\') {
+		*p = c + 1;
+		out[0] = *c;
+		return 1;
+	}
+
+	c++;
+	*p = c + 1;
+
+	switch (*c) {
+	case 'b':
+		out[0] = '\b';
+		return 1;
+	case 'f':
+		out[0] = '\f';
+		return 1;
+	case 'n':
+		out[0] = '\n';
+		return 1;
+	case 'r':
+		out[0] = '\r';
+		return 1;
+	case 't':
+		out[0] = '\t';
+		return 1;
+	case 'u':
+		break;
+	default:
+		out[0] = *c;
+		return 1;
+	}
+
+	cp = hex4(c + 1);
+	*p = c + 5;
+
+	/* Combine a surrogate pair, lone surrogates are kept as they are */
+	if (cp >= 0xd800 && cp < 0xdc00 && end - *p >= 6 &&
+	    (*p)[0] == '\\' && (*p)[1] == 'u') {
+		low = hex4(*p + 2);
+		if (low >= 0xdc00 && low < 0xe000) {
+			cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+			*p += 6;
+		}
+	}
+
+	return utf8_encode(cp, out);
+}
+
+int json_path_str_copy(const struct json_path_value *value, char *buf,
+		       size_t size)
+{
+	const char *p;
+	const char *end;
+	char dec[4];
+	size_t dec_len;
+	size_t len = 0;
+
+	if (value->type != JSON_PATH_STRING) {
+		return -EINVAL;
+	}
+
+	p = value->ptr;
+	end = value->ptr + value->len;
+
+	while (p < end) {
+		dec_len = unescape(&p, end, dec);
+
+		for (size_t i = 0; i < dec_len; i++, len++) {
+			if (len + 1 < size) {
+				buf[len] = dec[i];
+			}
+		}
+	}
+
+	if (size > 0) {
+		buf[MIN(len, size - 1)] = '\0';
+	}
+
+	return len;
+}
+
+bool json_path_str_eq(const struct json_path_value *value, const char *str)
+{
+	const char *p;
+	const char *end;
+	char dec[4];
+	size_t dec_len;
+
+	if (value->type != JSON_PATH_STRING) {
+		return false;
+	}
+
+	p = value->ptr;
+	end = value->ptr + value->len;
+
+	/* Without escape sequences, the value can be compared as is */
+	if (memchr(p, '\\', value->len) == NULL) {
+		return strncmp(p, str, value->len) == 0 &&
+		       str[value->len] == '\0';
+	}
+
+	while (p < end) {
+		dec_len = unescape(&p, end, dec);
+
+		for (size_t i = 0; i < dec_len; i++, str++) {
+			if (*str == '\0' || *str != dec[i]) {
+				return false;
+			}
+		}
+	}
+
+	return *str == '\0';
+}
+
+int json_path_int(const struct json_path_value *value, int64_t *out)
+{
+	const char *p = value->ptr;
+	const char *end = value->ptr + value->len;
+	bool negative = false;
+	uint64_t limit = INT64_MAX;
+	uint64_t val = 0;
+
+	if (value->type != JSON_PATH_NUMBER) {
+		return -EINVAL;
+	}
+
+	if (*p == '-') {
+		negative = true;
+		limit = (uint64_t)INT64_MAX + 1;
+		p++;
+	}
+
+	for (; p < end; p++) {
+		if (!is_digit(*p)) {
+			return -EINVAL;
+		}
+
+		if (val > (limit - (*p - '0')) / 10) {
+			return -ERANGE;
+		}
+
+		val = val * 10 + (*p - '0');
+	}
+
+	*out = negative ? (int64_t)(0 - val) : (int64_t)val;
+
+	return 0;
+}
@@ -0,0 +1,358 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <json_writer.h>
+
+BUILD_ASSERT(JSON_WRITER_MAX_DEPTH <= 32,
+	     "Nesting is tracked in 32-bit masks");
+
+/* Largest magnitude below which every integer is exact in a double */
+#define DOUBLE_INT_MAX 9007199254740992.0
+
+static void put(struct json_writer *w, const char *data, size_t len)
+{
+	if (w->err) {
+		return;
+	}
+
+	if (w->buf) {
+		/* Room is always left for the NUL character */
+		if (len >= w->size - w->len) {
+			w->err = -ENOMEM;
+			return;
+		}
+
+		memcpy(w->buf + w->len, data, len);
+	}
+
+	w->len += len;
+}
+
+static void put_char(struct json_writer *w, char c)
+{
+	put(w, &c, 1);
+}
+
+static void put_escaped(struct json_writer *w, const char *str)
+{
+	static const char hex[] = "0123456789abcdef";
+	const char *run = str;
+	char esc[6];
+	size_t esc_len;
+
+	put_char(w, '"');
+
+	/* Characters that need no escaping are copied in runs */
+	for (; *str; str++) {
+		unsigned char c = *str;
+
+		if (c >= 0x20 && c != '"' && c != '\\') {
+			continue;
+		}
+
+		put(w, run, str - run);
+		run = str + 1;
+
+		esc[0] = '\\';
+		esc_len = 2;
+
+		switch (c) {
+		case '"':
+		case '\\':
+			esc[1] = c;
+			break;
+		case '\b':
+			esc[1] = 'b';
+			break;
+		case '\f':
+			esc[1] = 'f';
+			break;
+		case '\n':
+			esc[1] = 'n';
+			break;
+		case '\r':
+			esc[1] = 'r';
+			break;
+		case '\t':
+			esc[1] = 't';
+			break;
+		default:
+			esc[1] = 'u';
+			esc[2] = '0';
+			esc[3] = '0';
+			esc[4] = hex[c >> 4];
+			esc[5] = hex[c & 0xf];
+			esc_len = 6;
+			break;
+		}
+
+		put(w, esc, esc_len);
+	}
+
+	put(w, run, str - run);
+	put_char(w, '"');
+}
+
+/* Writes the separator and member name preceding a value */
+static void value_begin(struct json_writer *w, const char *key)
+{
+	uint32_t level = BIT(w->depth);
+
+	if (w->err) {
+		return;
+	}
+
+	if (w->depth > 0 && (key != NULL) == !!(w->arrays & level)) {
+		/* Member without a name, or array element with one */
+		w->err = -EINVAL;
+		return;
+	}
+
+	if (w->nonempty & level) {
+		put_char(w, ',');
+	}
+
+	w->nonempty |= level;
+
+	if (key) {
+		put_escaped(w, key);
+		put_char(w, ':');
+	}
+}
+
+static void container_start(struct json_writer *w, const char *key,
+			    bool array)
+{
+	value_begin(w, key);
+
+	if (w->err) {
+		return;
+	}
+
+	if (w->depth + 1 >= JSON_WRITER_MAX_DEPTH) {
+		w->err = -EINVAL;
+		return;
+	}
+
+	put_char(w, array ? '[' : '{');
+
+	w->depth++;
+	w->nonempty &= ~BIT(w->depth);
+	WRITE_BIT(w->arrays, w->depth, array);
+}
+
+static void container_end(struct json_writer *w, bool array)
+{
+	if (w->err) {
+		return;
+	}
+
+	if (w->depth == 0 || !!(w->arrays & BIT(w->depth)) != array) {
+		w->err = -EINVAL;
+		return;
+	}
+
+	w->depth--;
+
+	put_char(w, array ? ']' : '}');
+}
+
+void json_writer_init(struct json_writer *w, char *buf, size_t size)
+{
+	__ASSERT_NO_MSG(w != NULL);
+
+	w->buf = buf;
+	w->size = size;
+	w->len = 0;
+	w->err = (buf && size == 0) ? -ENOMEM : 0;
+	w->depth = 0;
+	w->nonempty = 0;
+	w->arrays = 0;
+}
+
+void json_writer_obj_start(struct json_writer *w, const char *key)
+{
+	container_start(w, key, false);
+}
+
+void json_writer_obj_end(struct json_writer *w)
+{
+	container_end(w, false);
+}
+
+void json_writer_arr_start(struct json_writer *w, const char *key)
+{
+	container_start(w, key, true);
+}
+
+void json_writer_arr_end(struct json_writer *w)
+{
+	container_end(w, true);
+}
+
+void json_writer_str(struct json_writer *w, const char *key,
+		     const char *value)
+{
+	if (value == NULL) {
+		json_writer_null(w, key);
+		return;
+	}
+
+	value_begin(w, key);
+	put_escaped(w, value);
+}
+
+void json_writer_int(struct json_writer *w, const char *key, int64_t value)
+{
+	/* Digits are produced backwards, from the end of the buffer */
+	char num[21];
+	char *pos = num + sizeof(num);
+	uint64_t mag = value < 0 ? -(uint64_t)value : (uint64_t)value;
+
+	do {
+		*--pos = '0' + mag % 10;
+		mag /= 10;
+	} while (mag);
+
+	if (value < 0) {
+		*--pos = '-';
+	}
+
+	value_begin(w, key);
+	put(w, pos, num + sizeof(num) - pos);
+}
+
+void json_writer_double(struct json_writer *w, const char *key, double value)
+{
+	char num[32];
+	int len;
+
+	if (isnan(value) || isinf(value)) {
+		json_writer_null(w, key);
+		return;
+	}
+
+	if (value == floor(value) && fabs(value) < DOUBLE_INT_MAX) {
+		json_writer_int(w, key, (int64_t)value);
+		return;
+	}
+
+	len = snprintf(num, sizeof(num), "%.15g", value);
+	if (len < 0 || len >= sizeof(num)) {
+		if (!w->err) {
+			w->err = -EINVAL;
+		}
+		return;
+	}
+
+	value_begin(w, key);
+	put(w, num, len);
+}
+
+void json_writer_bool(struct json_writer *w, const char *key, bool value)
+{
+	value_begin(w, key);
+
+	if (value) {
+		put(w, "true", 4);
+	} else {
+		put(w, "false", 5);
+	}
+}
+
+void json_writer_null(struct json_writer *w, const char *key)
+{
+	value_begin(w, key);
+	put(w, "null", 4);
+}
+
+void json_writer_raw(struct json_writer *w, const char *key, const char *json,
+		     size_t len)
+{
+	if (json == NULL || len == 0) {
+		json_writer_null(w, key);
+		return;
+	}
+
+	value_begin(w, key);
+	put(w, json, len);
+}
+
+int json_writer_finish(struct json_writer *w)
+{
+	if (w->err) {
+		return w->err;
+	}
+
+	if (w->depth != 0) {
+		return -EINVAL;
+	}
+
+	if (w->buf) {
+		w->buf[w->len] = '\0';
+	}
+
+	return w->len;
+}
+
+int json_writer_encode_alloc(json_writer_encode_t encode, void *ctx,
+			     char **out, size_t *len)
+{
+	int err;
+	int size;
+	char *buf;
+	struct json_writer w;
+
+	__ASSERT_NO_MSG(encode != NULL);
+	__ASSERT_NO_MSG(out != NULL);
+
+	json_writer_init(&w, NULL, 0);
+
+	err = encode(&w, ctx);
+	if (err) {
+		return err;
+	}
+
+	size = json_writer_finish(&w);
+	if (size < 0) {
+		return size;
+	}
+
+	buf = k_malloc(size + 1);
+	if (buf == NULL) {
+		return -ENOMEM;
+	}
+
+	json_writer_init(&w, buf, size + 1);
+
+	err = encode(&w, ctx);
+	if (!err) {
+		err = json_writer_finish(&w);
+	}
+
+	if (err >= 0 && err != size) {
+		/* The encoder produced something else the second time */
+		err = -EIO;
+	} else if (err > 0) {
+		err = 0;
+	}
+
+	if (err) {
+		k_free(buf);
+		return err;
+	}
+
+	*out = buf;
+	if (len) {
+		*len = size;
+	}
+
+	return 0;
+}
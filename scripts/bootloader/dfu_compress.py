@@ -0,0 +1,211 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+
+"""
+Compress an MCUboot update image for the compressed DFU target.
+
+The output starts with a 16 byte header, followed by an LZSS bit stream
+that is decompressed on the device while the image is being downloaded.
+See subsys/dfu/src/dfu_target_compressed.c for the format.
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+MAGIC = 0x53535a4c
+VERSION = 1
+HEADER = struct.Struct('<IBBBBII')
+
+# Candidate positions kept per 3 byte prefix while searching for matches
+MAX_CANDIDATES = 64
+MIN_PREFIX = 3
+
+
+class BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.count = 0
+
+    def write(self, value, bits):
+        self.acc = (self.acc << bits) | value
+        self.count += bits
+        while self.count >= 8:
+            self.count -= 8
+            self.out.append((self.acc >> self.count) & 0xff)
+        self.acc &= (1 << self.count) - 1
+
+    def flush(self):
+        if self.count:
+            self.out.append((self.acc << (8 - self.count)) & 0xff)
+            self.acc = 0
+            self.count = 0
+        return bytes(self.out)
+
+
+class BitReader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+        self.acc = 0
+        self.count = 0
+
+    def read(self, bits):
+        while self.count < bits:
+            if self.pos >= len(self.data):
+                raise ValueError('Truncated stream')
+            self.acc = (self.acc << 8) | self.data[self.pos]
+            self.pos += 1
+            self.count += 8
+        self.count -= bits
+        value = (self.acc >> self.count) & ((1 << bits) - 1)
+        self.acc &= (1 << self.count) - 1
+        return value
+
+
+def lzss_compress(data, window_bits, lookahead_bits):
+    window = 1 << window_bits
+    max_len = 1 << lookahead_bits
+    backref_bits = 1 + window_bits + lookahead_bits
+    # A back-reference must be cheaper than the literals it replaces
+    min_len = max(MIN_PREFIX, backref_bits // 9 + 1)
+
+    writer = BitWriter()
+    chains = {}
+    pos = 0
+
+    def insert(i):
+        if i + MIN_PREFIX <= len(data):
+            chain = chains.setdefault(data[i:i + MIN_PREFIX], [])
+            chain.append(i)
+            if len(chain) > MAX_CANDIDATES:
+                del chain[0]
+
+    while pos < len(data):
+        best_len = 0
+        best_dist = 0
+        limit = min(max_len, len(data) - pos)
+
+        for cand in reversed(chains.get(data[pos:pos + MIN_PREFIX], [])):
+            dist = pos - cand
+            if dist > window:
+                break
+            length = 0
+            while length < limit and data[cand + length] == data[pos + length]:
+                length += 1
+            if length > best_len:
+                best_len = length
+                best_dist = dist
+                if length == limit:
+                    break
+
+        if best_len >= min_len:
+            writer.write(0, 1)
+            writer.write(best_dist - 1, window_bits)
+            writer.write(best_len - 1, lookahead_bits)
+            step = best_len
+        else:
+            writer.write(1, 1)
+            writer.write(data[pos], 8)
+            step = 1
+
+        for i in range(pos, pos + step):
+            insert(i)
+        pos += step
+
+    return writer.flush()
+
+
+def lzss_decompress(stream, size, window_bits, lookahead_bits):
+    reader = BitReader(stream)
+    out = bytearray()
+
+    while len(out) < size:
+        if reader.read(1):
+            out.append(reader.read(8))
+            continue
+        dist = reader.read(window_bits) + 1
+        length = reader.read(lookahead_bits) + 1
+        if dist > len(out):
+            raise ValueError('Back-reference before start of data')
+        for _ in range(min(length, size - len(out))):
+            out.append(out[-dist])
+
+    return bytes(out)
+
+
+def compress(data, window_bits, lookahead_bits):
+    header = HEADER.pack(MAGIC, VERSION, window_bits, lookahead_bits, 0,
+                         len(data), zlib.crc32(data) & 0xffffffff)
+    return header + lzss_compress(data, window_bits, lookahead_bits)
+
+
+def decompress(image):
+    magic, version, window_bits, lookahead_bits, _, size, crc = \
+        HEADER.unpack_from(image)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError('Not a compressed image')
+    data = lzss_decompress(image[HEADER.size:], size, window_bits,
+                           lookahead_bits)
+    if zlib.crc32(data) & 0xffffffff != crc:
+        raise ValueError('CRC mismatch')
+    return data
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(
+        description='Compress an MCUboot update image for the compressed '
+                    'DFU target.',
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+
+    parser.add_argument('input', help='Update image, for example '
+                                      'app_update.bin.')
+    parser.add_argument('-o', '--output', required=True,
+                        help='Compressed image to create.')
+    parser.add_argument('--window-bits', type=int, default=10,
+                        help='Base 2 logarithm of the window size. Must not '
+                             'exceed CONFIG_DFU_TARGET_COMPRESSED_WINDOW_BITS '
+                             'on the device (default: 10).')
+    parser.add_argument('--lookahead-bits', type=int, default=4,
+                        help='Base 2 logarithm of the longest match '
+                             '(default: 4).')
+    parser.add_argument('--decompress', action='store_true',
+                        help='Decompress the input instead.')
+    return parser.parse_args()
+
+
+def main():
+    args = parse_args()
+
+    with open(args.input, 'rb') as f:
+        data = f.read()
+
+    if args.decompress:
+        out = decompress(data)
+    else:
+        if not 8 <= args.window_bits <= 14:
+            sys.exit('Window bits must be in the range 8 to 14')
+        if not 2 <= args.lookahead_bits < args.window_bits:
+            sys.exit('Lookahead bits must be at least 2 and less than '
+                     'window bits')
+
+        out = compress(data, args.window_bits, args.lookahead_bits)
+
+        # Round trip, so that a broken image never reaches a device
+        if decompress(out) != data:
+            sys.exit('Round trip verification failed')
+
+        print('%s: %d -> %d bytes (%.1f%%)' %
+              (args.output, len(data), len(out), 100.0 * len(out) / len(data)))
+
+    with open(args.output, 'wb') as f:
+        f.write(out)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,180 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+
+"""
+Create a patch for the delta DFU target.
+
+The patch rebuilds a new MCUboot update image from the image that is
+running on the device. It consists of an 80 byte header followed by copy
+commands, which take data from the running image, and insert commands,
+which carry new data. See subsys/dfu/src/dfu_target_delta.c.
+"""
+
+import argparse
+import hashlib
+import struct
+import sys
+
+MAGIC = 0x41544c44
+VERSION = 1
+HEADER = struct.Struct('<IB3xII32s32s')
+CMD = struct.Struct('<B3xII')
+
+OP_COPY = 1
+OP_INSERT = 2
+
+# Length of the source fragments that are indexed to find matches
+BLOCK = 8
+# Candidate positions kept per fragment
+MAX_CANDIDATES = 16
+# A copy shorter than this costs more than inserting the data
+MIN_COPY = CMD.size + 4
+
+
+def index_source(source):
+    index = {}
+    for i in range(len(source) - BLOCK + 1):
+        chain = index.setdefault(source[i:i + BLOCK], [])
+        if len(chain) < MAX_CANDIDATES:
+            chain.append(i)
+    return index
+
+
+def match_len(source, src, target, dst):
+    limit = min(len(source) - src, len(target) - dst)
+    n = 0
+    while n < limit and source[src + n] == target[dst + n]:
+        n += 1
+    return n
+
+
+def diff(source, target):
+    index = index_source(source)
+    commands = []
+    literal = bytearray()
+    pos = 0
+    # Source position following the last copy. Code that did not change
+    # usually continues there, so it is tried first.
+    expected = 0
+
+    def flush_literal():
+        if literal:
+            commands.append((OP_INSERT, 0, bytes(literal)))
+            literal.clear()
+
+    while pos < len(target):
+        best_len = 0
+        best_src = 0
+
+        candidates = index.get(target[pos:pos + BLOCK], [])
+        for src in [expected] + candidates:
+            n = match_len(source, src, target, pos)
+            if n > best_len:
+                best_len = n
+                best_src = src
+
+        if best_len >= MIN_COPY:
+            flush_literal()
+            commands.append((OP_COPY, best_src, best_len))
+            pos += best_len
+            expected = best_src + best_len
+        else:
+            literal.append(target[pos])
+            pos += 1
+            expected += 1
+
+    flush_literal()
+
+    return commands
+
+
+def create(source, target):
+    out = bytearray(HEADER.pack(MAGIC, VERSION, len(source), len(target),
+                                hashlib.sha256(source).digest(),
+                                hashlib.sha256(target).digest()))
+
+    for op, offset, arg in diff(source, target):
+        if op == OP_COPY:
+            out += CMD.pack(op, offset, arg)
+        else:
+            out += CMD.pack(op, 0, len(arg)) + arg
+
+    return bytes(out)
+
+
+def apply(source, patch):
+    magic, version, source_size, target_size, source_hash, target_hash = \
+        HEADER.unpack_from(patch)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError('Not a delta image')
+    if hashlib.sha256(source[:source_size]).digest() != source_hash:
+        raise ValueError('Patch does not apply to this image')
+
+    out = bytearray()
+    pos = HEADER.size
+    while len(out) < target_size:
+        op, offset, length = CMD.unpack_from(patch, pos)
+        pos += CMD.size
+        if op == OP_COPY:
+            out += source[offset:offset + length]
+        elif op == OP_INSERT:
+            out += patch[pos:pos + length]
+            pos += length
+        else:
+            raise ValueError('Unknown command %d' % op)
+
+    if pos != len(patch) or hashlib.sha256(out).digest() != target_hash:
+        raise ValueError('Patched image mismatch')
+
+    return bytes(out)
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(
+        description='Create a patch for the delta DFU target.',
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+
+    parser.add_argument('source', help='Image running on the device, as '
+                                       'found in the primary slot, for '
+                                       'example the previous '
+                                       'app_update.bin.')
+    parser.add_argument('target', help='New update image, for example '
+                                       'app_update.bin.')
+    parser.add_argument('-o', '--output', required=True,
+                        help='Patch to create.')
+    parser.add_argument('--apply', action='store_true',
+                        help='Apply the patch given as target to source '
+                             'instead.')
+    return parser.parse_args()
+
+
+def main():
+    args = parse_args()
+
+    with open(args.source, 'rb') as f:
+        source = f.read()
+    with open(args.target, 'rb') as f:
+        target = f.read()
+
+    if args.apply:
+        out = apply(source, target)
+    else:
+        out = create(source, target)
+
+        # Round trip, so that a broken patch never reaches a device
+        if apply(source, out) != target:
+            sys.exit('Round trip verification failed')
+
+        print('%s: %d bytes for a %d byte image (%.1f%%)' %
+              (args.output, len(out), len(target),
+               100.0 * len(out) / len(target)))
+
+    with open(args.output, 'wb') as f:
+        f.write(out)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/** @file dfu_target_compressed.h
+ *
+ * @defgroup dfu_target_compressed Compressed MCUBoot DFU Target
+ * @{
+ * @brief DFU Target for compressed upgrades performed by MCUBoot
+ *
+ * The image is an MCUBoot image compressed with LZSS by
+ * scripts/bootloader/dfu_compress.py. It is decompressed as it is
+ * received and written through the MCUBoot DFU target.
+ */
+
+#ifndef DFU_TARGET_COMPRESSED_H__
+#define DFU_TARGET_COMPRESSED_H__
+
+#include <zephyr/types.h>
+#include <dfu/dfu_target.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Magic number of a compressed image, "LZSS". */
+#define DFU_TARGET_COMPRESSED_MAGIC 0x53535a4c
+
+/** Version of the compressed image format. */
+#define DFU_TARGET_COMPRESSED_VERSION 1
+
+/** @brief Header of a compressed image. All fields are little-endian. */
+struct dfu_target_compressed_header {
+	/** @ref DFU_TARGET_COMPRESSED_MAGIC */
+	uint32_t magic;
+	/** @ref DFU_TARGET_COMPRESSED_VERSION */
+	uint8_t version;
+	/** Base 2 logarithm of the back-reference window size. */
+	uint8_t window_bits;
+	/** Base 2 logarithm of the longest back-reference. */
+	uint8_t lookahead_bits;
+	/** Reserved, zero. */
+	uint8_t reserved;
+	/** Size of the decompressed image. */
+	uint32_t size;
+	/** CRC32 (IEEE) of the decompressed image. */
+	uint32_t crc;
+} __packed;
+
+/**
+ * @brief See if data in buf indicates a compressed MCUBoot upgrade.
+ *
+ * @retval true if data matches, false otherwise.
+ */
+bool dfu_target_compressed_identify(const void *const buf);
+
+/**
+ * @brief Initialize dfu target, perform steps necessary to receive firmware.
+ *
+ * The MCUBoot target is initialized once the header of the compressed
+ * image has been received.
+ *
+ * @param[in] file_size Size of the compressed file being downloaded.
+ * @param[in] cb Callback for signaling events(unused).
+ *
+ * @retval 0 If successful, negative errno otherwise.
+ */
+int dfu_target_compressed_init(size_t file_size, dfu_target_callback_t cb);
+
+/**
+ * @brief Get offset of firmware
+ *
+ * Decompression can not be resumed across resets, so the offset is the
+ * number of compressed bytes received since initialization.
+ *
+ * @param[out] offset Returns the offset of the firmware upgrade.
+ *
+ * @return 0 if success, otherwise negative value if unable to get the offset
+ */
+int dfu_target_compressed_offset_get(size_t *offset);
+
+/**
+ * @brief Write compressed firmware data.
+ *
+ * @param[in] buf Pointer to data that should be written.
+ * @param[in] len Length of data to write.
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+int dfu_target_compressed_write(const void *const buf, size_t len);
+
+/**
+ * @brief Deinitialize resources and finalize firmware upgrade if successful.
+ *
+ * The upgrade is only scheduled if the whole image was decompressed and
+ * its CRC matches the one in the header.
+ *
+ * @param[in] successful Indicate whether the firmware was successfully recived.
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+int dfu_target_compressed_done(bool successful);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DFU_TARGET_COMPRESSED_H__ */
+
+/**@} */
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/** @file dfu_target_delta.h
+ *
+ * @defgroup dfu_target_delta Delta MCUBoot DFU Target
+ * @{
+ * @brief DFU Target for delta upgrades performed by MCUBoot
+ *
+ * The image is a patch created by scripts/bootloader/dfu_delta.py. The
+ * new MCUBoot image is rebuilt from the image in the primary slot and the
+ * patch as the patch is received, and written through the MCUBoot DFU
+ * target.
+ */
+
+#ifndef DFU_TARGET_DELTA_H__
+#define DFU_TARGET_DELTA_H__
+
+#include <zephyr/types.h>
+#include <dfu/dfu_target.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Magic number of a delta image, "DLTA". */
+#define DFU_TARGET_DELTA_MAGIC 0x41544c44
+
+/** Version of the delta image format. */
+#define DFU_TARGET_DELTA_VERSION 1
+
+/** Size of the SHA-256 hashes in the header. */
+#define DFU_TARGET_DELTA_HASH_LEN 32
+
+/** @brief Header of a delta image. All fields are little-endian. */
+struct dfu_target_delta_header {
+	/** @ref DFU_TARGET_DELTA_MAGIC */
+	uint32_t magic;
+	/** @ref DFU_TARGET_DELTA_VERSION */
+	uint8_t version;
+	/** Reserved, zero. */
+	uint8_t reserved[3];
+	/** Size of the image the patch applies to. */
+	uint32_t source_size;
+	/** Size of the image the patch creates. */
+	uint32_t target_size;
+	/** SHA-256 of the image the patch applies to. */
+	uint8_t source_hash[DFU_TARGET_DELTA_HASH_LEN];
+	/** SHA-256 of the image the patch creates. */
+	uint8_t target_hash[DFU_TARGET_DELTA_HASH_LEN];
+} __packed;
+
+/** @brief Patch operations. */
+enum dfu_target_delta_op {
+	/** Copy len bytes of the source image, starting at offset. */
+	DFU_TARGET_DELTA_OP_COPY = 1,
+	/** Insert the len bytes following the command. */
+	DFU_TARGET_DELTA_OP_INSERT = 2,
+};
+
+/** @brief Patch command. The header is followed by a sequence of commands,
+ *  until target_size bytes have been produced.
+ */
+struct dfu_target_delta_cmd {
+	/** @ref dfu_target_delta_op */
+	uint8_t op;
+	/** Reserved, zero. */
+	uint8_t reserved[3];
+	/** Offset in the source image, unused for inserts. */
+	uint32_t offset;
+	/** Number of bytes produced by the command. */
+	uint32_t len;
+} __packed;
+
+/**
+ * @brief See if data in buf indicates a delta MCUBoot upgrade.
+ *
+ * @retval true if data matches, false otherwise.
+ */
+bool dfu_target_delta_identify(const void *const buf);
+
+/**
+ * @brief Initialize dfu target, perform steps necessary to receive firmware.
+ *
+ * The MCUBoot target is initialized once the header of the patch has been
+ * received and the image in the primary slot has been verified to be the
+ * one the patch applies to.
+ *
+ * @param[in] file_size Size of the patch being downloaded.
+ * @param[in] cb Callback for signaling events(unused).
+ *
+ * @retval 0 If successful, negative errno otherwise.
+ */
+int dfu_target_delta_init(size_t file_size, dfu_target_callback_t cb);
+
+/**
+ * @brief Get offset of firmware
+ *
+ * Patching can not be resumed across resets, so the offset is the
+ * number of patch bytes received since initialization.
+ *
+ * @param[out] offset Returns the offset of the firmware upgrade.
+ *
+ * @return 0 if success, otherwise negative value if unable to get the offset
+ */
+int dfu_target_delta_offset_get(size_t *offset);
+
+/**
+ * @brief Write patch data.
+ *
+ * @param[in] buf Pointer to data that should be written.
+ * @param[in] len Length of data to write.
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+int dfu_target_delta_write(const void *const buf, size_t len);
+
+/**
+ * @brief Deinitialize resources and finalize firmware upgrade if successful.
+ *
+ * The upgrade is only scheduled if the whole image was rebuilt and its
+ * SHA-256 matches the one in the header.
+ *
+ * @param[in] successful Indicate whether the firmware was successfully recived.
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+int dfu_target_delta_done(bool successful);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DFU_TARGET_DELTA_H__ */
+
+/**@} */
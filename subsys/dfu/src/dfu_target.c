@@ -3,10 +3,14 @@
  *
  * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
  */
+#include <string.h>
 #include <zephyr.h>
 #include <logging/log.h>
 #include <dfu/mcuboot.h>
 #include <dfu/dfu_target.h>
+#ifdef CONFIG_DFU_TARGET_HASH
+#include <mbedtls/sha256.h>
+#endif
 
 #define DEF_DFU_TARGET(name) \
 static const struct dfu_target dfu_target_ ## name  = { \
@@ -24,6 +28,14 @@ DEF_DFU_TARGET(modem);
 #include "dfu_target_mcuboot.h"
 DEF_DFU_TARGET(mcuboot);
 #endif
+#ifdef CONFIG_DFU_TARGET_COMPRESSED
+#include "dfu_target_compressed.h"
+DEF_DFU_TARGET(compressed);
+#endif
+#ifdef CONFIG_DFU_TARGET_DELTA
+#include "dfu_target_delta.h"
+DEF_DFU_TARGET(delta);
+#endif
 
 #define MIN_SIZE_IDENTIFY_BUF 32
 
@@ -31,6 +43,144 @@ LOG_MODULE_REGISTER(dfu_target, CONFIG_DFU_TARGET_LOG_LEVEL);
 
 static const struct dfu_target *current_target;
 
+#ifdef CONFIG_DFU_TARGET_HASH
+/* Digest of the image being received, computed as fragments are written */
+static struct {
+	mbedtls_sha256_context ctx;
+	uint8_t expected[DFU_TARGET_HASH_LEN];
+	bool expected_set;
+	/* Whether every byte of the image has gone through the context */
+	bool running;
+	/* The digest was expected but could not be computed */
+	bool failed;
+} hash;
+
+static void hash_start(void)
+{
+	int err;
+	size_t offset;
+
+	hash.running = false;
+	hash.failed = false;
+
+	if (!hash.expected_set) {
+		return;
+	}
+
+	err = current_target->offset_get(&offset);
+	if (err) {
+		hash.failed = true;
+		return;
+	}
+
+	if (offset != 0) {
+		/* Part of the image was received before a reset, and is
+		 * verified by the bootloader only.
+		 */
+		LOG_WRN("Resumed download, image hash is not verified");
+		return;
+	}
+
+	mbedtls_sha256_free(&hash.ctx);
+	mbedtls_sha256_init(&hash.ctx);
+	if (mbedtls_sha256_starts_ret(&hash.ctx, false) != 0) {
+		LOG_ERR("Unable to start image hash");
+		hash.failed = true;
+		return;
+	}
+
+	hash.running = true;
+}
+
+static void hash_abort(void)
+{
+	/* Restarted by the next initialization */
+	hash.running = false;
+}
+
+static void hash_update(const void *const buf, size_t len)
+{
+	if (hash.running &&
+	    mbedtls_sha256_update_ret(&hash.ctx, buf, len) != 0) {
+		LOG_ERR("Unable to hash image fragment");
+		hash.running = false;
+		hash.failed = true;
+	}
+}
+
+static int hash_verify(void)
+{
+	uint8_t digest[DFU_TARGET_HASH_LEN];
+
+	if (!hash.expected_set) {
+		return 0;
+	}
+
+	if (hash.failed) {
+		/* Not accepted unverified, as the digest was expected */
+		hash.failed = false;
+		hash.expected_set = false;
+		return -EIO;
+	}
+
+	if (!hash.running) {
+		/* Resumed from stored progress, see hash_start() */
+		return 0;
+	}
+
+	hash.running = false;
+	hash.expected_set = false;
+
+	if (mbedtls_sha256_finish_ret(&hash.ctx, digest) != 0) {
+		return -EIO;
+	}
+
+	if (memcmp(digest, hash.expected, sizeof(digest)) != 0) {
+		LOG_ERR("Image hash mismatch");
+		return -EBADMSG;
+	}
+
+	LOG_INF("Image hash verified");
+
+	return 0;
+}
+
+int dfu_target_hash_expect(const uint8_t *digest)
+{
+	hash.running = false;
+	hash.failed = false;
+	hash.expected_set = digest != NULL;
+
+	if (digest) {
+		memcpy(hash.expected, digest, sizeof(hash.expected));
+	}
+
+	return 0;
+}
+#else
+static void hash_start(void)
+{
+}
+
+static void hash_abort(void)
+{
+}
+
+static void hash_update(const void *const buf, size_t len)
+{
+}
+
+static int hash_verify(void)
+{
+	return 0;
+}
+
+int dfu_target_hash_expect(const uint8_t *digest)
+{
+	return digest ? -ENOTSUP : 0;
+}
+#endif /* CONFIG_DFU_TARGET_HASH */
+
 int dfu_target_img_type(const void *const buf, size_t len)
 {
 #ifdef CONFIG_DFU_TARGET_MCUBOOT
@@ -42,6 +192,16 @@ int dfu_target_img_type(const void *const buf, size_t len)
 	if (dfu_target_modem_identify(buf)) {
 		return DFU_TARGET_IMAGE_TYPE_MODEM_DELTA;
 	}
+#endif
+#ifdef CONFIG_DFU_TARGET_COMPRESSED
+	if (dfu_target_compressed_identify(buf)) {
+		return DFU_TARGET_IMAGE_TYPE_COMPRESSED;
+	}
+#endif
+#ifdef CONFIG_DFU_TARGET_DELTA
+	if (dfu_target_delta_identify(buf)) {
+		return DFU_TARGET_IMAGE_TYPE_DELTA;
+	}
 #endif
 	if (len < MIN_SIZE_IDENTIFY_BUF) {
 		return -EAGAIN;
@@ -64,6 +224,16 @@ int dfu_target_init(int img_type, size_t file_size, dfu_target_callback_t cb)
 	if (img_type == DFU_TARGET_IMAGE_TYPE_MODEM_DELTA) {
 		new_target = &dfu_target_modem;
 	}
+#endif
+#ifdef CONFIG_DFU_TARGET_COMPRESSED
+	if (img_type == DFU_TARGET_IMAGE_TYPE_COMPRESSED) {
+		new_target = &dfu_target_compressed;
+	}
+#endif
+#ifdef CONFIG_DFU_TARGET_DELTA
+	if (img_type == DFU_TARGET_IMAGE_TYPE_DELTA) {
+		new_target = &dfu_target_delta;
+	}
 #endif
 	if (new_target == NULL) {
 		LOG_ERR("Unknown image type");
@@ -75,14 +245,21 @@ int dfu_target_init(int img_type, size_t file_size, dfu_target_callback_t cb)
 	 * continue where it left off. Re-initializing is required for modem
 	 * upgrades to re-open the DFU socket that is closed on abort.
 	 */
-	if (new_target == current_target
-	   && img_type != DFU_TARGET_IMAGE_TYPE_MODEM_DELTA) {
-		return 0;
+	if (new_target != current_target
+	   || img_type == DFU_TARGET_IMAGE_TYPE_MODEM_DELTA) {
+		int err;
+
+		current_target = new_target;
+
+		err = current_target->init(file_size, cb);
+		if (err) {
+			return err;
+		}
 	}
 
-	current_target = new_target;
+	hash_start();
 
-	return current_target->init(file_size, cb);
+	return 0;
 }
 
 int dfu_target_offset_get(size_t *offset)
@@ -100,6 +277,8 @@ int dfu_target_write(const void *const buf, size_t len)
 		return -EACCES;
 	}
 
+	hash_update(buf, len);
+
 	return current_target->write(buf, len);
 }
 
@@ -111,6 +290,20 @@ int dfu_target_done(bool successful)
 		return -EACCES;
 	}
 
+	if (successful) {
+		err = hash_verify();
+		if (err) {
+			/* Make sure the image is not scheduled, and start over
+			 * on the next initialization.
+			 */
+			(void)current_target->done(false);
+			current_target = NULL;
+			return err;
+		}
+	} else {
+		hash_abort();
+	}
+
 	err = current_target->done(successful);
 	if (err != 0) {
 		LOG_ERR("Unable to clean up dfu_target");
@@ -126,6 +319,8 @@ int dfu_target_done(bool successful)
 
 int dfu_target_reset(void)
 {
+	hash_abort();
+
 	if (current_target != NULL) {
 		int err = current_target->done(false);
 
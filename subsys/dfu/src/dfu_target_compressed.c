@@ -0,0 +1,365 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <sys/crc.h>
+#include <logging/log.h>
+#include <dfu/dfu_target.h>
+#include <dfu_target_mcuboot.h>
+#include <dfu_target_compressed.h>
+
+LOG_MODULE_REGISTER(dfu_target_compressed, CONFIG_DFU_TARGET_LOG_LEVEL);
+
+#define WINDOW_BITS_MAX CONFIG_DFU_TARGET_COMPRESSED_WINDOW_BITS
+#define LOOKAHEAD_BITS_MIN 2
+#define OUT_BUF_SIZE CONFIG_DFU_TARGET_COMPRESSED_BUF_SIZE
+
+/* The compressed stream is a sequence of MSB-first bit fields:
+ *  - '1' followed by an 8 bit literal byte, or
+ *  - '0' followed by (distance - 1) in window_bits and (length - 1) in
+ *    lookahead_bits, copying length bytes from distance bytes back.
+ * The last byte is padded with zeroes.
+ */
+enum state {
+	STATE_HEADER,
+	STATE_TAG,
+	STATE_LITERAL,
+	STATE_DISTANCE,
+	STATE_LENGTH,
+	STATE_DONE,
+};
+
+static struct {
+	struct dfu_target_compressed_header header;
+	size_t header_len;
+	enum state state;
+	/* Compressed bytes received */
+	size_t consumed;
+	/* Decompressed bytes produced */
+	size_t produced;
+	uint32_t crc;
+	/* Bit accumulator, MSB first */
+	uint32_t bits;
+	uint8_t bit_count;
+	uint16_t distance;
+	/* Back-reference window */
+	uint8_t window[1 << WINDOW_BITS_MAX];
+	size_t head;
+	/* Decompressed data waiting to be written */
+	uint8_t out[OUT_BUF_SIZE];
+	size_t out_len;
+} ctx;
+
+BUILD_ASSERT(OUT_BUF_SIZE >= sizeof(uint32_t),
+	     "Output buffer can not hold the MCUBoot magic");
+
+bool dfu_target_compressed_identify(const void *const buf)
+{
+	return *((const uint32_t *)buf) == DFU_TARGET_COMPRESSED_MAGIC;
+}
+
+static int out_flush(void)
+{
+	int err;
+
+	if (ctx.out_len == 0) {
+		return 0;
+	}
+
+	if (ctx.produced == ctx.out_len &&
+	    !dfu_target_mcuboot_identify(ctx.out)) {
+		LOG_ERR("Compressed payload is not an MCUBoot image");
+		return -ENOTSUP;
+	}
+
+	ctx.crc = crc32_ieee_update(ctx.crc, ctx.out, ctx.out_len);
+
+	err = dfu_target_mcuboot_write(ctx.out, ctx.out_len);
+	if (err) {
+		return err;
+	}
+
+	ctx.out_len = 0;
+
+	return 0;
+}
+
+static int emit(uint8_t byte)
+{
+	if (ctx.produced == ctx.header.size) {
+		LOG_ERR("Decompressed image larger than announced");
+		return -EINVAL;
+	}
+
+	ctx.window[ctx.head] = byte;
+	ctx.head = (ctx.head + 1) & (BIT(ctx.header.window_bits) - 1);
+
+	ctx.out[ctx.out_len++] = byte;
+	ctx.produced++;
+
+	if (ctx.produced == ctx.header.size) {
+		ctx.state = STATE_DONE;
+	}
+
+	if (ctx.out_len == sizeof(ctx.out)) {
+		return out_flush();
+	}
+
+	return 0;
+}
+
+static int backref_copy(uint16_t distance, uint16_t length)
+{
+	int err;
+	size_t mask = BIT(ctx.header.window_bits) - 1;
+
+	if (distance > ctx.produced) {
+		LOG_ERR("Back-reference before start of image");
+		return -EINVAL;
+	}
+
+	while (length-- && ctx.state != STATE_DONE) {
+		err = emit(ctx.window[(ctx.head - distance) & mask]);
+		if (err) {
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+static int bits_get(uint8_t count, uint16_t *value)
+{
+	if (ctx.bit_count < count) {
+		return -EAGAIN;
+	}
+
+	ctx.bit_count -= count;
+	*value = (ctx.bits >> ctx.bit_count) & (BIT(count) - 1);
+
+	return 0;
+}
+
+/* Run the decoder on the bits accumulated so far */
+static int decode(void)
+{
+	int err = 0;
+	uint16_t value;
+
+	while (ctx.state != STATE_DONE) {
+		switch (ctx.state) {
+		case STATE_TAG:
+			err = bits_get(1, &value);
+			if (!err) {
+				ctx.state = value ? STATE_LITERAL :
+						    STATE_DISTANCE;
+			}
+			break;
+		case STATE_LITERAL:
+			err = bits_get(8, &value);
+			if (!err) {
+				ctx.state = STATE_TAG;
+				err = emit(value);
+			}
+			break;
+		case STATE_DISTANCE:
+			err = bits_get(ctx.header.window_bits, &value);
+			if (!err) {
+				ctx.distance = value + 1;
+				ctx.state = STATE_LENGTH;
+			}
+			break;
+		case STATE_LENGTH:
+			err = bits_get(ctx.header.lookahead_bits, &value);
+			if (!err) {
+				ctx.state = STATE_TAG;
+				err = backref_copy(ctx.distance, value + 1);
+			}
+			break;
+		default:
+			return -EINVAL;
+		}
+
+		if (err == -EAGAIN) {
+			/* Wait for more input */
+			return 0;
+		}
+
+		if (err) {
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+static int header_parse(void)
+{
+	int err;
+	size_t offset;
+	const struct dfu_target_compressed_header *hdr = &ctx.header;
+
+	if (hdr->magic != DFU_TARGET_COMPRESSED_MAGIC ||
+	    hdr->version != DFU_TARGET_COMPRESSED_VERSION) {
+		LOG_ERR("Unsupported compressed image");
+		return -ENOTSUP;
+	}
+
+	if (hdr->window_bits > WINDOW_BITS_MAX ||
+	    hdr->lookahead_bits < LOOKAHEAD_BITS_MIN ||
+	    hdr->lookahead_bits >= hdr->window_bits) {
+		LOG_ERR("Unsupported window %d/%d, max window is %d",
+			hdr->window_bits, hdr->lookahead_bits,
+			WINDOW_BITS_MAX);
+		return -ENOTSUP;
+	}
+
+	LOG_INF("Compressed image, %d bytes decompressed, window %d",
+		hdr->size, BIT(hdr->window_bits));
+
+	err = dfu_target_mcuboot_init(hdr->size, NULL);
+	if (err) {
+		return err;
+	}
+
+	err = dfu_target_mcuboot_offset_get(&offset);
+	if (err) {
+		return err;
+	}
+
+	if (offset) {
+		/* Decompression always starts from the beginning of the
+		 * image, so progress stored by the MCUBoot target is dropped.
+		 */
+		err = dfu_target_mcuboot_done(false);
+		if (err) {
+			return err;
+		}
+	}
+
+	ctx.state = hdr->size ? STATE_TAG : STATE_DONE;
+
+	return 0;
+}
+
+/* Restart decompression from the header */
+static void ctx_reset(void)
+{
+	memset(&ctx.header, 0, sizeof(ctx.header));
+	ctx.header_len = 0;
+	ctx.state = STATE_HEADER;
+	ctx.consumed = 0;
+	ctx.produced = 0;
+	ctx.crc = 0;
+	ctx.bits = 0;
+	ctx.bit_count = 0;
+	ctx.head = 0;
+	ctx.out_len = 0;
+}
+
+int dfu_target_compressed_init(size_t file_size, dfu_target_callback_t cb)
+{
+	ARG_UNUSED(cb);
+
+	if (file_size < sizeof(ctx.header)) {
+		LOG_ERR("Compressed image too small");
+		return -EINVAL;
+	}
+
+	ctx_reset();
+
+	return 0;
+}
+
+int dfu_target_compressed_offset_get(size_t *out)
+{
+	*out = ctx.consumed;
+	return 0;
+}
+
+int dfu_target_compressed_write(const void *const buf, size_t len)
+{
+	int err;
+	size_t chunk;
+	const uint8_t *data = buf;
+
+	while (len) {
+		if (ctx.state == STATE_HEADER) {
+			chunk = MIN(len, sizeof(ctx.header) - ctx.header_len);
+			memcpy((uint8_t *)&ctx.header + ctx.header_len, data,
+			       chunk);
+			ctx.header_len += chunk;
+			ctx.consumed += chunk;
+			data += chunk;
+			len -= chunk;
+
+			if (ctx.header_len == sizeof(ctx.header)) {
+				err = header_parse();
+				if (err) {
+					return err;
+				}
+			}
+			continue;
+		}
+
+		if (ctx.state == STATE_DONE) {
+			/* Padding of the last byte, or trailing data */
+			ctx.consumed += len;
+			break;
+		}
+
+		ctx.bits = (ctx.bits << 8) | *data++;
+		ctx.bit_count += 8;
+		ctx.consumed++;
+		len--;
+
+		err = decode();
+		if (err) {
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+int dfu_target_compressed_done(bool successful)
+{
+	int err;
+
+	if (successful) {
+		if (ctx.state != STATE_DONE) {
+			LOG_ERR("Compressed image incomplete, %d/%d bytes",
+				ctx.produced, ctx.header.size);
+			err = -EINVAL;
+			goto abort;
+		}
+
+		err = out_flush();
+		if (err) {
+			goto abort;
+		}
+
+		if (ctx.crc != ctx.header.crc) {
+			LOG_ERR("Decompressed image CRC mismatch");
+			err = -EINVAL;
+			goto abort;
+		}
+	}
+
+	if (!successful) {
+		/* The MCUBoot target drops its progress too, so that a retry
+		 * starts from offset 0.
+		 */
+		ctx_reset();
+	}
+
+	return dfu_target_mcuboot_done(successful);
+
+abort:
+	ctx_reset();
+	(void)dfu_target_mcuboot_done(false);
+	return err;
+}
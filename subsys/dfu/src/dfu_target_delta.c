@@ -0,0 +1,409 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <pm_config.h>
+#include <storage/flash_map.h>
+#include <logging/log.h>
+#include <mbedtls/sha256.h>
+#include <dfu/dfu_target.h>
+#include <dfu_target_mcuboot.h>
+#include <dfu_target_delta.h>
+
+LOG_MODULE_REGISTER(dfu_target_delta, CONFIG_DFU_TARGET_LOG_LEVEL);
+
+#define BUF_SIZE CONFIG_DFU_TARGET_DELTA_BUF_SIZE
+
+enum state {
+	STATE_HEADER,
+	STATE_CMD,
+	STATE_DATA,
+	STATE_DONE,
+};
+
+static struct {
+	struct dfu_target_delta_header header;
+	struct dfu_target_delta_cmd cmd;
+	/* Bytes of the header or command received so far */
+	size_t partial;
+	enum state state;
+	/* Patch bytes received */
+	size_t consumed;
+	/* Target bytes produced */
+	size_t produced;
+	/* Bytes left of the current insert command */
+	size_t remaining;
+	const struct flash_area *source;
+	mbedtls_sha256_context sha;
+	/* Source data being copied */
+	uint8_t buf[BUF_SIZE];
+} ctx;
+
+bool dfu_target_delta_identify(const void *const buf)
+{
+	return *((const uint32_t *)buf) == DFU_TARGET_DELTA_MAGIC;
+}
+
+static int source_read(size_t off, size_t len)
+{
+	int err;
+
+	err = flash_area_read(ctx.source, off, ctx.buf, len);
+	if (err) {
+		LOG_ERR("Failed to read source image, err %d", err);
+	}
+
+	return err;
+}
+
+static int output(const uint8_t *data, size_t len)
+{
+	int err;
+
+	err = mbedtls_sha256_update_ret(&ctx.sha, data, len);
+	if (err) {
+		return -EIO;
+	}
+
+	err = dfu_target_mcuboot_write(data, len);
+	if (err) {
+		return err;
+	}
+
+	ctx.produced += len;
+
+	return 0;
+}
+
+static int source_verify(void)
+{
+	int err;
+	size_t len;
+	uint8_t hash[DFU_TARGET_DELTA_HASH_LEN];
+
+	err = mbedtls_sha256_starts_ret(&ctx.sha, false);
+	if (err) {
+		return -EIO;
+	}
+
+	for (size_t off = 0; off < ctx.header.source_size; off += len) {
+		len = MIN(sizeof(ctx.buf), ctx.header.source_size - off);
+
+		err = source_read(off, len);
+		if (err) {
+			return err;
+		}
+
+		err = mbedtls_sha256_update_ret(&ctx.sha, ctx.buf, len);
+		if (err) {
+			return -EIO;
+		}
+	}
+
+	err = mbedtls_sha256_finish_ret(&ctx.sha, hash);
+	if (err) {
+		return -EIO;
+	}
+
+	if (memcmp(hash, ctx.header.source_hash, sizeof(hash))) {
+		LOG_ERR("Patch does not apply to the running image");
+		return -ENOTSUP;
+	}
+
+	return 0;
+}
+
+static int header_parse(void)
+{
+	int err;
+	size_t offset;
+	const struct dfu_target_delta_header *hdr = &ctx.header;
+
+	if (hdr->magic != DFU_TARGET_DELTA_MAGIC ||
+	    hdr->version != DFU_TARGET_DELTA_VERSION) {
+		LOG_ERR("Unsupported delta image");
+		return -ENOTSUP;
+	}
+
+	if (hdr->target_size == 0 || hdr->source_size > ctx.source->fa_size) {
+		LOG_ERR("Invalid delta image sizes");
+		return -EINVAL;
+	}
+
+	LOG_INF("Delta image, %d bytes from %d bytes", hdr->target_size,
+		hdr->source_size);
+
+	err = source_verify();
+	if (err) {
+		return err;
+	}
+
+	err = mbedtls_sha256_starts_ret(&ctx.sha, false);
+	if (err) {
+		return -EIO;
+	}
+
+	err = dfu_target_mcuboot_init(hdr->target_size, NULL);
+	if (err) {
+		return err;
+	}
+
+	err = dfu_target_mcuboot_offset_get(&offset);
+	if (err) {
+		return err;
+	}
+
+	if (offset) {
+		/* Patching always starts from the beginning of the image,
+		 * so progress stored by the MCUBoot target is dropped.
+		 */
+		err = dfu_target_mcuboot_done(false);
+		if (err) {
+			return err;
+		}
+	}
+
+	ctx.state = STATE_CMD;
+
+	return 0;
+}
+
+static int copy(size_t off, size_t len)
+{
+	int err;
+	size_t chunk;
+
+	while (len) {
+		chunk = MIN(len, sizeof(ctx.buf));
+
+		err = source_read(off, chunk);
+		if (err) {
+			return err;
+		}
+
+		err = output(ctx.buf, chunk);
+		if (err) {
+			return err;
+		}
+
+		off += chunk;
+		len -= chunk;
+	}
+
+	return 0;
+}
+
+static void cmd_complete(void)
+{
+	ctx.state = ctx.produced == ctx.header.target_size ? STATE_DONE :
+							     STATE_CMD;
+}
+
+static int cmd_parse(void)
+{
+	int err;
+	const struct dfu_target_delta_cmd *cmd = &ctx.cmd;
+
+	if (cmd->len == 0 ||
+	    cmd->len > ctx.header.target_size - ctx.produced) {
+		LOG_ERR("Patch command exceeds target image");
+		return -EINVAL;
+	}
+
+	if (cmd->op != DFU_TARGET_DELTA_OP_INSERT &&
+	    (cmd->offset > ctx.header.source_size ||
+	     cmd->len > ctx.header.source_size - cmd->offset)) {
+		LOG_ERR("Patch command exceeds source image");
+		return -EINVAL;
+	}
+
+	switch (cmd->op) {
+	case DFU_TARGET_DELTA_OP_COPY:
+		err = copy(cmd->offset, cmd->len);
+		if (err) {
+			return err;
+		}
+		cmd_complete();
+		break;
+	case DFU_TARGET_DELTA_OP_INSERT:
+		ctx.remaining = cmd->len;
+		ctx.state = STATE_DATA;
+		break;
+	default:
+		LOG_ERR("Unknown patch command %d", cmd->op);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/* Consumes data of an insert command, returns bytes consumed */
+static int insert(const uint8_t *data, size_t len)
+{
+	int err;
+	size_t chunk = MIN(len, ctx.remaining);
+
+	err = output(data, chunk);
+	if (err) {
+		return err;
+	}
+
+	ctx.remaining -= chunk;
+
+	if (ctx.remaining == 0) {
+		cmd_complete();
+	}
+
+	return chunk;
+}
+
+/* Collects a fixed size structure that may span several writes,
+ * returns bytes consumed.
+ */
+static size_t collect(void *dst, size_t size, const uint8_t *data, size_t len)
+{
+	size_t chunk = MIN(len, size - ctx.partial);
+
+	memcpy((uint8_t *)dst + ctx.partial, data, chunk);
+	ctx.partial += chunk;
+
+	return chunk;
+}
+
+/* Restart patching from the header */
+static void ctx_reset(void)
+{
+	mbedtls_sha256_free(&ctx.sha);
+	mbedtls_sha256_init(&ctx.sha);
+
+	ctx.partial = 0;
+	ctx.state = STATE_HEADER;
+	ctx.consumed = 0;
+	ctx.produced = 0;
+	ctx.remaining = 0;
+}
+
+int dfu_target_delta_init(size_t file_size, dfu_target_callback_t cb)
+{
+	int err;
+
+	ARG_UNUSED(cb);
+
+	if (file_size < sizeof(ctx.header)) {
+		LOG_ERR("Delta image too small");
+		return -EINVAL;
+	}
+
+	if (ctx.source == NULL) {
+		err = flash_area_open(PM_MCUBOOT_PRIMARY_ID, &ctx.source);
+		if (err) {
+			LOG_ERR("Failed to open primary slot, err %d", err);
+			return err;
+		}
+	}
+
+	ctx_reset();
+
+	return 0;
+}
+
+int dfu_target_delta_offset_get(size_t *out)
+{
+	*out = ctx.consumed;
+	return 0;
+}
+
+int dfu_target_delta_write(const void *const buf, size_t len)
+{
+	int err = 0;
+	size_t chunk;
+	const uint8_t *data = buf;
+
+	while (len) {
+		switch (ctx.state) {
+		case STATE_HEADER:
+			chunk = collect(&ctx.header, sizeof(ctx.header),
+					data, len);
+			if (ctx.partial == sizeof(ctx.header)) {
+				ctx.partial = 0;
+				err = header_parse();
+			}
+			break;
+		case STATE_CMD:
+			chunk = collect(&ctx.cmd, sizeof(ctx.cmd), data, len);
+			if (ctx.partial == sizeof(ctx.cmd)) {
+				ctx.partial = 0;
+				err = cmd_parse();
+			}
+			break;
+		case STATE_DATA:
+			err = insert(data, len);
+			if (err < 0) {
+				return err;
+			}
+			chunk = err;
+			err = 0;
+			break;
+		case STATE_DONE:
+		default:
+			LOG_ERR("Trailing data after patch");
+			return -EINVAL;
+		}
+
+		if (err) {
+			return err;
+		}
+
+		ctx.consumed += chunk;
+		data += chunk;
+		len -= chunk;
+	}
+
+	return 0;
+}
+
+int dfu_target_delta_done(bool successful)
+{
+	int err;
+	uint8_t hash[DFU_TARGET_DELTA_HASH_LEN];
+
+	if (successful) {
+		if (ctx.state != STATE_DONE) {
+			LOG_ERR("Delta image incomplete, %d/%d bytes",
+				ctx.produced, ctx.header.target_size);
+			err = -EINVAL;
+			goto abort;
+		}
+
+		err = mbedtls_sha256_finish_ret(&ctx.sha, hash);
+		if (err) {
+			err = -EIO;
+			goto abort;
+		}
+
+		if (memcmp(hash, ctx.header.target_hash, sizeof(hash))) {
+			LOG_ERR("Patched image hash mismatch");
+			err = -EINVAL;
+			goto abort;
+		}
+	}
+
+	if (successful) {
+		mbedtls_sha256_free(&ctx.sha);
+	} else {
+		/* The MCUBoot target drops its progress too, so that a retry
+		 * starts from offset 0.
+		 */
+		ctx_reset();
+	}
+
+	return dfu_target_mcuboot_done(successful);
+
+abort:
+	ctx_reset();
+	(void)dfu_target_mcuboot_done(false);
+	return err;
+}
@@ -24,13 +24,44 @@
 #include <dfu/dfu_target.h>
 #include <dfu/flash_img.h>
 #include <settings/settings.h>
+#include <sys/crc.h>
 
 LOG_MODULE_REGISTER(dfu_target_mcuboot, CONFIG_DFU_TARGET_LOG_LEVEL);
 
 #define MAX_FILE_SEARCH_LEN 500
 #define MCUBOOT_HEADER_MAGIC 0x96f3b83d
 
+#if defined(CONFIG_DFU_TARGET_MCUBOOT_SAVE_PROGRESS)
+#define SAVE_INTERVAL CONFIG_DFU_TARGET_MCUBOOT_SAVE_PROGRESS_INTERVAL
+#define SAVE_TIMEOUT CONFIG_DFU_TARGET_MCUBOOT_SAVE_PROGRESS_TIMEOUT
+#else
+#define SAVE_INTERVAL 0
+#define SAVE_TIMEOUT 0
+#endif
+
+#define PROGRESS_VERSION 1
+
+/* Write progress, as stored in settings. */
+struct progress_record {
+	uint8_t version;
+	uint8_t reserved[3];
+	/* Bytes of the image that are in flash */
+	uint32_t offset;
+	/* Size of the image being written */
+	uint32_t file_size;
+	/* CRC32 of the fields above */
+	uint32_t crc;
+};
+
 static struct flash_img_context flash_img;
+static size_t image_size;
+static struct progress_record stored;
+
+/* Last checkpoint */
+static struct {
+	size_t offset;
+	int64_t time;
+} checkpoint;
 
 int dfu_ctx_mcuboot_set_b1_file(const char *file, bool s0_active,
 				const char **update)
@@ -69,22 +100,57 @@ int dfu_ctx_mcuboot_set_b1_file(const char *file, bool s0_active,
 
 #define MODULE "dfu"
 #define FILE_FLASH_IMG "mcuboot/flash_img"
+
+static uint32_t progress_crc(const struct progress_record *record)
+{
+	return crc32_ieee((const uint8_t *)record,
+			  offsetof(struct progress_record, crc));
+}
+
 /**
  * @brief Store the information stored in the flash_img instance so that it can
  *	  be restored from flash in case of a power failure, reboot etc.
+ *
+ * Unless forced, the progress is only stored once it has advanced by
+ * CONFIG_DFU_TARGET_MCUBOOT_SAVE_PROGRESS_INTERVAL bytes, or once
+ * CONFIG_DFU_TARGET_MCUBOOT_SAVE_PROGRESS_TIMEOUT has passed since the
+ * last checkpoint, to limit flash wear and latency on the write path.
  */
-static int store_flash_img_context(void)
+static int store_flash_img_context(bool force)
 {
 	if (IS_ENABLED(CONFIG_DFU_TARGET_MCUBOOT_SAVE_PROGRESS)) {
 		char key[] = MODULE "/" FILE_FLASH_IMG;
 		size_t bytes_written = flash_img_bytes_written(&flash_img);
-		int err = settings_save_one(key, &bytes_written,
-					    sizeof(bytes_written));
+		int64_t now = k_uptime_get();
+		struct progress_record record = {
+			.version = PROGRESS_VERSION,
+			.offset = bytes_written,
+			.file_size = image_size,
+		};
+		int err;
+
+		if (!force) {
+			if (bytes_written == checkpoint.offset) {
+				return 0;
+			}
+
+			if ((bytes_written - checkpoint.offset < SAVE_INTERVAL) &&
+			    (SAVE_TIMEOUT == 0 ||
+			     now - checkpoint.time < SAVE_TIMEOUT)) {
+				return 0;
+			}
+		}
 
+		record.crc = progress_crc(&record);
+
+		err = settings_save_one(key, &record, sizeof(record));
 		if (err) {
 			LOG_ERR("Problem storing offset (err %d)", err);
 			return err;
 		}
+
+		checkpoint.offset = bytes_written;
+		checkpoint.time = now;
 	}
 
 	return 0;
@@ -98,19 +164,85 @@ static int store_flash_img_context(void)
 static int settings_set(const char *key, size_t len_rd,
 			settings_read_cb read_cb, void *cb_arg)
 {
-	if (!strcmp(key, FILE_FLASH_IMG)) {
-		ssize_t len = read_cb(cb_arg, &flash_img.stream.bytes_written,
-				      sizeof(flash_img.stream.bytes_written));
+	ssize_t len;
+
+	if (strcmp(key, FILE_FLASH_IMG)) {
+		return 0;
+	}
+
+	if (len_rd == sizeof(flash_img.stream.bytes_written)) {
+		/* Offset only, as stored by earlier versions */
+		size_t offset;
 
-		if (len != sizeof(flash_img.stream.bytes_written)) {
+		len = read_cb(cb_arg, &offset, sizeof(offset));
+		if (len != sizeof(offset)) {
 			LOG_ERR("Can't read flash_img from storage");
 			return len;
 		}
+
+		stored = (struct progress_record) {
+			.version = PROGRESS_VERSION,
+			.offset = offset,
+		};
+		stored.crc = progress_crc(&stored);
+
+		return 0;
+	}
+
+	len = read_cb(cb_arg, &stored, sizeof(stored));
+	if (len != sizeof(stored)) {
+		LOG_ERR("Can't read flash_img from storage");
+		memset(&stored, 0, sizeof(stored));
+		return len;
 	}
 
 	return 0;
 }
 
+/**
+ * @brief Resume from the stored progress, if it belongs to this image.
+ */
+static int progress_restore(void)
+{
+	int err;
+	struct flash_pages_info page;
+	size_t offset = stored.offset;
+
+	if (stored.version != PROGRESS_VERSION ||
+	    stored.crc != progress_crc(&stored)) {
+		if (offset) {
+			LOG_WRN("Discarding invalid write progress record");
+		}
+		offset = 0;
+	} else if ((stored.file_size && stored.file_size != image_size) ||
+		   offset > image_size) {
+		LOG_INF("Stored write progress belongs to another image");
+		offset = 0;
+	}
+
+	if (offset) {
+		/* The page holding the offset is erased again on the first
+		 * write, so resume from its start.
+		 */
+		err = flash_get_page_info_by_offs(flash_img.stream.fdev,
+						  flash_img.stream.offset +
+						  offset, &page);
+		if (err) {
+			LOG_ERR("Unable to get page info (err %d)", err);
+			return err;
+		}
+
+		offset = page.start_offset - flash_img.stream.offset;
+		LOG_INF("Resuming image write at offset %zu", offset);
+	}
+
+	flash_img.stream.bytes_written = offset;
+	checkpoint.offset = offset;
+	checkpoint.time = k_uptime_get();
+
+	return 0;
+}
+
 bool dfu_target_mcuboot_identify(const void *const buf)
 {
 	/* MCUBoot headers starts with 4 byte magic word */
@@ -146,17 +278,26 @@ int dfu_target_mcuboot_init(size_t file_size, dfu_target_callback_t cb)
 			return err;
 		}
 
+		/* The handler is kept registered between updates */
 		err = settings_register(&sh);
-		if (err) {
+		if (err && err != -EEXIST) {
 			LOG_ERR("Cannot register settings (err %d)", err);
 			return err;
 		}
 
+		memset(&stored, 0, sizeof(stored));
+		image_size = file_size;
+
 		err = settings_load();
 		if (err) {
 			LOG_ERR("Cannot load settings (err %d)", err);
 			return err;
 		}
+
+		err = progress_restore();
+		if (err) {
+			return err;
+		}
 	}
 
 	return 0;
@@ -177,7 +318,7 @@ int dfu_target_mcuboot_write(const void *const buf, size_t len)
 		return err;
 	}
 
-	err = store_flash_img_context();
+	err = store_flash_img_context(false);
 	if (err != 0) {
 		/* Failing to store progress is not a critical error you'll just
 		 * be left to download a bit more if you fail and resume.
@@ -196,7 +337,7 @@ static void reset_flash_context(void)
 	if (err) {
 		LOG_ERR("Unable to re-initialize flash_img");
 	}
-	err = store_flash_img_context();
+	err = store_flash_img_context(true);
 	if (err != 0) {
 		LOG_ERR("Unable to reset write progress: %d", err);
 	}
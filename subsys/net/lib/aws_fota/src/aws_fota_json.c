@@ -5,25 +5,13 @@
  */
 
 #include <zephyr.h>
-#include <string.h>
-#include <cJSON.h>
+#include <limits.h>
+#include <json_path.h>
 #include <sys/util.h>
 #include <net/aws_jobs.h>
 
 #include "aws_fota_json.h"
 
-/**@brief Copy max maxlen bytes from src to dst. Insert null-terminator.
- */
-static void strncpy_nullterm(char *dst, const char *src, size_t maxlen)
-{
-	size_t len = strlen(src) + 1;
-
-	memcpy(dst, src, MIN(len, maxlen));
-	if (len > maxlen) {
-		dst[maxlen - 1] = '\0';
-	}
-}
-
 int aws_fota_parse_UpdateJobExecution_rsp(const char *update_rsp_document,
 					  size_t payload_len, char *status_buf)
 {
@@ -31,31 +19,32 @@ int aws_fota_parse_UpdateJobExecution_rsp(const char *update_rsp_document,
 		return -EINVAL;
 	}
 
+	struct json_path_query status = JSON_PATH_QUERY("status");
 	int ret;
 
-	cJSON *update_response = cJSON_Parse(update_rsp_document);
-
-	if (update_response == NULL) {
-		ret = -ENODATA;
-		goto cleanup;
+	ret = json_path_extract(update_rsp_document, payload_len, &status, 1);
+	if (ret < 0) {
+		return -ENODATA;
 	}
 
-	cJSON *status = cJSON_GetObjectItemCaseSensitive(update_response,
-							  "status");
-	if (cJSON_IsString(status) && status->valuestring != NULL) {
-		strncpy_nullterm(status_buf, status->valuestring,
-				 STATUS_MAX_LEN);
-	} else {
-		ret = -ENODATA;
-		goto cleanup;
+	ret = json_path_str_copy(&status.value, status_buf, STATUS_MAX_LEN);
+	if (ret < 0) {
+		return -ENODATA;
 	}
 
-	ret = 0;
-cleanup:
-	cJSON_Delete(update_response);
-	return ret;
+	return 0;
 }
 
+enum {
+	EXECUTION,
+	JOB_ID,
+	JOB_DOCUMENT,
+	LOCATION,
+	HOST,
+	PATH,
+	VERSION_NUMBER,
+};
+
 int aws_fota_parse_DescribeJobExecution_rsp(const char *job_document,
 					   uint32_t payload_len,
 					   char *job_id_buf,
@@ -71,74 +60,53 @@ int aws_fota_parse_DescribeJobExecution_rsp(const char *job_document,
 		return -EINVAL;
 	}
 
+	struct json_path_query q[] = {
+		[EXECUTION] = JSON_PATH_QUERY("execution"),
+		[JOB_ID] = JSON_PATH_QUERY("execution.jobId"),
+		[JOB_DOCUMENT] = JSON_PATH_QUERY("execution.jobDocument"),
+		[LOCATION] = JSON_PATH_QUERY("execution.jobDocument.location"),
+		[HOST] = JSON_PATH_QUERY("execution.jobDocument.location.host"),
+		[PATH] = JSON_PATH_QUERY("execution.jobDocument.location.path"),
+		[VERSION_NUMBER] = JSON_PATH_QUERY("execution.versionNumber"),
+	};
+	int64_t version_number;
 	int ret;
 
-	cJSON *json_data = cJSON_Parse(job_document);
-
-	if (json_data == NULL) {
-		ret = -ENODATA;
-		goto cleanup;
+	ret = json_path_extract(job_document, payload_len, q, ARRAY_SIZE(q));
+	if (ret < 0) {
+		return -ENODATA;
 	}
 
-	cJSON *execution = cJSON_GetObjectItemCaseSensitive(json_data,
-							    "execution");
-	if (execution == NULL) {
-		ret = 0;
-		goto cleanup;
+	if (!json_path_found(&q[EXECUTION])) {
+		return 0;
 	}
 
-	cJSON *job_id = cJSON_GetObjectItemCaseSensitive(execution, "jobId");
-
-	if (cJSON_GetStringValue(job_id) != NULL) {
-		strncpy_nullterm(job_id_buf, job_id->valuestring,
-				AWS_JOBS_JOB_ID_MAX_LEN);
-	} else {
-		ret = -ENODATA;
-		goto cleanup;
+	if (json_path_str_copy(&q[JOB_ID].value, job_id_buf,
+			       AWS_JOBS_JOB_ID_MAX_LEN) < 0) {
+		return -ENODATA;
 	}
 
-	cJSON *job_data = cJSON_GetObjectItemCaseSensitive(execution,
-							   "jobDocument");
-
-	if (!cJSON_IsObject(job_data)) {
-		ret = -ENODATA;
-		goto cleanup;
+	if (q[JOB_DOCUMENT].value.type != JSON_PATH_OBJECT ||
+	    q[LOCATION].value.type != JSON_PATH_OBJECT) {
+		return -ENODATA;
 	}
 
-	cJSON *location = cJSON_GetObjectItemCaseSensitive(job_data,
-							    "location");
-
-	if (!cJSON_IsObject(location)) {
-		ret = -ENODATA;
-		goto cleanup;
+	if (q[HOST].value.type != JSON_PATH_STRING ||
+	    q[PATH].value.type != JSON_PATH_STRING) {
+		return -ENODATA;
 	}
 
-	cJSON *hostname = cJSON_GetObjectItemCaseSensitive(location, "host");
-	cJSON *path = cJSON_GetObjectItemCaseSensitive(location, "path");
-
-	if ((cJSON_GetStringValue(hostname) != NULL)
-	   && (cJSON_GetStringValue(path) != NULL)) {
-		strncpy_nullterm(hostname_buf, hostname->valuestring,
-				CONFIG_AWS_FOTA_HOSTNAME_MAX_LEN);
-		strncpy_nullterm(file_path_buf, path->valuestring,
-				CONFIG_AWS_FOTA_FILE_PATH_MAX_LEN);
-	} else {
-		ret = -ENODATA;
-		goto cleanup;
-	}
-
-	cJSON *version_number = cJSON_GetObjectItemCaseSensitive(
-					execution, "versionNumber");
+	(void)json_path_str_copy(&q[HOST].value, hostname_buf,
+				 CONFIG_AWS_FOTA_HOSTNAME_MAX_LEN);
+	(void)json_path_str_copy(&q[PATH].value, file_path_buf,
+				 CONFIG_AWS_FOTA_FILE_PATH_MAX_LEN);
 
-	if (cJSON_IsNumber(version_number)) {
-		*execution_version_number = version_number->valueint;
-	} else {
-		ret = -ENODATA;
-		goto cleanup;
+	if (json_path_int(&q[VERSION_NUMBER].value, &version_number) ||
+	    version_number > INT_MAX || version_number < INT_MIN) {
+		return -ENODATA;
 	}
 
-	ret = 1;
-cleanup:
-	cJSON_Delete(json_data);
-	return ret;
+	*execution_version_number = version_number;
+
+	return 1;
 }
@@ -6,6 +6,7 @@
 
 #include <net/aws_iot.h>
 #include <net/mqtt.h>
+#include <net/mqtt_topic_trie.h>
 #include <net/socket.h>
 #include <net/cloud.h>
 #include <stdio.h>
@@ -101,6 +102,11 @@ static char delete_accepted_topic[DELETE_ACCEPTED_TOPIC_LEN + 1];
 static char delete_rejected_topic[DELETE_REJECTED_TOPIC_LEN + 1];
 #endif
 
+/* Gives the type of received shadow topics. The subscribed topics share
+ * four levels, and have two more levels each.
+ */
+MQTT_TOPIC_TRIE_DEFINE(shadow_topic_trie, 16);
+
 #if defined(CONFIG_CLOUD_API)
 static struct cloud_backend *aws_iot_backend;
 #endif
@@ -348,6 +354,55 @@ static void aws_fota_cb_handler(struct aws_fota_event *fota_evt)
 }
 #endif
 
+/* Adds the subscribed shadow topics to the trie, after they have been
+ * populated.
+ */
+static int shadow_topic_trie_populate(void)
+{
+	int err;
+	const struct {
+		const char *topic;
+		enum aws_iot_topic_type type;
+	} shadow_topics[] = {
+#if defined(CONFIG_AWS_IOT_TOPIC_GET_ACCEPTED_SUBSCRIBE)
+		{ get_accepted_topic, AWS_IOT_SHADOW_TOPIC_GET_ACCEPTED },
+#endif
+#if defined(CONFIG_AWS_IOT_TOPIC_GET_REJECTED_SUBSCRIBE)
+		{ get_rejected_topic, AWS_IOT_SHADOW_TOPIC_GET_REJECTED },
+#endif
+#if defined(CONFIG_AWS_IOT_TOPIC_UPDATE_ACCEPTED_SUBSCRIBE)
+		{ update_accepted_topic, AWS_IOT_SHADOW_TOPIC_UPDATE_ACCEPTED },
+#endif
+#if defined(CONFIG_AWS_IOT_TOPIC_UPDATE_REJECTED_SUBSCRIBE)
+		{ update_rejected_topic, AWS_IOT_SHADOW_TOPIC_UPDATE_REJECTED },
+#endif
+#if defined(CONFIG_AWS_IOT_TOPIC_UPDATE_DELTA_SUBSCRIBE)
+		{ update_delta_topic, AWS_IOT_SHADOW_TOPIC_UPDATE_DELTA },
+#endif
+#if defined(CONFIG_AWS_IOT_TOPIC_DELETE_ACCEPTED_SUBSCRIBE)
+		{ delete_accepted_topic, AWS_IOT_SHADOW_TOPIC_DELETE_ACCEPTED },
+#endif
+#if defined(CONFIG_AWS_IOT_TOPIC_DELETE_REJECTED_SUBSCRIBE)
+		{ delete_rejected_topic, AWS_IOT_SHADOW_TOPIC_DELETE_REJECTED },
+#endif
+	};
+
+	mqtt_topic_trie_clear(&shadow_topic_trie);
+
+	for (size_t i = 0; i < ARRAY_SIZE(shadow_topics); i++) {
+		err = mqtt_topic_trie_add(&shadow_topic_trie,
+					  shadow_topics[i].topic,
+					  strlen(shadow_topics[i].topic),
+					  shadow_topics[i].type);
+		if (err) {
+			LOG_ERR("Failed to add shadow topic, error: %d", err);
+			return err;
+		}
+	}
+
+	return 0;
+}
+
 static int aws_iot_topics_populate(char *const id, size_t id_len)
 {
 	int err;
@@ -437,7 +492,7 @@ static int aws_iot_topics_populate(char *const id, size_t id_len)
 		return -ENOMEM;
 	}
 #endif
-	return 0;
+	return shadow_topic_trie_populate();
 }
 
 /* Returns the number of topics subscribed to (0 or greater),
@@ -741,6 +796,7 @@ static void mqtt_evt_handler(struct mqtt_client *const c,
 		break;
 	case MQTT_EVT_PUBLISH: {
 		const struct mqtt_publish_param *p = &mqtt_evt->param.publish;
+		int type;
 
 		LOG_DBG("MQTT_EVT_PUBLISH: id = %d len = %d ",
 			p->message_id,
@@ -763,7 +819,11 @@ static void mqtt_evt_handler(struct mqtt_client *const c,
 		aws_iot_evt.type = AWS_IOT_EVT_DATA_RECEIVED;
 		aws_iot_evt.data.msg.ptr = payload_buf;
 		aws_iot_evt.data.msg.len = p->message.payload.len;
-		aws_iot_evt.data.msg.topic.type = AWS_IOT_SHADOW_TOPIC_UNKNOWN;
+		type = mqtt_topic_trie_match(&shadow_topic_trie,
+					     p->message.topic.topic.utf8,
+					     p->message.topic.topic.size);
+		aws_iot_evt.data.msg.topic.type =
+			type < 0 ? AWS_IOT_SHADOW_TOPIC_UNKNOWN : type;
 		aws_iot_evt.data.msg.topic.str = p->message.topic.topic.utf8;
 		aws_iot_evt.data.msg.topic.len = p->message.topic.topic.size;
 
@@ -1326,6 +1386,8 @@ static int api_init(const struct cloud_backend *const backend,
 		    cloud_evt_handler_t handler)
 {
 	backend->config->handler = handler;
+	backend->config->encoding = IS_ENABLED(CONFIG_AWS_IOT_ENCODING_CBOR) ?
+				    CLOUD_ENCODING_CBOR : CLOUD_ENCODING_JSON;
 	aws_iot_backend = (struct cloud_backend *)backend;
 
 	struct aws_iot_config config = {
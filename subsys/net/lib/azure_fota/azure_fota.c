@@ -11,11 +11,11 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <net/fota_download.h>
 #include <net/azure_iot_hub.h>
 #include <net/azure_fota.h>
-#include <cJSON.h>
-#include <cJSON_os.h>
+#include <json_path.h>
 
 #include "azure_iot_hub_dps.h"
 
@@ -175,14 +175,40 @@ static void fota_dl_handler(const struct fota_download_evt *fota_evt)
 	}
 }
 
+/* Paths of the values used from a device twin message */
+enum twin_value {
+	REPORTED,
+	REPORTED_FW,
+	REPORTED_STATUS,
+	REPORTED_CURRENT,
+	REPORTED_PENDING,
+	DESIRED,
+
+	TWIN_VALUE_COUNT,
+};
+
+/* Paths within the desired firmware object */
+enum fw_value {
+	FW,
+	FW_VERSION,
+	FW_LOCATION,
+	FW_HOST,
+	FW_PATH,
+	FW_FRAGMENT_SIZE,
+
+	FW_VALUE_COUNT,
+};
+
 /* Checks the 'reported' object for current FOTA state
  * Returns true if the fota_state has been updated and should be reported to
  * the device twin. If no action is needed, false is returned.
  */
-static bool parse_reported_status(const char *msg)
+static bool parse_reported_status(const struct json_path_query *twin)
 {
-	struct cJSON *root_obj, *reported_obj, *fw_obj, *fw_status_obj,
-		*fw_current_obj, *fw_pending_obj;
+	const struct json_path_value *fw_status = &twin[REPORTED_STATUS].value;
+	const struct json_path_value *fw_current = &twin[REPORTED_CURRENT].value;
+	const struct json_path_value *fw_pending = &twin[REPORTED_PENDING].value;
+	char version[CONFIG_AZURE_FOTA_VERSION_MAX_LEN];
 	bool report_needed = false;
 
 	/* The 'reported' object has the excpected structure if it exists:
@@ -193,70 +219,49 @@ static bool parse_reported_status(const char *msg)
 	 *	}
 	 */
 
-	root_obj = cJSON_Parse(msg);
-	if (root_obj == NULL) {
-		LOG_ERR("Could not parse message");
-		return report_needed;
-	}
-
 	/* Reported object */
-	reported_obj = cJSON_GetObjectItemCaseSensitive(root_obj, "reported");
-	if (reported_obj == NULL) {
+	if (!json_path_found(&twin[REPORTED])) {
 		LOG_DBG("No 'reported' object found");
-		goto clean_exit;
+		return false;
 	}
 
 	/* Firmware object */
-	fw_obj = cJSON_GetObjectItemCaseSensitive(reported_obj, "firmware");
-	if (fw_obj == NULL) {
+	if (!json_path_found(&twin[REPORTED_FW])) {
 		LOG_DBG("No 'firmware' object found");
-
-		report_needed = true;
-
-		goto clean_exit;
+		return true;
 	}
 
 	/* Firmware update status object (fwUpdateStatus) */
-	fw_status_obj = cJSON_GetObjectItemCaseSensitive(fw_obj,
-							 "fwUpdateStatus");
-	if (fw_status_obj == NULL) {
+	if (fw_status->type != JSON_PATH_STRING) {
 		LOG_DBG("No fwUpdateStatus object found");
-		goto clean_exit;
+		return false;
 	}
 
-	LOG_DBG("Currently reported 'fwUpdateStatus' in device twin: %s",
-		log_strdup(fw_status_obj->valuestring));
-
 	/* Current firmware object (currentFwVersion) */
-	fw_current_obj = cJSON_GetObjectItemCaseSensitive(fw_obj,
-							 "currentFwVersion");
-	if (fw_current_obj == NULL) {
+	if (fw_current->type != JSON_PATH_STRING) {
 		LOG_DBG("No currentFwVersion object found");
-		goto clean_exit;
+		return false;
 	}
 
+	(void)json_path_str_copy(fw_current, version, sizeof(version));
 	LOG_DBG("Currently reported 'currentFwVersion' in device twin: %s",
-		log_strdup(fw_current_obj->valuestring));
+		log_strdup(version));
 
 	/* Pending firmware object (pendingFwVersion) */
-	fw_pending_obj = cJSON_GetObjectItemCaseSensitive(fw_obj,
-							 "pendingFwVersion");
-	if (fw_pending_obj == NULL) {
+	if (fw_pending->type != JSON_PATH_STRING) {
 		LOG_DBG("No pendingFwVersion object found");
-		goto clean_exit;
+		return false;
 	}
 
+	(void)json_path_str_copy(fw_pending, version, sizeof(version));
 	LOG_DBG("Currently reported 'pendingFwVersion' in device twin: %s",
-		strlen(fw_pending_obj->valuestring) > 0 ?
-		       log_strdup(fw_pending_obj->valuestring) :
-		       "(none)");
+		strlen(version) > 0 ? log_strdup(version) : "(none)");
 
 	/* "current" status indicates no FOTA was in progress, check if the
 	 * reported version matches the actual version of running firmware.
 	 */
-	if (strcmp("current", fw_status_obj->valuestring) == 0) {
-		if (strcmp(get_current_version(),
-			   fw_current_obj->valuestring) == 0) {
+	if (json_path_str_eq(fw_status, "current")) {
+		if (json_path_str_eq(fw_current, get_current_version())) {
 			LOG_DBG("Currently reported version is correct");
 			fota_state = STATUS_CURRENT;
 			report_needed = false;
@@ -266,19 +271,18 @@ static bool parse_reported_status(const char *msg)
 			fota_state = STATUS_CURRENT;
 			report_needed = true;
 		}
-	} else if (strcmp("applying", fw_status_obj->valuestring) == 0) {
+	} else if (json_path_str_eq(fw_status, "applying")) {
 		report_needed = true;
 
 		/* "applying" indicates firmware was downloaded and would be
 		 * used after reboot. Check if running version matches the
 		 * pending version.
 		 */
-		if (strcmp(get_current_version(),
-			   fw_pending_obj->valuestring) == 0) {
+		if (json_path_str_eq(fw_pending, get_current_version())) {
 			LOG_DBG("FOTA firmware was successfully applied");
 			fota_state = STATUS_CURRENT;
-		} else if (strcmp(get_current_version(),
-				  fw_current_obj->valuestring) == 0) {
+		} else if (json_path_str_eq(fw_current,
+					    get_current_version())) {
 			LOG_WRN("FOTA image was not applied, rolled back");
 			fota_state = STATUS_ROLLEDBACK;
 		} else {
@@ -296,24 +300,30 @@ static bool parse_reported_status(const char *msg)
 		report_needed = true;
 	}
 
-clean_exit:
-	cJSON_Delete(root_obj);
-
 	return report_needed;
 }
 
-/* @brief Extracts firmware image information from device twin JSON document.
+/* @brief Extracts firmware image information from the desired properties
+ *	  of the device twin.
  *
  * @retval 0 if successfully parsed, hostname and file_path populated.
  * @retval -ENOMSG Could not parse incoming buffer as JSON.
  * @retval -ENOMEM Could not find object, or insufficient memory to allocate it.
  */
-static int extract_fw_details(const char *msg)
+static int extract_fw_details(const char *json, size_t len)
 {
-	int err = -ENOMEM;
-	struct cJSON *root_obj, *desired_obj, *fw_obj, *fw_version_obj,
-		*fw_location_obj, *fw_hostname_obj, *fw_path_obj,
-		*fw_fragment_obj;
+	struct json_path_query fw[] = {
+		[FW] = JSON_PATH_QUERY("firmware"),
+		[FW_VERSION] = JSON_PATH_QUERY("firmware.fwVersion"),
+		[FW_LOCATION] = JSON_PATH_QUERY("firmware.fwLocation"),
+		[FW_HOST] = JSON_PATH_QUERY("firmware.fwLocation.host"),
+		[FW_PATH] = JSON_PATH_QUERY("firmware.fwLocation.path"),
+		[FW_FRAGMENT_SIZE] = JSON_PATH_QUERY("firmware.fwFragmentSize"),
+	};
+	int64_t value;
+	int ret;
+
+	BUILD_ASSERT(ARRAY_SIZE(fw) == FW_VALUE_COUNT);
 
 	/* The properties.desired.firmware object has the excpected structure:
 	 *	properties.desired.firmware : {
@@ -326,125 +336,87 @@ static int extract_fw_details(const char *msg)
 	 *	}
 	 */
 
-	root_obj = cJSON_Parse(msg);
-	if (root_obj == NULL) {
+	ret = json_path_extract(json, len, fw, ARRAY_SIZE(fw));
+	if (ret < 0) {
 		LOG_ERR("Could not parse message as JSON");
 		return -ENOMSG;
 	}
 
-	/* Desired object */
-	desired_obj = cJSON_GetObjectItemCaseSensitive(root_obj, "desired");
-	if (desired_obj == NULL) {
-		/* The received object can be the 'desired' object only, or
-		 * the whole device twin properties object. If there is no
-		 * 'desired' object to be found, assume it's the root object.
-		 */
-		LOG_DBG("No 'desired' object found, assuming it's root object");
-		desired_obj = root_obj;
-	}
-
 	/* Firmware update information object */
-	fw_obj = cJSON_GetObjectItemCaseSensitive(desired_obj, "firmware");
-	if (fw_obj == NULL) {
+	if (!json_path_found(&fw[FW])) {
 		LOG_DBG("No 'firmware' object found");
-		err = -ENOMSG;
-		goto clean_exit;
+		return -ENOMSG;
 	}
 
 	/* Firmware version */
-	fw_version_obj = cJSON_GetObjectItemCaseSensitive(fw_obj, "fwVersion");
-	if (fw_version_obj == NULL) {
-		LOG_DBG("No fwVersion object found");
-		goto clean_exit;
-	}
-
-	if (cJSON_IsString(fw_version_obj)) {
-		if (strlen(fw_version_obj->valuestring) >=
-		    sizeof(fota_object.version)) {
+	if (fw[FW_VERSION].value.type == JSON_PATH_STRING) {
+		ret = json_path_str_copy(&fw[FW_VERSION].value,
+					 fota_object.version,
+					 sizeof(fota_object.version));
+		if (ret >= sizeof(fota_object.version)) {
 			LOG_ERR("Version string longer than buffer");
-			err = -ENOMEM;
-			goto clean_exit;
+			return -ENOMEM;
 		}
 
-		memcpy(fota_object.version, fw_version_obj->valuestring,
-		       sizeof(fota_object.version));
-
 		LOG_DBG("Incoming firmware version: %s",
 			log_strdup(fota_object.version));
-	} else if (cJSON_IsNumber(fw_version_obj)) {
-		ssize_t len = snprintk(fota_object.version,
-				       sizeof(fota_object.version),
-				       "%d", fw_version_obj->valueint);
-
-		if ((len < 0) || (len >= sizeof(fota_object.version))) {
+	} else if (json_path_int(&fw[FW_VERSION].value, &value) == 0 &&
+		   value >= INT_MIN && value <= INT_MAX) {
+		ret = snprintk(fota_object.version,
+			       sizeof(fota_object.version), "%d", (int)value);
+		if ((ret < 0) || (ret >= sizeof(fota_object.version))) {
 			LOG_ERR("Version number too long for buffer");
-			err = -ENOMEM;
+			return -ENOMEM;
 		}
 	} else {
 		LOG_DBG("Invalid fwVersion format received");
-		goto clean_exit;
+		return -ENOMEM;
 	}
 
 	/* Firmware image location */
-	fw_location_obj = cJSON_GetObjectItemCaseSensitive(fw_obj,
-							   "fwLocation");
-	if (fw_location_obj == NULL) {
+	if (fw[FW_LOCATION].value.type != JSON_PATH_OBJECT) {
 		LOG_DBG("No fwLocation object found");
-		goto clean_exit;
+		return -ENOMEM;
 	}
 
 	/* Firmware image hostname */
-	fw_hostname_obj = cJSON_GetObjectItemCaseSensitive(fw_location_obj,
-							   "host");
-	if (fw_hostname_obj == NULL) {
+	if (fw[FW_HOST].value.type != JSON_PATH_STRING) {
 		LOG_DBG("No hostname object found");
-		goto clean_exit;
+		return -ENOMEM;
 	}
 
-	if (strlen(fw_hostname_obj->valuestring) >=
-	    sizeof(fota_object.host)) {
+	ret = json_path_str_copy(&fw[FW_HOST].value, fota_object.host,
+				 sizeof(fota_object.host));
+	if (ret >= sizeof(fota_object.host)) {
 		LOG_ERR("Received hostname larger (%d) than buffer (%d)",
-			strlen(fw_hostname_obj->valuestring),
-			sizeof(fota_object.host));
-		goto clean_exit;
+			ret, sizeof(fota_object.host));
+		return -ENOMEM;
 	}
 
-	strncpy(fota_object.host, fw_hostname_obj->valuestring,
-		sizeof(fota_object.host));
-
 	/* Firmware image file path */
-	fw_path_obj = cJSON_GetObjectItemCaseSensitive(fw_location_obj, "path");
-	if (fw_path_obj == NULL) {
+	if (fw[FW_PATH].value.type != JSON_PATH_STRING) {
 		LOG_DBG("No path object found");
-		goto clean_exit;
+		return -ENOMEM;
 	}
 
-	if (strlen(fw_path_obj->valuestring) >= sizeof(fota_object.path)) {
+	ret = json_path_str_copy(&fw[FW_PATH].value, fota_object.path,
+				 sizeof(fota_object.path));
+	if (ret >= sizeof(fota_object.path)) {
 		LOG_ERR("Received file path larger (%d) than buffer (%d)",
-			strlen(fw_path_obj->valuestring),
-			sizeof(fota_object.path));
-		goto clean_exit;
+			ret, sizeof(fota_object.path));
+		return -ENOMEM;
 	}
 
-	strncpy(fota_object.path, fw_path_obj->valuestring,
-		sizeof(fota_object.path));
-
 	/* Firmware fragment size */
-	fw_fragment_obj = cJSON_GetObjectItemCaseSensitive(fw_obj,
-							"fwFragmentSize");
-	if (fw_fragment_obj == NULL) {
+	if (json_path_int(&fw[FW_FRAGMENT_SIZE].value, &value) ||
+	    value < 0 || value > INT_MAX) {
 		LOG_DBG("Failed to parse 'fwFragmentSize' object");
-		goto clean_exit;
+		return -ENOMEM;
 	}
 
-	fota_object.fragment_size = fw_fragment_obj->valueint;
+	fota_object.fragment_size = value;
 
-	err = 0;
-
-clean_exit:
-	cJSON_Delete(root_obj);
-
-	return err;
+	return 0;
 }
 
 /* Public functions */
@@ -464,8 +436,6 @@ int azure_fota_init(azure_fota_callback_t evt_handler)
 		return err;
 	}
 
-	cJSON_Init();
-
 	fota_state = STATUS_CURRENT;
 
 	LOG_INF("Current firmware version: %s",
@@ -480,6 +450,21 @@ int azure_fota_msg_process(const char *const buf, size_t size)
 	struct azure_fota_event evt = {
 		.type = AZURE_FOTA_EVT_START
 	};
+	struct json_path_query twin[] = {
+		[REPORTED] = JSON_PATH_QUERY("reported"),
+		[REPORTED_FW] = JSON_PATH_QUERY("reported.firmware"),
+		[REPORTED_STATUS] =
+			JSON_PATH_QUERY("reported.firmware.fwUpdateStatus"),
+		[REPORTED_CURRENT] =
+			JSON_PATH_QUERY("reported.firmware.currentFwVersion"),
+		[REPORTED_PENDING] =
+			JSON_PATH_QUERY("reported.firmware.pendingFwVersion"),
+		[DESIRED] = JSON_PATH_QUERY("desired"),
+	};
+	const char *desired = buf;
+	size_t desired_len = size;
+
+	BUILD_ASSERT(ARRAY_SIZE(twin) == TWIN_VALUE_COUNT);
 
 	/* Ensure that FOTA download is not started multiple times, which
 	 * would corrupt the downloaded image.
@@ -489,8 +474,14 @@ int azure_fota_msg_process(const char *const buf, size_t size)
 		return 0;
 	}
 
+	err = json_path_extract(buf, size, twin, ARRAY_SIZE(twin));
+	if (err < 0) {
+		LOG_ERR("Could not parse message");
+		return 0;
+	}
+
 	/* Check last reported FOTA status */
-	if (parse_reported_status(buf)) {
+	if (parse_reported_status(twin)) {
 		evt.type = AZURE_FOTA_EVT_REPORT;
 
 		callback_with_report(&evt);
@@ -498,7 +489,18 @@ int azure_fota_msg_process(const char *const buf, size_t size)
 		evt.type = AZURE_FOTA_EVT_START;
 	}
 
-	err = extract_fw_details(buf);
+	/* The received object can be the 'desired' object only, or the whole
+	 * device twin properties object. If there is no 'desired' object to
+	 * be found, assume it's the root object.
+	 */
+	if (twin[DESIRED].value.type == JSON_PATH_OBJECT) {
+		desired = twin[DESIRED].value.ptr;
+		desired_len = twin[DESIRED].value.len;
+	} else {
+		LOG_DBG("No 'desired' object found, assuming it's root object");
+	}
+
+	err = extract_fw_details(desired, desired_len);
 	if (err == -ENOMSG) {
 		LOG_DBG("No 'firmware' object found, ignoring message");
 		return 0;
@@ -117,6 +117,9 @@ static int api_init(const struct cloud_backend *const backend,
 
 	azure_iot_hub_backend = (struct cloud_backend *)backend;
 	azure_iot_hub_backend->config->handler = handler;
+	azure_iot_hub_backend->config->encoding =
+		IS_ENABLED(CONFIG_AZURE_IOT_HUB_ENCODING_CBOR) ?
+		CLOUD_ENCODING_CBOR : CLOUD_ENCODING_JSON;
 
 	return azure_iot_hub_init(&config, api_event_handler);
 }
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <net/mqtt_topic_trie.h>
 
 #include "azure_iot_hub_topic.h"
 
@@ -26,6 +27,20 @@ static char *topic_prefixes[] = {
 	[TOPIC_TYPE_DIRECT_METHOD] = TOPIC_PREFIX_DIRECT_METHOD,
 };
 
+/* Topic filters used to get the topic type, in the same order as the
+ * prefixes.
+ */
+static const char *const topic_filters[] = {
+	[TOPIC_TYPE_DEVICEBOUND] = "devices/+/messages/devicebound/#",
+	[TOPIC_TYPE_TWIN_UPDATE_DESIRED] = TOPIC_PREFIX_TWIN_DESIRED "#",
+	[TOPIC_TYPE_TWIN_UPDATE_RESULT] = TOPIC_PREFIX_TWIN_RES "#",
+	[TOPIC_TYPE_DPS_REG_RESULT] = TOPIC_PREFIX_DPS_REG_RESULT "#",
+	[TOPIC_TYPE_DIRECT_METHOD] = TOPIC_PREFIX_DIRECT_METHOD "#",
+};
+
+/* The filters need 20 nodes, plus the root. */
+MQTT_TOPIC_TRIE_DEFINE(topic_trie, 24);
+
 /* If the topic type is TOPIC_TYPE_DEVICEBOUND, the dynamic value in the
  * topic (the device ID), is placed in the middle of the topic, and
  * the following string needs to be skipped before reaching the property
@@ -164,20 +179,44 @@ static int get_next_prop_bag(char *buf, size_t buf_len,
 	return parsed_len;
 }
 
+/* The trie is built on first use. Topics are only parsed from the thread
+ * that receives them.
+ */
+static int topic_trie_init(void)
+{
+	int err;
+
+	for (size_t i = 0; i < ARRAY_SIZE(topic_filters); i++) {
+		err = mqtt_topic_trie_add(&topic_trie, topic_filters[i],
+					  strlen(topic_filters[i]), i);
+		if (err) {
+			LOG_ERR("Failed to add topic filter, error: %d", err);
+			mqtt_topic_trie_clear(&topic_trie);
+			return err;
+		}
+	}
+
+	return 0;
+}
+
 enum topic_type topic_type_get(const char *buf, const size_t len)
 {
+	int type;
+
 	if (buf == NULL || len == 0) {
 		return TOPIC_TYPE_EMPTY;
 	}
 
-	for (size_t i = 0; i < ARRAY_SIZE(topic_prefixes); i++) {
-		if (strncmp(topic_prefixes[i], buf,
-			    MIN(strlen(topic_prefixes[i]), len)) == 0) {
-			return i;
-		}
+	if (topic_trie.count <= 1 && topic_trie_init()) {
+		return TOPIC_TYPE_UNEXPECTED;
+	}
+
+	type = mqtt_topic_trie_match(&topic_trie, buf, len);
+	if (type < 0) {
+		return TOPIC_TYPE_UNEXPECTED;
 	}
 
-	return TOPIC_TYPE_UNEXPECTED;
+	return type;
 }
 
 int azure_iot_hub_topic_parse(struct topic_parser_data *const data)
@@ -213,8 +252,10 @@ int azure_iot_hub_topic_parse(struct topic_parser_data *const data)
 	 * out the '=' sign.
 	 */
 
-	/* Detect if the topic carries more information than just the prefix. */
-	if (start_ptr == max_ptr) {
+	/* Detect if the topic carries more information than just the prefix.
+	 * The topic filters also match the prefix without the trailing '/'.
+	 */
+	if (start_ptr >= max_ptr) {
 		return 0;
 	}
 
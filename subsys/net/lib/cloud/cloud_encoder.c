@@ -0,0 +1,416 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <math.h>
+#include <sys/byteorder.h>
+#include <net/cloud_encoder.h>
+
+/* CBOR major types, RFC 8949 section 3.1 */
+#define CBOR_UINT 0
+#define CBOR_NINT 1
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+#define CBOR_SIMPLE 7
+
+#define CBOR_FALSE 0xf4
+#define CBOR_TRUE 0xf5
+#define CBOR_NULL 0xf6
+#define CBOR_FLOAT32 0xfa
+#define CBOR_FLOAT64 0xfb
+#define CBOR_INDEFINITE 31
+#define CBOR_BREAK 0xff
+
+/* Largest magnitude below which every integer is exact in a double */
+#define DOUBLE_INT_MAX 9007199254740992.0
+
+#if defined(CONFIG_CLOUD_ENCODER_CBOR)
+
+static void cbor_put(struct cloud_encoder_cbor *c, const void *data,
+		     size_t len)
+{
+	if (c->err) {
+		return;
+	}
+
+	if (c->buf) {
+		if (len > c->size - c->len) {
+			c->err = -ENOMEM;
+			return;
+		}
+
+		memcpy(c->buf + c->len, data, len);
+	}
+
+	c->len += len;
+}
+
+/* Encodes the initial byte of a data item and its argument */
+static void cbor_head(struct cloud_encoder_cbor *c, uint8_t major,
+		      uint64_t val)
+{
+	uint8_t head[9];
+	size_t len;
+
+	if (val < 24) {
+		head[0] = (major << 5) | val;
+		len = 1;
+	} else if (val <= UINT8_MAX) {
+		head[0] = (major << 5) | 24;
+		head[1] = val;
+		len = 2;
+	} else if (val <= UINT16_MAX) {
+		head[0] = (major << 5) | 25;
+		sys_put_be16(val, &head[1]);
+		len = 3;
+	} else if (val <= UINT32_MAX) {
+		head[0] = (major << 5) | 26;
+		sys_put_be32(val, &head[1]);
+		len = 5;
+	} else {
+		head[0] = (major << 5) | 27;
+		sys_put_be64(val, &head[1]);
+		len = 9;
+	}
+
+	cbor_put(c, head, len);
+}
+
+static void cbor_text(struct cloud_encoder_cbor *c, const char *str)
+{
+	size_t len = strlen(str);
+
+	cbor_head(c, CBOR_TEXT, len);
+	cbor_put(c, str, len);
+}
+
+static void cbor_byte(struct cloud_encoder_cbor *c, uint8_t byte)
+{
+	cbor_put(c, &byte, 1);
+}
+
+/* Encodes the key of a map member */
+static void cbor_key(struct cloud_encoder_cbor *c, const char *key)
+{
+	if (c->err) {
+		return;
+	}
+
+	if (c->depth > 0 && (key != NULL) == !!(c->arrays & BIT(c->depth))) {
+		/* Member without a name, or array element with one */
+		c->err = -EINVAL;
+		return;
+	}
+
+	if (key) {
+		cbor_text(c, key);
+	}
+}
+
+/* Containers have indefinite length, so that members can be streamed */
+static void cbor_start(struct cloud_encoder_cbor *c, const char *key,
+		       bool array)
+{
+	cbor_key(c, key);
+
+	if (c->err) {
+		return;
+	}
+
+	if (c->depth + 1 >= JSON_WRITER_MAX_DEPTH) {
+		c->err = -EINVAL;
+		return;
+	}
+
+	cbor_byte(c, ((array ? CBOR_ARRAY : CBOR_MAP) << 5) | CBOR_INDEFINITE);
+
+	c->depth++;
+	WRITE_BIT(c->arrays, c->depth, array);
+}
+
+static void cbor_end(struct cloud_encoder_cbor *c, bool array)
+{
+	if (c->err) {
+		return;
+	}
+
+	if (c->depth == 0 || !!(c->arrays & BIT(c->depth)) != array) {
+		c->err = -EINVAL;
+		return;
+	}
+
+	c->depth--;
+
+	cbor_byte(c, CBOR_BREAK);
+}
+
+static void cbor_int(struct cloud_encoder_cbor *c, const char *key,
+		     int64_t value)
+{
+	cbor_key(c, key);
+
+	if (value < 0) {
+		/* Negative integers are encoded as -1 - n */
+		cbor_head(c, CBOR_NINT, ~(uint64_t)value);
+	} else {
+		cbor_head(c, CBOR_UINT, value);
+	}
+}
+
+static void cbor_double(struct cloud_encoder_cbor *c, const char *key,
+			double value)
+{
+	uint8_t num[9];
+	float single = value;
+
+	/* Shortest form that keeps the value, as JSON has only one number
+	 * type and NaN or infinities are null there.
+	 */
+	if (isnan(value) || isinf(value)) {
+		cbor_key(c, key);
+		cbor_byte(c, CBOR_NULL);
+	} else if (value == floor(value) && fabs(value) < DOUBLE_INT_MAX) {
+		cbor_int(c, key, (int64_t)value);
+	} else if ((double)single == value) {
+		uint32_t bits;
+
+		memcpy(&bits, &single, sizeof(bits));
+		num[0] = CBOR_FLOAT32;
+		sys_put_be32(bits, &num[1]);
+
+		cbor_key(c, key);
+		cbor_put(c, num, 5);
+	} else {
+		uint64_t bits;
+
+		memcpy(&bits, &value, sizeof(bits));
+		num[0] = CBOR_FLOAT64;
+		sys_put_be64(bits, &num[1]);
+
+		cbor_key(c, key);
+		cbor_put(c, num, 9);
+	}
+}
+
+static void cbor_simple(struct cloud_encoder_cbor *c, const char *key,
+			uint8_t value)
+{
+	cbor_key(c, key);
+	cbor_byte(c, value);
+}
+
+static int cbor_finish(struct cloud_encoder_cbor *c)
+{
+	if (c->err) {
+		return c->err;
+	}
+
+	if (c->depth != 0) {
+		return -EINVAL;
+	}
+
+	return c->len;
+}
+
+#define IS_CBOR(enc) ((enc)->encoding == CLOUD_ENCODING_CBOR)
+
+#else
+
+#define IS_CBOR(enc) false
+#define cbor_start(...)
+#define cbor_end(...)
+#define cbor_text(...)
+#define cbor_int(...)
+#define cbor_double(...)
+#define cbor_simple(...)
+#define cbor_key(...)
+#define cbor_finish(...) -ENOTSUP
+
+#endif /* defined(CONFIG_CLOUD_ENCODER_CBOR) */
+
+int cloud_encoder_init(struct cloud_encoder *enc, enum cloud_encoding encoding,
+		       void *buf, size_t size)
+{
+	__ASSERT_NO_MSG(enc != NULL);
+
+	enc->encoding = encoding;
+
+	switch (encoding) {
+	case CLOUD_ENCODING_JSON:
+		json_writer_init(&enc->json, buf, size);
+		return 0;
+#if defined(CONFIG_CLOUD_ENCODER_CBOR)
+	case CLOUD_ENCODING_CBOR:
+		memset(&enc->cbor, 0, sizeof(enc->cbor));
+		enc->cbor.buf = buf;
+		enc->cbor.size = size;
+		return 0;
+#endif
+	default:
+		return -ENOTSUP;
+	}
+}
+
+void cloud_encoder_obj_start(struct cloud_encoder *enc, const char *key)
+{
+	if (IS_CBOR(enc)) {
+		cbor_start(&enc->cbor, key, false);
+	} else {
+		json_writer_obj_start(&enc->json, key);
+	}
+}
+
+void cloud_encoder_obj_end(struct cloud_encoder *enc)
+{
+	if (IS_CBOR(enc)) {
+		cbor_end(&enc->cbor, false);
+	} else {
+		json_writer_obj_end(&enc->json);
+	}
+}
+
+void cloud_encoder_arr_start(struct cloud_encoder *enc, const char *key)
+{
+	if (IS_CBOR(enc)) {
+		cbor_start(&enc->cbor, key, true);
+	} else {
+		json_writer_arr_start(&enc->json, key);
+	}
+}
+
+void cloud_encoder_arr_end(struct cloud_encoder *enc)
+{
+	if (IS_CBOR(enc)) {
+		cbor_end(&enc->cbor, true);
+	} else {
+		json_writer_arr_end(&enc->json);
+	}
+}
+
+void cloud_encoder_str(struct cloud_encoder *enc, const char *key,
+		       const char *value)
+{
+	if (IS_CBOR(enc)) {
+		if (value == NULL) {
+			cbor_simple(&enc->cbor, key, CBOR_NULL);
+		} else {
+			cbor_key(&enc->cbor, key);
+			cbor_text(&enc->cbor, value);
+		}
+	} else {
+		json_writer_str(&enc->json, key, value);
+	}
+}
+
+void cloud_encoder_int(struct cloud_encoder *enc, const char *key,
+		       int64_t value)
+{
+	if (IS_CBOR(enc)) {
+		cbor_int(&enc->cbor, key, value);
+	} else {
+		json_writer_int(&enc->json, key, value);
+	}
+}
+
+void cloud_encoder_double(struct cloud_encoder *enc, const char *key,
+			  double value)
+{
+	if (IS_CBOR(enc)) {
+		cbor_double(&enc->cbor, key, value);
+	} else {
+		json_writer_double(&enc->json, key, value);
+	}
+}
+
+void cloud_encoder_bool(struct cloud_encoder *enc, const char *key,
+			bool value)
+{
+	if (IS_CBOR(enc)) {
+		cbor_simple(&enc->cbor, key, value ? CBOR_TRUE : CBOR_FALSE);
+	} else {
+		json_writer_bool(&enc->json, key, value);
+	}
+}
+
+void cloud_encoder_null(struct cloud_encoder *enc, const char *key)
+{
+	if (IS_CBOR(enc)) {
+		cbor_simple(&enc->cbor, key, CBOR_NULL);
+	} else {
+		json_writer_null(&enc->json, key);
+	}
+}
+
+int cloud_encoder_finish(struct cloud_encoder *enc)
+{
+	if (IS_CBOR(enc)) {
+		return cbor_finish(&enc->cbor);
+	}
+
+	return json_writer_finish(&enc->json);
+}
+
+int cloud_encoder_encode_alloc(enum cloud_encoding encoding,
+			       cloud_encoder_encode_t encode, void *ctx,
+			       char **out, size_t *len)
+{
+	int err;
+	int size;
+	char *buf;
+	struct cloud_encoder enc;
+
+	__ASSERT_NO_MSG(encode != NULL);
+	__ASSERT_NO_MSG(out != NULL);
+
+	err = cloud_encoder_init(&enc, encoding, NULL, 0);
+	if (err) {
+		return err;
+	}
+
+	err = encode(&enc, ctx);
+	if (err) {
+		return err;
+	}
+
+	size = cloud_encoder_finish(&enc);
+	if (size < 0) {
+		return size;
+	}
+
+	/* Room for the NUL character of JSON text */
+	buf = k_malloc(size + 1);
+	if (buf == NULL) {
+		return -ENOMEM;
+	}
+
+	(void)cloud_encoder_init(&enc, encoding, buf, size + 1);
+
+	err = encode(&enc, ctx);
+	if (!err) {
+		err = cloud_encoder_finish(&enc);
+	}
+
+	if (err >= 0 && err != size) {
+		/* The encoder produced something else the second time */
+		err = -EIO;
+	} else if (err > 0) {
+		err = 0;
+	}
+
+	if (err) {
+		k_free(buf);
+		return err;
+	}
+
+	*out = buf;
+	if (len) {
+		*len = size;
+	}
+
+	return 0;
+}
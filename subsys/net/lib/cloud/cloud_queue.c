@@ -0,0 +1,576 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <fs/fcb.h>
+#include <storage/flash_map.h>
+#include <net/cloud_queue.h>
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(cloud_queue, CONFIG_CLOUD_QUEUE_LOG_LEVEL);
+
+/* The flash area is erased when it does not hold a valid queue, so it can
+ * not be shared with other users.
+ */
+#if USE_PARTITION_MANAGER
+#include <pm_config.h>
+#define QUEUE_AREA_ID PM_CLOUD_QUEUE_ID
+#elif FLASH_AREA_LABEL_EXISTS(cloud_queue)
+#define QUEUE_AREA_ID FLASH_AREA_ID(cloud_queue)
+#else
+#error "The cloud queue needs a flash partition labeled cloud_queue"
+#endif
+
+#define QUEUE_MAGIC 0x51554555
+#define QUEUE_VERSION 1
+#define QUEUE_SECTORS_MAX 32
+
+/* Message, followed by its payload */
+#define RECORD_MSG 0
+/* Marks every message up to the sequence number as sent */
+#define RECORD_ACK 1
+
+/* Batches need an opening and a closing byte around the messages */
+#define BATCH_OVERHEAD 2
+
+struct record_hdr {
+	uint32_t seq;
+	uint16_t endpoint;
+	uint8_t qos;
+	uint8_t type;
+} __packed;
+
+/* Messages read from flash, and combined into a publish */
+struct batch {
+	size_t len;
+	size_t count;
+	uint32_t last_seq;
+	/* Sequence number of the last message sent */
+	uint32_t sent;
+	uint16_t endpoint;
+	uint8_t qos;
+	bool array;
+};
+
+static struct {
+	const struct cloud_backend *backend;
+	struct fcb fcb;
+	/* Sequence number of the last stored message */
+	uint32_t seq;
+	/* Sequence number of the last sent message */
+	uint32_t acked;
+	bool link_up;
+	struct cloud_queue_stats stats;
+} q;
+
+static struct flash_sector sectors[QUEUE_SECTORS_MAX];
+static uint8_t batch_buf[CONFIG_CLOUD_QUEUE_BATCH_SIZE];
+
+static K_MUTEX_DEFINE(queue_lock);
+
+static void flush_work_fn(struct k_work *work);
+static K_WORK_DEFINE(flush_work, flush_work_fn);
+
+static int hdr_read(const struct fcb_entry *loc, struct record_hdr *hdr)
+{
+	if (loc->fe_data_len < sizeof(*hdr)) {
+		return -EBADMSG;
+	}
+
+	return flash_area_read(q.fcb.fap, FCB_ENTRY_FA_DATA_OFF((*loc)), hdr,
+			       sizeof(*hdr));
+}
+
+static bool is_pending(const struct record_hdr *hdr)
+{
+	return hdr->type == RECORD_MSG && hdr->seq > q.acked;
+}
+
+/* Writes a record in chunks of the flash write block size */
+static int record_write(const struct fcb_entry *loc,
+			const struct record_hdr *hdr, const void *data,
+			size_t len)
+{
+	off_t off = FCB_ENTRY_FA_DATA_OFF((*loc));
+	uint8_t align = q.fcb.f_align;
+	uint8_t tail[sizeof(*hdr)];
+	size_t bulk = ROUND_DOWN(len, align);
+	int err;
+
+	err = flash_area_write(q.fcb.fap, off, hdr, sizeof(*hdr));
+	if (err) {
+		return err;
+	}
+
+	off += sizeof(*hdr);
+
+	if (bulk) {
+		err = flash_area_write(q.fcb.fap, off, data, bulk);
+		if (err) {
+			return err;
+		}
+
+		off += bulk;
+	}
+
+	if (len > bulk) {
+		memset(tail, q.fcb.f_erase_value, align);
+		memcpy(tail, (const uint8_t *)data + bulk, len - bulk);
+
+		err = flash_area_write(q.fcb.fap, off, tail, align);
+	}
+
+	return err;
+}
+
+static int sector_pending_cb(struct fcb_entry_ctx *loc_ctx, void *arg)
+{
+	struct record_hdr hdr;
+	uint32_t *pending = arg;
+
+	if (hdr_read(&loc_ctx->loc, &hdr) == 0 && is_pending(&hdr)) {
+		(*pending)++;
+	}
+
+	return 0;
+}
+
+static uint32_t sector_pending(struct flash_sector *sector)
+{
+	uint32_t pending = 0;
+
+	(void)fcb_walk(&q.fcb, sector, sector_pending_cb, &pending);
+
+	return pending;
+}
+
+/* Erases the oldest sectors while every message in them has been sent */
+static void queue_trim(void)
+{
+	while (q.fcb.f_oldest != q.fcb.f_active.fe_sector &&
+	       sector_pending(q.fcb.f_oldest) == 0) {
+		if (fcb_rotate(&q.fcb)) {
+			break;
+		}
+	}
+}
+
+static int record_append(const struct record_hdr *hdr, const void *data,
+			 size_t len)
+{
+	struct fcb_entry loc;
+	uint32_t dropped;
+	int err;
+
+	err = fcb_append(&q.fcb, sizeof(*hdr) + len, &loc);
+	if (err == -ENOSPC) {
+		queue_trim();
+		err = fcb_append(&q.fcb, sizeof(*hdr) + len, &loc);
+	}
+
+	/* Make room by dropping the oldest messages, one sector at a time */
+	for (int i = 0; err == -ENOSPC && i < q.fcb.f_sector_cnt; i++) {
+		dropped = sector_pending(q.fcb.f_oldest);
+
+		err = fcb_rotate(&q.fcb);
+		if (err) {
+			break;
+		}
+
+		if (dropped) {
+			LOG_WRN("Queue full, %d oldest messages dropped",
+				dropped);
+			q.stats.pending -= dropped;
+			q.stats.dropped += dropped;
+		}
+
+		err = fcb_append(&q.fcb, sizeof(*hdr) + len, &loc);
+	}
+
+	if (err) {
+		LOG_ERR("Could not allocate record, error: %d", err);
+		return err;
+	}
+
+	err = record_write(&loc, hdr, data, len);
+	if (err) {
+		LOG_ERR("Could not write record, error: %d", err);
+		return err;
+	}
+
+	return fcb_append_finish(&q.fcb, &loc);
+}
+
+static int msg_store(const struct cloud_msg *msg)
+{
+	struct record_hdr hdr = {
+		.seq = q.seq + 1,
+		.endpoint = msg->endpoint.type,
+		.qos = msg->qos,
+		.type = RECORD_MSG,
+	};
+	int err;
+
+	err = record_append(&hdr, msg->buf, msg->len);
+	if (err) {
+		return err;
+	}
+
+	q.seq = hdr.seq;
+	q.stats.pending++;
+	q.stats.stored++;
+
+	return 0;
+}
+
+static int ack_store(uint32_t seq)
+{
+	struct record_hdr hdr = {
+		.seq = seq,
+		.type = RECORD_ACK,
+	};
+
+	q.acked = seq;
+
+	return record_append(&hdr, NULL, 0);
+}
+
+static int batch_publish(struct batch *batch)
+{
+	bool cbor = q.backend->config->encoding == CLOUD_ENCODING_CBOR;
+	struct cloud_msg msg = {
+		.qos = batch->qos,
+		.endpoint.type = batch->endpoint,
+	};
+	int err;
+
+	if (batch->count == 0) {
+		return 0;
+	}
+
+	if (batch->count == 1) {
+		/* A single message is sent as it was given */
+		msg.buf = (char *)batch_buf + 1;
+		msg.len = batch->len - 1;
+	} else {
+		/* Indefinite length CBOR array, or JSON array */
+		batch_buf[0] = cbor ? 0x9f : '[';
+		batch_buf[batch->len] = cbor ? 0xff : ']';
+		msg.buf = (char *)batch_buf;
+		msg.len = batch->len + 1;
+	}
+
+	err = cloud_send(q.backend, &msg);
+	if (err) {
+		LOG_WRN("Could not send %d queued messages, error: %d",
+			batch->count, err);
+		return err;
+	}
+
+	LOG_DBG("Sent %d queued messages in %d bytes", batch->count, msg.len);
+
+	q.stats.pending -= batch->count;
+	q.stats.sent += batch->count;
+	q.stats.publishes++;
+
+	batch->count = 0;
+	batch->sent = batch->last_seq;
+
+	return 0;
+}
+
+/* Adds a stored message to the batch, publishing the batch first if the
+ * message can not be combined with it.
+ */
+static int batch_add(struct batch *batch, const struct fcb_entry *loc,
+		     const struct record_hdr *hdr)
+{
+	bool cbor = q.backend->config->encoding == CLOUD_ENCODING_CBOR;
+	bool array = IS_ENABLED(CONFIG_CLOUD_QUEUE_BATCH) &&
+		     hdr->endpoint == CLOUD_EP_MSG;
+	size_t len = loc->fe_data_len - sizeof(*hdr);
+	size_t sep = (batch->count > 0 && !cbor) ? 1 : 0;
+	int err;
+
+	if (batch->count > 0 &&
+	    (!array || !batch->array || hdr->qos != batch->qos ||
+	     batch->len + sep + len + 1 > sizeof(batch_buf))) {
+		err = batch_publish(batch);
+		if (err) {
+			return err;
+		}
+
+		sep = 0;
+	}
+
+	if (batch->count == 0) {
+		/* Room for the opening byte of an array */
+		batch->len = 1;
+		batch->endpoint = hdr->endpoint;
+		batch->qos = hdr->qos;
+		batch->array = array;
+	}
+
+	if (sep) {
+		batch_buf[batch->len++] = ',';
+	}
+
+	err = flash_area_read(q.fcb.fap,
+			      FCB_ENTRY_FA_DATA_OFF((*loc)) + sizeof(*hdr),
+			      batch_buf + batch->len, len);
+	if (err) {
+		return err;
+	}
+
+	batch->len += len;
+	batch->count++;
+	batch->last_seq = hdr->seq;
+
+	if (!array) {
+		return batch_publish(batch);
+	}
+
+	return 0;
+}
+
+static int queue_flush(void)
+{
+	struct fcb_entry loc = { 0 };
+	struct record_hdr hdr;
+	struct batch batch = {
+		.sent = q.acked,
+	};
+	int err = 0;
+
+	while (q.stats.pending > 0 && fcb_getnext(&q.fcb, &loc) == 0) {
+		err = hdr_read(&loc, &hdr);
+		if (err) {
+			break;
+		}
+
+		if (!is_pending(&hdr)) {
+			continue;
+		}
+
+		err = batch_add(&batch, &loc, &hdr);
+		if (err) {
+			break;
+		}
+	}
+
+	if (!err) {
+		err = batch_publish(&batch);
+	}
+
+	if (batch.sent != q.acked) {
+		(void)ack_store(batch.sent);
+		queue_trim();
+	}
+
+	return err;
+}
+
+int cloud_queue_flush(void)
+{
+	int err;
+
+	if (q.backend == NULL) {
+		return -ENOENT;
+	}
+
+	k_mutex_lock(&queue_lock, K_FOREVER);
+
+	if (q.link_up) {
+		err = queue_flush();
+	} else {
+		err = -ENOTCONN;
+	}
+
+	k_mutex_unlock(&queue_lock);
+
+	return err;
+}
+
+static void flush_work_fn(struct k_work *work)
+{
+	int err;
+
+	err = cloud_queue_flush();
+	if (err && err != -ENOTCONN) {
+		LOG_WRN("Queued messages not sent, error: %d", err);
+	}
+}
+
+int cloud_queue_send(const struct cloud_msg *msg)
+{
+	struct cloud_msg direct;
+	int err;
+
+	if (q.backend == NULL) {
+		return -ENOENT;
+	}
+
+	if (msg == NULL || msg->endpoint.str != NULL) {
+		return -EINVAL;
+	}
+
+	if (msg->len > sizeof(batch_buf) - BATCH_OVERHEAD) {
+		return -EMSGSIZE;
+	}
+
+	k_mutex_lock(&queue_lock, K_FOREVER);
+
+	/* Earlier messages must be sent first, to keep the order */
+	if (q.link_up && q.stats.pending == 0) {
+		direct = *msg;
+
+		err = cloud_send(q.backend, &direct);
+		if (err == 0) {
+			k_mutex_unlock(&queue_lock);
+			return 0;
+		}
+
+		LOG_WRN("Send failed, error: %d, storing message", err);
+	}
+
+	err = msg_store(msg);
+	if (err == 0 && q.link_up) {
+		k_work_submit(&flush_work);
+	}
+
+	k_mutex_unlock(&queue_lock);
+
+	return err;
+}
+
+void cloud_queue_link_set(bool up)
+{
+	q.link_up = up;
+
+	if (up && q.stats.pending > 0) {
+		k_work_submit(&flush_work);
+	}
+}
+
+void cloud_queue_stats_get(struct cloud_queue_stats *stats)
+{
+	k_mutex_lock(&queue_lock, K_FOREVER);
+	*stats = q.stats;
+	k_mutex_unlock(&queue_lock);
+}
+
+static int recover_seq_cb(struct fcb_entry_ctx *loc_ctx, void *arg)
+{
+	struct record_hdr hdr;
+
+	if (hdr_read(&loc_ctx->loc, &hdr)) {
+		return 0;
+	}
+
+	if (hdr.type == RECORD_ACK) {
+		q.acked = MAX(q.acked, hdr.seq);
+	}
+
+	q.seq = MAX(q.seq, hdr.seq);
+
+	return 0;
+}
+
+static int recover_pending_cb(struct fcb_entry_ctx *loc_ctx, void *arg)
+{
+	struct record_hdr hdr;
+
+	if (hdr_read(&loc_ctx->loc, &hdr) == 0 && is_pending(&hdr)) {
+		q.stats.pending++;
+	}
+
+	return 0;
+}
+
+static int storage_init(void)
+{
+	const struct flash_area *fap;
+	uint32_t count = ARRAY_SIZE(sectors);
+	int err;
+
+	err = flash_area_get_sectors(QUEUE_AREA_ID, &count, sectors);
+	if (err) {
+		LOG_ERR("Could not get flash sectors, error: %d", err);
+		return err;
+	}
+
+	if (count < 2 ||
+	    sectors[0].fs_size < sizeof(batch_buf) + sizeof(struct record_hdr)) {
+		LOG_ERR("Flash area too small for the queue");
+		return -ENOSPC;
+	}
+
+	q.fcb.f_magic = QUEUE_MAGIC;
+	q.fcb.f_version = QUEUE_VERSION;
+	q.fcb.f_sectors = sectors;
+	q.fcb.f_sector_cnt = count;
+	q.fcb.f_scratch_cnt = 0;
+
+	err = fcb_init(QUEUE_AREA_ID, &q.fcb);
+	if (err == 0) {
+		return 0;
+	}
+
+	/* Not written yet, or by a different version of the queue */
+	LOG_WRN("Queue storage not valid, erasing");
+
+	err = flash_area_open(QUEUE_AREA_ID, &fap);
+	if (err) {
+		return err;
+	}
+
+	err = flash_area_erase(fap, 0, fap->fa_size);
+	flash_area_close(fap);
+	if (err) {
+		return err;
+	}
+
+	return fcb_init(QUEUE_AREA_ID, &q.fcb);
+}
+
+int cloud_queue_init(const struct cloud_backend *backend)
+{
+	int err;
+
+	if (backend == NULL) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&queue_lock, K_FOREVER);
+
+	memset(&q, 0, sizeof(q));
+
+	err = storage_init();
+	if (err) {
+		LOG_ERR("Could not initialize queue storage, error: %d", err);
+		goto exit;
+	}
+
+	if (q.fcb.f_align > sizeof(struct record_hdr)) {
+		LOG_ERR("Unsupported flash write block size");
+		err = -ENOTSUP;
+		goto exit;
+	}
+
+	/* Find the messages that were not sent before the reset */
+	(void)fcb_walk(&q.fcb, NULL, recover_seq_cb, NULL);
+	(void)fcb_walk(&q.fcb, NULL, recover_pending_cb, NULL);
+
+	q.backend = backend;
+
+	LOG_DBG("%d stored messages to send", q.stats.pending);
+
+exit:
+	k_mutex_unlock(&queue_lock);
+
+	return err;
+}
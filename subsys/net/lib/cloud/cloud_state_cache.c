@@ -0,0 +1,417 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <net/cloud_state_cache.h>
+
+/* Maximum nesting of objects and arrays */
+#define MAX_DEPTH 16
+
+#define FNV_OFFSET 2166136261U
+#define FNV_PRIME 16777619U
+
+struct scan {
+	struct cloud_state_cache *cache;
+	const char *pos;
+	const char *end;
+	char *buf;
+	size_t size;
+	size_t len;
+	/* Write every member, changed or not */
+	bool full;
+	int err;
+};
+
+static uint32_t hash(uint32_t h, const char *data, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		h = (h ^ (uint8_t)data[i]) * FNV_PRIME;
+	}
+
+	return h;
+}
+
+/* The output never gets ahead of the input, so the input can be
+ * overwritten as it is read.
+ */
+static void put(struct scan *s, const char *data, size_t len)
+{
+	if (s->err) {
+		return;
+	}
+
+	/* Room is always left for the NUL character */
+	if (len >= s->size - s->len) {
+		s->err = -ENOMEM;
+		return;
+	}
+
+	memmove(s->buf + s->len, data, len);
+	s->len += len;
+}
+
+static void skip_ws(struct scan *s)
+{
+	while (s->pos < s->end && (*s->pos == ' ' || *s->pos == '\t' ||
+				   *s->pos == '\n' || *s->pos == '\r')) {
+		s->pos++;
+	}
+}
+
+static bool next_is(struct scan *s, char c)
+{
+	skip_ws(s);
+
+	return s->pos < s->end && *s->pos == c;
+}
+
+/* Skips a string, pos is at the opening quote */
+static int string_skip(struct scan *s)
+{
+	for (s->pos++; s->pos < s->end; s->pos++) {
+		if (*s->pos == '\\') {
+			s->pos++;
+		} else if (*s->pos == '"') {
+			s->pos++;
+			return 0;
+		} else if ((uint8_t)*s->pos < 0x20) {
+			break;
+		}
+	}
+
+	return -EBADMSG;
+}
+
+static int value_skip(struct scan *s, int depth);
+
+/* Skips the members or elements of a container, pos is after the opening
+ * character.
+ */
+static int container_skip(struct scan *s, int depth, bool object)
+{
+	char close = object ? '}' : ']';
+	int err;
+
+	if (depth >= MAX_DEPTH) {
+		return -EBADMSG;
+	}
+
+	if (next_is(s, close)) {
+		s->pos++;
+		return 0;
+	}
+
+	for (;;) {
+		if (object) {
+			if (!next_is(s, '"') || string_skip(s) ||
+			    !next_is(s, ':')) {
+				return -EBADMSG;
+			}
+
+			s->pos++;
+		}
+
+		err = value_skip(s, depth + 1);
+		if (err) {
+			return err;
+		}
+
+		if (next_is(s, ',')) {
+			s->pos++;
+		} else if (next_is(s, close)) {
+			s->pos++;
+			return 0;
+		} else {
+			return -EBADMSG;
+		}
+	}
+}
+
+static int literal_skip(struct scan *s, const char *literal)
+{
+	size_t len = strlen(literal);
+
+	if ((size_t)(s->end - s->pos) < len ||
+	    memcmp(s->pos, literal, len) != 0) {
+		return -EBADMSG;
+	}
+
+	s->pos += len;
+
+	return 0;
+}
+
+static int value_skip(struct scan *s, int depth)
+{
+	const char *start;
+
+	skip_ws(s);
+
+	if (s->pos == s->end) {
+		return -EBADMSG;
+	}
+
+	switch (*s->pos) {
+	case '"':
+		return string_skip(s);
+	case '{':
+	case '[':
+		s->pos++;
+		return container_skip(s, depth, s->pos[-1] == '{');
+	case 't':
+		return literal_skip(s, "true");
+	case 'f':
+		return literal_skip(s, "false");
+	case 'n':
+		return literal_skip(s, "null");
+	default:
+		break;
+	}
+
+	for (start = s->pos; s->pos < s->end; s->pos++) {
+		if (*s->pos == '\0' || !strchr("+-.0123456789eE", *s->pos)) {
+			break;
+		}
+	}
+
+	return s->pos > start ? 0 : -EBADMSG;
+}
+
+/* Records a member of the new document, and returns true if its value is
+ * not the acknowledged one.
+ */
+static bool member_changed(struct cloud_state_cache *cache, uint32_t path,
+			   uint32_t value)
+{
+	uint16_t hint = cache->pending_count;
+	uint16_t i;
+
+	if (cache->pending_count == cache->size) {
+		/* Not tracked, so always sent */
+		return true;
+	}
+
+	cache->pending[cache->pending_count++] =
+		(struct cloud_state_cache_entry){ .path = path, .value = value };
+
+	if (!cache->valid) {
+		return true;
+	}
+
+	/* Documents mostly have the same members in the same order, so
+	 * start looking where the member was in the last one.
+	 */
+	for (i = 0; i < cache->acked_count; i++) {
+		const struct cloud_state_cache_entry *entry =
+			&cache->acked[(hint + i) % cache->acked_count];
+
+		if (entry->path == path) {
+			return entry->value != value;
+		}
+	}
+
+	return true;
+}
+
+/* Writes the separator and the name of a member */
+static void member_put(struct scan *s, int written, const char *name,
+		       size_t len)
+{
+	if (written > 0) {
+		put(s, ",", 1);
+	}
+
+	put(s, name, len);
+	put(s, ":", 1);
+}
+
+/* Scans the members of an object, pos is after the opening brace. Returns
+ * the number of members written.
+ */
+static int object_scan(struct scan *s, uint32_t path, int depth)
+{
+	const char *name;
+	const char *value;
+	size_t name_len;
+	uint32_t member;
+	size_t mark;
+	int written = 0;
+	int ret;
+
+	if (depth >= MAX_DEPTH) {
+		return -EBADMSG;
+	}
+
+	if (next_is(s, '}')) {
+		s->pos++;
+		return 0;
+	}
+
+	for (;;) {
+		if (!next_is(s, '"')) {
+			return -EBADMSG;
+		}
+
+		name = s->pos;
+		if (string_skip(s)) {
+			return -EBADMSG;
+		}
+
+		name_len = s->pos - name;
+
+		if (!next_is(s, ':')) {
+			return -EBADMSG;
+		}
+
+		s->pos++;
+
+		member = hash(hash(path, "/", 1), name, name_len);
+		mark = s->len;
+
+		if (next_is(s, '{')) {
+			s->pos++;
+			member_put(s, written, name, name_len);
+			put(s, "{", 1);
+
+			ret = object_scan(s, member, depth + 1);
+			if (ret < 0) {
+				return ret;
+			}
+
+			if (ret > 0 || s->full) {
+				put(s, "}", 1);
+				written++;
+			} else {
+				/* Nothing changed in the object */
+				s->len = mark;
+			}
+		} else {
+			skip_ws(s);
+			value = s->pos;
+
+			ret = value_skip(s, depth + 1);
+			if (ret) {
+				return ret;
+			}
+
+			if (member_changed(s->cache, member,
+					   hash(FNV_OFFSET, value,
+						s->pos - value)) || s->full) {
+				member_put(s, written, name, name_len);
+				put(s, value, s->pos - value);
+				written++;
+			}
+		}
+
+		if (next_is(s, ',')) {
+			s->pos++;
+		} else if (next_is(s, '}')) {
+			s->pos++;
+			return written;
+		} else {
+			return -EBADMSG;
+		}
+	}
+}
+
+static bool resync_due(const struct cloud_state_cache *cache)
+{
+	if (!cache->valid) {
+		return true;
+	}
+
+	return CONFIG_CLOUD_STATE_CACHE_RESYNC_INTERVAL > 0 &&
+	       k_uptime_get() - cache->full_time >=
+	       CONFIG_CLOUD_STATE_CACHE_RESYNC_INTERVAL * MSEC_PER_SEC;
+}
+
+int cloud_state_cache_delta(struct cloud_state_cache *cache, const char *json,
+			    size_t len, char *buf, size_t size)
+{
+	struct scan s = {
+		.cache = cache,
+		.pos = json,
+		.end = json + len,
+		.buf = buf,
+		.size = size,
+		.full = resync_due(cache),
+	};
+	int ret;
+
+	__ASSERT_NO_MSG(cache != NULL);
+	__ASSERT_NO_MSG(json != NULL);
+	__ASSERT_NO_MSG(buf != NULL);
+
+	cache->pending_ready = false;
+	cache->pending_count = 0;
+
+	if (size == 0) {
+		return -ENOMEM;
+	}
+
+	if (!next_is(&s, '{')) {
+		return -EBADMSG;
+	}
+
+	s.pos++;
+	put(&s, "{", 1);
+
+	ret = object_scan(&s, FNV_OFFSET, 0);
+	if (ret < 0) {
+		return ret;
+	}
+
+	if (ret == 0 && !s.full) {
+		s.len = 0;
+	} else {
+		put(&s, "}", 1);
+	}
+
+	if (s.err) {
+		return s.err;
+	}
+
+	buf[s.len] = '\0';
+
+	cache->pending_ready = true;
+	cache->pending_full = s.full;
+
+	return s.len;
+}
+
+void cloud_state_cache_ack(struct cloud_state_cache *cache)
+{
+	struct cloud_state_cache_entry *entries;
+
+	__ASSERT_NO_MSG(cache != NULL);
+
+	if (!cache->pending_ready) {
+		return;
+	}
+
+	entries = cache->acked;
+	cache->acked = cache->pending;
+	cache->acked_count = cache->pending_count;
+	cache->pending = entries;
+	cache->pending_count = 0;
+	cache->pending_ready = false;
+	cache->valid = true;
+
+	if (cache->pending_full) {
+		cache->full_time = k_uptime_get();
+	}
+}
+
+void cloud_state_cache_reset(struct cloud_state_cache *cache)
+{
+	__ASSERT_NO_MSG(cache != NULL);
+
+	cache->acked_count = 0;
+	cache->pending_count = 0;
+	cache->pending_ready = false;
+	cache->valid = false;
+}
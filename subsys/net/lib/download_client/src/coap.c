@@ -5,6 +5,7 @@
  */
 
 #include <zephyr.h>
+#include <sys/util.h>
 #include <net/coap.h>
 #include <net/download_client.h>
 #include <logging/log.h>
@@ -14,107 +15,215 @@ LOG_MODULE_DECLARE(download_client, CONFIG_DOWNLOAD_CLIENT_LOG_LEVEL);
 #define COAP_VER 1
 #define FILENAME_SIZE CONFIG_DOWNLOAD_CLIENT_MAX_FILENAME_SIZE
 
+#define WINDOW DOWNLOAD_CLIENT_COAP_WINDOW
+
+/* Block2 option fields (RFC 7959, section 2.2) */
+#define BLOCK_NUM(opt) ((uint32_t)(opt) >> 4)
+#define BLOCK_MORE(opt) (((opt) & 0x08) != 0)
+#define BLOCK_SZX(opt) ((enum coap_block_size)((opt) & 0x07))
+
+/* Retransmission timeout bounds (RFC 6298) */
+#define RTO_INIT CONFIG_DOWNLOAD_CLIENT_UDP_SOCK_TIMEO_MS
+#define RTO_MIN CONFIG_DOWNLOAD_CLIENT_COAP_RTO_MIN_MS
+#define RTO_MAX CONFIG_DOWNLOAD_CLIENT_COAP_RTO_MAX_MS
+/* Granularity of the socket receive timeout */
+#define RCVTIMEO_GRANULARITY 100
+
+/* Smallest block size used when adapting to a lossy link */
+#define BLOCK_SIZE_MIN COAP_BLOCK_64
+/* Retransmissions of the next expected block before shrinking */
+#define BLOCK_SHRINK_RETRIES 2
+/* Blocks received in a row without retransmissions before growing */
+#define BLOCK_GROW_STREAK 16
+
+BUILD_ASSERT(WINDOW * DOWNLOAD_CLIENT_COAP_BLOCK_MAX <=
+	     CONFIG_DOWNLOAD_CLIENT_BUF_SIZE,
+	     "The CoAP block window does not fit in the download buffer");
+
+enum req_state {
+	REQ_FREE,
+	REQ_SENT,
+	REQ_RECEIVED,
+};
+
 int url_parse_file(const char *url, char *file, size_t len);
 int socket_send(const struct download_client *client, size_t len);
 
-int coap_block_init(struct download_client *client, size_t from)
+static size_t block_bytes(const struct download_client *client)
 {
-	coap_block_transfer_init(&client->coap.block_ctx,
-				 CONFIG_DOWNLOAD_CLIENT_COAP_BLOCK_SIZE, 0);
-	client->coap.block_ctx.current = from;
-	return 0;
+	return coap_block_size_to_bytes(client->coap.block_ctx.block_size);
 }
 
-int coap_block_update(struct download_client *client, struct coap_packet *pkt,
-		      size_t *blk_off)
+/* Block number of the next byte to be delivered to the application */
+static uint32_t window_base(const struct download_client *client)
 {
-	int err;
-	bool more;
+	return client->coap.block_ctx.current / block_bytes(client);
+}
+
+static uint8_t *stash_get(struct download_client *client,
+			  const struct download_client_coap_req *req)
+{
+#if WINDOW > 1
+	return client->coap.stash +
+	       (req - client->coap.req) * DOWNLOAD_CLIENT_COAP_BLOCK_MAX;
+#else
+	return NULL;
+#endif
+}
 
-	*blk_off = client->coap.block_ctx.current %
-		   coap_block_size_to_bytes(client->coap.block_ctx.block_size);
-	if (*blk_off) {
-		LOG_DBG("%d bytes of current block already downloaded",
-			*blk_off);
+static struct download_client_coap_req *
+req_find_num(struct download_client *client, uint32_t num)
+{
+	for (size_t i = 0; i < WINDOW; i++) {
+		if (client->coap.req[i].state != REQ_FREE &&
+		    client->coap.req[i].num == num) {
+			return &client->coap.req[i];
+		}
 	}
 
-	err = coap_update_from_block(pkt, &client->coap.block_ctx);
-	if (err) {
-		return err;
+	return NULL;
+}
+
+static struct download_client_coap_req *
+req_find_token(struct download_client *client, const uint8_t *token,
+	       uint8_t tkl)
+{
+	if (tkl != sizeof(client->coap.req[0].token)) {
+		return NULL;
 	}
 
-	if (client->file_size == 0) {
-		LOG_DBG("Total size: %d", client->coap.block_ctx.total_size);
-		client->file_size = client->coap.block_ctx.total_size;
+	for (size_t i = 0; i < WINDOW; i++) {
+		if (client->coap.req[i].state == REQ_SENT &&
+		    !memcmp(client->coap.req[i].token, token, tkl)) {
+			return &client->coap.req[i];
+		}
 	}
 
-	more = coap_next_block(pkt, &client->coap.block_ctx);
-	if (!more) {
-		LOG_DBG("Last block received");
+	return NULL;
+}
+
+static struct download_client_coap_req *
+req_alloc(struct download_client *client)
+{
+	for (size_t i = 0; i < WINDOW; i++) {
+		if (client->coap.req[i].state == REQ_FREE) {
+			return &client->coap.req[i];
+		}
 	}
 
-	return 0;
+	return NULL;
 }
 
-int coap_parse(struct download_client *client, size_t len)
+static bool window_has_received(const struct download_client *client)
 {
-	int err;
-	size_t blk_off;
-	uint8_t response_code;
-	uint16_t payload_len;
-	const uint8_t *payload;
-	struct coap_packet response;
+	for (size_t i = 0; i < WINDOW; i++) {
+		if (client->coap.req[i].state == REQ_RECEIVED) {
+			return true;
+		}
+	}
 
-	err = coap_packet_parse(&response, client->buf, len, NULL, 0);
-	if (err) {
-		LOG_ERR("Failed to parse CoAP packet, err %d", err);
-		return -1;
+	return false;
+}
+
+static void window_reset(struct download_client *client)
+{
+	for (size_t i = 0; i < WINDOW; i++) {
+		client->coap.req[i].state = REQ_FREE;
 	}
+}
 
-	err = coap_block_update(client, &response, &blk_off);
-	if (err) {
-		return -1;
+/* Outstanding requests refer to block numbers of the old size,
+ * so they are forgotten; responses to them are ignored.
+ */
+static void block_size_set(struct download_client *client,
+			   enum coap_block_size size)
+{
+	LOG_INF("CoAP block size %d -> %d", block_bytes(client),
+		coap_block_size_to_bytes(size));
+
+	client->coap.block_ctx.block_size = size;
+	client->coap.streak = 0;
+	window_reset(client);
+}
+
+static void rtt_update(struct download_client *client, uint32_t rtt)
+{
+	uint32_t delta;
+
+	if (client->coap.srtt == 0) {
+		client->coap.srtt = rtt;
+		client->coap.rttvar = rtt / 2;
+	} else {
+		delta = (client->coap.srtt > rtt) ?
+			client->coap.srtt - rtt : rtt - client->coap.srtt;
+		client->coap.rttvar = (3 * client->coap.rttvar + delta) / 4;
+		client->coap.srtt = (7 * client->coap.srtt + rtt) / 8;
 	}
 
-	response_code = coap_header_get_code(&response);
-	if (response_code != COAP_RESPONSE_CODE_OK &&
-	    response_code != COAP_RESPONSE_CODE_CONTENT) {
-		LOG_ERR("Server responded with code 0x%x", response_code);
-		return -1;
+	client->coap.rto = MIN(MAX(client->coap.srtt + 4 * client->coap.rttvar,
+				   RTO_MIN), RTO_MAX);
+
+	LOG_DBG("RTT %d ms, SRTT %d ms, RTO %d ms", rtt, client->coap.srtt,
+		client->coap.rto);
+}
+
+static size_t block_deliver(struct download_client *client, uint32_t num,
+			    const uint8_t *payload, size_t len)
+{
+	size_t skip;
+	struct coap_block_context *ctx = &client->coap.block_ctx;
+
+	skip = ctx->current - num * block_bytes(client);
+	if (skip >= len) {
+		return 0;
 	}
 
-	payload = coap_packet_get_payload(&response, &payload_len);
-	if (!payload) {
-		LOG_WRN("No CoAP payload!");
-		return -1;
+	if (skip) {
+		LOG_DBG("%d bytes of current block already downloaded", skip);
 	}
 
-	/* TODO: because our buffer is large enough for the whole datagram,
-	 * we don't scrictly need to copy the bytes at the beginning
-	 * of the buffer, we could simply send a fragment pointing to the
-	 * payload directly.
-	 */
-	LOG_DBG("CoAP response: %d, copying %d bytes",
-		coap_header_get_code(&response), payload_len - blk_off);
-	memcpy(client->buf + client->offset, payload + blk_off,
-	       payload_len - blk_off);
+	__ASSERT(client->offset + len - skip <= CONFIG_DOWNLOAD_CLIENT_BUF_SIZE,
+		 "Buffer overflow!");
 
-	client->offset += payload_len - blk_off;
-	client->progress += payload_len - blk_off;
+	/* The payload may be in the receive buffer itself */
+	memmove(client->buf + client->offset, payload + skip, len - skip);
 
-	return 0;
+	client->offset += len - skip;
+	client->progress += len - skip;
+	ctx->current += len - skip;
+
+	return len - skip;
 }
 
-int coap_request_send(struct download_client *client)
+static void stash_drain(struct download_client *client)
+{
+	struct download_client_coap_req *req;
+
+	while (true) {
+		req = req_find_num(client, window_base(client));
+		if (!req || req->state != REQ_RECEIVED) {
+			return;
+		}
+
+		LOG_DBG("Delivering block %d out of order", req->num);
+		block_deliver(client, req->num, stash_get(client, req),
+			      req->len);
+		req->state = REQ_FREE;
+	}
+}
+
+static int block_request_send(struct download_client *client,
+			      struct download_client_coap_req *req)
 {
 	int err;
 	char file[FILENAME_SIZE];
 	struct coap_packet request;
+	struct coap_block_context block = client->coap.block_ctx;
 
 	err = coap_packet_init(
 		&request, client->buf, CONFIG_DOWNLOAD_CLIENT_BUF_SIZE,
-		COAP_VER, COAP_TYPE_CON, 8, coap_next_token(),
-		COAP_METHOD_GET, coap_next_id()
+		COAP_VER, COAP_TYPE_CON, sizeof(req->token), req->token,
+		COAP_METHOD_GET, req->id
 	);
 	if (err) {
 		LOG_ERR("Failed to init CoAP message, err %d", err);
@@ -133,7 +242,9 @@ int coap_request_send(struct download_client *client)
 		return err;
 	}
 
-	err = coap_append_block2_option(&request, &client->coap.block_ctx);
+	block.current = req->num * block_bytes(client);
+
+	err = coap_append_block2_option(&request, &block);
 	if (err) {
 		LOG_ERR("Unable to add block2 option");
 		return err;
@@ -145,7 +256,7 @@ int coap_request_send(struct download_client *client)
 		return err;
 	}
 
-	LOG_DBG("CoAP next block: %d", client->coap.block_ctx.current);
+	LOG_DBG("CoAP next block: %d (%d)", block.current, req->num);
 
 	err = socket_send(client, request.offset);
 	if (err) {
@@ -153,9 +264,267 @@ int coap_request_send(struct download_client *client)
 		return err;
 	}
 
+	req->sent = k_uptime_get_32();
+
 	if (IS_ENABLED(CONFIG_DOWNLOAD_CLIENT_LOG_HEADERS)) {
 		LOG_HEXDUMP_DBG(request.data, request.offset, "CoAP request");
 	}
 
 	return 0;
 }
+
+int coap_block_init(struct download_client *client, size_t from)
+{
+	coap_block_transfer_init(&client->coap.block_ctx,
+				 CONFIG_DOWNLOAD_CLIENT_COAP_BLOCK_SIZE, 0);
+	client->coap.block_ctx.current = from;
+	client->coap.max_block_size = CONFIG_DOWNLOAD_CLIENT_COAP_BLOCK_SIZE;
+	client->coap.srtt = 0;
+	client->coap.rttvar = 0;
+	client->coap.rto = RTO_INIT;
+	client->coap.streak = 0;
+	window_reset(client);
+	return 0;
+}
+
+void coap_requests_reset(struct download_client *client)
+{
+	/* Blocks already received are kept, the rest is requested anew */
+	for (size_t i = 0; i < WINDOW; i++) {
+		if (client->coap.req[i].state == REQ_SENT) {
+			client->coap.req[i].state = REQ_FREE;
+		}
+	}
+}
+
+int coap_recv_timeout_get(const struct download_client *client)
+{
+	int32_t left;
+	int32_t timeout = RTO_MAX;
+	const uint32_t now = k_uptime_get_32();
+
+	if (RTO_INIT == SYS_FOREVER_MS) {
+		return SYS_FOREVER_MS;
+	}
+
+	/* Wake up at the earliest retransmission deadline */
+	for (size_t i = 0; i < WINDOW; i++) {
+		if (client->coap.req[i].state != REQ_SENT) {
+			continue;
+		}
+
+		left = (int32_t)(client->coap.req[i].sent +
+				 client->coap.req[i].rto - now);
+		timeout = MIN(timeout, MAX(left, 0));
+	}
+
+	/* Rounded up to limit how often the socket option is updated */
+	return ROUND_UP(MAX(timeout, 1), RCVTIMEO_GRANULARITY);
+}
+
+int coap_parse(struct download_client *client, size_t len)
+{
+	int err;
+	int opt;
+	int size2;
+	uint8_t tkl;
+	uint32_t num;
+	uint8_t retries;
+	uint8_t response_code;
+	uint16_t payload_len;
+	const uint8_t *payload;
+	uint8_t token[COAP_TOKEN_MAX_LEN];
+	struct coap_packet response;
+	struct download_client_coap_req *req;
+
+	err = coap_packet_parse(&response, client->buf, len, NULL, 0);
+	if (err) {
+		LOG_ERR("Failed to parse CoAP packet, err %d", err);
+		return -1;
+	}
+
+	tkl = coap_header_get_token(&response, token);
+	req = req_find_token(client, token, tkl);
+	if (!req) {
+		LOG_DBG("Ignoring stale or duplicate CoAP response");
+		return 1;
+	}
+
+	response_code = coap_header_get_code(&response);
+	if (response_code != COAP_RESPONSE_CODE_OK &&
+	    response_code != COAP_RESPONSE_CODE_CONTENT) {
+		LOG_ERR("Server responded with code 0x%x", response_code);
+		return -1;
+	}
+
+	opt = coap_get_option_int(&response, COAP_OPTION_BLOCK2);
+	if (opt < 0) {
+		LOG_ERR("No block2 option in response");
+		return -1;
+	}
+
+	payload = coap_packet_get_payload(&response, &payload_len);
+	if (!payload) {
+		LOG_WRN("No CoAP payload!");
+		return -1;
+	}
+
+	retries = req->retries;
+	if (retries == 0) {
+		/* Karn's algorithm: only sample unambiguous round trips */
+		rtt_update(client, k_uptime_get_32() - req->sent);
+	}
+
+	size2 = coap_get_option_int(&response, COAP_OPTION_SIZE2);
+	if (size2 > 0 && client->file_size == 0) {
+		LOG_DBG("Total size: %d", size2);
+		client->coap.block_ctx.total_size = size2;
+		client->file_size = size2;
+	}
+
+	if (BLOCK_SZX(opt) < client->coap.block_ctx.block_size) {
+		/* The server wants smaller blocks, never go above that */
+		client->coap.max_block_size = BLOCK_SZX(opt);
+		block_size_set(client, BLOCK_SZX(opt));
+		req = NULL;
+	} else if (BLOCK_SZX(opt) > client->coap.block_ctx.block_size) {
+		LOG_ERR("Server responded with a larger block size");
+		return -1;
+	}
+
+	if (payload_len > block_bytes(client)) {
+		LOG_ERR("CoAP payload larger than block size");
+		return -1;
+	}
+
+	num = BLOCK_NUM(opt);
+
+	if (!BLOCK_MORE(opt)) {
+		LOG_DBG("Last block received");
+		if (client->file_size == 0) {
+			client->file_size = num * block_bytes(client) +
+					    payload_len;
+		}
+	}
+
+	LOG_DBG("CoAP response: %d, block %d, %d bytes",
+		response_code, num, payload_len);
+
+	if (num == window_base(client)) {
+		if (req) {
+			req->state = REQ_FREE;
+		}
+
+		if (!block_deliver(client, num, payload, payload_len)) {
+			return 1;
+		}
+
+		client->coap.streak = retries ? 0 : client->coap.streak + 1;
+		stash_drain(client);
+		return 0;
+	}
+
+	if (WINDOW > 1 && num > window_base(client) &&
+	    num < window_base(client) + WINDOW) {
+		/* Out of order, hold it until the gap is filled */
+		if (!req) {
+			req = req_alloc(client);
+		}
+		if (req) {
+			memcpy(stash_get(client, req), payload, payload_len);
+			req->num = num;
+			req->len = payload_len;
+			req->state = REQ_RECEIVED;
+		}
+		return 1;
+	}
+
+	LOG_DBG("Block %d outside of window", num);
+	if (req) {
+		req->state = REQ_FREE;
+	}
+
+	return 1;
+}
+
+int coap_request_send(struct download_client *client)
+{
+	int err;
+	uint32_t num;
+	size_t window;
+	uint32_t now = k_uptime_get_32();
+	struct download_client_coap_req *req;
+	struct coap_block_context *ctx = &client->coap.block_ctx;
+
+	/* Retransmit requests whose timeout has expired */
+	for (size_t i = 0; i < WINDOW && RTO_INIT != SYS_FOREVER_MS; i++) {
+		req = &client->coap.req[i];
+		if (req->state != REQ_SENT ||
+		    (int32_t)(now - req->sent) < (int32_t)req->rto) {
+			continue;
+		}
+
+		client->coap.streak = 0;
+
+		if (IS_ENABLED(CONFIG_DOWNLOAD_CLIENT_COAP_BLOCK_SIZE_ADAPTIVE) &&
+		    req->num == window_base(client) &&
+		    req->retries + 1 >= BLOCK_SHRINK_RETRIES &&
+		    ctx->block_size > BLOCK_SIZE_MIN) {
+			block_size_set(client, ctx->block_size - 1);
+			break;
+		}
+
+		req->retries++;
+		req->rto = MIN(2 * req->rto, RTO_MAX);
+
+		LOG_DBG("Retransmitting block %d (%d)", req->num, req->retries);
+
+		err = block_request_send(client, req);
+		if (err) {
+			return err;
+		}
+	}
+
+	if (IS_ENABLED(CONFIG_DOWNLOAD_CLIENT_COAP_BLOCK_SIZE_ADAPTIVE) &&
+	    client->coap.streak >= BLOCK_GROW_STREAK &&
+	    ctx->block_size < client->coap.max_block_size &&
+	    ctx->current % (2 * block_bytes(client)) == 0 &&
+	    !window_has_received(client)) {
+		block_size_set(client, ctx->block_size + 1);
+	}
+
+	/* Until the size of the file is known, send one request at a time */
+	window = client->file_size ? WINDOW : 1;
+
+	for (num = window_base(client); num < window_base(client) + window;
+	     num++) {
+		if (client->file_size &&
+		    num * block_bytes(client) >= client->file_size) {
+			break;
+		}
+
+		if (req_find_num(client, num)) {
+			continue;
+		}
+
+		req = req_alloc(client);
+		if (!req) {
+			break;
+		}
+
+		req->num = num;
+		req->id = coap_next_id();
+		req->rto = client->coap.rto;
+		req->retries = 0;
+		req->state = REQ_SENT;
+		memcpy(req->token, coap_next_token(), sizeof(req->token));
+
+		err = block_request_send(client, req);
+		if (err) {
+			req->state = REQ_FREE;
+			return err;
+		}
+	}
+
+	return 0;
+}
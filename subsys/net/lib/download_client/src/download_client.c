@@ -32,6 +32,8 @@ int http_get_request_send(struct download_client *client);
 int coap_block_init(struct download_client *client, size_t from);
 int coap_parse(struct download_client *client, size_t len);
 int coap_request_send(struct download_client *client);
+int coap_recv_timeout_get(const struct download_client *client);
+void coap_requests_reset(struct download_client *client);
 
 static const char *str_family(int family)
 {
@@ -46,22 +48,26 @@ static const char *str_family(int family)
 	}
 }
 
-static int socket_timeout_set(int fd)
+static bool is_coap(const struct download_client *dl)
+{
+	return IS_ENABLED(CONFIG_COAP) &&
+	       (dl->proto == IPPROTO_UDP || dl->proto == IPPROTO_DTLS_1_2);
+}
+
+static int socket_timeout_set(int fd, int timeout_ms)
 {
 	int err;
 
-	if (CONFIG_DOWNLOAD_CLIENT_UDP_SOCK_TIMEO_MS == SYS_FOREVER_MS) {
+	if (timeout_ms == SYS_FOREVER_MS) {
 		return 0;
 	}
 
-	const uint32_t timeout_ms = CONFIG_DOWNLOAD_CLIENT_UDP_SOCK_TIMEO_MS;
-
 	struct timeval timeo = {
 		.tv_sec = (timeout_ms / 1000),
 		.tv_usec = (timeout_ms % 1000) * 1000,
 	};
 
-	LOG_INF("Configuring socket timeout (%ld s)", timeo.tv_sec);
+	LOG_DBG("Configuring socket timeout (%d ms)", timeout_ms);
 
 	err = setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeo, sizeof(timeo));
 	if (err) {
@@ -100,6 +106,18 @@ static int socket_sectag_set(int fd, int sec_tag)
 		return -errno;
 	}
 
+	if (IS_ENABLED(CONFIG_DOWNLOAD_CLIENT_TLS_SESSION_CACHING)) {
+		int cache = TLS_SESSION_CACHE_ENABLED;
+
+		/* Reconnects during a download resume the session */
+		err = setsockopt(fd, SOL_TLS, TLS_SESSION_CACHE, &cache,
+				 sizeof(cache));
+		if (err) {
+			LOG_WRN("Failed to enable TLS session caching, errno %d",
+				errno);
+		}
+	}
+
 	return 0;
 }
 
@@ -307,6 +325,27 @@ static int request_send(struct download_client *dl)
 	return 0;
 }
 
+static int recv_timeout_update(struct download_client *dl)
+{
+	int err;
+	int timeout;
+
+	/* Wake up in time for the next CoAP retransmission */
+	timeout = coap_recv_timeout_get(dl);
+	if (timeout == dl->coap.rcvtimeo) {
+		return 0;
+	}
+
+	err = socket_timeout_set(dl->fd, timeout);
+	if (err) {
+		return err;
+	}
+
+	dl->coap.rcvtimeo = timeout;
+
+	return 0;
+}
+
 static int fragment_evt_send(const struct download_client *client)
 {
 	__ASSERT(client->offset <= CONFIG_DOWNLOAD_CLIENT_BUF_SIZE,
@@ -351,6 +390,12 @@ static int reconnect(struct download_client *dl)
 		return err;
 	}
 
+	if (is_coap(dl)) {
+		/* Requests sent on the old socket will not be answered */
+		coap_requests_reset(dl);
+		dl->coap.rcvtimeo = SYS_FOREVER_MS;
+	}
+
 	return 0;
 }
 
@@ -373,6 +418,13 @@ restart_and_suspend:
 			break;
 		}
 
+		if (is_coap(dl)) {
+			rc = recv_timeout_update(dl);
+			if (rc) {
+				LOG_WRN("Failed to update socket timeout");
+			}
+		}
+
 		LOG_DBG("Receiving up to %d bytes at %p...",
 			(sizeof(dl->buf) - dl->offset), (dl->buf + dl->offset));
 
@@ -436,6 +488,12 @@ restart_and_suspend:
 			}
 		} else if (IS_ENABLED(CONFIG_COAP)) {
 			rc = coap_parse(client, len);
+			if (rc > 0) {
+				/* Block held back or discarded, keep the
+				 * window of requests going.
+				 */
+				goto send_again;
+			}
 		}
 
 		if (rc < 0) {
@@ -617,10 +675,12 @@ int download_client_start(struct download_client *client, const char *file,
 	if (IS_ENABLED(CONFIG_COAP)) {
 		coap_block_init(client, from);
 		/* Set socket timeout, if configured */
-		err = socket_timeout_set(client->fd);
+		err = socket_timeout_set(client->fd,
+					 CONFIG_DOWNLOAD_CLIENT_UDP_SOCK_TIMEO_MS);
 		if (err) {
 			return err;
 		}
+		client->coap.rcvtimeo = CONFIG_DOWNLOAD_CLIENT_UDP_SOCK_TIMEO_MS;
 	}
 
 	err = request_send(client);
@@ -24,6 +24,8 @@ static fota_download_callback_t callback;
 static struct download_client   dlc;
 static struct k_delayed_work    dlc_with_offset_work;
 static int socket_retries_left;
+static uint8_t expected_hash[DFU_TARGET_HASH_LEN];
+static bool expected_hash_set;
 
 static void send_evt(enum fota_download_evt_id id)
 {
@@ -165,7 +167,13 @@ static int download_client_callback(const struct download_client_evt *event)
 
 	case DOWNLOAD_CLIENT_EVT_DONE:
 		err = dfu_target_done(true);
-		if (err != 0) {
+		if (err == -EBADMSG) {
+			LOG_ERR("Downloaded image is corrupted");
+			(void)download_client_disconnect(&dlc);
+			first_fragment = true;
+			send_error_evt(FOTA_DOWNLOAD_ERROR_CAUSE_INVALID_UPDATE);
+			return err;
+		} else if (err != 0) {
 			LOG_ERR("dfu_target_done error: %d", err);
 			send_error_evt(FOTA_DOWNLOAD_ERROR_CAUSE_DOWNLOAD_FAILED);
 			return err;
@@ -257,6 +265,12 @@ int fota_download_start(const char *host, const char *file, int sec_tag,
 
 	socket_retries_left = CONFIG_FOTA_SOCKET_RETRIES;
 
+	err = dfu_target_hash_expect(expected_hash_set ? expected_hash : NULL);
+	expected_hash_set = false;
+	if (err != 0) {
+		return err;
+	}
+
 #ifdef PM_S1_ADDRESS
 	/* B1 upgrade is supported, check what B1 slot is active,
 	 * (s0 or s1), and update file to point to correct candidate if
@@ -303,6 +317,20 @@ int fota_download_start(const char *host, const char *file, int sec_tag,
 	return 0;
 }
 
+int fota_download_hash_set(const uint8_t *hash)
+{
+	if (!IS_ENABLED(CONFIG_DFU_TARGET_HASH)) {
+		return -ENOTSUP;
+	}
+
+	expected_hash_set = hash != NULL;
+	if (hash != NULL) {
+		memcpy(expected_hash, hash, sizeof(expected_hash));
+	}
+
+	return 0;
+}
+
 int fota_download_init(fota_download_callback_t client_callback)
 {
 	if (client_callback == NULL) {
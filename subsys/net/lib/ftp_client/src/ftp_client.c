@@ -29,7 +29,9 @@ static K_THREAD_STACK_DEFINE(ftp_stack_area, FTP_STACK_SIZE);
 
 static struct ftp_client {
 	int sock; /* Socket descriptor. */
+	int data_sock; /* Data channel of the transfer in progress */
 	bool connected; /* Server connected flag */
+	bool xfer_done; /* Transfer completion already received */
 	struct sockaddr_in remote; /* Server */
 	int sec_tag;
 	ftp_client_callback_t ctrl_callback;
@@ -37,21 +39,10 @@ static struct ftp_client {
 } client;
 
 static struct k_work_q ftp_work_q;
+/* Serializes the commands and the keep-alive on the control channel */
+static K_MUTEX_DEFINE(ftp_mutex);
 static char ctrl_buf[NET_IPV4_MTU];
-static K_SEM_DEFINE(tx_done, 0, 1);
-
-enum data_task_type {
-	TASK_SEND,
-	TASK_RECEIVE
-};
-
-static struct data_task {
-	struct k_work work;
-	enum data_task_type task;
-	char *ctrl_msg;		/* PSAV resposne */
-	uint8_t *data;		/* TX data */
-	uint16_t length;	/* TX length */
-} data_task_param;
+static uint8_t data_buf[NET_IPV4_MTU];
 
 static int parse_return_code(const uint8_t *message, int success_code)
 {
@@ -66,7 +57,9 @@ static int parse_return_code(const uint8_t *message, int success_code)
 	return ret;
 }
 
-static int establish_data_channel(const char *pasv_msg)
+/**@brief Create the data channel socket for the port in a PASV reply
+ */
+static int open_data_channel(const char *pasv_msg)
 {
 	int ret;
 	char tmp[16];
@@ -105,7 +98,7 @@ static int establish_data_channel(const char *pasv_msg)
 	}
 	if (data_sock < 0) {
 		LOG_ERR("socket(data) failed: %d", -errno);
-		ret = -errno;
+		return -errno;
 	}
 
 	if (client.sec_tag > 0) {
@@ -121,15 +114,24 @@ static int establish_data_channel(const char *pasv_msg)
 
 	}
 	client.remote.sin_port = htons(data_port);
-	ret = connect(data_sock, (struct sockaddr *)&client.remote,
+
+	return data_sock;
+}
+
+/**@brief Connect the data channel of the transfer in progress
+ */
+static int connect_data_channel(void)
+{
+	int ret;
+
+	ret = connect(client.data_sock, (struct sockaddr *)&client.remote,
 		 sizeof(struct sockaddr_in));
 	if (ret < 0) {
 		LOG_ERR("connect(data) failed: %d", -errno);
-		close(data_sock);
 		return -errno;
 	}
 
-	return data_sock;
+	return 0;
 }
 
 /**@brief Send FTP message via socket
@@ -156,39 +158,6 @@ static int do_ftp_send_ctrl(const uint8_t *message, int length)
 	return ret;
 }
 
-/**@brief Send FTP data via socket
- */
-static int do_ftp_send_data(const char *pasv_msg, uint8_t *message, uint16_t length)
-{
-	int data_sock;
-	int ret;
-	uint32_t offset = 0;
-
-	/* Establish data channel */
-	ret = establish_data_channel(pasv_msg);
-	if (ret < 0) {
-		return ret;
-	}
-
-	LOG_HEXDUMP_DBG(message, length, "TXD");
-
-	data_sock = ret;
-	while (offset < length) {
-		ret = send(data_sock, message + offset, length - offset, 0);
-		if (ret < 0) {
-			LOG_ERR("send(data) failed: %d", -errno);
-			ret = -errno;
-			break;
-		}
-		offset += ret;
-		ret = 0;
-	}
-
-	LOG_DBG("DATA sent");
-	close(data_sock);
-	return ret;
-}
-
 /**@brief Receive FTP message from socket
  */
 static int do_ftp_recv_ctrl(bool post_result, int success_code)
@@ -204,7 +173,7 @@ static int do_ftp_recv_ctrl(bool post_result, int success_code)
 		LOG_ERR("poll(ctrl) failed: (%d)", -errno);
 		return -ETIMEDOUT;
 	}
-	ret = recv(client.sock, ctrl_buf, sizeof(ctrl_buf), 0);
+	ret = recv(client.sock, ctrl_buf, sizeof(ctrl_buf) - 1, 0);
 	if (ret < 0) {
 		LOG_ERR("recv(ctrl) failed: (%d)", -errno);
 		return -errno;
@@ -225,77 +194,151 @@ static int do_ftp_recv_ctrl(bool post_result, int success_code)
 	return parse_return_code(ctrl_buf, success_code);
 }
 
-/**@brief Receive FTP data from socket
+/**@brief Open the data channel and start a transfer
+ *
+ * Without TLS, the data channel is connected before the transfer command is
+ * sent, so no data is lost. A short transfer may be completed in the same
+ * reply that starts it. With TLS, the server only starts the handshake once
+ * it has accepted the command, so the data channel is connected after it.
  */
-static void do_ftp_recv_data(const char *pasv_msg)
+static int do_ftp_xfer_start(const char *xfer_cmd, size_t offset)
 {
 	int ret;
-	int data_sock;
-	struct pollfd fds[1];
-	char data_buf[NET_IPV4_MTU];
+	int err;
+
+	if (client.data_sock != INVALID_SOCKET) {
+		LOG_ERR("Transfer in progress");
+		return -EBUSY;
+	}
 
-	/* Establish data channel */
-	ret = establish_data_channel(pasv_msg);
+	/* Always set Passive mode to act as TCP client */
+	ret = do_ftp_send_ctrl(CMD_PASV, sizeof(CMD_PASV) - 1);
+	if (ret) {
+		return -EIO;
+	}
+	ret = do_ftp_recv_ctrl(true, FTP_CODE_227);
+	if (ret != FTP_CODE_227) {
+		return ret;
+	}
+	ret = open_data_channel(ctrl_buf);
 	if (ret < 0) {
-		return;
+		return ret;
 	}
+	client.data_sock = ret;
+	client.xfer_done = false;
 
-	/* Receive FTP data message */
-	data_sock = ret;
-	fds[0].fd = data_sock;
-	fds[0].events = POLLIN;
-	do {
-		ret = poll(fds, 1,
-			MSEC_PER_SEC * CONFIG_FTP_CLIENT_LISTEN_TIME);
-		if (ret <= 0) {
-			LOG_ERR("poll(data) failed: (%d)", -errno);
-			break;
+	if (client.sec_tag <= 0) {
+		ret = connect_data_channel();
+		if (ret) {
+			goto error;
 		}
-		if ((fds[0].revents & POLLIN) != POLLIN) {
-			LOG_INF("No more data");
-			break;
+	}
+
+	/* Resume from offset */
+	if (offset > 0) {
+		sprintf(ctrl_buf, CMD_REST, (unsigned int)offset);
+		ret = do_ftp_send_ctrl(ctrl_buf, strlen(ctrl_buf));
+		if (ret == 0) {
+			ret = do_ftp_recv_ctrl(true, FTP_CODE_350);
 		}
-		ret = recv(data_sock, data_buf, sizeof(data_buf), 0);
-		if (ret < 0) {
-			LOG_ERR("recv(data) failed: (%d)", -errno);
-			break;
+		if (ret != FTP_CODE_350) {
+			goto error;
 		}
-		if (ret == 0) {
-			/* Server close connection */
-			break;
+	}
+
+	ret = do_ftp_send_ctrl(xfer_cmd, strlen(xfer_cmd));
+	if (ret) {
+		goto error;
+	}
+	ret = do_ftp_recv_ctrl(true, FTP_CODE_150);
+	if (ret < 0) {
+		goto error;
+	}
+	if (ret != FTP_CODE_150) {
+		ret = parse_return_code(ctrl_buf, FTP_CODE_125);
+		if (ret != FTP_CODE_125) {
+			goto error;
+		}
+	}
+	client.xfer_done = (parse_return_code(ctrl_buf, FTP_CODE_226) ==
+			    FTP_CODE_226);
+
+	if (client.sec_tag > 0) {
+		err = connect_data_channel();
+		if (err) {
+			ret = err;
+			goto error;
 		}
+	}
 
-		LOG_HEXDUMP_DBG(data_buf, ret, "RXD");
-		client.data_callback(data_buf, ret);
-	} while (true);
+	return ret;
 
-	close(data_sock);
-	LOG_DBG("DATA received");
+error:
+	close(client.data_sock);
+	client.data_sock = INVALID_SOCKET;
+	return ret;
 }
 
-static void data_task(struct k_work *item)
+/**@brief Close the data channel and wait for the transfer to complete
+ */
+static int do_ftp_xfer_end(void)
 {
-	struct data_task *task_param =
-		CONTAINER_OF(item, struct data_task, work);
+	int ret = FTP_CODE_226;
+
+	if (client.data_sock == INVALID_SOCKET) {
+		return -EINVAL;
+	}
 
-	if (task_param->task == TASK_RECEIVE) {
-		do_ftp_recv_data(task_param->ctrl_msg);
-	} else if (task_param->task == TASK_SEND) {
-		do_ftp_send_data(task_param->ctrl_msg,
-				task_param->data,
-				task_param->length);
-		k_sem_give(&tx_done);
+	close(client.data_sock);
+	client.data_sock = INVALID_SOCKET;
+
+	if (!client.xfer_done) {
+		do {
+			ret = do_ftp_recv_ctrl(true, FTP_CODE_226);
+			if (ret < 0 || ret == FTP_CODE_226) {
+				break;
+			}
+		} while (1);
 	}
+
+	LOG_DBG("Transfer ended");
+	return ret;
+}
+
+/**@brief Receive all data of a transfer through the data callback
+ */
+static int do_ftp_recv_data(void)
+{
+	int ret;
+
+	do {
+		ret = ftp_get_data(data_buf, sizeof(data_buf));
+		if (ret > 0) {
+			client.data_callback(data_buf, ret);
+		}
+	} while (ret > 0);
+
+	return ret;
 }
 
 static void keepalive_handler(struct k_work *work)
 {
 	int ret;
 
-	ret = do_ftp_send_ctrl(CMD_NOOP, sizeof(CMD_NOOP) - 1);
-	if (ret == 0) {
-		(void)do_ftp_recv_ctrl(false, FTP_CODE_200);
+	/* A command in progress keeps the connection alive */
+	if (k_mutex_lock(&ftp_mutex, K_NO_WAIT) != 0) {
+		return;
+	}
+
+	/* The server does not answer during a transfer */
+	if (client.connected && client.data_sock == INVALID_SOCKET) {
+		ret = do_ftp_send_ctrl(CMD_NOOP, sizeof(CMD_NOOP) - 1);
+		if (ret == 0) {
+			(void)do_ftp_recv_ctrl(false, FTP_CODE_200);
+		}
 	}
+
+	k_mutex_unlock(&ftp_mutex);
 }
 
 K_WORK_DEFINE(keepalive_work, keepalive_handler);
@@ -307,7 +350,7 @@ static void keepalive_timeout(struct k_timer *dummy)
 
 K_TIMER_DEFINE(keepalive_timer, keepalive_timeout, NULL);
 
-int ftp_open(const char *hostname, uint16_t port, int sec_tag)
+static int do_ftp_open(const char *hostname, uint16_t port, int sec_tag)
 {
 	int ret;
 	struct addrinfo *result;
@@ -391,7 +434,7 @@ int ftp_open(const char *hostname, uint16_t port, int sec_tag)
 	return ret;
 }
 
-int ftp_login(const char *username, const char *password)
+static int do_ftp_login(const char *username, const char *password)
 {
 	int ret;
 	int keepalive_time = CONFIG_FTP_CLIENT_KEEPALIVE_TIME;
@@ -426,10 +469,37 @@ int ftp_login(const char *username, const char *password)
 	return ret;
 }
 
+int ftp_open(const char *hostname, uint16_t port, int sec_tag)
+{
+	int ret;
+
+	k_mutex_lock(&ftp_mutex, K_FOREVER);
+	ret = do_ftp_open(hostname, port, sec_tag);
+	k_mutex_unlock(&ftp_mutex);
+
+	return ret;
+}
+
+int ftp_login(const char *username, const char *password)
+{
+	int ret;
+
+	k_mutex_lock(&ftp_mutex, K_FOREVER);
+	ret = do_ftp_login(username, password);
+	k_mutex_unlock(&ftp_mutex);
+
+	return ret;
+}
+
 int ftp_close(void)
 {
 	int ret = 0;
 
+	k_mutex_lock(&ftp_mutex, K_FOREVER);
+	if (client.data_sock != INVALID_SOCKET) {
+		close(client.data_sock);
+		client.data_sock = INVALID_SOCKET;
+	}
 	if (client.connected) {
 		ret = do_ftp_send_ctrl(CMD_QUIT, sizeof(CMD_QUIT) - 1);
 		if (ret == 0) {
@@ -441,6 +511,8 @@ int ftp_close(void)
 	close(client.sock);
 	client.connected = false;
 	client.sec_tag = INVALID_SEC_TAG;
+	k_mutex_unlock(&ftp_mutex);
+
 	return ret;
 }
 
@@ -448,6 +520,8 @@ int ftp_status(void)
 {
 	int ret;
 
+	k_mutex_lock(&ftp_mutex, K_FOREVER);
+
 	/* get server system type */
 	ret = do_ftp_send_ctrl(CMD_SYST, sizeof(CMD_SYST) - 1);
 	if (ret == 0) {
@@ -468,6 +542,8 @@ int ftp_status(void)
 		}
 	}
 
+	k_mutex_unlock(&ftp_mutex);
+
 	return ret;
 }
 
@@ -475,16 +551,20 @@ int ftp_type(enum ftp_trasfer_type type)
 {
 	int ret;
 
+	if (type != FTP_TYPE_ASCII && type != FTP_TYPE_BINARY) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&ftp_mutex, K_FOREVER);
 	if (type == FTP_TYPE_ASCII) {
 		ret = do_ftp_send_ctrl(CMD_TYPE_A, sizeof(CMD_TYPE_A) - 1);
-	} else if (type == FTP_TYPE_BINARY) {
-		ret = do_ftp_send_ctrl(CMD_TYPE_I, sizeof(CMD_TYPE_I) - 1);
 	} else {
-		return -EINVAL;
+		ret = do_ftp_send_ctrl(CMD_TYPE_I, sizeof(CMD_TYPE_I) - 1);
 	}
 	if (ret == 0) {
 		ret = do_ftp_recv_ctrl(true, FTP_CODE_200);
 	}
+	k_mutex_unlock(&ftp_mutex);
 
 	return ret;
 }
@@ -493,10 +573,12 @@ int ftp_pwd(void)
 {
 	int ret;
 
+	k_mutex_lock(&ftp_mutex, K_FOREVER);
 	ret = do_ftp_send_ctrl(CMD_PWD, sizeof(CMD_PWD) - 1);
 	if (ret == 0) {
 		ret = do_ftp_recv_ctrl(true, FTP_CODE_257);
 	}
+	k_mutex_unlock(&ftp_mutex);
 
 	return ret;
 }
@@ -506,18 +588,6 @@ int ftp_list(const char *options, const char *target)
 	int ret;
 	char list_cmd[128];
 
-	/* Always set Passive mode to act as TCP client */
-	ret = do_ftp_send_ctrl(CMD_PASV, sizeof(CMD_PASV) - 1);
-	if (ret) {
-		return -EIO;
-	}
-	ret = do_ftp_recv_ctrl(true, FTP_CODE_227);
-	if (ret != FTP_CODE_227) {
-		return ret;
-	}
-	data_task_param.ctrl_msg = ctrl_buf;
-	data_task_param.task = TASK_RECEIVE;
-
 	/* Send LIST/NLST command in control channel */
 	if (strlen(options) != 0) {
 		if (strlen(target) != 0) {
@@ -529,22 +599,17 @@ int ftp_list(const char *options, const char *target)
 		if (strlen(target) != 0) {
 			sprintf(list_cmd, CMD_LIST_FILE, target);
 		} else {
-			memcpy(list_cmd, CMD_NLST, sizeof(CMD_NLST) - 1);
+			strcpy(list_cmd, CMD_NLST);
 		}
 	}
-	ret = do_ftp_send_ctrl(list_cmd, strlen(list_cmd));
-
-	/* Set up data connection */
-	k_work_submit_to_queue(&ftp_work_q, &data_task_param.work);
 
-	if (ret == 0) {
-		do {
-			ret = do_ftp_recv_ctrl(true, FTP_CODE_226);
-			if (ret == -ETIMEDOUT || ret == FTP_CODE_226) {
-				break;
-			}
-		} while (1);
+	k_mutex_lock(&ftp_mutex, K_FOREVER);
+	ret = do_ftp_xfer_start(list_cmd, 0);
+	if (FTP_PRELIMINARY_POS(ret)) {
+		(void)do_ftp_recv_data();
+		ret = do_ftp_xfer_end();
 	}
+	k_mutex_unlock(&ftp_mutex);
 
 	return ret;
 }
@@ -553,6 +618,7 @@ int ftp_cwd(const char *folder)
 {
 	int ret;
 
+	k_mutex_lock(&ftp_mutex, K_FOREVER);
 	if (strcmp(folder, "..") == 0) {
 		ret = do_ftp_send_ctrl(CMD_CDUP, sizeof(CMD_CDUP) - 1);
 	} else {
@@ -562,6 +628,7 @@ int ftp_cwd(const char *folder)
 	if (ret == 0) {
 		ret = do_ftp_recv_ctrl(true, FTP_CODE_250);
 	}
+	k_mutex_unlock(&ftp_mutex);
 
 	return ret;
 }
@@ -570,11 +637,13 @@ int ftp_mkd(const char *folder)
 {
 	int ret;
 
+	k_mutex_lock(&ftp_mutex, K_FOREVER);
 	sprintf(ctrl_buf, CMD_MKD, folder);
 	ret = do_ftp_send_ctrl(ctrl_buf, strlen(ctrl_buf));
 	if (ret == 0) {
 		ret = do_ftp_recv_ctrl(true, FTP_CODE_257);
 	}
+	k_mutex_unlock(&ftp_mutex);
 
 	return ret;
 }
@@ -583,11 +652,13 @@ int ftp_rmd(const char *folder)
 {
 	int ret;
 
+	k_mutex_lock(&ftp_mutex, K_FOREVER);
 	sprintf(ctrl_buf, CMD_RMD, folder);
 	ret = do_ftp_send_ctrl(ctrl_buf, strlen(ctrl_buf));
 	if (ret == 0) {
 		ret = do_ftp_recv_ctrl(true, FTP_CODE_250);
 	}
+	k_mutex_unlock(&ftp_mutex);
 
 	return ret;
 }
@@ -596,20 +667,20 @@ int ftp_rename(const char *old_name, const char *new_name)
 {
 	int ret;
 
+	k_mutex_lock(&ftp_mutex, K_FOREVER);
 	sprintf(ctrl_buf, CMD_RNFR, old_name);
 	ret = do_ftp_send_ctrl(ctrl_buf, strlen(ctrl_buf));
 	if (ret == 0) {
 		ret = do_ftp_recv_ctrl(true, FTP_CODE_350);
 	}
-	if (ret != FTP_CODE_350) {
-		return ret;
-	}
-
-	sprintf(ctrl_buf, CMD_RNTO, new_name);
-	ret = do_ftp_send_ctrl(ctrl_buf, strlen(ctrl_buf));
-	if (ret == 0) {
-		ret = do_ftp_recv_ctrl(true, FTP_CODE_250);
+	if (ret == FTP_CODE_350) {
+		sprintf(ctrl_buf, CMD_RNTO, new_name);
+		ret = do_ftp_send_ctrl(ctrl_buf, strlen(ctrl_buf));
+		if (ret == 0) {
+			ret = do_ftp_recv_ctrl(true, FTP_CODE_250);
+		}
 	}
+	k_mutex_unlock(&ftp_mutex);
 
 	return ret;
 }
@@ -618,11 +689,13 @@ int ftp_delete(const char *file)
 {
 	int ret;
 
+	k_mutex_lock(&ftp_mutex, K_FOREVER);
 	sprintf(ctrl_buf, CMD_DELE, file);
 	ret = do_ftp_send_ctrl(ctrl_buf, strlen(ctrl_buf));
 	if (ret == 0) {
 		ret = do_ftp_recv_ctrl(true, FTP_CODE_250);
 	}
+	k_mutex_unlock(&ftp_mutex);
 
 	return ret;
 }
@@ -630,85 +703,152 @@ int ftp_delete(const char *file)
 int ftp_get(const char *file)
 {
 	int ret;
-	char get_cmd[128];
 
-	/* Always set Passive mode to act as TCP client */
-	ret = do_ftp_send_ctrl(CMD_PASV, sizeof(CMD_PASV) - 1);
-	if (ret) {
-		return -EIO;
+	k_mutex_lock(&ftp_mutex, K_FOREVER);
+	ret = ftp_get_start(file, 0);
+	if (FTP_PRELIMINARY_POS(ret)) {
+		(void)do_ftp_recv_data();
+		ret = ftp_get_end();
 	}
-	ret = do_ftp_recv_ctrl(true, FTP_CODE_227);
-	if (ret != FTP_CODE_227) {
-		return ret;
+	k_mutex_unlock(&ftp_mutex);
+
+	return ret;
+}
+
+int ftp_get_start(const char *file, size_t offset)
+{
+	int ret;
+	char get_cmd[128];
+
+	snprintf(get_cmd, sizeof(get_cmd), CMD_RETR, file);
+
+	k_mutex_lock(&ftp_mutex, K_FOREVER);
+	ret = do_ftp_xfer_start(get_cmd, offset);
+	k_mutex_unlock(&ftp_mutex);
+
+	return ret;
+}
+
+int ftp_get_data(uint8_t *buf, size_t length)
+{
+	int ret;
+	struct pollfd fds[1];
+
+	if (client.data_sock == INVALID_SOCKET) {
+		return -EINVAL;
 	}
-	data_task_param.ctrl_msg = ctrl_buf;
-	data_task_param.task = TASK_RECEIVE;
 
-	/* Send RETR command in control channel */
-	sprintf(get_cmd, CMD_RETR, file);
-	ret = do_ftp_send_ctrl(get_cmd, strlen(get_cmd));
-	if (ret) {
+	fds[0].fd = client.data_sock;
+	fds[0].events = POLLIN;
+	ret = poll(fds, 1, MSEC_PER_SEC * CONFIG_FTP_CLIENT_LISTEN_TIME);
+	if (ret < 0) {
+		LOG_ERR("poll(data) failed: (%d)", -errno);
+		return -errno;
+	}
+	if (ret == 0) {
+		LOG_ERR("poll(data) timeout");
+		return -ETIMEDOUT;
+	}
+	if ((fds[0].revents & POLLIN) != POLLIN) {
+		/* POLLERR, POLLHUP or POLLNVAL before the end of the data */
+		LOG_ERR("poll(data) revents: 0x%x", fds[0].revents);
 		return -EIO;
 	}
+	ret = recv(client.data_sock, buf, length, 0);
+	if (ret < 0) {
+		LOG_ERR("recv(data) failed: (%d)", -errno);
+		return -errno;
+	}
+	if (ret == 0) {
+		LOG_INF("No more data");
+	}
 
-	/* Set up data connection */
-	k_work_submit_to_queue(&ftp_work_q, &data_task_param.work);
+	LOG_HEXDUMP_DBG(buf, ret, "RXD");
+	return ret;
+}
 
-	/* Receive control */
-	do {
-		ret = do_ftp_recv_ctrl(false, FTP_CODE_226);
-		if (ret == -ETIMEDOUT || ret == FTP_CODE_226) {
-			break;
-		}
-	} while (1);
+int ftp_get_end(void)
+{
+	int ret;
 
-	if (ret == FTP_CODE_226) {
-		client.ctrl_callback(ctrl_buf, strlen(ctrl_buf));
-	}
+	k_mutex_lock(&ftp_mutex, K_FOREVER);
+	ret = do_ftp_xfer_end();
+	k_mutex_unlock(&ftp_mutex);
 
 	return ret;
 }
 
-int ftp_put(const char *file, const uint8_t *data, uint16_t length)
+int ftp_put(const char *file, const uint8_t *data, size_t length)
 {
 	int ret;
-	char put_cmd[128];
+
+	k_mutex_lock(&ftp_mutex, K_FOREVER);
+	ret = ftp_put_start(file, 0);
+	if (!FTP_PRELIMINARY_POS(ret)) {
+		goto exit;
+	}
 
 	if (data && length) {
-		/* Always set Passive mode to act as TCP client */
-		ret = do_ftp_send_ctrl(CMD_PASV, sizeof(CMD_PASV) - 1);
+		ret = ftp_put_data(data, length);
 		if (ret) {
-			return -EIO;
+			(void)ftp_put_end();
+			goto exit;
 		}
-		ret = do_ftp_recv_ctrl(true, FTP_CODE_227);
-		if (ret != FTP_CODE_227) {
-			return ret;
-		}
-		data_task_param.ctrl_msg = ctrl_buf;
-		data_task_param.task = TASK_SEND;
-		data_task_param.data = (uint8_t *)data;
-		data_task_param.length = length;
 	}
 
-	/* Send STOR command in control channel */
-	sprintf(put_cmd, CMD_STOR, file);
-	ret = do_ftp_send_ctrl(put_cmd, strlen(put_cmd));
+	ret = ftp_put_end();
 
-	/* Now send data */
-	if (data && length) {
-		k_work_submit_to_queue(&ftp_work_q, &data_task_param.work);
-		k_sem_take(&tx_done, K_FOREVER);
+exit:
+	k_mutex_unlock(&ftp_mutex);
+
+	return ret;
+}
+
+int ftp_put_start(const char *file, size_t offset)
+{
+	int ret;
+	char put_cmd[128];
+
+	snprintf(put_cmd, sizeof(put_cmd), CMD_STOR, file);
+
+	k_mutex_lock(&ftp_mutex, K_FOREVER);
+	ret = do_ftp_xfer_start(put_cmd, offset);
+	k_mutex_unlock(&ftp_mutex);
+
+	return ret;
+}
+
+int ftp_put_data(const uint8_t *data, size_t length)
+{
+	int ret;
+	size_t offset = 0;
+
+	if (client.data_sock == INVALID_SOCKET) {
+		return -EINVAL;
 	}
 
-	if (ret == 0) {
-		do {
-			ret = do_ftp_recv_ctrl(true, FTP_CODE_226);
-			if (ret == -ETIMEDOUT || ret == FTP_CODE_226) {
-				break;
-			}
-		} while (1);
+	LOG_HEXDUMP_DBG(data, length, "TXD");
+
+	while (offset < length) {
+		ret = send(client.data_sock, data + offset, length - offset, 0);
+		if (ret < 0) {
+			LOG_ERR("send(data) failed: %d", -errno);
+			return -errno;
+		}
+		offset += ret;
 	}
 
+	return 0;
+}
+
+int ftp_put_end(void)
+{
+	int ret;
+
+	k_mutex_lock(&ftp_mutex, K_FOREVER);
+	ret = do_ftp_xfer_end();
+	k_mutex_unlock(&ftp_mutex);
+
 	return ret;
 }
 
@@ -719,6 +859,7 @@ int ftp_init(ftp_client_callback_t ctrl_callback,
 		return -EINVAL;
 	}
 	client.sock = INVALID_SOCKET;
+	client.data_sock = INVALID_SOCKET;
 	client.connected = false;
 	client.sec_tag = INVALID_SEC_TAG;
 	client.ctrl_callback = ctrl_callback;
@@ -726,7 +867,6 @@ int ftp_init(ftp_client_callback_t ctrl_callback,
 
 	k_work_q_start(&ftp_work_q, ftp_stack_area,
 		K_THREAD_STACK_SIZEOF(ftp_stack_area), FTP_PRIORITY);
-	k_work_init(&data_task_param.work, data_task);
 
 	return 0;
 }
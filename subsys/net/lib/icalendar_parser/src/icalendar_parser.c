@@ -5,6 +5,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <strings.h>
 #include <zephyr.h>
 #include <zephyr/types.h>
@@ -14,402 +15,307 @@
 
 LOG_MODULE_REGISTER(icalendar_parser, CONFIG_ICAL_PARSER_LOG_LEVEL);
 
-static size_t unfold_contentline(const char *buf, char *prop_buf)
+/* Part of the content line being parsed.
+ * Reference: RFC 5545 3.1 Content Lines
+ *
+ * contentline = name *(";" param ) ":" value CRLF
+ */
+enum line_state {
+	LINE_NAME,
+	LINE_PARAM,
+	LINE_VALUE,
+};
+
+/* Properties other than those in the props table */
+enum {
+	PROP_NONE = -1,
+	PROP_BEGIN = -2,
+	PROP_END = -3,
+};
+
+/* Properties of an Event Component that are parsed */
+static const struct {
+	const char *name;
+	enum ical_parser_error_id error;
+	size_t offset;
+	size_t size;
+	/* Property parameters are allowed */
+	bool param;
+} props[] = {
+	{ "SUMMARY", ICAL_ERROR_SUMMARY,
+	  offsetof(struct ical_component, summary),
+	  CONFIG_ICAL_PARSER_SUMMARY_SIZE, false },
+	{ "LOCATION", ICAL_ERROR_LOCATION,
+	  offsetof(struct ical_component, location),
+	  CONFIG_ICAL_PARSER_LOCATION_SIZE, false },
+	{ "DESCRIPTION", ICAL_ERROR_DESCRIPTION,
+	  offsetof(struct ical_component, description),
+	  CONFIG_ICAL_PARSER_DESCRIPTION_SIZE, false },
+	{ "DTSTART", ICAL_ERROR_DTSTART,
+	  offsetof(struct ical_component, dtstart),
+	  CONFIG_ICAL_PARSER_DTSTART_SIZE, true },
+	{ "DTEND", ICAL_ERROR_DTEND,
+	  offsetof(struct ical_component, dtend),
+	  CONFIG_ICAL_PARSER_DTEND_SIZE, true },
+};
+
+/* Calendar components that are reported */
+static const struct {
+	const char *name;
+	enum ical_parser_evt_id id;
+} coms[] = {
+	{ "VEVENT", ICAL_EVT_VEVENT },
+	{ "VTODO", ICAL_EVT_VTODO },
+	{ "VJOURNAL", ICAL_EVT_VJOURNAL },
+	{ "VFREEBUSY", ICAL_EVT_VFREEBUSY },
+	{ "VTIMEZONE", ICAL_EVT_VTIMEZONE },
+};
+
+static void line_reset(struct icalendar_parser *ical)
 {
-	size_t unfold_size = 0;
-	const char *sol = buf;
-	char *eol;
-	uint16_t total_line_len = 0, single_line_len = 0;
-
-	while (1) {
-		eol = strstr(sol, "\r\n");
-		if (!eol) {
-			return 0;
-		}
-		single_line_len = eol - sol;
-		if ((total_line_len + single_line_len)
-		    <= CONFIG_ICAL_PARSER_MAX_PROPERTY_SIZE) {
-			memcpy(prop_buf +
-			       total_line_len, sol, single_line_len);
-			total_line_len += single_line_len;
-		} else {
-			LOG_DBG("Property value overflow."
-				"Increase CONFIG_ICAL_PARSER_MAX_PROPERTY_SIZE.");
-			return 0;
-		}
-		if (!strncmp(eol, "\r\n ", strlen("\r\n "))) {
-			/* Long content line is split into multiple lines.
-			 * Copy the folded part to unfolded buffer.
-			 */
-			sol = eol + strlen("\r\n ");
-		} else {
-			/* Content line is delimited. Count parsed bytes */
-			unfold_size = eol - buf;
-			break;
-		}
-	}
-	prop_buf[unfold_size] = '\0';
-
-	return unfold_size;
+	ical->state = LINE_NAME;
+	ical->name_len = 0;
+	ical->value = NULL;
+	ical->value_len = 0;
+	ical->value_size = 0;
+	ical->prop = PROP_NONE;
+	ical->quoted = false;
+	ical->param = false;
+	ical->overflow = false;
 }
 
-static bool parse_desc_props(const char *buf,
-			     const char *name,
-			     size_t name_size,
-			     char *value,
-			     size_t max_value_len)
+/* The name of the content line is complete. Decide where the value goes. */
+static void name_end(struct icalendar_parser *ical, char delim)
 {
-	bool ret;
-	size_t unfold_size;
-	char ical_prop_buf[CONFIG_ICAL_PARSER_MAX_PROPERTY_SIZE + 1];
-
-	unfold_size = unfold_contentline(buf, ical_prop_buf);
-	if (unfold_size <= 0) {
-		/* Property wrong format - no parameter or value. */
-		LOG_ERR("%s no value/param.", name);
-		return false;
+	if (ical->name_len > ICAL_PARSER_NAME_SIZE) {
+		/* Not a name we know */
+		return;
 	}
+	ical->name[ical->name_len] = '\0';
+	ical->param = (delim == ';');
 
-	if (ical_prop_buf[name_size] == ':') {
-		size_t value_len = unfold_size - name_size - 1;
-
-		if (value_len <= max_value_len) {
-			memcpy(value,
-				ical_prop_buf + name_size + 1,
-				value_len);
-			value[value_len] = '\0';
-			ret = true;
-		} else {
-			/* Property value overflow. */
-			LOG_ERR("%s value overflow.", name);
-			ret = false;
-		}
-	} else if (ical_prop_buf[name_size] == ';') {
-		/* Does not support property parameter. */
-		LOG_ERR("%s param not supported.", name);
-		ret = false;
-	} else {
-		/* Property wrong format - no parameter or value. */
-		LOG_ERR("%s wrong format.", name);
-		ret = false;
+	if (!strcasecmp(ical->name, "BEGIN")) {
+		ical->prop = PROP_BEGIN;
+	} else if (!strcasecmp(ical->name, "END")) {
+		ical->prop = PROP_END;
 	}
-
-	return ret;
-}
-
-static bool parse_datetime_props(const char *buf,
-				 const char *name,
-				 size_t name_size,
-				 char *value,
-				 size_t max_value_len)
-{
-	bool ret;
-	size_t unfold_size;
-	char ical_prop_buf[CONFIG_ICAL_PARSER_MAX_PROPERTY_SIZE + 1];
-
-	unfold_size = unfold_contentline(buf, ical_prop_buf);
-	if (unfold_size <= 0) {
-		/* Property wrong format - fail to unfold property. */
-		LOG_ERR("%s wrong format. Fail to unfold property", name);
-		return false;
+	if (ical->prop != PROP_NONE) {
+		ical->value = ical->com_name;
+		ical->value_size = ICAL_PARSER_NAME_SIZE;
+		return;
 	}
 
-	if (ical_prop_buf[name_size] == ':') {
-		size_t value_len = unfold_size - name_size - 1;
+	/* Only properties of an Event Component, not of the components
+	 * in it, are parsed. After an error the rest of the component is
+	 * skipped.
+	 */
+	if (ical->com_depth != 1 || !ical->com_known ||
+	    ical->evt.id != ICAL_EVT_VEVENT ||
+	    ical->evt.error != ICAL_ERROR_NONE) {
+		return;
+	}
 
-		if (value_len <= max_value_len) {
-			memcpy(value,
-				ical_prop_buf + name_size + 1,
-				value_len);
-			value[value_len] = '\0';
-			ret = true;
-		} else {
-			/* Property value overflow. */
-			LOG_ERR("%s value overflow.", name);
-			ret = false;
-		}
-	} else if (ical_prop_buf[name_size] == ';') {
-		char *dtvalue;
-
-		dtvalue = strchr(ical_prop_buf, ':');
-		if (dtvalue) {
-			dtvalue = dtvalue + 1;
-			size_t value_len;
-
-			value_len = unfold_size -
-					(dtvalue - ical_prop_buf);
-			if (value_len <= max_value_len) {
-				memcpy(value, dtvalue, value_len);
-				value[value_len] = '\0';
-				ret = true;
-			} else {
-				/* Property value overflow. */
-				LOG_ERR("%s value overflow.", name);
-				ret = false;
-			}
-		} else {
-			/* Property wrong format - no value. */
-			LOG_ERR("%s wrong format - no value.", name);
-			ret = false;
+	for (int i = 0; i < ARRAY_SIZE(props); i++) {
+		if (!strcasecmp(ical->name, props[i].name)) {
+			ical->prop = i;
+			ical->value = (char *)&ical->evt.ical_com +
+				      props[i].offset;
+			ical->value_size = props[i].size;
+			break;
 		}
-	} else {
-		/* Property wrong format - no parameter or value. */
-		LOG_ERR("%s wrong format.", name);
-		ret = false;
 	}
-
-	return ret;
 }
 
-static size_t parse_calprops(const char *buf)
+static void com_begin(struct icalendar_parser *ical)
 {
-	const char *parsed = buf;
-	char *end = NULL;
-	char prop_value[CONFIG_ICAL_PARSER_MAX_PROPERTY_SIZE + 1];
-
-	parsed = strstr(parsed, "BEGIN:VCALENDAR\r\n");
-	if (parsed == NULL) {
-		return 0;
+	/* Check begin of iCalendar object delimiter
+	 * Reference: RFC 5545 3.4 iCalendar Object
+	 */
+	if (!ical->icalobject_begin) {
+		if (!strcasecmp(ical->com_name, "VCALENDAR")) {
+			LOG_DBG("Found a calendar stream");
+			ical->icalobject_begin = true;
+		}
+		return;
 	}
-	parsed += strlen("BEGIN:VCALENDAR\r\n");
 
-	end = strstr(parsed, "\r\nBEGIN:");
-	if (end == NULL) {
-		return 0;
-	}
-	end += strlen("\r\n");
-
-	while (parsed < end) {
-		memset(prop_value, 0, sizeof(prop_value));
-		if (!strncmp(parsed, "PRODID", 6)) {
-			if (!parse_desc_props(parsed, "PRODID", 6,
-					prop_value, sizeof(prop_value))) {
-				LOG_ERR("Wrong PRODID");
-			}
-		} else if (!strncmp(parsed, "VERSION", 7)) {
-			if (!parse_desc_props(parsed, "VERSION", 7,
-					prop_value, sizeof(prop_value))) {
-				LOG_ERR("Wrong VERSION");
-			}
+	/* Components can have components in them, such as VALARM in VEVENT
+	 * Reference: RFC 5545 3.6 Calendar Components
+	 */
+	if (ical->com_depth > 0) {
+		if (ical->com_depth < UINT8_MAX) {
+			ical->com_depth++;
 		}
-		parsed = strstr(parsed, "\r\n");
-		parsed += strlen("\r\n");
+		return;
 	}
 
-	return (parsed - buf);
+	ical->com_depth = 1;
+	ical->com_known = false;
+	memset(&ical->evt, 0, sizeof(ical->evt));
+	for (int i = 0; i < ARRAY_SIZE(coms); i++) {
+		if (!strcasecmp(ical->com_name, coms[i].name)) {
+			ical->com_known = true;
+			ical->evt.id = coms[i].id;
+			break;
+		}
+	}
+	if (ical->com_known && ical->evt.id != ICAL_EVT_VEVENT) {
+		ical->evt.error = ICAL_ERROR_COM_NOT_SUPPORTED;
+	}
 }
 
-static size_t parse_eventprop(const char *buf,
-			      struct ical_parser_evt *evt)
+/* Returns non-zero if the callback asked to stop parsing */
+static int com_end(struct icalendar_parser *ical)
 {
-	const char *parsed = buf;
-	char *com_end;
-
-	if (strncmp(buf, "BEGIN:VEVENT\r\n", strlen("BEGIN:VEVENT\r\n"))) {
-		return 0;
-	}
-
-	com_end = strstr(buf, "END:VEVENT\r\n");
-	if (com_end == NULL) {
+	if (!ical->icalobject_begin) {
 		return 0;
 	}
 
-	evt->id = ICAL_EVT_VEVENT;
-	evt->error = ICAL_ERROR_NONE;
-	com_end += strlen("END:VEVENT\r\n");
-	while (parsed < com_end) {
-		if (!strncasecmp(parsed, "SUMMARY", 7)) {
-			if (!parse_desc_props(
-				parsed, "SUMMARY", 7,
-				evt->ical_com.summary,
-				CONFIG_ICAL_PARSER_SUMMARY_SIZE)) {
-				evt->error = ICAL_ERROR_SUMMARY;
-				parsed = com_end;
-			}
-		} else if (!strncasecmp(parsed, "LOCATION", 8)) {
-			if (!parse_desc_props(
-				parsed, "LOCATION", 8,
-				evt->ical_com.location,
-				CONFIG_ICAL_PARSER_LOCATION_SIZE)) {
-				evt->error = ICAL_ERROR_LOCATION;
-				parsed = com_end;
-			}
-		} else if (!strncasecmp(parsed, "DESCRIPTION", 11)) {
-			if (!parse_desc_props(
-				parsed, "DESCRIPTION", 11,
-				evt->ical_com.description,
-				CONFIG_ICAL_PARSER_DESCRIPTION_SIZE)) {
-				evt->error = ICAL_ERROR_DESCRIPTION;
-				parsed = com_end;
-			}
-		} else if (!strncasecmp(parsed, "DTSTART", 7)) {
-			if (!parse_datetime_props(
-				parsed, "DTSTART", 7,
-				evt->ical_com.dtstart,
-				CONFIG_ICAL_PARSER_DTSTART_SIZE)) {
-				evt->error = ICAL_ERROR_DTSTART;
-				parsed = com_end;
-			}
-		} else if (!strncasecmp(parsed,
-					"DTEND", 5)) {
-			if (!parse_datetime_props(
-				parsed, "DTEND", 5,
-				evt->ical_com.dtend,
-				CONFIG_ICAL_PARSER_DTEND_SIZE)) {
-				evt->error = ICAL_ERROR_DTEND;
-				parsed = com_end;
-			}
+	if (ical->com_depth == 0) {
+		if (!strcasecmp(ical->com_name, "VCALENDAR")) {
+			LOG_DBG("End of calendar stream");
+			ical->icalobject_begin = false;
 		}
-
-		/* Move parsed pointer to end of line break */
-		parsed = strstr(parsed, "\r\n") + 2;
+		return 0;
 	}
 
-	return parsed - buf;
-}
-
-static size_t parse_todoprop(const char *buf,
-				struct ical_parser_evt *evt)
-{
-	const char *parsed = buf;
-	char *com_end;
-
-	com_end = strstr(buf, "END:VTODO\r\n");
-	if (com_end) {
-		parsed = com_end + strlen("END:VTODO\r\n");
+	ical->com_depth--;
+	if (ical->com_depth > 0 || !ical->com_known) {
+		return 0;
 	}
-	evt->id = ICAL_EVT_VTODO;
-	evt->error = ICAL_ERROR_COM_NOT_SUPPORTED;
 
-	return parsed - buf;
+	return ical->callback(&ical->evt);
 }
 
-static size_t parse_jourprop(const char *buf,
-				struct ical_parser_evt *evt)
+static void prop_end(struct icalendar_parser *ical)
 {
-	const char *parsed = buf;
-	char *com_end;
+	const char *name = props[ical->prop].name;
+	bool ret = false;
 
-	com_end = strstr(buf, "END:VJOURNAL\r\n");
-	if (com_end) {
-		parsed = com_end + strlen("END:VJOURNAL\r\n");
+	if (ical->state != LINE_VALUE) {
+		/* Property wrong format - no value. */
+		LOG_ERR("%s wrong format - no value.", name);
+	} else if (ical->param && !props[ical->prop].param) {
+		/* Does not support property parameter. */
+		LOG_ERR("%s param not supported.", name);
+	} else if (ical->overflow) {
+		/* Property value overflow. */
+		LOG_ERR("%s value overflow.", name);
+	} else {
+		ret = true;
 	}
-	evt->id = ICAL_EVT_VJOURNAL;
-	evt->error = ICAL_ERROR_COM_NOT_SUPPORTED;
-
-	return parsed - buf;
-}
-
-static size_t parse_fbprop(const char *buf, struct ical_parser_evt *evt)
-{
-	const char *parsed = buf;
-	char *com_end;
 
-	com_end = strstr(buf, "END:VFREEBUSY\r\n");
-	if (com_end) {
-		parsed = com_end + strlen("END:VFREEBUSY\r\n");
+	if (ret) {
+		ical->value[ical->value_len] = '\0';
+	} else {
+		ical->value[0] = '\0';
+		ical->evt.error = props[ical->prop].error;
 	}
-	evt->id = ICAL_EVT_VFREEBUSY;
-	evt->error = ICAL_ERROR_COM_NOT_SUPPORTED;
-
-	return parsed - buf;
 }
 
-static size_t parse_tzprop(const char *buf, struct ical_parser_evt *evt)
+/* The content line is complete. Returns non-zero if the callback asked to
+ * stop parsing.
+ */
+static int line_end(struct icalendar_parser *ical)
 {
-	const char *parsed = buf;
-	char *com_end;
+	int ret = 0;
 
-	com_end = strstr(buf, "END:VTIMEZONE\r\n");
-	if (com_end) {
-		parsed = com_end + strlen("END:VTIMEZONE\r\n");
+	if (ical->prop == PROP_BEGIN || ical->prop == PROP_END) {
+		if (ical->state == LINE_VALUE && !ical->overflow) {
+			ical->com_name[ical->value_len] = '\0';
+		} else {
+			/* Not a component we know */
+			ical->com_name[0] = '\0';
+		}
+		if (ical->prop == PROP_BEGIN) {
+			com_begin(ical);
+		} else {
+			ret = com_end(ical);
+		}
+	} else if (ical->prop >= 0) {
+		prop_end(ical);
 	}
-	evt->id = ICAL_EVT_VTIMEZONE;
-	evt->error = ICAL_ERROR_COM_NOT_SUPPORTED;
 
-	return parsed - buf;
-}
-
-static size_t parse_component(char *buf, struct ical_parser_evt *evt)
-{
-	char *com_begin = buf;
-	size_t ret = 0;
-
-	/* Search begin of component */
-	if (!strncmp(com_begin, "BEGIN:VEVENT\r\n", 14)) {
-		ret += parse_eventprop(com_begin, evt);
-	} else if (!strncmp(com_begin, "BEGIN:VTODO\r\n", 13)) {
-		ret += parse_todoprop(com_begin, evt);
-	} else if (!strncmp(com_begin, "BEGIN:VJOURNAL\r\n", 16)) {
-		ret += parse_jourprop(com_begin, evt);
-	} else if (!strncmp(com_begin, "BEGIN:VFREEBUSY\r\n", 17)) {
-		ret += parse_fbprop(com_begin, evt);
-	} else if (!strncmp(com_begin, "BEGIN:VTIMEZONE\r\n", 17)) {
-		ret += parse_tzprop(com_begin, evt);
-	}
+	line_reset(ical);
 
 	return ret;
 }
 
-static size_t parse_icalbody(char *buf,
-				icalendar_parser_callback_t callback)
+static void line_put(struct icalendar_parser *ical, char c)
 {
-	size_t parsed_bytes = 0, parsed_offset = 0;
-
-	do {
-		struct ical_parser_evt evt;
-
-		parsed_bytes = parse_component(buf + parsed_offset, &evt);
-		parsed_offset += parsed_bytes;
-		if (parsed_bytes > 0) {
-			callback(&evt);
+	switch (ical->state) {
+	case LINE_NAME:
+		if (c == ':' || c == ';') {
+			name_end(ical, c);
+			ical->state = (c == ':') ? LINE_VALUE : LINE_PARAM;
+		} else if (ical->name_len < ICAL_PARSER_NAME_SIZE) {
+			ical->name[ical->name_len++] = c;
+		} else {
+			ical->name_len = ICAL_PARSER_NAME_SIZE + 1;
 		}
-	} while (parsed_bytes > 0);
-
-	return parsed_offset;
+		break;
+	case LINE_PARAM:
+		/* Parameter values can be quoted to have ':' in them */
+		if (c == '"') {
+			ical->quoted = !ical->quoted;
+		} else if (c == ':' && !ical->quoted) {
+			ical->state = LINE_VALUE;
+		}
+		break;
+	case LINE_VALUE:
+		if (ical->value == NULL) {
+			break;
+		}
+		if (ical->value_len < ical->value_size) {
+			ical->value[ical->value_len++] = c;
+		} else {
+			ical->overflow = true;
+		}
+		break;
+	}
 }
 
 size_t ical_parser_parse(struct icalendar_parser *ical,
 			const char *data, size_t len)
 {
-	size_t parsed_offset = 0;
+	for (size_t i = 0; i < len; i++) {
+		char c = data[i];
 
-	if (CONFIG_ICAL_PARSER_BUFFER_SIZE < (ical->offset + len)) {
-		return -ENOBUFS;
-	}
-
-	memcpy(ical->buf + ical->offset, data, len);
-	ical->buf[ical->offset + len] = '\0';
+		if (c == '\r') {
+			continue;
+		}
 
-	/* Check begin of iCalendar object delimiter
-	 * Reference: RFC 5545 3.4 iCalendar Object
-	 */
-	if (!ical->icalobject_begin) {
-		/* The body of the iCalendar object consists of
-		 * a sequence of calendar properties and
-		 * one or more calendar components.
-		 *
-		 * Reference: RFC 5545 3.6 Calendar Components
+		/* A long content line is split into multiple lines, each
+		 * after the first starting with a space or a tab. A line
+		 * is only complete when the next one starts with neither.
+		 * Reference: RFC 5545 3.1 Content Lines
 		 */
-		parsed_offset += parse_calprops(ical->buf);
-		if (parsed_offset > 0) {
-			LOG_DBG("Found a calendar stream");
-			ical->icalobject_begin = true;
+		if (ical->eol) {
+			ical->eol = false;
+			if (c == ' ' || c == '\t') {
+				continue;
+			}
+			(void)line_end(ical);
 		}
-	}
 
-	/* If we got a calendar property, start parsing calendar body. */
-	if (ical->icalobject_begin) {
-		parsed_offset += parse_icalbody(ical->buf + parsed_offset,
-						ical->callback);
-	}
+		if (c != '\n') {
+			line_put(ical, c);
+			continue;
+		}
 
-	if (parsed_offset) {
-		ical->offset = ical->offset + len - parsed_offset;
-		memcpy(ical->buf, ical->buf + parsed_offset, ical->offset);
+		/* BEGIN and END lines are not folded, so a component is
+		 * reported without waiting for more data.
+		 */
+		if (ical->prop == PROP_BEGIN || ical->prop == PROP_END) {
+			if (line_end(ical)) {
+				return i + 1;
+			}
+		} else {
+			ical->eol = true;
+		}
 	}
 
-	return parsed_offset;
+	return len;
 }
 
 int ical_parser_init(struct icalendar_parser *ical,
@@ -421,7 +327,10 @@ int ical_parser_init(struct icalendar_parser *ical,
 
 	ical->callback = callback;
 	ical->icalobject_begin = false;
-	ical->offset = 0;
+	ical->com_depth = 0;
+	ical->com_known = false;
+	ical->eol = false;
+	line_reset(ical);
 
 	return 0;
 }
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <net/mqtt_topic_trie.h>
+
+#define ROOT 0
+#define NONE 0
+
+static bool level_eq(const struct mqtt_topic_trie_node *node,
+		     const char *level, size_t len)
+{
+	return node->len == len && memcmp(node->level, level, len) == 0;
+}
+
+static bool is_wildcard(const struct mqtt_topic_trie_node *node, char c)
+{
+	return node->len == 1 && node->level[0] == c;
+}
+
+/* Length of the level at the start of str, up to the next '/' or end */
+static size_t level_len(const char *str, const char *end)
+{
+	const char *slash = memchr(str, '/', end - str);
+
+	return slash ? slash - str : end - str;
+}
+
+static bool level_valid(const char *level, size_t len, bool last)
+{
+	for (size_t i = 0; i < len; i++) {
+		if ((level[i] == '+' || level[i] == '#') && len != 1) {
+			/* Wildcards take a whole level */
+			return false;
+		}
+	}
+
+	/* The multi-level wildcard is the last level */
+	return !(len == 1 && level[0] == '#' && !last);
+}
+
+void mqtt_topic_trie_clear(struct mqtt_topic_trie *trie)
+{
+	__ASSERT_NO_MSG(trie != NULL);
+	__ASSERT_NO_MSG(trie->size > 0);
+
+	trie->nodes[ROOT] = (struct mqtt_topic_trie_node){
+		.value = MQTT_TOPIC_TRIE_NO_VALUE,
+	};
+	trie->count = 1;
+}
+
+/* Child of a node for a level, or NONE */
+static uint16_t child_find(const struct mqtt_topic_trie *trie,
+			   uint16_t parent, const char *level, size_t len)
+{
+	uint16_t node;
+
+	for (node = trie->nodes[parent].child; node != NONE;
+	     node = trie->nodes[node].sibling) {
+		if (level_eq(&trie->nodes[node], level, len)) {
+			break;
+		}
+	}
+
+	return node;
+}
+
+int mqtt_topic_trie_add(struct mqtt_topic_trie *trie, const char *filter,
+			size_t len, int value)
+{
+	const char *end = filter + len;
+	const char *level;
+	uint16_t parent = ROOT;
+	uint16_t node = ROOT;
+	bool found = true;
+	size_t missing = 0;
+	size_t n;
+
+	__ASSERT_NO_MSG(trie != NULL);
+
+	if (filter == NULL || len == 0 || value < 0 || value > INT16_MAX) {
+		return -EINVAL;
+	}
+
+	if (trie->count == 0) {
+		mqtt_topic_trie_clear(trie);
+	}
+
+	/* Validate the filter and count the nodes to add, so that nothing
+	 * is changed if the filter can not be added.
+	 */
+	for (level = filter; ; level += n + 1) {
+		n = level_len(level, end);
+
+		if (n > UINT16_MAX || !level_valid(level, n, level + n == end)) {
+			return -EINVAL;
+		}
+
+		/* The root has index zero too, so track the path separately */
+		if (found) {
+			node = child_find(trie, node, level, n);
+			found = node != NONE;
+		}
+
+		if (!found) {
+			missing++;
+		}
+
+		if (level + n == end) {
+			break;
+		}
+	}
+
+	if (missing > (size_t)(trie->size - trie->count)) {
+		return -ENOMEM;
+	}
+
+	if (missing == 0 && trie->nodes[node].value != MQTT_TOPIC_TRIE_NO_VALUE) {
+		return -EEXIST;
+	}
+
+	for (level = filter; ; level += n + 1) {
+		n = level_len(level, end);
+
+		node = child_find(trie, parent, level, n);
+		if (node == NONE) {
+			node = trie->count++;
+
+			trie->nodes[node] = (struct mqtt_topic_trie_node){
+				.level = level,
+				.len = n,
+				.sibling = trie->nodes[parent].child,
+				.value = MQTT_TOPIC_TRIE_NO_VALUE,
+			};
+			trie->nodes[parent].child = node;
+		}
+
+		parent = node;
+
+		if (level + n == end) {
+			break;
+		}
+	}
+
+	trie->nodes[parent].value = value;
+
+	return 0;
+}
+
+/* Matches the rest of a topic below a node. The topic is at its end if
+ * at_end is set, otherwise topic points to the next level, which may be
+ * empty.
+ */
+static int node_match(const struct mqtt_topic_trie *trie, uint16_t parent,
+		      const char *topic, const char *end, bool at_end)
+{
+	const struct mqtt_topic_trie_node *child;
+	uint16_t plus = NONE;
+	uint16_t hash = NONE;
+	size_t n = 0;
+	int ret;
+
+	/* Wildcards do not match topics starting with '$' at the top level */
+	bool system = parent == ROOT && !at_end && topic < end &&
+		      topic[0] == '$';
+
+	if (!at_end) {
+		n = level_len(topic, end);
+	}
+
+	for (uint16_t node = trie->nodes[parent].child; node != NONE;
+	     node = child->sibling) {
+		child = &trie->nodes[node];
+
+		if (is_wildcard(child, '#')) {
+			hash = node;
+		} else if (at_end) {
+			continue;
+		} else if (is_wildcard(child, '+')) {
+			plus = node;
+		} else if (level_eq(child, topic, n)) {
+			ret = topic + n == end ?
+			      node_match(trie, node, end, end, true) :
+			      node_match(trie, node, topic + n + 1, end, false);
+			if (ret >= 0) {
+				return ret;
+			}
+		}
+	}
+
+	if (at_end) {
+		if (trie->nodes[parent].value != MQTT_TOPIC_TRIE_NO_VALUE) {
+			return trie->nodes[parent].value;
+		}
+
+		/* "a/#" also matches "a" */
+		return hash != NONE && trie->nodes[hash].value >= 0 ?
+		       trie->nodes[hash].value : -ENOENT;
+	}
+
+	if (plus != NONE && !system) {
+		ret = topic + n == end ?
+		      node_match(trie, plus, end, end, true) :
+		      node_match(trie, plus, topic + n + 1, end, false);
+		if (ret >= 0) {
+			return ret;
+		}
+	}
+
+	if (hash != NONE && !system) {
+		return trie->nodes[hash].value;
+	}
+
+	return -ENOENT;
+}
+
+int mqtt_topic_trie_match(const struct mqtt_topic_trie *trie,
+			  const char *topic, size_t len)
+{
+	__ASSERT_NO_MSG(trie != NULL);
+
+	if (topic == NULL || len == 0 || trie->count == 0) {
+		return -ENOENT;
+	}
+
+	return node_match(trie, ROOT, topic, topic + len, false);
+}
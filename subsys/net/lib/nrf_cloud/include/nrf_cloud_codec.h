@@ -9,6 +9,7 @@
 
 #include <stdbool.h>
 
+#include <net/cloud.h>
 #include <net/nrf_cloud.h>
 #include "nrf_cloud_fsm.h"
 
@@ -16,6 +17,11 @@
 extern "C" {
 #endif
 
+/**@brief Encoding of the sensor data sent on the data topic. */
+#define NRF_CLOUD_ENCODING \
+	(IS_ENABLED(CONFIG_NRF_CLOUD_ENCODING_CBOR) ? \
+	 CLOUD_ENCODING_CBOR : CLOUD_ENCODING_JSON)
+
 /**@brief Initialize the codec used encoding the data to the cloud. */
 int nrf_codec_init(void);
 
@@ -23,9 +29,17 @@ int nrf_codec_init(void);
 int nrf_cloud_encode_sensor_data(const struct nrf_cloud_sensor_data *input,
 				 struct nrf_cloud_data *output);
 
-/**@brief Encode the sensor data to be sent to the device shadow. */
-int nrf_cloud_encode_shadow_data(const struct nrf_cloud_sensor_data *sensor,
-				 struct nrf_cloud_data *output);
+/**@brief Encode the sensor data into a buffer.
+ *
+ * @return Length of the encoded data, or -ENOMEM if it does not fit.
+ *         JSON data needs one byte more, for the NUL character.
+ */
+int nrf_cloud_encode_sensor_data_buf(const struct nrf_cloud_sensor_data *sensor,
+				     void *buf, size_t size);
+
+/**@brief Encode the JSON text of a sensor to be sent to the device shadow. */
+int nrf_cloud_encode_shadow_data(enum nrf_cloud_sensor type, const char *json,
+				 size_t len, struct nrf_cloud_data *output);
 
 /**@brief Encode the user association data based on the indicated type. */
 int nrf_cloud_decode_requested_state(const struct nrf_cloud_data *payload,
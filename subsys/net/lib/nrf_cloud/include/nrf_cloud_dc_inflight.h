@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef NRF_CLOUD_DC_INFLIGHT_H__
+#define NRF_CLOUD_DC_INFLIGHT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <net/mqtt.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@brief Check if a message id is one of the fixed ids of the control
+ * channel and of the subscriptions, see nrf_cloud_transport.h.
+ */
+bool nct_message_id_reserved(uint16_t id);
+
+/**@brief Get the next message id of the control or the data channel.
+ *
+ * Skips zero, the reserved ids and the ids of the data channel messages in
+ * flight.
+ */
+uint16_t nct_message_id_next(void);
+
+/**@brief Keep a copy of a reliable data channel message until it is
+ * acknowledged.
+ *
+ * If the message id is zero, the next free one is given to the message and
+ * written to @p publish. The slot is taken before publishing, as the PUBACK
+ * can be handled by the polling thread before mqtt_publish() returns.
+ *
+ * @retval 0 The message is kept.
+ * @retval -EALREADY A message with the same id is in flight.
+ * @retval -EAGAIN CONFIG_NRF_CLOUD_DC_INFLIGHT_MAX messages are in flight.
+ * @retval -ENOMEM The copy could not be allocated.
+ */
+int nct_dc_inflight_add(struct mqtt_publish_param *publish);
+
+/**@brief Release a message that could not be published. Does nothing if
+ * no message with the id is in flight.
+ */
+void nct_dc_inflight_release(uint16_t id);
+
+/**@brief Release a message on its PUBACK.
+ *
+ * @return true if the id is the one of a data channel message in flight.
+ */
+bool nct_dc_inflight_ack(uint16_t id);
+
+/**@brief Send the messages in flight again, with the DUP flag set.
+ *
+ * Messages that could not be sent are kept for the next reconnect.
+ *
+ * @return 0 or the error of mqtt_publish().
+ */
+int nct_dc_inflight_retransmit(struct mqtt_client *client);
+
+/**@brief Release all messages in flight, when the broker did not keep the
+ * session.
+ *
+ * @return Number of messages released.
+ */
+size_t nct_dc_inflight_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NRF_CLOUD_DC_INFLIGHT_H__ */
@@ -13,6 +13,30 @@
 extern "C" {
 #endif
 
+/* Fixed message ids of the control channel and of the subscriptions. They
+ * are never given to other messages, so that a PUBACK can be routed by its
+ * id. Each can be any unique unsigned 16-bit integer value except zero.
+ */
+
+/**@brief Default message identifier. */
+#define NCT_DEFAULT_REPORT_ID 1
+
+/**@brief Identifier for subscribing to the control channel topics. */
+#define NCT_CC_SUBSCRIBE_ID 1234
+
+/**@brief Identifier for cloud state request. */
+#define NCT_CLOUD_STATE_REQ_ID 5678
+
+/**@brief Identifier for message sent to report status in UA_COMPLETE state.
+ */
+#define NCT_PAIRING_STATUS_REPORT_ID 7890
+
+/**@brief Identifier for subscribing to the data channel topics. */
+#define NCT_DC_SUBSCRIBE_ID 8765
+
+/**@brief Identifier for user association data. */
+#define NCT_CC_UA_DATA_ID 9547
+
 enum nct_evt_type {
 	NCT_EVT_CONNECTED,
 	NCT_EVT_CC_CONNECTED,
@@ -78,6 +102,11 @@ int nct_cc_send(const struct nct_cc_data *cc);
 
 /**@brief Sends data on the data channel. Reliable, should expect a @ref
  * NCT_EVT_DC_TX_DATA_ACK event.
+ *
+ * The data is copied and kept until it is acknowledged, and sent again
+ * after a reconnect if the broker kept the session. Returns -EAGAIN if CONFIG_NRF_CLOUD_DC_INFLIGHT_MAX
+ * messages are waiting for acknowledgment, and -EALREADY if one of them
+ * has the same id.
  */
 int nct_dc_send(const struct nct_dc_data *dc);
 
@@ -111,6 +140,14 @@ void nct_dc_endpoint_get(struct nrf_cloud_data *tx_endpoint,
 			 struct nrf_cloud_data *rx_endpoint,
 			 struct nrf_cloud_data *m_endpoint);
 
+/**
+ * @brief Restore the endpoint information saved with the persistent session.
+ *
+ * @retval 0 If the endpoints were restored.
+ * @retval -ENOENT If there is no persistent session, or no saved endpoints.
+ */
+int nct_dc_endpoint_restore(void);
+
 /**@brief Needed for keep alive. */
 void nct_process(void);
 
@@ -6,10 +6,15 @@
 #include <net/socket.h>
 #include <net/cloud.h>
 #include <net/nrf_cloud.h>
+#if defined(CONFIG_NRF_CLOUD_SHADOW_DELTA)
+#include <net/cloud_state_cache.h>
+#endif
 #include "nrf_cloud_codec.h"
 #include "nrf_cloud_fsm.h"
 #include "nrf_cloud_transport.h"
 #include "nrf_cloud_mem.h"
+#include "cJSON.h"
+#include "cJSON_os.h"
 
 #include <logging/log.h>
 
@@ -18,11 +23,6 @@ LOG_MODULE_REGISTER(nrf_cloud, CONFIG_NRF_CLOUD_LOG_LEVEL);
 /* Validates if the API was requested in the right state. */
 #define NOT_VALID_STATE(EXPECTED) ((EXPECTED) < current_state)
 
-/* Identifier for user association message sent to the cloud.
- * A unique, unsigned 16 bit magic number. Can't be zero.
- */
-#define CC_UA_DATA_ID 9547
-
 /* Maintains the state with respect to the cloud. */
 static volatile enum nfsm_state current_state = STATE_IDLE;
 
@@ -36,6 +36,12 @@ static nrf_cloud_event_handler_t app_event_handler;
 
 static K_MUTEX_DEFINE(state_mutex);
 
+#if defined(CONFIG_NRF_CLOUD_SHADOW_DELTA)
+/* Shadow members reported with nrf_cloud_shadow_json_update() */
+CLOUD_STATE_CACHE_DEFINE(shadow_cache, 16);
+static K_MUTEX_DEFINE(shadow_cache_mutex);
+#endif
+
 enum nfsm_state nfsm_get_current_state(void)
 {
 	return current_state;
@@ -44,6 +50,18 @@ enum nfsm_state nfsm_get_current_state(void)
 void nfsm_set_current_state_and_notify(enum nfsm_state state,
 				       const struct nrf_cloud_evt *evt)
 {
+#if defined(CONFIG_NRF_CLOUD_SHADOW_DELTA)
+	if ((evt != NULL) &&
+	    (evt->type == NRF_CLOUD_EVT_TRANSPORT_CONNECTED)) {
+		/* Updates are cached as reported once sent, so all of the
+		 * shadow is reported again on a new connection.
+		 */
+		k_mutex_lock(&shadow_cache_mutex, K_FOREVER);
+		cloud_state_cache_reset(&shadow_cache);
+		k_mutex_unlock(&shadow_cache_mutex);
+	}
+#endif
+
 	k_mutex_lock(&state_mutex, K_FOREVER);
 	LOG_DBG("state: %d", state);
 
@@ -105,37 +123,95 @@ int nrf_cloud_disconnect(void)
 		return -EACCES;
 	}
 
+	if (IS_ENABLED(CONFIG_NRF_CLOUD_BATCH)) {
+		/* Best effort, the batch is kept if it can not be sent */
+		(void)nrf_cloud_sensor_data_batch_flush();
+	}
+
 	atomic_set(&disconnect_requested, 1);
 	return nct_disconnect();
 }
 
-int nrf_cloud_shadow_update(const struct nrf_cloud_sensor_data *param)
+static int shadow_update(enum nrf_cloud_sensor type, const char *json,
+			 size_t len, uint32_t tag)
 {
 	int err;
 	struct nct_cc_data sensor_data = {
 		.opcode = NCT_CC_OPCODE_UPDATE_REQ,
-		.id = param->tag
+		.id = tag
 	};
 
+	err = nrf_cloud_encode_shadow_data(type, json, len, &sensor_data.data);
+	if (err) {
+		return err;
+	}
+
+#if defined(CONFIG_NRF_CLOUD_SHADOW_DELTA)
+	k_mutex_lock(&shadow_cache_mutex, K_FOREVER);
+
+	err = cloud_state_cache_delta(&shadow_cache, sensor_data.data.ptr,
+				      sensor_data.data.len,
+				      (char *)sensor_data.data.ptr,
+				      sensor_data.data.len + 1);
+	if (err > 0) {
+		sensor_data.data.len = err;
+		err = nct_cc_send(&sensor_data);
+		if (err == 0) {
+			cloud_state_cache_ack(&shadow_cache);
+		}
+	} else if (err == 0) {
+		LOG_DBG("Shadow data unchanged, not sent");
+	}
+
+	k_mutex_unlock(&shadow_cache_mutex);
+#else
+	err = nct_cc_send(&sensor_data);
+#endif
+	nrf_cloud_free((void *)sensor_data.data.ptr);
+
+	return err;
+}
+
+int nrf_cloud_shadow_update(const struct nrf_cloud_sensor_data *param)
+{
+	int err;
+	char *json;
+
 	if (NOT_VALID_STATE(STATE_DC_CONNECTED)) {
 		return -EACCES;
 	}
 
-	if (param == NULL) {
+	if (param == NULL || param->data.ptr == NULL) {
 		return -EINVAL;
 	}
 
-	err = nrf_cloud_encode_shadow_data(param, &sensor_data.data);
-	if (err) {
-		return err;
+	/* Deleted here, as it was with the cJSON shadow document before */
+	json = cJSON_PrintUnformatted((cJSON *)param->data.ptr);
+	cJSON_Delete((cJSON *)param->data.ptr);
+	if (json == NULL) {
+		return -ENOMEM;
 	}
 
-	err = nct_cc_send(&sensor_data);
-	nrf_cloud_free((void *)sensor_data.data.ptr);
+	err = shadow_update(param->type, json, strlen(json), param->tag);
+	cJSON_FreeString(json);
 
 	return err;
 }
 
+int nrf_cloud_shadow_json_update(enum nrf_cloud_sensor type,
+				 const char *json, size_t len)
+{
+	if (NOT_VALID_STATE(STATE_DC_CONNECTED)) {
+		return -EACCES;
+	}
+
+	if (json == NULL || len == 0) {
+		return -EINVAL;
+	}
+
+	return shadow_update(type, json, len, 0);
+}
+
 int nrf_cloud_sensor_attach(const struct nrf_cloud_sa_param *param)
 {
 	if (NOT_VALID_STATE(STATE_DC_CONNECTED)) {
@@ -336,6 +412,7 @@ static int api_init(const struct cloud_backend *const backend,
 	};
 
 	backend->config->handler = handler;
+	backend->config->encoding = NRF_CLOUD_ENCODING;
 	nrf_cloud_backend = (struct cloud_backend *)backend;
 
 	return nrf_cloud_init(&params);
@@ -25,6 +25,7 @@ extern void agps_print(enum nrf_cloud_agps_type type, void *data);
 static int fd = -1;
 static bool agps_print_enabled;
 static const struct device *gps_dev;
+static nrf_cloud_agps_data_handler_t data_handler;
 
 static enum gps_agps_type type_lookup_socket2gps[] = {
 	[NRF_GNSS_AGPS_UTC_PARAMETERS]	= GPS_AGPS_UTC_PARAMETERS,
@@ -227,8 +228,13 @@ static int send_to_modem(void *data, size_t data_len,
 
 	/* At this point, GPS driver or app-provided socket is assumed. */
 	if (gps_dev) {
-		return gps_agps_write(gps_dev, type_socket2gps(type), data,
-				      data_len);
+		err = gps_agps_write(gps_dev, type_socket2gps(type), data,
+				     data_len);
+		if (!err && data_handler) {
+			data_handler(type_socket2gps(type), data, data_len);
+		}
+
+		return err;
 	}
 
 	err = nrf_sendto(fd, data, data_len, 0, &type, sizeof(type));
@@ -245,6 +251,10 @@ static int send_to_modem(void *data, size_t data_len,
 		agps_print(type, data);
 	}
 
+	if (!err && data_handler) {
+		data_handler(type_socket2gps(type), data, data_len);
+	}
+
 	return err;
 }
 
@@ -535,6 +545,11 @@ static size_t get_next_agps_element(struct nrf_cloud_apgs_element *element,
 	return len;
 }
 
+void nrf_cloud_agps_data_handler_set(nrf_cloud_agps_data_handler_t handler)
+{
+	data_handler = handler;
+}
+
 int nrf_cloud_agps_process(const char *buf, size_t buf_len, const int *socket)
 {
 	int err;
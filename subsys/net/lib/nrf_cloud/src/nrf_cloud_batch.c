@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <net/nrf_cloud.h>
+#include "nrf_cloud_codec.h"
+#include "nrf_cloud_fsm.h"
+#include "nrf_cloud_transport.h"
+
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(nrf_cloud_batch, CONFIG_NRF_CLOUD_LOG_LEVEL);
+
+/* Start and end of the array of messages, for JSON and for CBOR arrays of
+ * indefinite length.
+ */
+#define JSON_ARRAY_START '['
+#define JSON_ARRAY_SEP ','
+#define JSON_ARRAY_END ']'
+#define CBOR_ARRAY_START 0x9f
+#define CBOR_ARRAY_END 0xff
+
+#define IS_JSON (NRF_CLOUD_ENCODING == CLOUD_ENCODING_JSON)
+
+/* Validates if the API was requested in the right state. */
+#define NOT_VALID_STATE(EXPECTED) ((EXPECTED) < nfsm_get_current_state())
+
+static struct {
+	/* Array of the messages added since the last flush */
+	uint8_t buf[CONFIG_NRF_CLOUD_BATCH_SIZE];
+	/* Length of the array, without its end */
+	size_t len;
+	/* Number of messages in the array */
+	size_t count;
+} batch;
+
+static K_MUTEX_DEFINE(batch_mutex);
+
+static void batch_work_fn(struct k_work *work);
+static K_DELAYED_WORK_DEFINE(batch_work, batch_work_fn);
+
+static int batch_append(const struct nrf_cloud_sensor_data *sensor)
+{
+	size_t start;
+	int len;
+
+	if (batch.count == 0) {
+		batch.buf[0] = IS_JSON ? JSON_ARRAY_START : CBOR_ARRAY_START;
+		batch.len = 1;
+	}
+
+	/* JSON messages are separated by a comma, CBOR data items are not */
+	start = batch.len + (IS_JSON && batch.count > 0);
+
+	/* Room for the end of the array */
+	if (start + 1 >= sizeof(batch.buf)) {
+		return -ENOMEM;
+	}
+
+	len = nrf_cloud_encode_sensor_data_buf(sensor, &batch.buf[start],
+					       sizeof(batch.buf) - start - 1);
+	if (len < 0) {
+		return len;
+	}
+
+	if (IS_JSON && batch.count > 0) {
+		batch.buf[batch.len] = JSON_ARRAY_SEP;
+	}
+
+	batch.len = start + len;
+	batch.count++;
+
+	return 0;
+}
+
+static int batch_flush(void)
+{
+	int err;
+	struct nct_dc_data msg = {
+		.data.ptr = batch.buf,
+	};
+
+	if (batch.count == 0) {
+		return 0;
+	}
+
+	if (NOT_VALID_STATE(STATE_DC_CONNECTED)) {
+		return -EACCES;
+	}
+
+	batch.buf[batch.len] = IS_JSON ? JSON_ARRAY_END : CBOR_ARRAY_END;
+	msg.data.len = batch.len + 1;
+
+	if (IS_ENABLED(CONFIG_NRF_CLOUD_BATCH_RELIABLE)) {
+		err = nct_dc_send(&msg);
+	} else {
+		err = nct_dc_stream(&msg);
+	}
+
+	if (err) {
+		/* The messages are kept, and sent on the next flush */
+		return err;
+	}
+
+	LOG_DBG("Sent %d messages in %d bytes", batch.count, msg.data.len);
+
+	batch.count = 0;
+	batch.len = 0;
+
+	k_delayed_work_cancel(&batch_work);
+
+	return 0;
+}
+
+static void batch_work_fn(struct k_work *work)
+{
+	int err;
+
+	k_mutex_lock(&batch_mutex, K_FOREVER);
+	err = batch_flush();
+	k_mutex_unlock(&batch_mutex);
+
+	if (err) {
+		LOG_ERR("Batch could not be sent, error: %d", err);
+	}
+}
+
+int nrf_cloud_sensor_data_batch(const struct nrf_cloud_sensor_data *param)
+{
+	int err;
+
+	if (NOT_VALID_STATE(STATE_DC_CONNECTED)) {
+		return -EACCES;
+	}
+
+	if (param == NULL) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&batch_mutex, K_FOREVER);
+
+	err = batch_append(param);
+	if (err == -ENOMEM && batch.count > 0) {
+		/* Full, send the batch and start a new one */
+		err = batch_flush();
+		if (!err) {
+			err = batch_append(param);
+		}
+	}
+
+	if (err == -ENOMEM) {
+		LOG_ERR("Message does not fit in CONFIG_NRF_CLOUD_BATCH_SIZE");
+		err = -EMSGSIZE;
+	}
+
+	if (!err && k_delayed_work_remaining_get(&batch_work) == 0) {
+		/* The first message of a batch waits the longest. The timer
+		 * is also restarted if sending the batch failed before.
+		 */
+		k_delayed_work_submit(&batch_work,
+				      K_MSEC(CONFIG_NRF_CLOUD_BATCH_LATENCY));
+	}
+
+	k_mutex_unlock(&batch_mutex);
+
+	return err;
+}
+
+int nrf_cloud_sensor_data_batch_flush(void)
+{
+	int err;
+
+	k_mutex_lock(&batch_mutex, K_FOREVER);
+	err = batch_flush();
+	k_mutex_unlock(&batch_mutex);
+
+	return err;
+}
@@ -11,6 +11,9 @@
 #include <string.h>
 #include <zephyr.h>
 #include <logging/log.h>
+#include <json_writer.h>
+#include <json_path.h>
+#include <net/cloud_encoder.h>
 #include "cJSON.h"
 #include "cJSON_os.h"
 
@@ -41,30 +44,6 @@ static int json_add_obj(cJSON *parent, const char *str, cJSON *item)
 	return 0;
 }
 
-static int json_add_str(cJSON *parent, const char *str, const char *item)
-{
-	cJSON *json_str;
-
-	json_str = cJSON_CreateString(item);
-	if (json_str == NULL) {
-		return -ENOMEM;
-	}
-
-	return json_add_obj(parent, str, json_str);
-}
-
-static int json_add_null(cJSON *parent, const char *str)
-{
-	cJSON *json_null;
-
-	json_null = cJSON_CreateNull();
-	if (json_null == NULL) {
-		return -ENOMEM;
-	}
-
-	return json_add_obj(parent, str, json_null);
-}
-
 static cJSON *json_object_decode(cJSON *obj, const char *str)
 {
 	return obj ? cJSON_GetObjectItem(obj, str) : NULL;
@@ -119,44 +98,71 @@ int nrf_codec_init(void)
 	return 0;
 }
 
-int nrf_cloud_encode_shadow_data(const struct nrf_cloud_sensor_data *sensor,
-				 struct nrf_cloud_data *output)
+static int encode(json_writer_encode_t encoder, void *ctx,
+		  struct nrf_cloud_data *output)
 {
-	int ret;
+	int err;
 	char *buffer;
+	size_t len;
 
-	__ASSERT_NO_MSG(sensor != NULL);
-	__ASSERT_NO_MSG(sensor->data.ptr != NULL);
-	__ASSERT_NO_MSG(sensor->data.len != 0);
-	__ASSERT_NO_MSG(output != NULL);
+	err = json_writer_encode_alloc(encoder, ctx, &buffer, &len);
+	if (err) {
+		return err;
+	}
 
-	cJSON *root_obj = cJSON_CreateObject();
-	cJSON *state_obj = cJSON_CreateObject();
-	cJSON *reported_obj = cJSON_CreateObject();
+	output->ptr = buffer;
+	output->len = len;
 
-	if (root_obj == NULL || state_obj == NULL || reported_obj == NULL) {
-		cJSON_Delete(root_obj);
-		cJSON_Delete(state_obj);
-		cJSON_Delete(reported_obj);
-		return -ENOMEM;
-	}
+	return 0;
+}
 
-	ret = json_add_obj(reported_obj, sensor_type_str[sensor->type],
-			   (cJSON *)sensor->data.ptr);
-	ret += json_add_obj(state_obj, "reported", reported_obj);
-	ret += json_add_obj(root_obj, "state", state_obj);
+struct shadow_ctx {
+	enum nrf_cloud_sensor type;
+	const char *json;
+	size_t len;
+};
 
-	if (ret != 0) {
-		cJSON_Delete(root_obj);
-		cJSON_Delete(state_obj);
-		cJSON_Delete(reported_obj);
-	}
+static int shadow_data_encode(struct json_writer *w, void *ctx)
+{
+	const struct shadow_ctx *shadow = ctx;
 
-	buffer = cJSON_PrintUnformatted(root_obj);
-	cJSON_Delete(root_obj);
+	json_writer_obj_start(w, NULL);
+	json_writer_obj_start(w, "state");
+	json_writer_obj_start(w, "reported");
+	json_writer_raw(w, sensor_type_str[shadow->type], shadow->json,
+			shadow->len);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
 
-	output->ptr = buffer;
-	output->len = strlen(buffer);
+	return 0;
+}
+
+int nrf_cloud_encode_shadow_data(enum nrf_cloud_sensor type, const char *json,
+				 size_t len, struct nrf_cloud_data *output)
+{
+	struct shadow_ctx shadow = {
+		.type = type,
+		.json = json,
+		.len = len,
+	};
+
+	__ASSERT_NO_MSG(json != NULL);
+	__ASSERT_NO_MSG(len != 0);
+	__ASSERT_NO_MSG(output != NULL);
+
+	return encode(shadow_data_encode, &shadow, output);
+}
+
+static int sensor_data_encode(struct cloud_encoder *enc, void *ctx)
+{
+	const struct nrf_cloud_sensor_data *sensor = ctx;
+
+	cloud_encoder_obj_start(enc, NULL);
+	cloud_encoder_str(enc, "appId", sensor_type_str[sensor->type]);
+	cloud_encoder_str(enc, "data", sensor->data.ptr);
+	cloud_encoder_str(enc, "messageType", "DATA");
+	cloud_encoder_obj_end(enc);
 
 	return 0;
 }
@@ -164,39 +170,64 @@ int nrf_cloud_encode_shadow_data(const struct nrf_cloud_sensor_data *sensor,
 int nrf_cloud_encode_sensor_data(const struct nrf_cloud_sensor_data *sensor,
 				 struct nrf_cloud_data *output)
 {
-	int ret;
+	int err;
+	char *buffer;
+	size_t len;
 
 	__ASSERT_NO_MSG(sensor != NULL);
 	__ASSERT_NO_MSG(sensor->data.ptr != NULL);
 	__ASSERT_NO_MSG(sensor->data.len != 0);
 	__ASSERT_NO_MSG(output != NULL);
 
-	cJSON *root_obj = cJSON_CreateObject();
-
-	if (root_obj == NULL) {
-		return -ENOMEM;
+	err = cloud_encoder_encode_alloc(NRF_CLOUD_ENCODING, sensor_data_encode,
+					 (void *)sensor, &buffer, &len);
+	if (err) {
+		return err;
 	}
 
-	ret = json_add_str(root_obj, "appId", sensor_type_str[sensor->type]);
-	ret += json_add_str(root_obj, "data", sensor->data.ptr);
-	ret += json_add_str(root_obj, "messageType", "DATA");
+	output->ptr = buffer;
+	output->len = len;
 
-	if (ret != 0) {
-		cJSON_Delete(root_obj);
-		return -ENOMEM;
-	}
+	return 0;
+}
 
-	char *buffer;
+int nrf_cloud_encode_sensor_data_buf(const struct nrf_cloud_sensor_data *sensor,
+				     void *buf, size_t size)
+{
+	int err;
+	struct cloud_encoder enc;
 
-	buffer = cJSON_PrintUnformatted(root_obj);
-	cJSON_Delete(root_obj);
+	__ASSERT_NO_MSG(sensor != NULL);
+	__ASSERT_NO_MSG(sensor->data.ptr != NULL);
+	__ASSERT_NO_MSG(sensor->data.len != 0);
+	__ASSERT_NO_MSG(buf != NULL);
 
-	output->ptr = buffer;
-	output->len = strlen(buffer);
+	err = cloud_encoder_init(&enc, NRF_CLOUD_ENCODING, buf, size);
+	if (err) {
+		return err;
+	}
 
-	return 0;
+	err = sensor_data_encode(&enc, (void *)sensor);
+	if (err) {
+		return err;
+	}
+
+	return cloud_encoder_finish(&enc);
 }
 
+/* Paths used from a shadow delta or a full shadow document */
+enum requested_state_value {
+	STATE,
+	STATE_TOPIC_PREFIX,
+	STATE_PAIRING_STATE,
+	STATE_CONFIG,
+	DESIRED_TOPIC_PREFIX,
+	DESIRED_PAIRING_STATE,
+	DESIRED_CONFIG,
+
+	REQUESTED_STATE_VALUE_COUNT,
+};
+
 int nrf_cloud_decode_requested_state(const struct nrf_cloud_data *input,
 				     enum nfsm_state *requested_state)
 {
@@ -205,60 +236,72 @@ int nrf_cloud_decode_requested_state(const struct nrf_cloud_data *input,
 	__ASSERT_NO_MSG(input->ptr != NULL);
 	__ASSERT_NO_MSG(input->len != 0);
 
-	cJSON *root_obj;
-	cJSON *desired_obj;
-	cJSON *pairing_obj;
-	cJSON *pairing_state_obj;
-	cJSON *topic_prefix_obj;
+	struct json_path_query q[] = {
+		[STATE] = JSON_PATH_QUERY("state"),
+		[STATE_TOPIC_PREFIX] =
+			JSON_PATH_QUERY("state.nrfcloud_mqtt_topic_prefix"),
+		[STATE_PAIRING_STATE] = JSON_PATH_QUERY("state.pairing.state"),
+		[STATE_CONFIG] = JSON_PATH_QUERY("state.config"),
+		[DESIRED_TOPIC_PREFIX] =
+			JSON_PATH_QUERY("desired.nrfcloud_mqtt_topic_prefix"),
+		[DESIRED_PAIRING_STATE] =
+			JSON_PATH_QUERY("desired.pairing.state"),
+		[DESIRED_CONFIG] = JSON_PATH_QUERY("desired.config"),
+	};
+	const struct json_path_query *topic_prefix;
+	const struct json_path_query *pairing_state;
+	const struct json_path_query *config;
+	int err;
 
-	root_obj = cJSON_Parse(input->ptr);
-	if (root_obj == NULL) {
-		LOG_ERR("cJSON_Parse failed: %s",
+	BUILD_ASSERT(ARRAY_SIZE(q) == REQUESTED_STATE_VALUE_COUNT);
+
+	err = json_path_extract(input->ptr, input->len, q, ARRAY_SIZE(q));
+	if (err < 0) {
+		LOG_ERR("JSON parsing failed: %s",
 			log_strdup((char *)input->ptr));
 		return -ENOENT;
 	}
 
-	nrf_cloud_decode_desired_obj(root_obj, &desired_obj);
+	/* On initial pairing, a shadow delta event is sent which does not
+	 * include the "desired" JSON key, "state" is used instead.
+	 */
+	if (json_path_found(&q[STATE])) {
+		topic_prefix = &q[STATE_TOPIC_PREFIX];
+		pairing_state = &q[STATE_PAIRING_STATE];
+		config = &q[STATE_CONFIG];
+	} else {
+		topic_prefix = &q[DESIRED_TOPIC_PREFIX];
+		pairing_state = &q[DESIRED_PAIRING_STATE];
+		config = &q[DESIRED_CONFIG];
+	}
 
-	topic_prefix_obj =
-		json_object_decode(desired_obj, "nrfcloud_mqtt_topic_prefix");
-	if (topic_prefix_obj != NULL) {
+	if (json_path_found(topic_prefix)) {
 		(*requested_state) = STATE_UA_PIN_COMPLETE;
-		cJSON_Delete(root_obj);
 		return 0;
 	}
 
-	pairing_obj = json_object_decode(desired_obj, "pairing");
-	pairing_state_obj = json_object_decode(pairing_obj, "state");
-
-	if (!pairing_state_obj || pairing_state_obj->type != cJSON_String) {
-		if (cJSON_HasObjectItem(desired_obj, "config") == false) {
+	if (pairing_state->value.type != JSON_PATH_STRING) {
+		if (!json_path_found(config)) {
 			LOG_WRN("Unhandled data received from nRF Cloud.");
 			LOG_INF("Ensure device firmware is up to date.");
 			LOG_INF("Delete and re-add device to nRF Cloud if problem persists.");
 		}
-		cJSON_Delete(root_obj);
 		return -ENOENT;
 	}
 
-	const char *state_str = pairing_state_obj->valuestring;
-
-	if (compare(state_str, DUA_PIN_STR)) {
+	if (json_path_str_eq(&pairing_state->value, DUA_PIN_STR)) {
 		(*requested_state) = STATE_UA_PIN_WAIT;
 	} else {
 		LOG_ERR("Deprecated state. Delete device from nRF Cloud and update device with JITP certificates.");
-		cJSON_Delete(root_obj);
 		return -ENOTSUP;
 	}
 
-	cJSON_Delete(root_obj);
-
 	return 0;
 }
 
-int nrf_cloud_encode_config_response(struct nrf_cloud_data const *const input,
-				     struct nrf_cloud_data *const output,
-				     bool *const has_config)
+static int config_response_encode(struct nrf_cloud_data const *const input,
+				  struct nrf_cloud_data *const output,
+				  bool *const has_config)
 {
 	__ASSERT_NO_MSG(output != NULL);
 	__ASSERT_NO_MSG(input != NULL);
@@ -332,130 +375,119 @@ int nrf_cloud_encode_config_response(struct nrf_cloud_data const *const input,
 		return -ENOMEM;
 	}
 
-	output->ptr = buffer;
 	output->len = strlen(buffer);
 
+	if (IS_ENABLED(CONFIG_CJSON_ARENA)) {
+		/* The response must outlive the arena scope */
+		output->ptr = nrf_cloud_malloc(output->len + 1);
+		if (output->ptr != NULL) {
+			memcpy((char *)output->ptr, buffer, output->len + 1);
+		}
+
+		cJSON_FreeString(buffer);
+
+		if (output->ptr == NULL) {
+			return -ENOMEM;
+		}
+	} else {
+		output->ptr = buffer;
+	}
+
 	return 0;
 }
 
-int nrf_cloud_encode_state(uint32_t reported_state, struct nrf_cloud_data *output)
+int nrf_cloud_encode_config_response(struct nrf_cloud_data const *const input,
+				     struct nrf_cloud_data *const output,
+				     bool *const has_config)
 {
-	int ret;
+	int err;
 
-	__ASSERT_NO_MSG(output != NULL);
+	cJSON_ArenaBegin();
+	err = config_response_encode(input, output, has_config);
+	cJSON_ArenaEnd();
 
-	cJSON *root_obj = cJSON_CreateObject();
-	cJSON *state_obj = cJSON_CreateObject();
-	cJSON *reported_obj = cJSON_CreateObject();
-	cJSON *pairing_obj = cJSON_CreateObject();
-	cJSON *connection_obj = cJSON_CreateObject();
+	return err;
+}
 
-	if ((root_obj == NULL) || (state_obj == NULL) ||
-	    (reported_obj == NULL) || (pairing_obj == NULL) ||
-	    (connection_obj == NULL)) {
-		cJSON_Delete(root_obj);
-		cJSON_Delete(state_obj);
-		cJSON_Delete(reported_obj);
-		cJSON_Delete(pairing_obj);
-		cJSON_Delete(connection_obj);
+struct state_ctx {
+	uint32_t state;
+	struct nrf_cloud_data tx_endp;
+	struct nrf_cloud_data rx_endp;
+	struct nrf_cloud_data m_endp;
+};
 
-		return -ENOMEM;
-	}
+static int state_encode(struct json_writer *w, void *ctx)
+{
+	const struct state_ctx *state = ctx;
 
-	ret = 0;
+	json_writer_obj_start(w, NULL);
+	json_writer_obj_start(w, "state");
+	json_writer_obj_start(w, "reported");
 
-	switch (reported_state) {
-	case STATE_UA_PIN_WAIT: {
-		ret += json_add_str(pairing_obj, "state", DUA_PIN_STR);
-		ret += json_add_null(pairing_obj, "topics");
-		ret += json_add_null(pairing_obj, "config");
-		ret += json_add_null(reported_obj, "stage");
-		ret += json_add_null(reported_obj,
-				     "nrfcloud_mqtt_topic_prefix");
-		ret += json_add_null(connection_obj, "keepalive");
-		break;
-	}
-	case STATE_UA_PIN_COMPLETE: {
-		struct nrf_cloud_data rx_endp;
-		struct nrf_cloud_data tx_endp;
-		struct nrf_cloud_data m_endp;
+	if (state->state == STATE_UA_PIN_WAIT) {
+		json_writer_null(w, "stage");
+		json_writer_null(w, "nrfcloud_mqtt_topic_prefix");
 
-		/* Get the endpoint information. */
-		nct_dc_endpoint_get(&tx_endp, &rx_endp, &m_endp);
-		ret += json_add_str(reported_obj, "nrfcloud_mqtt_topic_prefix",
-				    m_endp.ptr);
+		json_writer_obj_start(w, "pairing");
+		json_writer_str(w, "state", DUA_PIN_STR);
+		json_writer_null(w, "topics");
+		json_writer_null(w, "config");
+		json_writer_obj_end(w);
+
+		json_writer_obj_start(w, "connection");
+		json_writer_null(w, "keepalive");
+		json_writer_obj_end(w);
+	} else {
+		json_writer_str(w, "nrfcloud_mqtt_topic_prefix",
+				state->m_endp.ptr);
 
 		/* Clear pairing config and pairingStatus fields. */
-		ret += json_add_str(pairing_obj, "state", PAIRED_STR);
-		ret += json_add_null(pairing_obj, "config");
-		ret += json_add_null(reported_obj, "pairingStatus");
+		json_writer_null(w, "pairingStatus");
 
-		/* Report keepalive value. */
-		if (cJSON_AddNumberToObject(connection_obj, "keepalive",
-					    CONFIG_MQTT_KEEPALIVE) == NULL) {
-			ret = -ENOMEM;
-		}
+		json_writer_obj_start(w, "pairing");
+		json_writer_str(w, "state", PAIRED_STR);
+		json_writer_null(w, "config");
 
 		/* Report pairing topics. */
-		cJSON *topics_obj = cJSON_CreateObject();
+		json_writer_obj_start(w, "topics");
+		json_writer_str(w, "d2c", state->tx_endp.ptr);
+		json_writer_str(w, "c2d", state->rx_endp.ptr);
+		json_writer_obj_end(w);
+		json_writer_obj_end(w);
 
-		if (topics_obj == NULL) {
-			cJSON_Delete(root_obj);
-			cJSON_Delete(state_obj);
-			cJSON_Delete(reported_obj);
-			cJSON_Delete(pairing_obj);
-			cJSON_Delete(connection_obj);
-
-			return -ENOMEM;
-		}
-
-		ret += json_add_str(topics_obj, "d2c", tx_endp.ptr);
-		ret += json_add_str(topics_obj, "c2d", rx_endp.ptr);
-		ret += json_add_obj(pairing_obj, "topics", topics_obj);
-
-		if (ret != 0) {
-			cJSON_Delete(topics_obj);
-		}
-		break;
-	}
-	default: {
-		cJSON_Delete(root_obj);
-		cJSON_Delete(state_obj);
-		cJSON_Delete(reported_obj);
-		cJSON_Delete(pairing_obj);
-		cJSON_Delete(connection_obj);
-		return -ENOTSUP;
-	}
+		/* Report keepalive value. */
+		json_writer_obj_start(w, "connection");
+		json_writer_int(w, "keepalive", CONFIG_MQTT_KEEPALIVE);
+		json_writer_obj_end(w);
 	}
 
-	ret += json_add_obj(reported_obj, "pairing", pairing_obj);
-	ret += json_add_obj(reported_obj, "connection", connection_obj);
-	ret += json_add_obj(state_obj, "reported", reported_obj);
-	ret += json_add_obj(root_obj, "state", state_obj);
-
-	if (ret != 0) {
-		cJSON_Delete(root_obj);
-		cJSON_Delete(state_obj);
-		cJSON_Delete(reported_obj);
-		cJSON_Delete(pairing_obj);
-		cJSON_Delete(connection_obj);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
 
-		return -ENOMEM;
-	}
+	return 0;
+}
 
-	char *buffer;
+int nrf_cloud_encode_state(uint32_t reported_state, struct nrf_cloud_data *output)
+{
+	struct state_ctx ctx = {
+		.state = reported_state,
+	};
 
-	buffer = cJSON_PrintUnformatted(root_obj);
-	cJSON_Delete(root_obj);
+	__ASSERT_NO_MSG(output != NULL);
 
-	if (buffer == NULL) {
-		return -ENOMEM;
+	switch (reported_state) {
+	case STATE_UA_PIN_WAIT:
+		break;
+	case STATE_UA_PIN_COMPLETE:
+		/* Get the endpoint information. */
+		nct_dc_endpoint_get(&ctx.tx_endp, &ctx.rx_endp, &ctx.m_endp);
+		break;
+	default:
+		return -ENOTSUP;
 	}
 
-	output->ptr = buffer;
-	output->len = strlen(buffer);
-
-	return 0;
+	return encode(state_encode, &ctx, output);
 }
 
 /**
@@ -465,10 +497,10 @@ int nrf_cloud_encode_state(uint32_t reported_state, struct nrf_cloud_data *outpu
  *
  * @retval 0 or an error code indicating reason for failure
  */
-int nrf_cloud_decode_data_endpoint(const struct nrf_cloud_data *input,
-				   struct nrf_cloud_data *tx_endpoint,
-				   struct nrf_cloud_data *rx_endpoint,
-				   struct nrf_cloud_data *m_endpoint)
+static int data_endpoint_decode(const struct nrf_cloud_data *input,
+				struct nrf_cloud_data *tx_endpoint,
+				struct nrf_cloud_data *rx_endpoint,
+				struct nrf_cloud_data *m_endpoint)
 {
 	__ASSERT_NO_MSG(input != NULL);
 	__ASSERT_NO_MSG(input->ptr != NULL);
@@ -538,3 +570,18 @@ int nrf_cloud_decode_data_endpoint(const struct nrf_cloud_data *input,
 
 	return err;
 }
+
+int nrf_cloud_decode_data_endpoint(const struct nrf_cloud_data *input,
+				   struct nrf_cloud_data *tx_endpoint,
+				   struct nrf_cloud_data *rx_endpoint,
+				   struct nrf_cloud_data *m_endpoint)
+{
+	int err;
+
+	cJSON_ArenaBegin();
+	err = data_endpoint_decode(input, tx_endpoint, rx_endpoint,
+				   m_endpoint);
+	cJSON_ArenaEnd();
+
+	return err;
+}
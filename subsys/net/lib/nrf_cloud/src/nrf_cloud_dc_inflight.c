@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include "nrf_cloud_dc_inflight.h"
+#include "nrf_cloud_transport.h"
+#include "nrf_cloud_mem.h"
+
+#include <zephyr.h>
+#include <string.h>
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(nrf_cloud_dc_inflight, CONFIG_NRF_CLOUD_LOG_LEVEL);
+
+/* Reliable data channel message that is waiting for its PUBACK. The topic
+ * and the payload are copied to buf, so that the message can be sent again
+ * after a reconnect.
+ */
+struct dc_inflight {
+	uint8_t *buf;
+	uint32_t len;
+	uint16_t topic_len;
+	uint16_t id;
+};
+
+static struct dc_inflight dc_inflight[CONFIG_NRF_CLOUD_DC_INFLIGHT_MAX];
+static uint16_t message_id;
+static K_MUTEX_DEFINE(dc_inflight_mutex);
+
+static const uint16_t reserved_message_ids[] = {
+	NCT_DEFAULT_REPORT_ID,
+	NCT_CC_SUBSCRIBE_ID,
+	NCT_CLOUD_STATE_REQ_ID,
+	NCT_PAIRING_STATUS_REPORT_ID,
+	NCT_DC_SUBSCRIBE_ID,
+	NCT_CC_UA_DATA_ID,
+};
+
+/* Must be called with dc_inflight_mutex locked. */
+static struct dc_inflight *dc_inflight_find(uint16_t id)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(dc_inflight); i++) {
+		if (dc_inflight[i].buf != NULL && dc_inflight[i].id == id) {
+			return &dc_inflight[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void dc_inflight_free(struct dc_inflight *slot)
+{
+	nrf_cloud_free(slot->buf);
+	slot->buf = NULL;
+}
+
+/* Must be called with dc_inflight_mutex locked. */
+static uint16_t message_id_next(void)
+{
+	do {
+		message_id++;
+	} while (message_id == 0 || nct_message_id_reserved(message_id) ||
+		 dc_inflight_find(message_id) != NULL);
+
+	return message_id;
+}
+
+bool nct_message_id_reserved(uint16_t id)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(reserved_message_ids); i++) {
+		if (reserved_message_ids[i] == id) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+uint16_t nct_message_id_next(void)
+{
+	uint16_t id;
+
+	k_mutex_lock(&dc_inflight_mutex, K_FOREVER);
+	id = message_id_next();
+	k_mutex_unlock(&dc_inflight_mutex);
+
+	return id;
+}
+
+int nct_dc_inflight_add(struct mqtt_publish_param *publish)
+{
+	const struct mqtt_topic *topic = &publish->message.topic;
+	const struct mqtt_binstr *payload = &publish->message.payload;
+	struct dc_inflight *slot = NULL;
+	int err = 0;
+
+	k_mutex_lock(&dc_inflight_mutex, K_FOREVER);
+
+	if (publish->message_id == 0) {
+		publish->message_id = message_id_next();
+	} else if (dc_inflight_find(publish->message_id) != NULL) {
+		/* Same message id as a message in flight */
+		err = -EALREADY;
+		goto exit;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(dc_inflight); i++) {
+		if (dc_inflight[i].buf == NULL) {
+			slot = &dc_inflight[i];
+			break;
+		}
+	}
+
+	if (slot == NULL) {
+		/* Window full, wait for a PUBACK */
+		err = -EAGAIN;
+		goto exit;
+	}
+
+	slot->buf = nrf_cloud_malloc(topic->topic.size + payload->len);
+	if (slot->buf == NULL) {
+		err = -ENOMEM;
+		goto exit;
+	}
+
+	memcpy(slot->buf, topic->topic.utf8, topic->topic.size);
+	if (payload->len != 0) {
+		memcpy(slot->buf + topic->topic.size, payload->data,
+		       payload->len);
+	}
+
+	slot->topic_len = topic->topic.size;
+	slot->len = payload->len;
+	slot->id = publish->message_id;
+
+exit:
+	k_mutex_unlock(&dc_inflight_mutex);
+
+	return err;
+}
+
+void nct_dc_inflight_release(uint16_t id)
+{
+	(void)nct_dc_inflight_ack(id);
+}
+
+bool nct_dc_inflight_ack(uint16_t id)
+{
+	struct dc_inflight *slot;
+
+	k_mutex_lock(&dc_inflight_mutex, K_FOREVER);
+
+	slot = dc_inflight_find(id);
+	if (slot != NULL) {
+		dc_inflight_free(slot);
+	}
+
+	k_mutex_unlock(&dc_inflight_mutex);
+
+	return slot != NULL;
+}
+
+int nct_dc_inflight_retransmit(struct mqtt_client *client)
+{
+	int err = 0;
+
+	k_mutex_lock(&dc_inflight_mutex, K_FOREVER);
+
+	for (size_t i = 0; i < ARRAY_SIZE(dc_inflight); i++) {
+		struct dc_inflight *slot = &dc_inflight[i];
+		struct mqtt_publish_param publish = {
+			.message.topic.qos = MQTT_QOS_1_AT_LEAST_ONCE,
+			.message_id = slot->id,
+			.dup_flag = 1,
+		};
+
+		if (slot->buf == NULL) {
+			continue;
+		}
+
+		publish.message.topic.topic.utf8 = slot->buf;
+		publish.message.topic.topic.size = slot->topic_len;
+		publish.message.payload.data = slot->buf + slot->topic_len;
+		publish.message.payload.len = slot->len;
+
+		LOG_DBG("Retransmitting message id %d", slot->id);
+
+		err = mqtt_publish(client, &publish);
+		if (err) {
+			/* Kept for the next reconnect */
+			LOG_ERR("Retransmission failed: %d", err);
+			break;
+		}
+	}
+
+	k_mutex_unlock(&dc_inflight_mutex);
+
+	return err;
+}
+
+size_t nct_dc_inflight_clear(void)
+{
+	size_t count = 0;
+
+	k_mutex_lock(&dc_inflight_mutex, K_FOREVER);
+
+	for (size_t i = 0; i < ARRAY_SIZE(dc_inflight); i++) {
+		if (dc_inflight[i].buf != NULL) {
+			dc_inflight_free(&dc_inflight[i]);
+			count++;
+		}
+	}
+
+	k_mutex_unlock(&dc_inflight_mutex);
+
+	return count;
+}
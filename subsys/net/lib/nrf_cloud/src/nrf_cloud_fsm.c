@@ -13,21 +13,6 @@
 
 LOG_MODULE_REGISTER(nrf_cloud_fsm, CONFIG_NRF_CLOUD_LOG_LEVEL);
 
-/**@brief Identifier for cloud state request.
- * Can be any unique unsigned 16-bit integer value except zero.
- */
-#define CLOUD_STATE_REQ_ID 5678
-
-/**@brief Identifier for message sent to report status in UA_COMPLETE state.
- * Can be any unique unsigned 16-bit integer value except zero.
- */
-#define PAIRING_STATUS_REPORT_ID 7890
-
-/**@brief Default message identifier.
- * Can be any unique unsigned 16-bit integer value except zero.
- */
-#define DEFAULT_REPORT_ID 1
-
 typedef int (*fsm_transition)(const struct nct_evt *nct_evt);
 
 static int drop_event_handler(const struct nct_evt *nct_evt);
@@ -155,7 +140,7 @@ static int state_ua_pin_wait(void)
 	int err;
 	struct nct_cc_data msg = {
 		.opcode = NCT_CC_OPCODE_UPDATE_REQ,
-		.id = DEFAULT_REPORT_ID,
+		.id = NCT_DEFAULT_REPORT_ID,
 	};
 
 	/* Publish report to the cloud on current status. */
@@ -189,7 +174,7 @@ static int handle_device_config_update(const struct nct_evt *const evt,
 	int err;
 	struct nct_cc_data msg = {
 		.opcode = NCT_CC_OPCODE_UPDATE_REQ,
-		.id = DEFAULT_REPORT_ID,
+		.id = NCT_DEFAULT_REPORT_ID,
 	};
 
 	struct nrf_cloud_evt cloud_evt = {
@@ -237,7 +222,7 @@ static int state_ua_pin_complete(void)
 	int err;
 	struct nct_cc_data msg = {
 		.opcode = NCT_CC_OPCODE_UPDATE_REQ,
-		.id = PAIRING_STATUS_REPORT_ID,
+		.id = NCT_PAIRING_STATUS_REPORT_ID,
 	};
 
 	err = nrf_cloud_encode_state(STATE_UA_PIN_COMPLETE, &msg.data);
@@ -271,6 +256,23 @@ static int drop_event_handler(const struct nct_evt *nct_evt)
 	return 0;
 }
 
+/* Resume a session whose subscriptions and data endpoints are known.
+ * Shadow changes made while offline are still received, as the broker
+ * keeps the messages for the subscribed delta topic, so the shadow is not
+ * requested again.
+ */
+static void session_resume(void)
+{
+	struct nrf_cloud_evt evt = {
+		.type = NRF_CLOUD_EVT_USER_ASSOCIATED,
+	};
+
+	nfsm_set_current_state_and_notify(STATE_UA_PIN_COMPLETE, &evt);
+
+	evt.type = NRF_CLOUD_EVT_READY;
+	nfsm_set_current_state_and_notify(STATE_DC_CONNECTED, &evt);
+}
+
 static int connection_handler(const struct nct_evt *nct_evt)
 {
 	int err;
@@ -299,6 +301,9 @@ static int connection_handler(const struct nct_evt *nct_evt)
 			return err;
 		}
 		nfsm_set_current_state_and_notify(STATE_CC_CONNECTING, NULL);
+	} else if (nct_dc_endpoint_restore() == 0) {
+		LOG_DBG("Previous session valid; resuming it");
+		session_resume();
 	} else {
 		struct nct_evt nevt = { .type = NCT_EVT_CC_CONNECTED,
 					.status = 0 };
@@ -307,7 +312,6 @@ static int connection_handler(const struct nct_evt *nct_evt)
 		nfsm_handle_incoming_event(&nevt, STATE_CC_CONNECTING);
 	}
 
-
 	return 0;
 }
 
@@ -332,7 +336,7 @@ static int cc_connection_handler(const struct nct_evt *nct_evt)
 	 */
 	static const struct nct_cc_data get_request = {
 		.opcode = NCT_CC_OPCODE_GET_REQ,
-		.id = CLOUD_STATE_REQ_ID,
+		.id = NCT_CLOUD_STATE_REQ_ID,
 	};
 
 	int err;
@@ -431,13 +435,13 @@ static int cc_tx_ack_handler(const struct nct_evt *nct_evt)
 {
 	int err;
 
-	if (nct_evt->param.data_id == CLOUD_STATE_REQ_ID) {
+	if (nct_evt->param.data_id == NCT_CLOUD_STATE_REQ_ID) {
 		nfsm_set_current_state_and_notify(STATE_CLOUD_STATE_REQUESTED,
 						  NULL);
 		return 0;
 	}
 
-	if (nct_evt->param.data_id == PAIRING_STATUS_REPORT_ID) {
+	if (nct_evt->param.data_id == NCT_PAIRING_STATUS_REPORT_ID) {
 		if (!persistent_session) {
 			err = nct_dc_connect();
 			if (err) {
@@ -461,7 +465,7 @@ static int cc_tx_ack_handler(const struct nct_evt *nct_evt)
 
 static int cc_tx_ack_in_state_requested_handler(const struct nct_evt *nct_evt)
 {
-	if (nct_evt->param.data_id == CLOUD_STATE_REQ_ID) {
+	if (nct_evt->param.data_id == NCT_CLOUD_STATE_REQ_ID) {
 		nfsm_set_current_state_and_notify(STATE_CLOUD_STATE_REQUESTED,
 						  NULL);
 	}
@@ -501,7 +505,14 @@ static int dc_rx_data_handler(const struct nct_evt *nct_evt)
 
 static int dc_tx_ack_handler(const struct nct_evt *nct_evt)
 {
-	return 0; /* Nothing to do */
+	struct nrf_cloud_evt cloud_evt = {
+		.type = NRF_CLOUD_EVT_SENSOR_DATA_ACK,
+		.status = nct_evt->param.data_id,
+	};
+
+	nfsm_set_current_state_and_notify(nfsm_get_current_state(), &cloud_evt);
+
+	return 0;
 }
 
 static int dc_disconnection_handler(const struct nct_evt *nct_evt)
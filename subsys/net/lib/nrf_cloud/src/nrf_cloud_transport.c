@@ -5,12 +5,14 @@
  */
 
 #include "nrf_cloud_transport.h"
+#include "nrf_cloud_dc_inflight.h"
 #include "nrf_cloud_mem.h"
 
 #include <zephyr.h>
 #include <stdio.h>
 #include <fcntl.h>
 #include <net/mqtt.h>
+#include <net/mqtt_topic_trie.h>
 #include <net/socket.h>
 #include <net/cloud.h>
 #include <logging/log.h>
@@ -105,12 +107,6 @@ static int last_sent_fota_progress;
 static bool initialized;
 static bool persistent_session;
 
-#define NCT_CC_SUBSCRIBE_ID 1234
-#define NCT_DC_SUBSCRIBE_ID 8765
-
-#define NCT_RX_LIST 0
-#define NCT_TX_LIST 1
-
 static int nct_settings_set(const char *key, size_t len_rd,
 			    settings_read_cb read_cb, void *cb_arg);
 
@@ -123,6 +119,27 @@ static int nct_settings_set(const char *key, size_t len_rd,
 SETTINGS_STATIC_HANDLER_DEFINE(nrf_cloud, SETTINGS_NAME, NULL, nct_settings_set,
 			       NULL, NULL);
 
+/* Data channel endpoints, saved with the session so that a session can be
+ * resumed without requesting them from the shadow again.
+ */
+enum session_endp {
+	SESSION_ENDP_TX,
+	SESSION_ENDP_RX,
+	SESSION_ENDP_M,
+	SESSION_ENDP_COUNT,
+};
+
+static const char *const session_endp_key[SESSION_ENDP_COUNT] = {
+	[SESSION_ENDP_TX] = "dc_tx",
+	[SESSION_ENDP_RX] = "dc_rx",
+	[SESSION_ENDP_M] = "dc_m",
+};
+
+static struct nrf_cloud_data session_endp[SESSION_ENDP_COUNT];
+
+/* Time of the last connection attempt, until the first data publish */
+static int64_t connect_start_time;
+
 /* Forward declaration of the event handler registered with MQTT. */
 static void nct_mqtt_evt_handler(struct mqtt_client *client,
 				 const struct mqtt_evt *evt);
@@ -136,7 +153,6 @@ static struct nct {
 	struct mqtt_utf8 dc_rx_endp;
 	struct mqtt_utf8 dc_m_endp;
 	struct mqtt_utf8 job_status_endp;
-	uint32_t message_id;
 	uint8_t rx_buf[CONFIG_NRF_CLOUD_MQTT_MESSAGE_BUFFER_LEN];
 	uint8_t tx_buf[CONFIG_NRF_CLOUD_MQTT_MESSAGE_BUFFER_LEN];
 	uint8_t payload_buf[CONFIG_NRF_CLOUD_MQTT_PAYLOAD_BUFFER_LEN];
@@ -189,6 +205,11 @@ static uint32_t const nct_cc_rx_opcode_map[] = {
 	NCT_CC_OPCODE_UPDATE_ACCEPT_RSP
 };
 
+/* Routes the control channel topics to their index in nct_cc_rx_list.
+ * The topics have up to six levels each, and share the first ones.
+ */
+MQTT_TOPIC_TRIE_DEFINE(nct_cc_rx_trie, 16);
+
 /* Internal routine to reset data endpoint information. */
 static void dc_endpoint_reset(void)
 {
@@ -205,18 +226,6 @@ static void dc_endpoint_reset(void)
 	nct.job_status_endp.size = 0;
 }
 
-/* Get the next unused message id. */
-static uint32_t dc_get_next_message_id(void)
-{
-	nct.message_id++;
-
-	if ((uint16_t)nct.message_id == 0) {
-		nct.message_id++;
-	}
-
-	return nct.message_id;
-}
-
 /* Free memory allocated for the data endpoint and reset the endpoint.
  *
  * Casting away const for rx, tx, and m seems to be OK because the
@@ -244,8 +253,20 @@ static void dc_endpoint_free(void)
 	dc_endpoint_reset();
 }
 
-static uint32_t dc_send(const struct nct_dc_data *dc_data, uint8_t qos)
+/* Log the time from the start of connecting to the first data publish. */
+static void first_publish_log(void)
+{
+	if (connect_start_time != 0) {
+		LOG_INF("First data publish %d ms after connecting",
+			(int)(k_uptime_get() - connect_start_time));
+		connect_start_time = 0;
+	}
+}
+
+static int dc_send(const struct nct_dc_data *dc_data, uint8_t qos)
 {
+	int err;
+
 	if (dc_data == NULL) {
 		return -EINVAL;
 	}
@@ -262,48 +283,49 @@ static uint32_t dc_send(const struct nct_dc_data *dc_data, uint8_t qos)
 		publish.message.payload.len = dc_data->data.len;
 	}
 
-	if (dc_data->id != 0) {
-		publish.message_id = dc_data->id;
+	if (qos != MQTT_QOS_0_AT_MOST_ONCE &&
+	    nct_message_id_reserved(dc_data->id)) {
+		/* The PUBACK would be taken for a control channel one */
+		LOG_ERR("Message id %d is reserved", dc_data->id);
+		return -EINVAL;
+	}
+
+	publish.message_id = dc_data->id;
+
+	if (qos == MQTT_QOS_0_AT_MOST_ONCE) {
+		if (publish.message_id == 0) {
+			publish.message_id = nct_message_id_next();
+		}
 	} else {
-		publish.message_id = dc_get_next_message_id();
+		err = nct_dc_inflight_add(&publish);
+		if (err) {
+			return err;
+		}
 	}
 
-	return mqtt_publish(&nct.client, &publish);
-}
+	err = mqtt_publish(&nct.client, &publish);
+	if (!err) {
+		first_publish_log();
+	} else if (qos != MQTT_QOS_0_AT_MOST_ONCE) {
+		nct_dc_inflight_release(publish.message_id);
+	}
 
-static bool strings_compare(const char *s1, const char *s2, uint32_t s1_len,
-			    uint32_t s2_len)
-{
-	return (strncmp(s1, s2, MIN(s1_len, s2_len))) ? false : true;
+	return err;
 }
 
 /* Verify if the topic is a control channel topic or not. */
-static bool control_channel_topic_match(uint32_t list_id,
-					const struct mqtt_topic *topic,
+static bool control_channel_topic_match(const struct mqtt_topic *topic,
 					enum nct_cc_opcode *opcode)
 {
-	struct mqtt_topic *topic_list;
-	uint32_t list_size;
-
-	if (list_id == NCT_RX_LIST) {
-		topic_list = (struct mqtt_topic *)nct_cc_rx_list;
-		list_size = ARRAY_SIZE(nct_cc_rx_list);
-	} else if (list_id == NCT_TX_LIST) {
-		topic_list = (struct mqtt_topic *)nct_cc_tx_list;
-		list_size = ARRAY_SIZE(nct_cc_tx_list);
-	} else {
+	int index = mqtt_topic_trie_match(&nct_cc_rx_trie, topic->topic.utf8,
+					  topic->topic.size);
+
+	if (index < 0) {
 		return false;
 	}
 
-	for (uint32_t index = 0; index < list_size; index++) {
-		if (strings_compare(
-			    topic->topic.utf8, topic_list[index].topic.utf8,
-			    topic->topic.size, topic_list[index].topic.size)) {
-			*opcode = nct_cc_rx_opcode_map[index];
-			return true;
-		}
-	}
-	return false;
+	*opcode = nct_cc_rx_opcode_map[index];
+	return true;
 }
 
 /* Function to get the client id */
@@ -394,6 +416,18 @@ static int nct_topics_populate(void)
 	}
 	LOG_DBG("shadow_get_topic: %s", log_strdup(shadow_get_topic));
 
+	mqtt_topic_trie_clear(&nct_cc_rx_trie);
+
+	for (size_t i = 0; i < ARRAY_SIZE(nct_cc_rx_list); i++) {
+		ret = mqtt_topic_trie_add(&nct_cc_rx_trie,
+					  nct_cc_rx_list[i].topic.utf8,
+					  nct_cc_rx_list[i].topic.size, i);
+		if (ret) {
+			LOG_ERR("Failed to add topic to trie, error: %d", ret);
+			return ret;
+		}
+	}
+
 	return 0;
 }
 
@@ -408,6 +442,14 @@ static int nct_provision(void)
 	nct.tls_config.sec_tag_count = ARRAY_SIZE(sec_tag_list);
 	nct.tls_config.sec_tag_list = sec_tag_list;
 	nct.tls_config.hostname = NRF_CLOUD_HOSTNAME;
+#if defined(CONFIG_BSD_LIBRARY)
+	nct.tls_config.session_cache =
+		IS_ENABLED(CONFIG_NRF_CLOUD_TLS_SESSION_CACHING) ?
+			TLS_SESSION_CACHE_ENABLED : TLS_SESSION_CACHE_DISABLED;
+#else
+	/* TLS session caching is not supported by the Zephyr network stack */
+	nct.tls_config.session_cache = TLS_SESSION_CACHE_DISABLED;
+#endif
 
 #if defined(CONFIG_NRF_CLOUD_PROVISION_CERTIFICATES)
 #if defined(CONFIG_BSD_LIBRARY)
@@ -622,6 +664,97 @@ static void aws_fota_cb_handler(struct aws_fota_event *fota_evt)
 }
 #endif /* defined(CONFIG_AWS_FOTA) */
 
+/* Replace the saved copy of an endpoint. The copy is NUL terminated. */
+static int session_endp_copy(enum session_endp idx, const void *ptr,
+			     size_t len)
+{
+	char *copy = NULL;
+
+	if (ptr != NULL) {
+		copy = nrf_cloud_malloc(len + 1);
+		if (copy == NULL) {
+			return -ENOMEM;
+		}
+
+		memcpy(copy, ptr, len);
+		copy[len] = '\0';
+	}
+
+	if (session_endp[idx].ptr != NULL) {
+		nrf_cloud_free((void *)session_endp[idx].ptr);
+	}
+
+	session_endp[idx].ptr = copy;
+	session_endp[idx].len = copy ? len : 0;
+
+	return 0;
+}
+
+static int session_endp_load(enum session_endp idx, size_t len_rd,
+			     settings_read_cb read_cb, void *cb_arg)
+{
+	int err;
+	char *buf = nrf_cloud_malloc(len_rd);
+
+	if (buf == NULL) {
+		return -ENOMEM;
+	}
+
+	err = read_cb(cb_arg, buf, len_rd);
+	if (err == len_rd) {
+		err = session_endp_copy(idx, buf, len_rd);
+	} else if (err >= 0) {
+		err = -EIO;
+	}
+
+	nrf_cloud_free(buf);
+
+	return err;
+}
+
+/* Save the endpoints of the data channel if they changed. */
+static void session_endp_save(void)
+{
+#if !IS_ENABLED(CONFIG_MQTT_CLEAN_SESSION)
+	const struct mqtt_utf8 *endp[SESSION_ENDP_COUNT] = {
+		[SESSION_ENDP_TX] = &nct.dc_tx_endp,
+		[SESSION_ENDP_RX] = &nct.dc_rx_endp,
+		[SESSION_ENDP_M] = &nct.dc_m_endp,
+	};
+	char key[sizeof(SETTINGS_NAME) + 8];
+	int err;
+
+	for (size_t i = 0; i < SESSION_ENDP_COUNT; i++) {
+		if (endp[i]->size == session_endp[i].len &&
+		    (endp[i]->size == 0 ||
+		     !memcmp(endp[i]->utf8, session_endp[i].ptr,
+			     endp[i]->size))) {
+			continue;
+		}
+
+		err = session_endp_copy(i, endp[i]->utf8, endp[i]->size);
+		if (err) {
+			LOG_ERR("Failed to copy endpoint: %d", err);
+			return;
+		}
+
+		snprintf(key, sizeof(key), SETTINGS_NAME "/%s",
+			 session_endp_key[i]);
+
+		if (session_endp[i].ptr != NULL) {
+			err = settings_save_one(key, session_endp[i].ptr,
+						session_endp[i].len);
+		} else {
+			err = settings_delete(key);
+		}
+
+		if (err) {
+			LOG_ERR("Failed to save endpoint: %d", err);
+		}
+	}
+#endif
+}
+
 static int nct_settings_set(const char *key, size_t len_rd,
 			    settings_read_cb read_cb, void *cb_arg)
 {
@@ -633,6 +766,12 @@ static int nct_settings_set(const char *key, size_t len_rd,
 
 	LOG_DBG("Settings key: %s, size: %d", log_strdup(key), len_rd);
 
+	for (size_t i = 0; i < SESSION_ENDP_COUNT; i++) {
+		if (!strcmp(key, session_endp_key[i])) {
+			return session_endp_load(i, len_rd, read_cb, cb_arg);
+		}
+	}
+
 	if (!strncmp(key, SETTINGS_KEY_PERSISTENT_SESSION,
 		     strlen(SETTINGS_KEY_PERSISTENT_SESSION)) &&
 	    (len_rd == sizeof(read_val))) {
@@ -656,6 +795,9 @@ int save_session_state(const int session_valid)
 	persistent_session = (bool)session_valid;
 	ret = settings_save_one(SETTINGS_FULL_PERSISTENT_SESSION,
 				&session_valid, sizeof(session_valid));
+	if (session_valid) {
+		session_endp_save();
+	}
 #endif
 	return ret;
 }
@@ -697,9 +839,6 @@ int nct_mqtt_connect(void)
 		nct.client.protocol_version = MQTT_VERSION_3_1_1;
 		nct.client.password = NULL;
 		nct.client.user_name = NULL;
-		nct.client.clean_session = persistent_session ? 0U : 1U;
-		LOG_DBG("MQTT clean session flag: %u",
-			nct.client.clean_session);
 
 #if defined(CONFIG_MQTT_LIB_TLS)
 		nct.client.transport.type = MQTT_TRANSPORT_SECURE;
@@ -726,6 +865,15 @@ int nct_mqtt_connect(void)
 		initialized = true;
 	}
 
+	/* The broker keeps the session from the first connection on, and
+	 * the saved session state tells if the subscriptions were completed.
+	 */
+	nct.client.clean_session =
+		IS_ENABLED(CONFIG_MQTT_CLEAN_SESSION) ? 1U : 0U;
+	LOG_DBG("MQTT clean session flag: %u", nct.client.clean_session);
+
+	connect_start_time = k_uptime_get();
+
 	err = mqtt_connect(&nct.client);
 	if (err != 0) {
 		LOG_DBG("mqtt_connect failed %d", err);
@@ -810,6 +958,20 @@ static void nct_mqtt_evt_handler(struct mqtt_client *const mqtt_client,
 			save_session_state(0);
 		}
 
+		if (_mqtt_evt->result == 0 && p->session_present_flag != 0) {
+			(void)nct_dc_inflight_retransmit(&nct.client);
+		} else if (_mqtt_evt->result == 0) {
+			/* The broker has no state for the messages in
+			 * flight, they are not sent again.
+			 */
+			size_t dropped = nct_dc_inflight_clear();
+
+			if (dropped != 0) {
+				LOG_WRN("No session present, dropped %d unacknowledged messages",
+					(int)dropped);
+			}
+		}
+
 		evt.type = NCT_EVT_CONNECTED;
 		event_notify = true;
 		break;
@@ -834,7 +996,7 @@ static void nct_mqtt_evt_handler(struct mqtt_client *const mqtt_client,
 		/* If the data arrives on one of the subscribed control channel
 		 * topic. Then we notify the same.
 		 */
-		if (control_channel_topic_match(NCT_RX_LIST, &p->message.topic,
+		if (control_channel_topic_match(&p->message.topic,
 						&cc.opcode)) {
 			cc.id = p->message_id;
 			cc.data.ptr = nct.payload_buf;
@@ -902,7 +1064,12 @@ static void nct_mqtt_evt_handler(struct mqtt_client *const mqtt_client,
 		LOG_DBG("MQTT_EVT_PUBACK: id = %d result = %d",
 			_mqtt_evt->param.puback.message_id, _mqtt_evt->result);
 
-		evt.type = NCT_EVT_CC_TX_DATA_ACK;
+		if (nct_dc_inflight_ack(_mqtt_evt->param.puback.message_id)) {
+			evt.type = NCT_EVT_DC_TX_DATA_ACK;
+		} else {
+			evt.type = NCT_EVT_CC_TX_DATA_ACK;
+		}
+
 		evt.param.data_id = _mqtt_evt->param.puback.message_id;
 		event_notify = true;
 		break;
@@ -1055,8 +1222,6 @@ int nct_cc_connect(void)
 
 int nct_cc_send(const struct nct_cc_data *cc_data)
 {
-	static uint32_t msg_id;
-
 	if (cc_data == NULL) {
 		LOG_ERR("cc_data == NULL");
 		return -EINVAL;
@@ -1081,7 +1246,14 @@ int nct_cc_send(const struct nct_cc_data *cc_data)
 		publish.message.payload.len = cc_data->data.len;
 	}
 
-	publish.message_id = cc_data->id ? cc_data->id : ++msg_id;
+	if (cc_data->id) {
+		publish.message_id = cc_data->id;
+	} else {
+		/* Same ids as the data channel, so that the PUBACK of this
+		 * message is not taken for the one of a data message in flight.
+		 */
+		publish.message_id = nct_message_id_next();
+	}
 
 	LOG_DBG("mqtt_publish: id = %d opcode = %d len = %d", publish.message_id,
 		cc_data->opcode, cc_data->data.len);
@@ -1159,6 +1331,48 @@ void nct_dc_endpoint_set(const struct nrf_cloud_data *tx_endp,
 		nct.job_status_endp.size = ret;
 #endif
 	}
+
+	if (persistent_session) {
+		session_endp_save();
+	}
+}
+
+int nct_dc_endpoint_restore(void)
+{
+	struct nrf_cloud_data endp[SESSION_ENDP_COUNT];
+
+	if (!persistent_session || session_endp[SESSION_ENDP_TX].ptr == NULL ||
+	    session_endp[SESSION_ENDP_RX].ptr == NULL) {
+		return -ENOENT;
+	}
+
+	/* The data channel takes ownership of the endpoints */
+	for (size_t i = 0; i < SESSION_ENDP_COUNT; i++) {
+		endp[i].len = session_endp[i].len;
+		endp[i].ptr = NULL;
+
+		if (session_endp[i].ptr == NULL) {
+			continue;
+		}
+
+		endp[i].ptr = nrf_cloud_malloc(endp[i].len + 1);
+		if (endp[i].ptr == NULL) {
+			while (i-- > 0) {
+				nrf_cloud_free((void *)endp[i].ptr);
+			}
+
+			return -ENOMEM;
+		}
+
+		memcpy((void *)endp[i].ptr, session_endp[i].ptr,
+		       endp[i].len + 1);
+	}
+
+	nct_dc_endpoint_set(&endp[SESSION_ENDP_TX], &endp[SESSION_ENDP_RX],
+			    endp[SESSION_ENDP_M].ptr ?
+			    &endp[SESSION_ENDP_M] : NULL);
+
+	return 0;
 }
 
 void nct_dc_endpoint_get(struct nrf_cloud_data *const tx_endp,
@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include "gps_scheduler.h"
+
+/* Same as the asset tracker defaults */
+#define INTERVAL	120
+#define OVERDUE		900
+#define TRY_TIME	180
+#define IDLE_DELAY	2
+#define RRC_WAIT	70
+#define PSM_WAIT	60
+
+/* Simulated day */
+#define SIM_TIME	(24 * 3600)
+/* Data is sent every LTE_PERIOD seconds, keeping LTE in RRC connected mode
+ * for LTE_CONNECTED seconds, followed by the PSM active time
+ */
+#define LTE_PERIOD	600
+#define LTE_CONNECTED	30
+#define PSM_ACTIVE	10
+/* Seconds between motion events while moving */
+#define MOTION_PERIOD	10
+/* Search time needed for a fix, with and without valid ephemerides from
+ * the last fix
+ */
+#define TTFF_HOT	5
+#define TTFF_COLD	40
+#define EPHE_VALIDITY	(4 * 3600)
+
+static const struct gps_sched_cfg cfg = {
+	.interval = INTERVAL,
+	.overdue = OVERDUE,
+	.idle_delay = IDLE_DELAY,
+	.rrc_wait = RRC_WAIT,
+	.psm_wait = PSM_WAIT,
+};
+
+static struct gps_sched sched;
+
+static void test_first_search(void)
+{
+	gps_sched_init(&sched, &cfg);
+	zassert_equal(gps_sched_next(&sched, 100), 100, NULL);
+
+	gps_sched_search_start(&sched, 100);
+	zassert_equal(gps_sched_next(&sched, 110), GPS_SCHED_SEARCHING, NULL);
+	gps_sched_search_end(&sched, true, 130);
+	zassert_equal(sched.fixes, 1, NULL);
+	zassert_equal(sched.fix_time, 30, NULL);
+}
+
+/* Searches are skipped while not moving, until the fix is overdue */
+static void test_stationary(void)
+{
+	gps_sched_init(&sched, &cfg);
+	gps_sched_motion(&sched, 90);
+	gps_sched_search_start(&sched, 100);
+	gps_sched_search_end(&sched, true, 130);
+
+	zassert_equal(gps_sched_next(&sched, 140), 130 + OVERDUE, NULL);
+
+	gps_sched_motion(&sched, 200);
+	zassert_equal(gps_sched_next(&sched, 200), 130 + INTERVAL, NULL);
+	zassert_equal(gps_sched_next(&sched, 300), 300, NULL);
+}
+
+/* The interval doubles after each timeout, up to the overdue time */
+static void test_backoff(void)
+{
+	int64_t now = 0;
+
+	gps_sched_init(&sched, &cfg);
+	gps_sched_motion(&sched, 0);
+
+	for (int i = 0; i < 5; i++) {
+		gps_sched_search_start(&sched, now);
+		now += TRY_TIME;
+		gps_sched_search_end(&sched, false, now);
+		zassert_equal(gps_sched_next(&sched, now) - now,
+			      MIN(INTERVAL << (i + 1), OVERDUE), NULL);
+		now = gps_sched_next(&sched, now);
+	}
+
+	gps_sched_search_start(&sched, now);
+	gps_sched_search_end(&sched, true, now + 10);
+	gps_sched_motion(&sched, now + 20);
+	zassert_equal(gps_sched_next(&sched, now + 20), now + 10 + INTERVAL,
+		      NULL);
+}
+
+/* Searches wait for LTE to go idle, and for the PSM active time */
+static void test_lte(void)
+{
+	gps_sched_init(&sched, &cfg);
+
+	gps_sched_rrc(&sched, true, 100);
+	zassert_equal(gps_sched_next(&sched, 110), 100 + RRC_WAIT, NULL);
+
+	gps_sched_rrc(&sched, false, 120);
+	zassert_equal(gps_sched_next(&sched, 120), 120 + IDLE_DELAY, NULL);
+
+	gps_sched_psm(&sched, 20);
+	zassert_equal(gps_sched_next(&sched, 120), 120 + IDLE_DELAY + 20,
+		      NULL);
+
+	gps_sched_psm(&sched, 600);
+	zassert_equal(gps_sched_next(&sched, 120),
+		      120 + IDLE_DELAY + PSM_WAIT, NULL);
+
+	gps_sched_psm(&sched, -1);
+	zassert_equal(gps_sched_next(&sched, 500), 500, NULL);
+}
+
+/* Simulation of a day for the asset tracker: moving in the morning, at
+ * noon and in the afternoon, and sending data every LTE_PERIOD seconds.
+ */
+struct sim_result {
+	uint32_t searches;
+	uint32_t fixes;
+	/* Time searching while the GPS is not blocked by LTE */
+	int64_t on_time;
+	/* Time from start to fix */
+	int64_t fix_time;
+	int64_t max_age_moving;
+};
+
+struct gnss {
+	bool searching;
+	int64_t start;
+	int64_t progress;
+	int64_t last_fix;
+};
+
+static bool moving(int64_t t)
+{
+	return (t >= 8 * 3600 && t < 9 * 3600) ||
+	       (t >= 12 * 3600 && t < 12 * 3600 + 1800) ||
+	       (t >= 17 * 3600 && t < 18 * 3600);
+}
+
+static bool lte_connected(int64_t t)
+{
+	return (t % LTE_PERIOD) < LTE_CONNECTED;
+}
+
+static bool gnss_blocked(int64_t t)
+{
+	return (t % LTE_PERIOD) < LTE_CONNECTED + PSM_ACTIVE;
+}
+
+static void gnss_start(struct gnss *gnss, struct sim_result *res, int64_t t)
+{
+	gnss->searching = true;
+	gnss->start = t;
+	gnss->progress = 0;
+	res->searches++;
+}
+
+/* Runs the search for one second. Returns 1 on a fix, -1 on a timeout. */
+static int gnss_step(struct gnss *gnss, struct sim_result *res, int64_t t)
+{
+	int64_t ttff;
+
+	if (!gnss->searching) {
+		return 0;
+	}
+
+	if (!gnss_blocked(t)) {
+		gnss->progress++;
+		res->on_time++;
+	}
+
+	ttff = (gnss->last_fix >= 0 &&
+		gnss->start - gnss->last_fix < EPHE_VALIDITY) ?
+		TTFF_HOT : TTFF_COLD;
+
+	if (gnss->progress >= ttff) {
+		gnss->searching = false;
+		gnss->last_fix = t + 1;
+		res->fixes++;
+		res->fix_time += t + 1 - gnss->start;
+		return 1;
+	}
+
+	if (t + 1 - gnss->start >= TRY_TIME) {
+		gnss->searching = false;
+		return -1;
+	}
+
+	return 0;
+}
+
+static void sim_age(struct gnss *gnss, struct sim_result *res, int64_t t)
+{
+	if (moving(t) && gnss->last_fix >= 0) {
+		res->max_age_moving = MAX(res->max_age_moving,
+					  t - gnss->last_fix);
+	}
+}
+
+/* The GPS in periodic mode, as without the scheduler */
+static void sim_periodic(struct sim_result *res)
+{
+	struct gnss gnss = { .last_fix = -1 };
+	int64_t next = 0;
+
+	for (int64_t t = 0; t < SIM_TIME; t++) {
+		if (t >= next) {
+			/* A search still running is restarted */
+			gnss_start(&gnss, res, t);
+			next = t + TRY_TIME + INTERVAL;
+		}
+
+		(void)gnss_step(&gnss, res, t);
+		sim_age(&gnss, res, t);
+	}
+}
+
+static void sim_scheduled(struct sim_result *res)
+{
+	struct gnss gnss = { .last_fix = -1 };
+	bool connected = false;
+	int ret;
+
+	gps_sched_init(&sched, &cfg);
+	gps_sched_psm(&sched, PSM_ACTIVE);
+
+	for (int64_t t = 0; t < SIM_TIME; t++) {
+		if (moving(t) && (t % MOTION_PERIOD) == 0) {
+			gps_sched_motion(&sched, t);
+		}
+
+		if (lte_connected(t) != connected) {
+			connected = !connected;
+			gps_sched_rrc(&sched, connected, t);
+		}
+
+		if (gps_sched_next(&sched, t) == t) {
+			gps_sched_search_start(&sched, t);
+			gnss_start(&gnss, res, t);
+		}
+
+		ret = gnss_step(&gnss, res, t);
+		if (ret) {
+			gps_sched_search_end(&sched, ret > 0, t + 1);
+		}
+		sim_age(&gnss, res, t);
+	}
+
+	/* The scheduler keeps the same statistics */
+	zassert_equal(sched.searches, res->searches, NULL);
+	zassert_equal(sched.fixes, res->fixes, NULL);
+	zassert_equal(sched.fix_time, res->fix_time, NULL);
+}
+
+static void print_result(const char *name, const struct sim_result *res)
+{
+	TC_PRINT("  %-10s %8u %6u %10u %9u %12u\n", name, res->searches,
+		 res->fixes, (uint32_t)res->on_time,
+		 res->fixes ? (uint32_t)(res->fix_time / res->fixes) : 0,
+		 (uint32_t)res->max_age_moving);
+}
+
+static void test_simulation(void)
+{
+	struct sim_result periodic = { 0 };
+	struct sim_result scheduled = { 0 };
+
+	sim_periodic(&periodic);
+	sim_scheduled(&scheduled);
+
+	TC_PRINT("GPS over %d hours, LTE active every %d s\n",
+		 SIM_TIME / 3600, LTE_PERIOD);
+	TC_PRINT("  %-10s %8s %6s %10s %9s %12s\n", "", "searches", "fixes",
+		 "GPS on [s]", "TTFF [s]", "max age [s]");
+	print_result("periodic", &periodic);
+	print_result("scheduled", &scheduled);
+
+	zassert_true(scheduled.on_time < periodic.on_time,
+		     "GPS not on for less time");
+	zassert_true(scheduled.fix_time * periodic.fixes <=
+		     periodic.fix_time * scheduled.fixes,
+		     "Mean time to fix not shorter");
+	/* A fix within a search after the motion starts */
+	zassert_true(scheduled.max_age_moving <=
+		     OVERDUE + RRC_WAIT + TRY_TIME, NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(gps_scheduler_test,
+		ztest_unit_test(test_first_search),
+		ztest_unit_test(test_stationary),
+		ztest_unit_test(test_backoff),
+		ztest_unit_test(test_lte),
+		ztest_unit_test(test_simulation)
+	);
+
+	ztest_run_test_suite(gps_scheduler_test);
+}
@@ -0,0 +1,346 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <string.h>
+#include "slm_uart.h"
+#include "slm_passthrough.h"
+
+#define GUARD_TIME_MS	CONFIG_SLM_PASSTHROUGH_GUARD_TIME
+#define RX_LEN		CONFIG_SLM_UART_RX_BUF_SIZE
+#define BUF_SIZE	CONFIG_SLM_PASSTHROUGH_BUF_SIZE
+
+/* Throughput benchmark */
+#define BENCH_TOTAL	65536
+#define BENCH_RDY_LEN	64
+/* Bytes per second sent by the simulated modem */
+#define BENCH_LINK_RATE	100000
+
+static uint8_t sent[BUF_SIZE];
+static size_t sent_len;
+static uint8_t tx_out[16];
+static size_t tx_out_len;
+
+static bool gated;
+static bool bench;
+static uint8_t bench_next;
+static size_t bench_errors;
+
+static K_SEM_DEFINE(gate, 0, 1);
+static K_SEM_DEFINE(exit_sem, 0, 1);
+static K_SEM_DEFINE(resume_sem, 0, 1);
+
+/* Replaces the UART transmit buffer, for XON, XOFF and OK */
+void slm_uart_tx_write(const uint8_t *data, size_t len)
+{
+	len = MIN(len, sizeof(tx_out) - tx_out_len);
+	memcpy(tx_out + tx_out_len, data, len);
+	tx_out_len += len;
+}
+
+static int send_handler(const uint8_t *data, size_t len)
+{
+	if (gated) {
+		k_sem_take(&gate, K_FOREVER);
+	}
+
+	if (bench) {
+		for (size_t i = 0; i < len; i++) {
+			if (data[i] != bench_next++) {
+				bench_errors++;
+			}
+		}
+		sent_len += len;
+		k_busy_wait((uint64_t)len * USEC_PER_SEC / BENCH_LINK_RATE);
+		return len;
+	}
+
+	len = MIN(len, sizeof(sent) - sent_len);
+	memcpy(sent + sent_len, data, len);
+	sent_len += len;
+
+	return len;
+}
+
+static void exit_handler(void)
+{
+	k_sem_give(&exit_sem);
+}
+
+static void resume_handler(void)
+{
+	k_sem_give(&resume_sem);
+}
+
+static void rx_str(const char *str)
+{
+	slm_passthrough_rx((const uint8_t *)str, strlen(str));
+}
+
+static void wait_sent(size_t len)
+{
+	int64_t end = k_uptime_get() + MSEC_PER_SEC;
+
+	while (sent_len < len && k_uptime_get() < end) {
+		k_sleep(K_MSEC(1));
+	}
+}
+
+static void enter(void)
+{
+	sent_len = 0;
+	tx_out_len = 0;
+	k_sem_reset(&exit_sem);
+	k_sem_reset(&resume_sem);
+	zassert_equal(slm_passthrough_enter(send_handler, exit_handler), 0,
+		      NULL);
+	zassert_true(slm_passthrough_active(), NULL);
+}
+
+static void leave(void)
+{
+	slm_passthrough_exit();
+	zassert_false(slm_passthrough_active(), NULL);
+	zassert_not_equal(k_sem_take(&exit_sem, K_NO_WAIT), 0,
+			  "Exit handler called on close");
+}
+
+static void test_enter_twice(void)
+{
+	enter();
+	zassert_equal(slm_passthrough_enter(send_handler, exit_handler),
+		      -EBUSY, NULL);
+	leave();
+	zassert_equal(slm_passthrough_enter(NULL, NULL), -EINVAL, NULL);
+}
+
+/* Data is passed on as it is, including characters that are special in
+ * command mode
+ */
+static void test_data(void)
+{
+	static const uint8_t data[] = "AT+CGMI\r\n\0\x08\x7F\"";
+
+	enter();
+	slm_passthrough_rx(data, sizeof(data));
+	wait_sent(sizeof(data));
+	zassert_equal(sent_len, sizeof(data), NULL);
+	zassert_mem_equal(sent, data, sizeof(data), NULL);
+	leave();
+	zassert_equal(tx_out_len, 0, NULL);
+
+	/* Data received in command mode is not passed on */
+	rx_str("AT");
+	k_sleep(K_MSEC(10));
+	zassert_equal(sent_len, sizeof(data), NULL);
+}
+
+static void test_escape(void)
+{
+	enter();
+	rx_str("abc");
+	k_sleep(K_MSEC(GUARD_TIME_MS + 10));
+	rx_str("+++");
+	zassert_true(slm_passthrough_active(), "Left before the guard time");
+	zassert_equal(k_sem_take(&exit_sem, K_MSEC(2 * GUARD_TIME_MS)), 0,
+		      "Escape sequence not detected");
+	k_sleep(K_MSEC(10));
+	zassert_false(slm_passthrough_active(), NULL);
+	zassert_equal(sent_len, 3, NULL);
+	zassert_mem_equal(sent, "abc", 3, NULL);
+	zassert_equal(tx_out_len, 4, NULL);
+	zassert_mem_equal(tx_out, "OK\r\n", 4, NULL);
+}
+
+static void test_escape_split(void)
+{
+	enter();
+	k_sleep(K_MSEC(GUARD_TIME_MS + 10));
+	rx_str("+");
+	k_sleep(K_MSEC(5));
+	rx_str("++");
+	zassert_equal(k_sem_take(&exit_sem, K_MSEC(2 * GUARD_TIME_MS)), 0,
+		      "Escape sequence not detected");
+	k_sleep(K_MSEC(10));
+	zassert_false(slm_passthrough_active(), NULL);
+	zassert_equal(sent_len, 0, NULL);
+}
+
+/* Escape characters without the guard time before them are data */
+static void test_escape_no_leading_guard(void)
+{
+	enter();
+	rx_str("abc");
+	rx_str("+++");
+	k_sleep(K_MSEC(2 * GUARD_TIME_MS));
+	zassert_true(slm_passthrough_active(), NULL);
+	rx_str("d");
+	wait_sent(7);
+	zassert_equal(sent_len, 7, NULL);
+	zassert_mem_equal(sent, "abc+++d", 7, NULL);
+	leave();
+}
+
+/* Escape characters followed by data within the guard time are data */
+static void test_escape_trailing_data(void)
+{
+	enter();
+	k_sleep(K_MSEC(GUARD_TIME_MS + 10));
+	rx_str("++");
+	rx_str("+");
+	k_sleep(K_MSEC(GUARD_TIME_MS / 2));
+	rx_str("x");
+	k_sleep(K_MSEC(2 * GUARD_TIME_MS));
+	zassert_true(slm_passthrough_active(), NULL);
+	wait_sent(4);
+	zassert_equal(sent_len, 4, NULL);
+	zassert_mem_equal(sent, "+++x", 4, NULL);
+
+	/* More than three are data too */
+	k_sleep(K_MSEC(GUARD_TIME_MS + 10));
+	rx_str("++++");
+	k_sleep(K_MSEC(2 * GUARD_TIME_MS));
+	zassert_true(slm_passthrough_active(), NULL);
+	wait_sent(8);
+	zassert_equal(sent_len, 8, NULL);
+	leave();
+}
+
+/* Without an exit handler, as for a payload of known length, the escape
+ * sequence is data
+ */
+static void test_no_escape(void)
+{
+	sent_len = 0;
+	zassert_equal(slm_passthrough_enter(send_handler, NULL), 0, NULL);
+	k_sleep(K_MSEC(GUARD_TIME_MS + 10));
+	rx_str("+++");
+	k_sleep(K_MSEC(2 * GUARD_TIME_MS));
+	zassert_true(slm_passthrough_active(), NULL);
+	wait_sent(3);
+	zassert_equal(sent_len, 3, NULL);
+	zassert_mem_equal(sent, "+++", 3, NULL);
+	slm_passthrough_exit();
+	zassert_false(slm_passthrough_active(), NULL);
+}
+
+/* Reception is held while the data can not be sent, and started again
+ * when there is room
+ */
+static void test_hold(void)
+{
+	uint8_t chunk[RX_LEN];
+	int count = 0;
+
+	gated = true;
+	enter();
+
+	while (!slm_passthrough_rx_hold()) {
+		memset(chunk, 'a' + count, sizeof(chunk));
+		slm_passthrough_rx(chunk, sizeof(chunk));
+		count++;
+		zassert_true(count * RX_LEN <= BUF_SIZE, "Never held");
+	}
+	zassert_equal(count, (BUF_SIZE - 2 * RX_LEN) / RX_LEN + 1, NULL);
+
+	/* The buffer being received when the UART asked for the next one */
+	memset(chunk, 'a' + count, sizeof(chunk));
+	slm_passthrough_rx(chunk, sizeof(chunk));
+	count++;
+	slm_passthrough_rx_stopped();
+	zassert_not_equal(k_sem_take(&resume_sem, K_MSEC(10)), 0,
+			  "Resumed while full");
+
+	gated = false;
+	k_sem_give(&gate);
+	zassert_equal(k_sem_take(&resume_sem, K_SECONDS(1)), 0,
+		      "Not resumed");
+	wait_sent(count * RX_LEN);
+	zassert_equal(sent_len, count * RX_LEN, NULL);
+	for (int i = 0; i < count; i++) {
+		zassert_equal(sent[i * RX_LEN], 'a' + i, NULL);
+		zassert_equal(sent[(i + 1) * RX_LEN - 1], 'a' + i, NULL);
+	}
+	zassert_false(slm_passthrough_rx_hold(), NULL);
+	leave();
+}
+
+/* Feeds data as the UART would, at full speed, to a link that sends
+ * BENCH_LINK_RATE bytes per second. All data must arrive in order.
+ */
+static void test_benchmark_throughput(void)
+{
+	uint8_t chunk[RX_LEN];
+	uint8_t next = 0;
+	uint32_t rx_cycles = 0;
+	uint32_t start;
+	uint32_t time;
+	int holds = 0;
+	bool held;
+
+	bench = true;
+	bench_next = 0;
+	bench_errors = 0;
+	enter();
+
+	time = k_uptime_get_32();
+	for (size_t total = 0; total < BENCH_TOTAL; total += RX_LEN) {
+		/* The UART asks for the next buffer when it starts on this
+		 * one
+		 */
+		held = slm_passthrough_rx_hold();
+
+		for (size_t i = 0; i < sizeof(chunk); i++) {
+			chunk[i] = next++;
+		}
+		for (size_t i = 0; i < sizeof(chunk); i += BENCH_RDY_LEN) {
+			start = k_cycle_get_32();
+			slm_passthrough_rx(chunk + i, BENCH_RDY_LEN);
+			rx_cycles += k_cycle_get_32() - start;
+		}
+
+		if (held) {
+			holds++;
+			slm_passthrough_rx_stopped();
+			zassert_equal(k_sem_take(&resume_sem, K_SECONDS(5)), 0,
+				      "Not resumed");
+		}
+	}
+	wait_sent(BENCH_TOTAL);
+	time = MAX(k_uptime_get_32() - time, 1);
+	bench = false;
+
+	zassert_equal(sent_len, BENCH_TOTAL, "Data lost");
+	zassert_equal(bench_errors, 0, "Data out of order");
+	leave();
+
+	TC_PRINT("Pass-through, %d bytes to a %d bytes/s link\n",
+		 BENCH_TOTAL, BENCH_LINK_RATE);
+	TC_PRINT("  sustained:   %7u bytes/s\n",
+		 (uint32_t)((uint64_t)BENCH_TOTAL * MSEC_PER_SEC / time));
+	TC_PRINT("  RX handling: %7u cycles per %d bytes\n",
+		 rx_cycles / (BENCH_TOTAL / BENCH_RDY_LEN), BENCH_RDY_LEN);
+	TC_PRINT("  held %d times\n", holds);
+}
+
+void test_main(void)
+{
+	slm_passthrough_init(resume_handler);
+
+	ztest_test_suite(slm_passthrough_test,
+		ztest_unit_test(test_enter_twice),
+		ztest_unit_test(test_data),
+		ztest_unit_test(test_escape),
+		ztest_unit_test(test_escape_split),
+		ztest_unit_test(test_escape_no_leading_guard),
+		ztest_unit_test(test_escape_trailing_data),
+		ztest_unit_test(test_no_escape),
+		ztest_unit_test(test_hold),
+		ztest_unit_test(test_benchmark_throughput)
+	);
+
+	ztest_run_test_suite(slm_passthrough_test);
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/* Compares the UART paths of the serial LTE modem before and after the
+ * transmit ring buffer: scanning received data a character at a time with
+ * scanning it a word at a time, and sending every response from its own
+ * heap buffer, one at a time, with sending it through the ring. Data is
+ * sent over a UART whose TX pin is connected to its RX pin.
+ */
+
+#include <ztest.h>
+#include <string.h>
+#include <drivers/uart.h>
+#include "slm_util.h"
+#include "slm_uart.h"
+
+#define ITERATIONS	100
+#define RX_SCAN_LEN	1024
+
+#define TX_TOTAL	16384
+#define TX_CHUNK	64
+#define RX_BUF_LEN	256
+
+static const uint8_t special[] = { 0x08, 0x7F, '"', '\r' };
+static uint8_t payload[RX_SCAN_LEN];
+static uint8_t at_buf[RX_SCAN_LEN];
+
+/* As the AT host did, for a command without special characters */
+static size_t scan_bytes(const uint8_t *data, size_t len)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		for (size_t j = 0; j < sizeof(special); j++) {
+			if (data[i] == special[j]) {
+				return count;
+			}
+		}
+		at_buf[count++] = data[i];
+	}
+
+	return count;
+}
+
+static size_t scan_words(const uint8_t *data, size_t len)
+{
+	size_t count = slm_util_find_any(data, len, special, sizeof(special));
+
+	memcpy(at_buf, data, count);
+
+	return count;
+}
+
+void test_benchmark_rx_scan(void)
+{
+	uint32_t start;
+	uint32_t byte_cycles;
+	uint32_t word_cycles;
+
+	/* Printable data, as sent in data mode */
+	for (size_t i = 0; i < sizeof(payload); i++) {
+		payload[i] = 'a' + i % 26;
+	}
+
+	zassert_equal(scan_bytes(payload, sizeof(payload)), sizeof(payload),
+		      NULL);
+	zassert_equal(scan_words(payload, sizeof(payload)), sizeof(payload),
+		      NULL);
+
+	start = k_cycle_get_32();
+	for (int i = 0; i < ITERATIONS; i++) {
+		(void)scan_bytes(payload, sizeof(payload));
+	}
+	byte_cycles = (k_cycle_get_32() - start) / ITERATIONS;
+
+	start = k_cycle_get_32();
+	for (int i = 0; i < ITERATIONS; i++) {
+		(void)scan_words(payload, sizeof(payload));
+	}
+	word_cycles = (k_cycle_get_32() - start) / ITERATIONS;
+
+	TC_PRINT("RX scan, %d bytes\n", RX_SCAN_LEN);
+	TC_PRINT("  byte at a time: %7u cycles\n", byte_cycles);
+	TC_PRINT("  word at a time: %7u cycles\n", word_cycles);
+}
+
+static const struct device *uart_dev;
+static uint8_t rx_buf[2][RX_BUF_LEN];
+static uint8_t *next_buf;
+static size_t rx_count;
+static bool use_ring;
+static uint8_t *heap_buf;
+
+static K_SEM_DEFINE(tx_done, 1, 1);
+static K_SEM_DEFINE(rx_done, 0, 1);
+
+static void uart_callback(const struct device *dev, struct uart_event *evt,
+			  void *user_data)
+{
+	ARG_UNUSED(dev);
+	ARG_UNUSED(user_data);
+
+	switch (evt->type) {
+	case UART_TX_DONE:
+	case UART_TX_ABORTED:
+		if (use_ring) {
+			slm_uart_tx_done();
+		} else {
+			k_free(heap_buf);
+			k_sem_give(&tx_done);
+		}
+		break;
+	case UART_RX_RDY:
+		rx_count += evt->data.rx.len;
+		if (rx_count >= TX_TOTAL) {
+			k_sem_give(&rx_done);
+		}
+		break;
+	case UART_RX_BUF_REQUEST:
+		(void)uart_rx_buf_rsp(uart_dev, next_buf, RX_BUF_LEN);
+		break;
+	case UART_RX_BUF_RELEASED:
+		next_buf = evt->data.rx_buf.buf;
+		break;
+	default:
+		break;
+	}
+}
+
+/* As rsp_send() did */
+static void heap_write(const uint8_t *data, size_t len)
+{
+	k_sem_take(&tx_done, K_FOREVER);
+
+	heap_buf = k_malloc(len);
+	zassert_not_null(heap_buf, "No heap");
+
+	memcpy(heap_buf, data, len);
+	zassert_equal(uart_tx(uart_dev, heap_buf, len, SYS_FOREVER_MS), 0,
+		      NULL);
+}
+
+/* Returns the throughput in bytes per second */
+static uint32_t loopback_run(bool ring)
+{
+	uint32_t start;
+	uint32_t time;
+
+	use_ring = ring;
+	rx_count = 0;
+	next_buf = rx_buf[1];
+	k_sem_reset(&rx_done);
+
+	zassert_equal(uart_rx_enable(uart_dev, rx_buf[0], RX_BUF_LEN, 1), 0,
+		      NULL);
+
+	start = k_uptime_get_32();
+	for (size_t sent = 0; sent < TX_TOTAL; sent += TX_CHUNK) {
+		if (ring) {
+			slm_uart_tx_write(payload, TX_CHUNK);
+		} else {
+			heap_write(payload, TX_CHUNK);
+		}
+	}
+	zassert_equal(k_sem_take(&rx_done, K_SECONDS(5)), 0,
+		      "Only %d bytes looped back", rx_count);
+	time = MAX(k_uptime_get_32() - start, 1);
+
+	(void)uart_rx_disable(uart_dev);
+	k_sleep(K_MSEC(10));
+
+	/* Wait for the last heap buffer to be freed */
+	if (!ring) {
+		k_sem_take(&tx_done, K_FOREVER);
+		k_sem_give(&tx_done);
+	}
+
+	return (uint32_t)((uint64_t)TX_TOTAL * MSEC_PER_SEC / time);
+}
+
+void test_benchmark_tx_loopback(void)
+{
+	struct uart_config cfg;
+	uint32_t heap_rate;
+	uint32_t ring_rate;
+
+	uart_dev = device_get_binding(DT_LABEL(DT_NODELABEL(uart1)));
+	zassert_not_null(uart_dev, "No UART");
+	zassert_equal(uart_callback_set(uart_dev, uart_callback, NULL), 0,
+		      NULL);
+	zassert_equal(uart_config_get(uart_dev, &cfg), 0, NULL);
+	slm_uart_tx_init(uart_dev);
+
+	heap_rate = loopback_run(false);
+	ring_rate = loopback_run(true);
+
+	TC_PRINT("TX loopback, %d bytes in %d byte writes at %d baud\n",
+		 TX_TOTAL, TX_CHUNK, cfg.baudrate);
+	TC_PRINT("  heap buffer per write: %7u bytes/s\n", heap_rate);
+	TC_PRINT("  ring buffer:           %7u bytes/s\n", ring_rate);
+}
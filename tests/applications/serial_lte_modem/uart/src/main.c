@@ -0,0 +1,20 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+
+extern void test_benchmark_rx_scan(void);
+extern void test_benchmark_tx_loopback(void);
+
+void test_main(void)
+{
+	ztest_test_suite(slm_uart_test,
+		ztest_unit_test(test_benchmark_rx_scan),
+		ztest_unit_test(test_benchmark_tx_loopback)
+	);
+
+	ztest_run_test_suite(slm_uart_test);
+}
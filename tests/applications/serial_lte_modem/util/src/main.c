@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <string.h>
+#include "slm_util.h"
+
+static const uint8_t special[] = { 0x08, 0x7F, '"', '\r' };
+
+static size_t find(const uint8_t *data, size_t len)
+{
+	return slm_util_find_any(data, len, special, sizeof(special));
+}
+
+static void test_find_none(void)
+{
+	static const uint8_t data[] = "AT#XTCPSEND=1,0123456789abcdef";
+
+	zassert_equal(find(data, 0), 0, NULL);
+	zassert_equal(find(data, 3), 3, NULL);
+	zassert_equal(find(data, sizeof(data) - 1), sizeof(data) - 1, NULL);
+}
+
+/* Every byte of the set is found at every offset and alignment */
+static void test_find_each_position(void)
+{
+	uint8_t data[24];
+
+	for (size_t start = 0; start < 4; start++) {
+		for (size_t pos = start; pos < sizeof(data); pos++) {
+			for (size_t i = 0; i < sizeof(special); i++) {
+				memset(data, 'A', sizeof(data));
+				data[pos] = special[i];
+				zassert_equal(find(data + start,
+						   sizeof(data) - start),
+					      pos - start, "pos %d, byte %d",
+					      pos, i);
+			}
+		}
+	}
+}
+
+static void test_find_first(void)
+{
+	static const uint8_t data[] = "AT+CGMI\"\x7F\r\"\r";
+
+	zassert_equal(find(data, sizeof(data) - 1), 7, NULL);
+	zassert_equal(find(data + 8, sizeof(data) - 9), 0, NULL);
+}
+
+/* Bytes that differ from the set only in the high bit, or by a borrow from
+ * a lower byte, are not found.
+ */
+static void test_find_near_misses(void)
+{
+	static const uint8_t data[] = {
+		0x88, 0xFF, 0xA2, 0x8D, 0x09, 0x7E, 0x00, 0x01,
+		0x0E, 0x0C, 0x80, 0x23,
+	};
+
+	zassert_equal(find(data, sizeof(data)), sizeof(data), NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(slm_util_test,
+		ztest_unit_test(test_find_none),
+		ztest_unit_test(test_find_each_position),
+		ztest_unit_test(test_find_first),
+		ztest_unit_test(test_find_near_misses)
+	);
+
+	ztest_run_test_suite(slm_util_test);
+}
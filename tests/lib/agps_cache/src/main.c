@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <string.h>
+#include <logging/log.h>
+#include <settings/settings.h>
+#include <date_time.h>
+#include <nrf_socket.h>
+#include <drivers/gps.h>
+
+#include "agps_cache.h"
+
+LOG_MODULE_REGISTER(agps, CONFIG_AGPS_LOG_LEVEL);
+
+#define SV_COUNT 32
+#define MIN_TO_MS(min) ((int64_t)(min) * 60 * MSEC_PER_SEC)
+
+/* Unix time at boot, as known by the date_time stub */
+#define UNIX_TIME_AT_BOOT 1600000000000LL
+
+/* Layout of the times saved by the cache, see agps_cache.c */
+struct saved_times {
+	uint32_t ephe_mask;
+	uint32_t alm_mask;
+	uint8_t param_mask;
+	int64_t ephe[SV_COUNT];
+	int64_t alm[SV_COUNT];
+	int64_t param[3];
+};
+
+/* Uptime moved forward by the test */
+static int64_t uptime_shift;
+
+int64_t __real_z_impl_k_uptime_ticks(void);
+
+int64_t __wrap_z_impl_k_uptime_ticks(void)
+{
+	return __real_z_impl_k_uptime_ticks() +
+	       k_ms_to_ticks_ceil64(uptime_shift);
+}
+
+static void minutes_pass(uint32_t min)
+{
+	uptime_shift += MIN_TO_MS(min);
+}
+
+int date_time_now(int64_t *unix_time_ms)
+{
+	*unix_time_ms = UNIX_TIME_AT_BOOT + k_uptime_get();
+
+	return 0;
+}
+
+/* Settings in RAM, standing in for the flash of the previous boot */
+static struct {
+	char name[16];
+	uint8_t value[SV_COUNT * sizeof(nrf_gnss_agps_data_ephemeris_t)];
+	size_t len;
+} saved[5];
+
+static int saved_set(const char *name, const void *value, size_t len)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(saved); i++) {
+		if (saved[i].len == 0 || strcmp(saved[i].name, name) == 0) {
+			zassert_true(len <= sizeof(saved[i].value), "Too long");
+			strcpy(saved[i].name, name);
+			memcpy(saved[i].value, value, len);
+			saved[i].len = len;
+			return 0;
+		}
+	}
+
+	return -ENOMEM;
+}
+
+static ssize_t saved_read(void *cb_arg, void *data, size_t len)
+{
+	size_t i = (size_t)cb_arg;
+
+	len = MIN(len, saved[i].len);
+	memcpy(data, saved[i].value, len);
+
+	return len;
+}
+
+static int ram_load(struct settings_store *cs,
+		    const struct settings_load_arg *arg)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(saved) && saved[i].len; i++) {
+		settings_call_set_handler(saved[i].name, saved[i].len,
+					  saved_read, (void *)i, arg);
+	}
+
+	return 0;
+}
+
+static int ram_save(struct settings_store *cs, const char *name,
+		    const char *value, size_t val_len)
+{
+	return saved_set(name, value, val_len);
+}
+
+static const struct settings_store_itf ram_itf = {
+	.csi_load = ram_load,
+	.csi_save = ram_save,
+};
+
+static struct settings_store ram_store = {
+	.cs_itf = &ram_itf,
+};
+
+int settings_backend_init(void)
+{
+	settings_src_register(&ram_store);
+	settings_dst_register(&ram_store);
+
+	return 0;
+}
+
+/* Data written to the GPS module by the cache */
+static struct {
+	enum gps_agps_type type;
+	uint8_t sv_id;
+} written[SV_COUNT];
+static size_t write_count;
+static int write_err;
+
+static int write(enum gps_agps_type type, void *data, size_t data_len)
+{
+	if (write_err) {
+		return write_err;
+	}
+
+	zassert_true(write_count < ARRAY_SIZE(written), "Too many writes");
+
+	written[write_count].type = type;
+	if (type == GPS_AGPS_EPHEMERIDES) {
+		zassert_equal(data_len, sizeof(nrf_gnss_agps_data_ephemeris_t),
+			      "Wrong size");
+		written[write_count].sv_id =
+			((nrf_gnss_agps_data_ephemeris_t *)data)->sv_id;
+	} else if (type == GPS_AGPS_ALMANAC) {
+		zassert_equal(data_len, sizeof(nrf_gnss_agps_data_almanac_t),
+			      "Wrong size");
+		written[write_count].sv_id =
+			((nrf_gnss_agps_data_almanac_t *)data)->sv_id;
+	}
+	write_count++;
+
+	return 0;
+}
+
+static void ephe_store(uint8_t sv_id)
+{
+	nrf_gnss_agps_data_ephemeris_t ephe = { .sv_id = sv_id };
+
+	agps_cache_store(GPS_AGPS_EPHEMERIDES, &ephe, sizeof(ephe));
+}
+
+static void alm_store(uint8_t sv_id)
+{
+	nrf_gnss_agps_data_almanac_t alm = { .sv_id = sv_id };
+
+	agps_cache_store(GPS_AGPS_ALMANAC, &alm, sizeof(alm));
+}
+
+static void setup(void)
+{
+	memset(written, 0, sizeof(written));
+	write_count = 0;
+	write_err = 0;
+}
+
+static void teardown(void)
+{
+}
+
+/* Runs first, as the cache is only loaded on the first request */
+static void test_load_converts_saved_times(void)
+{
+	static nrf_gnss_agps_data_ephemeris_t ephe[SV_COUNT];
+	static nrf_gnss_agps_data_almanac_t alm[SV_COUNT];
+	static uint8_t params[sizeof(nrf_gnss_agps_data_utc_t) +
+			      sizeof(nrf_gnss_agps_data_klobuchar_t) +
+			      sizeof(nrf_gnss_agps_data_nequick_t)];
+	struct saved_times times = {
+		.ephe_mask = BIT(0) | BIT(1),
+	};
+	struct gps_agps_request request = {
+		.sv_mask_ephe = BIT(0) | BIT(1),
+	};
+	/* The previous boot was a day before this one, and its uptime was
+	 * a day longer than now when the cache was saved.
+	 */
+	int64_t saved_offset = UNIX_TIME_AT_BOOT - MIN_TO_MS(24 * 60);
+	int64_t now = k_uptime_get() + MIN_TO_MS(24 * 60);
+
+	/* Received 119 and 121 minutes before now */
+	times.ephe[0] = now - MIN_TO_MS(CONFIG_AGPS_CACHE_EPHE_VALIDITY - 1);
+	times.ephe[1] = now - MIN_TO_MS(CONFIG_AGPS_CACHE_EPHE_VALIDITY + 1);
+	ephe[0].sv_id = 1;
+	ephe[1].sv_id = 2;
+
+	zassert_equal(saved_set("agps/offset", &saved_offset,
+				sizeof(saved_offset)), 0, NULL);
+	zassert_equal(saved_set("agps/time", &times, sizeof(times)), 0,
+		      NULL);
+	zassert_equal(saved_set("agps/ephe", ephe, sizeof(ephe)), 0, NULL);
+	zassert_equal(saved_set("agps/alm", alm, sizeof(alm)), 0, NULL);
+	zassert_equal(saved_set("agps/param", params, sizeof(params)), 0,
+		      NULL);
+
+	zassert_equal(agps_cache_inject(&request, write), 1,
+		      "Saved ephemeris not injected");
+	zassert_equal(written[0].type, GPS_AGPS_EPHEMERIDES, "Wrong type");
+	zassert_equal(written[0].sv_id, 1, "Wrong ephemeris");
+	zassert_equal(request.sv_mask_ephe, BIT(1),
+		      "Expired ephemeris not requested");
+}
+
+static void test_save(void)
+{
+	ephe_store(3);
+
+	memset(saved, 0, sizeof(saved));
+	zassert_equal(agps_cache_save(), 0, "Save failed");
+
+	for (size_t i = 0; i < ARRAY_SIZE(saved); i++) {
+		zassert_not_equal(saved[i].len, 0, "Not all saved");
+	}
+
+	/* Unchanged since */
+	memset(saved, 0, sizeof(saved));
+	zassert_equal(agps_cache_save(), 0, "Save failed");
+	zassert_equal(saved[0].len, 0, "Saved again");
+}
+
+static void test_ephe_expiry(void)
+{
+	struct gps_agps_request request = {
+		.sv_mask_ephe = BIT(4),
+	};
+
+	ephe_store(5);
+
+	minutes_pass(CONFIG_AGPS_CACHE_EPHE_VALIDITY - 1);
+	zassert_equal(agps_cache_inject(&request, write), 1, "Not injected");
+	zassert_equal(written[0].sv_id, 5, "Wrong ephemeris");
+	zassert_equal(request.sv_mask_ephe, 0, "Still requested");
+
+	minutes_pass(2);
+	request.sv_mask_ephe = BIT(4);
+	zassert_equal(agps_cache_inject(&request, write), 0,
+		      "Expired ephemeris injected");
+	zassert_equal(request.sv_mask_ephe, BIT(4), "Not requested");
+}
+
+static void test_alm_expiry(void)
+{
+	struct gps_agps_request request = {
+		.sv_mask_alm = BIT(5),
+	};
+
+	alm_store(6);
+
+	minutes_pass(CONFIG_AGPS_CACHE_ALM_VALIDITY - 1);
+	zassert_equal(agps_cache_inject(&request, write), 1, "Not injected");
+	zassert_equal(written[0].type, GPS_AGPS_ALMANAC, "Wrong type");
+	zassert_equal(written[0].sv_id, 6, "Wrong almanac");
+	zassert_equal(request.sv_mask_alm, 0, "Still requested");
+
+	minutes_pass(2);
+	request.sv_mask_alm = BIT(5);
+	zassert_equal(agps_cache_inject(&request, write), 0,
+		      "Expired almanac injected");
+	zassert_equal(request.sv_mask_alm, BIT(5), "Not requested");
+}
+
+static void test_request_mask_reduced(void)
+{
+	struct gps_agps_request request = {
+		.sv_mask_ephe = BIT(9) | BIT(10) | BIT(12),
+		.sv_mask_alm = BIT(9),
+	};
+
+	ephe_store(10);
+	ephe_store(13);
+	ephe_store(20);
+	alm_store(11);
+
+	/* Only the requested data that is cached is injected */
+	zassert_equal(agps_cache_inject(&request, write), 2,
+		      "Wrong number injected");
+	zassert_equal(write_count, 2, "Wrong number written");
+	zassert_equal(written[0].sv_id, 10, "Wrong ephemeris");
+	zassert_equal(written[1].sv_id, 13, "Wrong ephemeris");
+	zassert_equal(request.sv_mask_ephe, BIT(10), "Wrong ephemeris mask");
+	zassert_equal(request.sv_mask_alm, BIT(9), "Wrong almanac mask");
+}
+
+static void test_write_error(void)
+{
+	struct gps_agps_request request = {
+		.sv_mask_ephe = BIT(14),
+	};
+
+	ephe_store(15);
+
+	write_err = -EIO;
+	zassert_equal(agps_cache_inject(&request, write), -EIO,
+		      "Error not returned");
+	zassert_equal(request.sv_mask_ephe, BIT(14), "Not requested");
+}
+
+static void test_params(void)
+{
+	nrf_gnss_agps_data_utc_t utc = { 0 };
+	nrf_gnss_agps_data_klobuchar_t klobuchar = { 0 };
+	nrf_gnss_agps_data_nequick_t nequick = { 0 };
+	struct gps_agps_request request = {
+		.utc = 1,
+		.nequick = 1,
+	};
+
+	agps_cache_store(GPS_AGPS_UTC_PARAMETERS, &utc, sizeof(utc));
+	agps_cache_store(GPS_AGPS_KLOBUCHAR_CORRECTION, &klobuchar,
+			 sizeof(klobuchar));
+	agps_cache_store(GPS_AGPS_NEQUICK_CORRECTION, &nequick,
+			 sizeof(nequick));
+
+	/* Only the requested ones */
+	minutes_pass(CONFIG_AGPS_CACHE_PARAM_VALIDITY - 1);
+	zassert_equal(agps_cache_inject(&request, write), 2,
+		      "Wrong number injected");
+	zassert_equal(written[0].type, GPS_AGPS_UTC_PARAMETERS, "No UTC");
+	zassert_equal(written[1].type, GPS_AGPS_NEQUICK_CORRECTION,
+		      "No NeQuick");
+	zassert_false(request.utc, "UTC still requested");
+	zassert_false(request.klobuchar, "Klobuchar requested");
+	zassert_false(request.nequick, "NeQuick still requested");
+
+	/* Expired */
+	minutes_pass(2);
+	write_count = 0;
+	request.utc = 1;
+	request.klobuchar = 1;
+	request.nequick = 1;
+	zassert_equal(agps_cache_inject(&request, write), 0,
+		      "Expired data injected");
+	zassert_equal(write_count, 0, "Expired data written");
+	zassert_true(request.utc, "UTC not requested");
+	zassert_true(request.klobuchar, "Klobuchar not requested");
+	zassert_true(request.nequick, "NeQuick not requested");
+}
+
+static void test_wrong_size_ignored(void)
+{
+	uint8_t data[sizeof(nrf_gnss_agps_data_utc_t) + 1] = { 0 };
+	struct gps_agps_request request = {
+		.utc = 1,
+	};
+
+	agps_cache_store(GPS_AGPS_UTC_PARAMETERS, data, sizeof(data));
+
+	zassert_equal(agps_cache_inject(&request, write), 0,
+		      "Wrong size cached");
+	zassert_true(request.utc, "UTC not requested");
+}
+
+void test_main(void)
+{
+	ztest_test_suite(agps_cache_test,
+		ztest_unit_test_setup_teardown(test_load_converts_saved_times,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_save, setup, teardown),
+		ztest_unit_test_setup_teardown(test_ephe_expiry, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_alm_expiry, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_request_mask_reduced,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_write_error, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_params, setup, teardown),
+		ztest_unit_test_setup_teardown(test_wrong_size_ignored, setup,
+					       teardown)
+	);
+
+	ztest_run_test_suite(agps_cache_test);
+}
@@ -0,0 +1,356 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <ztest.h>
+#include <string.h>
+#include <stdio.h>
+#include <cJSON.h>
+#include <cJSON_os.h>
+
+/* Number of messages decoded by the soak test in each mode */
+#define SOAK_ITERATIONS 20000
+
+/* Blocks kept allocated on the heap by the soak test, like the buffers and
+ * strings other modules keep across messages.
+ */
+#define SOAK_BLOCKS 24
+#define SOAK_BLOCK_SIZE_MAX 384
+
+#define THREAD_STACK_SIZE 2048
+
+static const char shadow_delta[] =
+	"{\"state\":{\"config\":{\"GPS\":{\"enable\":true},"
+	"\"TEMP\":{\"enable\":false,\"thresh_hi\":30.5}},"
+	"\"pairing\":{\"state\":\"paired\",\"topics\":{"
+	"\"d2c\":\"prod/a1b2/d2c\",\"c2d\":\"prod/a1b2/+/r\"}}},"
+	"\"version\":42}";
+
+static char doc[2048];
+static uint32_t rand_state;
+
+K_THREAD_STACK_DEFINE(thread_stack, THREAD_STACK_SIZE);
+static struct k_thread thread;
+
+static uint32_t xorshift32(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= rand_state << 5;
+
+	return rand_state;
+}
+
+static void setup(void)
+{
+	rand_state = 0x2545f491;
+	cJSON_Init();
+}
+
+static void teardown(void)
+{
+}
+
+static int version_get(const cJSON *root)
+{
+	cJSON *version = cJSON_GetObjectItem(root, "version");
+
+	return cJSON_IsNumber(version) ? version->valueint : -1;
+}
+
+static void test_arena_release(void)
+{
+	struct cJSON_arena_stats stats;
+	cJSON *first;
+	cJSON *root;
+
+	cJSON_ArenaBegin();
+	first = cJSON_Parse(shadow_delta);
+	zassert_not_null(first, NULL);
+	zassert_equal(version_get(first), 42, NULL);
+
+	cJSON_ArenaStatsGet(&stats);
+	zassert_true(stats.used > 0, "Nothing allocated from the arena");
+
+	cJSON_Delete(first);
+	cJSON_ArenaEnd();
+
+	cJSON_ArenaStatsGet(&stats);
+	zassert_equal(stats.used, 0, "Arena not released");
+
+	/* The next scope starts from the beginning of the arena again */
+	cJSON_ArenaBegin();
+	root = cJSON_Parse(shadow_delta);
+	zassert_equal(root, first, "Arena memory not reused");
+	cJSON_Delete(root);
+	cJSON_ArenaEnd();
+}
+
+static void test_arena_nested(void)
+{
+	struct cJSON_arena_stats stats;
+	size_t outer_used;
+	cJSON *outer;
+	cJSON *inner;
+
+	cJSON_ArenaBegin();
+	outer = cJSON_Parse(shadow_delta);
+	zassert_not_null(outer, NULL);
+
+	cJSON_ArenaStatsGet(&stats);
+	outer_used = stats.used;
+
+	cJSON_ArenaBegin();
+	inner = cJSON_Parse(shadow_delta);
+	zassert_not_null(inner, NULL);
+	zassert_not_equal(inner, outer, NULL);
+	cJSON_Delete(inner);
+	cJSON_ArenaEnd();
+
+	/* The outer document is still valid */
+	cJSON_ArenaStatsGet(&stats);
+	zassert_true(stats.used >= outer_used, NULL);
+	zassert_equal(version_get(outer), 42, NULL);
+
+	cJSON_Delete(outer);
+	cJSON_ArenaEnd();
+
+	cJSON_ArenaStatsGet(&stats);
+	zassert_equal(stats.used, 0, NULL);
+}
+
+/* Array of numbers that does not fit in the arena */
+static void large_doc_create(void)
+{
+	size_t len = 0;
+
+	len += snprintf(&doc[len], sizeof(doc) - len, "{\"values\":[");
+	for (int i = 0; i < 200; i++) {
+		len += snprintf(&doc[len], sizeof(doc) - len, "%s%d",
+				i ? "," : "", i);
+	}
+	len += snprintf(&doc[len], sizeof(doc) - len, "],\"version\":7}");
+
+	zassert_true(len < sizeof(doc), NULL);
+}
+
+static void test_arena_overflow(void)
+{
+	struct cJSON_arena_stats stats;
+	uint32_t overflows;
+	cJSON *root;
+
+	large_doc_create();
+
+	cJSON_ArenaStatsGet(&stats);
+	overflows = stats.overflows;
+
+	/* Items that do not fit are taken from the heap and freed by
+	 * cJSON_Delete, so this would run out of heap if they leaked.
+	 */
+	for (int i = 0; i < 200; i++) {
+		cJSON_ArenaBegin();
+		root = cJSON_Parse(doc);
+		zassert_not_null(root, "Parsing failed in iteration %d", i);
+		zassert_equal(cJSON_GetArraySize(
+				      cJSON_GetObjectItem(root, "values")),
+			      200, NULL);
+		zassert_equal(version_get(root), 7, NULL);
+		cJSON_Delete(root);
+		cJSON_ArenaEnd();
+	}
+
+	cJSON_ArenaStatsGet(&stats);
+	zassert_true(stats.overflows > overflows, "Arena did not overflow");
+	zassert_equal(stats.used, 0, NULL);
+}
+
+static void other_thread(void *p1, void *p2, void *p3)
+{
+	cJSON **root = p1;
+
+	*root = cJSON_Parse(shadow_delta);
+}
+
+static void test_arena_other_thread(void)
+{
+	struct cJSON_arena_stats before;
+	struct cJSON_arena_stats after;
+	cJSON *root = NULL;
+
+	cJSON_ArenaBegin();
+	cJSON_ArenaStatsGet(&before);
+
+	/* Items parsed by another thread outlive the scope, so they must be
+	 * taken from the heap.
+	 */
+	k_thread_create(&thread, thread_stack,
+			K_THREAD_STACK_SIZEOF(thread_stack), other_thread,
+			&root, NULL, NULL, K_PRIO_PREEMPT(0), 0, K_NO_WAIT);
+	k_thread_join(&thread, K_FOREVER);
+
+	cJSON_ArenaStatsGet(&after);
+	cJSON_ArenaEnd();
+
+	zassert_not_null(root, NULL);
+	zassert_equal(after.used, before.used, "Other thread used the arena");
+
+	/* Still valid after the scope has ended */
+	zassert_equal(version_get(root), 42, NULL);
+	cJSON_Delete(root);
+}
+
+/* Shadow delta with a random number of sensors and random topic length */
+static void soak_doc_create(int version)
+{
+	static const char *const sensors[] = {
+		"GPS", "FLIP", "TEMP", "HUMID", "AIR_PRESS", "AIR_QUAL",
+		"LIGHT", "RSRP"
+	};
+	char prefix[49];
+	int count = 1 + xorshift32() % ARRAY_SIZE(sensors);
+	size_t prefix_len = 8 + xorshift32() % (sizeof(prefix) - 8);
+	size_t len = 0;
+
+	for (size_t i = 0; i < prefix_len; i++) {
+		prefix[i] = 'a' + xorshift32() % 26;
+	}
+	prefix[prefix_len] = '\0';
+
+	len += snprintf(&doc[len], sizeof(doc) - len,
+			"{\"state\":{\"config\":{");
+	for (int i = 0; i < count; i++) {
+		len += snprintf(&doc[len], sizeof(doc) - len,
+				"%s\"%s\":{\"enable\":%s,\"thresh_hi\":%d.%d}",
+				i ? "," : "", sensors[i],
+				xorshift32() & 1 ? "true" : "false",
+				xorshift32() % 100, xorshift32() % 10);
+	}
+	len += snprintf(&doc[len], sizeof(doc) - len,
+			"},\"pairing\":{\"state\":\"paired\",\"topics\":{"
+			"\"d2c\":\"%s/d2c\",\"c2d\":\"%s/+/r\"}},"
+			"\"nrfcloud_mqtt_topic_prefix\":\"%s/\"},"
+			"\"version\":%d}",
+			prefix, prefix, prefix, version);
+
+	zassert_true(len < sizeof(doc), NULL);
+}
+
+/* Size of the largest block that can be allocated from the heap */
+static size_t heap_largest_block(void)
+{
+	size_t low = 0;
+	size_t high = CONFIG_HEAP_MEM_POOL_SIZE;
+
+	while (low < high) {
+		size_t size = (low + high + 1) / 2;
+		void *p = k_malloc(size);
+
+		if (p) {
+			k_free(p);
+			low = size;
+		} else {
+			high = size - 1;
+		}
+	}
+
+	return low;
+}
+
+/* Decodes messages while replacing one of the long-lived heap blocks per
+ * message, in the middle of decoding, like a decoder that copies a value
+ * out of the document. Returns the number of messages that failed.
+ */
+static int soak_run(bool arena, size_t *largest)
+{
+	static void *blocks[SOAK_BLOCKS];
+	struct cJSON_arena_stats stats;
+	int failures = 0;
+	cJSON *root;
+
+	rand_state = 0x2545f491;
+
+	for (int i = 0; i < SOAK_ITERATIONS; i++) {
+		int slot = xorshift32() % SOAK_BLOCKS;
+
+		soak_doc_create(i);
+
+		if (arena) {
+			cJSON_ArenaBegin();
+		}
+
+		root = cJSON_Parse(doc);
+		if (version_get(root) != i) {
+			failures++;
+		}
+
+		k_free(blocks[slot]);
+		blocks[slot] = k_malloc(1 + xorshift32() % SOAK_BLOCK_SIZE_MAX);
+
+		cJSON_Delete(root);
+
+		if (arena) {
+			cJSON_ArenaEnd();
+
+			cJSON_ArenaStatsGet(&stats);
+			zassert_equal(stats.used, 0, NULL);
+		}
+	}
+
+	*largest = heap_largest_block();
+
+	for (int i = 0; i < SOAK_BLOCKS; i++) {
+		k_free(blocks[i]);
+		blocks[i] = NULL;
+	}
+
+	return failures;
+}
+
+static void test_soak_fragmentation(void)
+{
+	struct cJSON_arena_stats stats;
+	uint32_t overflows;
+	size_t heap_largest;
+	size_t arena_largest;
+	int heap_failures;
+	int arena_failures;
+
+	heap_failures = soak_run(false, &heap_largest);
+
+	cJSON_ArenaStatsGet(&stats);
+	overflows = stats.overflows;
+
+	arena_failures = soak_run(true, &arena_largest);
+
+	cJSON_ArenaStatsGet(&stats);
+
+	TC_PRINT("%d messages, arena peak %u of %u bytes\n", SOAK_ITERATIONS,
+		 (uint32_t)stats.peak, CONFIG_CJSON_ARENA_SIZE);
+	TC_PRINT("  heap:  %5d failed, largest free block %5u bytes\n",
+		 heap_failures, (uint32_t)heap_largest);
+	TC_PRINT("  arena: %5d failed, largest free block %5u bytes\n",
+		 arena_failures, (uint32_t)arena_largest);
+
+	zassert_equal(arena_failures, 0, "Decoding failed with the arena");
+	zassert_equal(stats.overflows, overflows, "Arena too small for soak");
+}
+
+void test_main(void)
+{
+	ztest_test_suite(lib_cjson_arena_test,
+		ztest_unit_test_setup_teardown(test_arena_release,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_arena_nested,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_arena_overflow,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_arena_other_thread,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_soak_fragmentation,
+					       setup, teardown)
+	);
+
+	ztest_run_test_suite(lib_cjson_arena_test);
+}
@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <ztest.h>
+#include <string.h>
+#include <json_path.h>
+
+extern void test_benchmark_job_document(void);
+extern void test_benchmark_shadow_delta(void);
+
+static int extract(const char *json, struct json_path_query *q, size_t count)
+{
+	return json_path_extract(json, strlen(json), q, count);
+}
+
+static void assert_value(const struct json_path_query *q,
+			 enum json_path_type type, const char *text)
+{
+	zassert_equal(q->value.type, type, "Wrong type for %s", q->path);
+	zassert_equal(q->value.len, strlen(text), "Wrong length for %s",
+		      q->path);
+	zassert_mem_equal(q->value.ptr, text, q->value.len,
+			  "Wrong value for %s", q->path);
+}
+
+static void test_path_values(void)
+{
+	static const char json[] =
+		"{ \"a\": { \"b\": \"str\", \"c\": -12.5e3, \"d\": true,\n"
+		"  \"e\": false, \"f\": null, \"g\": [1, {\"b\": 2}],\n"
+		"  \"h\": {}, \"i\": { \"j\": { \"k\": 7 } } },\n"
+		"  \"b\": 0 }";
+	struct json_path_query q[] = {
+		JSON_PATH_QUERY("a.b"),
+		JSON_PATH_QUERY("a.c"),
+		JSON_PATH_QUERY("a.d"),
+		JSON_PATH_QUERY("a.e"),
+		JSON_PATH_QUERY("a.f"),
+		JSON_PATH_QUERY("a.g"),
+		JSON_PATH_QUERY("a.h"),
+		JSON_PATH_QUERY("a.i.j.k"),
+		JSON_PATH_QUERY("b"),
+		JSON_PATH_QUERY("a.i.j"),
+		JSON_PATH_QUERY("a.x"),
+		JSON_PATH_QUERY("a.g.b"),
+		JSON_PATH_QUERY("a.b.c"),
+	};
+
+	zassert_equal(extract(json, q, ARRAY_SIZE(q)), 10, NULL);
+
+	assert_value(&q[0], JSON_PATH_STRING, "str");
+	assert_value(&q[1], JSON_PATH_NUMBER, "-12.5e3");
+	assert_value(&q[2], JSON_PATH_TRUE, "true");
+	assert_value(&q[3], JSON_PATH_FALSE, "false");
+	assert_value(&q[4], JSON_PATH_NULL, "null");
+	assert_value(&q[5], JSON_PATH_ARRAY, "[1, {\"b\": 2}]");
+	assert_value(&q[6], JSON_PATH_OBJECT, "{}");
+	assert_value(&q[7], JSON_PATH_NUMBER, "7");
+	assert_value(&q[8], JSON_PATH_NUMBER, "0");
+	assert_value(&q[9], JSON_PATH_OBJECT, "{ \"k\": 7 }");
+
+	/* Paths do not lead through arrays or into strings */
+	zassert_false(json_path_found(&q[10]), NULL);
+	zassert_false(json_path_found(&q[11]), NULL);
+	zassert_false(json_path_found(&q[12]), NULL);
+}
+
+static void test_path_root(void)
+{
+	struct json_path_query root = JSON_PATH_QUERY("");
+	struct json_path_query member = JSON_PATH_QUERY("a");
+
+	zassert_equal(extract(" \"top\" ", &root, 1), 1, NULL);
+	assert_value(&root, JSON_PATH_STRING, "top");
+
+	zassert_equal(extract("[{\"a\": 1}]", &root, 1), 1, NULL);
+	assert_value(&root, JSON_PATH_ARRAY, "[{\"a\": 1}]");
+
+	zassert_equal(extract("[{\"a\": 1}]", &member, 1), 0, NULL);
+}
+
+static void test_path_slice(void)
+{
+	static const char json[] = "{\"desired\":{\"firmware\":{\"v\":3}}}";
+	struct json_path_query desired = JSON_PATH_QUERY("desired");
+	struct json_path_query v = JSON_PATH_QUERY("firmware.v");
+
+	zassert_equal(extract(json, &desired, 1), 1, NULL);
+
+	/* An object can be scanned again, with relative paths */
+	zassert_equal(json_path_extract(desired.value.ptr, desired.value.len,
+					&v, 1), 1, NULL);
+	assert_value(&v, JSON_PATH_NUMBER, "3");
+}
+
+static void test_path_duplicate(void)
+{
+	static const char json[] =
+		"{\"a\": {\"b\": 1}, \"a\": {\"b\": 2, \"c\": 3}}";
+	struct json_path_query q[] = {
+		JSON_PATH_QUERY("a.b"),
+		JSON_PATH_QUERY("a.c"),
+	};
+
+	zassert_equal(extract(json, q, ARRAY_SIZE(q)), 2, NULL);
+
+	/* First one wins, like cJSON_GetObjectItem */
+	assert_value(&q[0], JSON_PATH_NUMBER, "1");
+	assert_value(&q[1], JSON_PATH_NUMBER, "3");
+}
+
+static void test_path_not_terminated(void)
+{
+	static const char json[] = "{\"a\": 12}{\"a\": 3";
+	struct json_path_query q = JSON_PATH_QUERY("a");
+
+	/* Only the given length is read, and trailing text is ignored */
+	zassert_equal(json_path_extract(json, 9, &q, 1), 1, NULL);
+	assert_value(&q, JSON_PATH_NUMBER, "12");
+
+	zassert_equal(json_path_extract(json, 7, &q, 1), -EBADMSG, NULL);
+	zassert_equal(extract(json, &q, 1), 1, NULL);
+}
+
+static void test_path_malformed(void)
+{
+	static const char *const malformed[] = {
+		"",
+		"   ",
+		"{",
+		"{\"a\"}",
+		"{\"a\" 1}",
+		"{\"a\": 1,}",
+		"{a: 1}",
+		"[1, 2",
+		"[1 2]",
+		"[1,]",
+		"{\"a\": [}",
+		"{\"a\": 1]",
+		"\"unterminated",
+		"\"bad \\x escape\"",
+		"\"bad \\u12g4\"",
+		"\"short \\u12\"",
+		"\"control \n\"",
+		"tru",
+		"nul",
+		"[-]",
+		"[01]",
+		"[1.]",
+		"[1e]",
+		"[.5]",
+		"[+1]",
+	};
+	struct json_path_query q = JSON_PATH_QUERY("a");
+
+	for (size_t i = 0; i < ARRAY_SIZE(malformed); i++) {
+		zassert_equal(extract(malformed[i], &q, 1), -EBADMSG,
+			      "Accepted '%s'", malformed[i]);
+	}
+}
+
+static void test_path_depth(void)
+{
+	static char json[2 * JSON_PATH_MAX_DEPTH + 4];
+	struct json_path_query q = JSON_PATH_QUERY("");
+	size_t depth;
+
+	for (depth = 0; depth < JSON_PATH_MAX_DEPTH; depth++) {
+		json[depth] = '[';
+		json[2 * JSON_PATH_MAX_DEPTH - 1 - depth] = ']';
+	}
+
+	zassert_equal(json_path_extract(json, 2 * depth, &q, 1), 1, NULL);
+	zassert_equal(q.value.len, 2 * depth, NULL);
+
+	memmove(json + 1, json, 2 * depth);
+	json[0] = '[';
+	json[2 * depth + 1] = ']';
+
+	zassert_equal(json_path_extract(json, 2 * depth + 2, &q, 1),
+		      -EBADMSG, NULL);
+}
+
+static void test_path_too_long(void)
+{
+	static char path[2 * (JSON_PATH_MAX_DEPTH + 1)];
+	struct json_path_query q = JSON_PATH_QUERY(path);
+
+	for (size_t i = 0; i < sizeof(path) - 1; i++) {
+		path[i] = (i % 2) ? '.' : 'a';
+	}
+
+	zassert_equal(extract("{}", &q, 1), -EINVAL, NULL);
+
+	path[2 * JSON_PATH_MAX_DEPTH - 1] = '\0';
+	zassert_equal(extract("{}", &q, 1), 0, NULL);
+}
+
+static void test_str_copy(void)
+{
+	static const char json[] =
+		"{\"s\": \"a\\\"\\\\\\/\\b\\f\\n\\r\\t\\u0041\\u00e9\\u20ac"
+		"\\ud83d\\ude00\", \"n\": 5, \"p\": \"plain\"}";
+	static const char expected[] = "a\"\\/\b\f\n\r\tA\xc3\xa9\xe2\x82\xac"
+				       "\xf0\x9f\x98\x80";
+	struct json_path_query q[] = {
+		JSON_PATH_QUERY("s"),
+		JSON_PATH_QUERY("n"),
+		JSON_PATH_QUERY("p"),
+	};
+	char buf[32];
+
+	zassert_equal(extract(json, q, ARRAY_SIZE(q)), 3, NULL);
+
+	zassert_equal(json_path_str_copy(&q[0].value, buf, sizeof(buf)),
+		      strlen(expected), NULL);
+	zassert_true(strcmp(buf, expected) == 0, NULL);
+	zassert_true(json_path_str_eq(&q[0].value, expected), NULL);
+
+	/* Truncated, but still terminated */
+	memset(buf, 0xa5, sizeof(buf));
+	zassert_equal(json_path_str_copy(&q[2].value, buf, 4), 5, NULL);
+	zassert_true(strcmp(buf, "pla") == 0, NULL);
+	zassert_equal((uint8_t)buf[4], 0xa5, "Wrote past the buffer");
+
+	zassert_equal(json_path_str_copy(&q[2].value, buf, 0), 5, NULL);
+	zassert_equal(json_path_str_copy(&q[1].value, buf, sizeof(buf)),
+		      -EINVAL, NULL);
+}
+
+static void test_str_eq(void)
+{
+	static const char json[] =
+		"{\"a\": \"current\", \"b\": \"cur\\u0072ent\", \"c\": 1,"
+		" \"d\": \"\", \"e\": \"a\\u0000b\"}";
+	struct json_path_query q[] = {
+		JSON_PATH_QUERY("a"),
+		JSON_PATH_QUERY("b"),
+		JSON_PATH_QUERY("c"),
+		JSON_PATH_QUERY("d"),
+		JSON_PATH_QUERY("e"),
+	};
+
+	zassert_equal(extract(json, q, ARRAY_SIZE(q)), 5, NULL);
+
+	zassert_true(json_path_str_eq(&q[0].value, "current"), NULL);
+	zassert_false(json_path_str_eq(&q[0].value, "curren"), NULL);
+	zassert_false(json_path_str_eq(&q[0].value, "currents"), NULL);
+	zassert_true(json_path_str_eq(&q[1].value, "current"), NULL);
+	zassert_false(json_path_str_eq(&q[1].value, "currentt"), NULL);
+	zassert_false(json_path_str_eq(&q[2].value, "1"), NULL);
+	zassert_true(json_path_str_eq(&q[3].value, ""), NULL);
+	zassert_false(json_path_str_eq(&q[4].value, "a"), NULL);
+}
+
+static void test_int(void)
+{
+	static const char json[] =
+		"{\"a\": 0, \"b\": -42, \"c\": 9223372036854775807,"
+		" \"d\": -9223372036854775808, \"e\": 9223372036854775808,"
+		" \"f\": -9223372036854775809, \"g\": 1.5, \"h\": 1e3,"
+		" \"i\": \"1\"}";
+	struct json_path_query q[] = {
+		JSON_PATH_QUERY("a"), JSON_PATH_QUERY("b"),
+		JSON_PATH_QUERY("c"), JSON_PATH_QUERY("d"),
+		JSON_PATH_QUERY("e"), JSON_PATH_QUERY("f"),
+		JSON_PATH_QUERY("g"), JSON_PATH_QUERY("h"),
+		JSON_PATH_QUERY("i"),
+	};
+	int64_t val;
+
+	zassert_equal(extract(json, q, ARRAY_SIZE(q)), 9, NULL);
+
+	zassert_equal(json_path_int(&q[0].value, &val), 0, NULL);
+	zassert_equal(val, 0, NULL);
+	zassert_equal(json_path_int(&q[1].value, &val), 0, NULL);
+	zassert_equal(val, -42, NULL);
+	zassert_equal(json_path_int(&q[2].value, &val), 0, NULL);
+	zassert_equal(val, INT64_MAX, NULL);
+	zassert_equal(json_path_int(&q[3].value, &val), 0, NULL);
+	zassert_equal(val, INT64_MIN, NULL);
+	zassert_equal(json_path_int(&q[4].value, &val), -ERANGE, NULL);
+	zassert_equal(json_path_int(&q[5].value, &val), -ERANGE, NULL);
+	zassert_equal(json_path_int(&q[6].value, &val), -EINVAL, NULL);
+	zassert_equal(json_path_int(&q[7].value, &val), -EINVAL, NULL);
+	zassert_equal(json_path_int(&q[8].value, &val), -EINVAL, NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(lib_json_path_test,
+		ztest_unit_test(test_path_values),
+		ztest_unit_test(test_path_root),
+		ztest_unit_test(test_path_slice),
+		ztest_unit_test(test_path_duplicate),
+		ztest_unit_test(test_path_not_terminated),
+		ztest_unit_test(test_path_malformed),
+		ztest_unit_test(test_path_depth),
+		ztest_unit_test(test_path_too_long),
+		ztest_unit_test(test_str_copy),
+		ztest_unit_test(test_str_eq),
+		ztest_unit_test(test_int),
+		ztest_unit_test(test_benchmark_job_document),
+		ztest_unit_test(test_benchmark_shadow_delta)
+	);
+
+	ztest_run_test_suite(lib_json_path_test);
+}
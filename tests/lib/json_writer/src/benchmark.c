@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/* Compares encoding typical cloud messages by building a cJSON tree and
+ * printing it, as the codecs used to, with the JSON writer.
+ */
+
+#include <ztest.h>
+#include <string.h>
+#include <stdlib.h>
+#include <json_writer.h>
+#include <cJSON.h>
+
+#define ITERATIONS 200
+
+static struct {
+	size_t allocs;
+	size_t frees;
+	size_t current;
+	size_t peak;
+} heap;
+
+/* The size of each block is stored in front of it, to track the peak */
+static void *counting_malloc(size_t size)
+{
+	size_t *block = malloc(sizeof(size_t) + size);
+
+	if (block == NULL) {
+		return NULL;
+	}
+
+	block[0] = size;
+	heap.allocs++;
+	heap.current += size;
+	heap.peak = MAX(heap.peak, heap.current);
+
+	return block + 1;
+}
+
+static void counting_free(void *ptr)
+{
+	size_t *block = ptr;
+
+	if (block == NULL) {
+		return;
+	}
+
+	block--;
+	heap.frees++;
+	heap.current -= block[0];
+	free(block);
+}
+
+static void heap_reset(void)
+{
+	memset(&heap, 0, sizeof(heap));
+}
+
+struct bench {
+	const char *name;
+	/* Returns printed JSON, freed with cJSON_free */
+	char *(*cjson_encode)(void);
+	/* Returns length of JSON written to buf */
+	int (*writer_encode)(char *buf, size_t size);
+};
+
+/* Sensor sample, as sent by the asset tracker for every measurement */
+static char *sample_cjson(void)
+{
+	char *out;
+	cJSON *root = cJSON_CreateObject();
+
+	cJSON_AddItemToObject(root, "appId", cJSON_CreateString("TEMP"));
+	cJSON_AddItemToObject(root, "data", cJSON_CreateString("23.5"));
+	cJSON_AddItemToObject(root, "messageType",
+			      cJSON_CreateString("DATA"));
+	cJSON_AddItemToObject(root, "ts", cJSON_CreateNumber(1602345678901.0));
+
+	out = cJSON_PrintUnformatted(root);
+	cJSON_Delete(root);
+
+	return out;
+}
+
+static int sample_writer(char *buf, size_t size)
+{
+	struct json_writer w;
+
+	json_writer_init(&w, buf, size);
+	json_writer_obj_start(&w, NULL);
+	json_writer_str(&w, "appId", "TEMP");
+	json_writer_str(&w, "data", "23.5");
+	json_writer_str(&w, "messageType", "DATA");
+	json_writer_int(&w, "ts", 1602345678901LL);
+	json_writer_obj_end(&w);
+
+	return json_writer_finish(&w);
+}
+
+static const char *const ui[] = { "GPS", "FLIP", "TEMP", "HUMID",
+				  "AIR_PRESS", "BUTTON", "RSRP" };
+static const char *const fota[] = { "APP", "MODEM" };
+
+static const struct {
+	const char *key;
+	const char *value;
+} info_str[] = {
+	{ "ipAddress", "10.160.33.51" },
+	{ "ueMode", "2" },
+	{ "iccid", "89450421180216216095" },
+	{ "imsi", "204080813516718" },
+	{ "modemFirmware", "mfw_nrf9160_1.2.1" },
+	{ "imei", "352656100367872" },
+	{ "board", "nrf9160dk_nrf9160" },
+	{ "appVersion", "v1.4.0" },
+	{ "appName", "asset_tracker" },
+};
+
+/* Device status shadow update, with modem and service information */
+static char *device_status_cjson(void)
+{
+	char *out;
+	cJSON *root = cJSON_CreateObject();
+	cJSON *state = cJSON_CreateObject();
+	cJSON *reported = cJSON_CreateObject();
+	cJSON *device = cJSON_CreateObject();
+	cJSON *network = cJSON_CreateObject();
+	cJSON *info = cJSON_CreateObject();
+	cJSON *service = cJSON_CreateObject();
+
+	cJSON_AddItemToObject(network, "currentBand", cJSON_CreateNumber(20));
+	cJSON_AddItemToObject(network, "supportedBands",
+			      cJSON_CreateString("(1,2,3,4,5,8,12,13,18,19)"));
+	cJSON_AddItemToObject(network, "areaCode", cJSON_CreateNumber(2305));
+	cJSON_AddItemToObject(network, "mccmnc", cJSON_CreateString("24201"));
+	cJSON_AddItemToObject(network, "cellID", cJSON_CreateNumber(33703711));
+	cJSON_AddItemToObject(network, "networkMode",
+			      cJSON_CreateString("LTE-M GPS"));
+	cJSON_AddItemToObject(device, "networkInfo", network);
+
+	for (int i = 0; i < ARRAY_SIZE(info_str); i++) {
+		cJSON_AddItemToObject(info, info_str[i].key,
+				      cJSON_CreateString(info_str[i].value));
+	}
+	cJSON_AddItemToObject(info, "batteryVoltage", cJSON_CreateNumber(4401));
+	cJSON_AddItemToObject(device, "deviceInfo", info);
+
+	cJSON_AddItemToObject(service, "ui",
+			      cJSON_CreateStringArray((const char **)ui,
+						      ARRAY_SIZE(ui)));
+	cJSON_AddItemToObject(service, "fota_v1",
+			      cJSON_CreateStringArray((const char **)fota,
+						      ARRAY_SIZE(fota)));
+	cJSON_AddItemToObject(device, "serviceInfo", service);
+
+	cJSON_AddItemToObject(reported, "DEVICE", cJSON_CreateNull());
+	cJSON_AddItemToObject(reported, "device", device);
+	cJSON_AddItemToObject(state, "reported", reported);
+	cJSON_AddItemToObject(root, "state", state);
+
+	out = cJSON_PrintUnformatted(root);
+	cJSON_Delete(root);
+
+	return out;
+}
+
+static int device_status_writer(char *buf, size_t size)
+{
+	struct json_writer w;
+
+	json_writer_init(&w, buf, size);
+	json_writer_obj_start(&w, NULL);
+	json_writer_obj_start(&w, "state");
+	json_writer_obj_start(&w, "reported");
+	json_writer_null(&w, "DEVICE");
+	json_writer_obj_start(&w, "device");
+
+	json_writer_obj_start(&w, "networkInfo");
+	json_writer_int(&w, "currentBand", 20);
+	json_writer_str(&w, "supportedBands", "(1,2,3,4,5,8,12,13,18,19)");
+	json_writer_int(&w, "areaCode", 2305);
+	json_writer_str(&w, "mccmnc", "24201");
+	json_writer_double(&w, "cellID", 33703711);
+	json_writer_str(&w, "networkMode", "LTE-M GPS");
+	json_writer_obj_end(&w);
+
+	json_writer_obj_start(&w, "deviceInfo");
+	for (int i = 0; i < ARRAY_SIZE(info_str); i++) {
+		json_writer_str(&w, info_str[i].key, info_str[i].value);
+	}
+	json_writer_int(&w, "batteryVoltage", 4401);
+	json_writer_obj_end(&w);
+
+	json_writer_obj_start(&w, "serviceInfo");
+	json_writer_arr_start(&w, "ui");
+	for (int i = 0; i < ARRAY_SIZE(ui); i++) {
+		json_writer_str(&w, NULL, ui[i]);
+	}
+	json_writer_arr_end(&w);
+	json_writer_arr_start(&w, "fota_v1");
+	for (int i = 0; i < ARRAY_SIZE(fota); i++) {
+		json_writer_str(&w, NULL, fota[i]);
+	}
+	json_writer_arr_end(&w);
+	json_writer_obj_end(&w);
+
+	json_writer_obj_end(&w);
+	json_writer_obj_end(&w);
+	json_writer_obj_end(&w);
+	json_writer_obj_end(&w);
+
+	return json_writer_finish(&w);
+}
+
+static void bench_run(const struct bench *bench)
+{
+	static char buf[1024];
+	cJSON_Hooks hooks = {
+		.malloc_fn = counting_malloc,
+		.free_fn = counting_free,
+	};
+	char *reference;
+	size_t cjson_ops;
+	size_t cjson_peak;
+	uint32_t start;
+	uint32_t cjson_cycles;
+	uint32_t writer_cycles;
+	int len;
+
+	cJSON_InitHooks(&hooks);
+
+	/* Heap use of a single encoding, the writer does not allocate */
+	heap_reset();
+	reference = bench->cjson_encode();
+	zassert_not_null(reference, NULL);
+
+	len = bench->writer_encode(buf, sizeof(buf));
+	zassert_equal(len, strlen(reference), "Length differs from cJSON");
+	zassert_mem_equal(buf, reference, len + 1, "Output differs from cJSON");
+
+	cJSON_free(reference);
+	zassert_equal(heap.current, 0, "cJSON leaked memory");
+
+	cjson_ops = heap.allocs + heap.frees;
+	cjson_peak = heap.peak;
+
+	start = k_cycle_get_32();
+	for (int i = 0; i < ITERATIONS; i++) {
+		cJSON_free(bench->cjson_encode());
+	}
+	cjson_cycles = (k_cycle_get_32() - start) / ITERATIONS;
+
+	start = k_cycle_get_32();
+	for (int i = 0; i < ITERATIONS; i++) {
+		(void)bench->writer_encode(buf, sizeof(buf));
+	}
+	writer_cycles = (k_cycle_get_32() - start) / ITERATIONS;
+
+	cJSON_InitHooks(NULL);
+
+	zassert_true(cjson_peak > len, NULL);
+
+	TC_PRINT("%s, %d bytes of JSON\n", bench->name, len);
+	TC_PRINT("  cJSON:  %4u heap ops, %5u bytes peak, %7u cycles\n",
+		 (uint32_t)cjson_ops, (uint32_t)cjson_peak, cjson_cycles);
+	TC_PRINT("  writer: %4u heap ops, %5u bytes peak, %7u cycles\n",
+		 0, len + 1, writer_cycles);
+}
+
+void test_benchmark_sample(void)
+{
+	static const struct bench bench = {
+		.name = "Sensor sample",
+		.cjson_encode = sample_cjson,
+		.writer_encode = sample_writer,
+	};
+
+	bench_run(&bench);
+}
+
+void test_benchmark_device_status(void)
+{
+	static const struct bench bench = {
+		.name = "Device status",
+		.cjson_encode = device_status_cjson,
+		.writer_encode = device_status_writer,
+	};
+
+	bench_run(&bench);
+}
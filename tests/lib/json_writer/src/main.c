@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <ztest.h>
+#include <string.h>
+#include <json_writer.h>
+
+#define GUARD 0xa5
+
+extern void test_benchmark_sample(void);
+extern void test_benchmark_device_status(void);
+
+static char buf[256];
+static int encode_calls;
+
+static int document_encode(struct json_writer *w, void *ctx)
+{
+	static const char *const ui[] = { "GPS", "FLIP", "TEMP" };
+
+	encode_calls++;
+
+	json_writer_obj_start(w, NULL);
+	json_writer_str(w, "appId", "GPS");
+	json_writer_int(w, "ts", 1602345678901LL);
+	json_writer_int(w, "min", INT64_MIN);
+	json_writer_double(w, "temp", 23.5);
+	json_writer_double(w, "count", 42.0);
+	json_writer_bool(w, "enable", true);
+	json_writer_bool(w, "disable", false);
+	json_writer_null(w, "DEVICE");
+	json_writer_arr_start(w, "ui");
+	for (int i = 0; i < ARRAY_SIZE(ui); i++) {
+		json_writer_str(w, NULL, ui[i]);
+	}
+	json_writer_arr_end(w);
+	json_writer_arr_start(w, "empty");
+	json_writer_arr_end(w);
+	json_writer_obj_start(w, "config");
+	json_writer_raw(w, "GPS", "{\"enable\":true}", 15);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
+
+	return 0;
+}
+
+static const char document[] =
+	"{\"appId\":\"GPS\",\"ts\":1602345678901,"
+	"\"min\":-9223372036854775808,\"temp\":23.5,\"count\":42,"
+	"\"enable\":true,\"disable\":false,\"DEVICE\":null,"
+	"\"ui\":[\"GPS\",\"FLIP\",\"TEMP\"],\"empty\":[],"
+	"\"config\":{\"GPS\":{\"enable\":true}}}";
+
+static void setup(void)
+{
+	memset(buf, GUARD, sizeof(buf));
+	encode_calls = 0;
+}
+
+static void teardown(void)
+{
+}
+
+static void test_writer_document(void)
+{
+	int len;
+	struct json_writer w;
+
+	json_writer_init(&w, buf, sizeof(buf));
+	document_encode(&w, NULL);
+
+	len = json_writer_finish(&w);
+	zassert_equal(len, sizeof(document) - 1, "Wrong length %d", len);
+	zassert_mem_equal(buf, document, sizeof(document), NULL);
+}
+
+static void test_writer_measure(void)
+{
+	struct json_writer w;
+
+	json_writer_init(&w, NULL, 0);
+	document_encode(&w, NULL);
+
+	zassert_equal(json_writer_finish(&w), sizeof(document) - 1, NULL);
+}
+
+static void test_writer_escape(void)
+{
+	static const char expected[] =
+		"[\"q\\\"b\\\\n\\nt\\tc\\u0001\\u001f\",\"k\\u0007\",null]";
+	struct json_writer w;
+
+	json_writer_init(&w, buf, sizeof(buf));
+	json_writer_arr_start(&w, NULL);
+	json_writer_str(&w, NULL, "q\"b\\n\nt\tc\x01\x1f");
+	json_writer_str(&w, NULL, "k\a");
+	json_writer_str(&w, NULL, NULL);
+	json_writer_arr_end(&w);
+
+	zassert_equal(json_writer_finish(&w), sizeof(expected) - 1, NULL);
+	zassert_mem_equal(buf, expected, sizeof(expected), NULL);
+}
+
+static void test_writer_nesting(void)
+{
+	struct json_writer w;
+
+	/* Member without a name */
+	json_writer_init(&w, buf, sizeof(buf));
+	json_writer_obj_start(&w, NULL);
+	json_writer_int(&w, NULL, 1);
+	json_writer_obj_end(&w);
+	zassert_equal(json_writer_finish(&w), -EINVAL, NULL);
+
+	/* Array element with a name */
+	json_writer_init(&w, buf, sizeof(buf));
+	json_writer_arr_start(&w, NULL);
+	json_writer_int(&w, "a", 1);
+	json_writer_arr_end(&w);
+	zassert_equal(json_writer_finish(&w), -EINVAL, NULL);
+
+	/* Mismatched end */
+	json_writer_init(&w, buf, sizeof(buf));
+	json_writer_obj_start(&w, NULL);
+	json_writer_arr_end(&w);
+	zassert_equal(json_writer_finish(&w), -EINVAL, NULL);
+
+	/* Unterminated object */
+	json_writer_init(&w, buf, sizeof(buf));
+	json_writer_obj_start(&w, NULL);
+	zassert_equal(json_writer_finish(&w), -EINVAL, NULL);
+
+	/* Too deep */
+	json_writer_init(&w, NULL, 0);
+	for (int i = 0; i < JSON_WRITER_MAX_DEPTH; i++) {
+		json_writer_arr_start(&w, NULL);
+	}
+	zassert_equal(json_writer_finish(&w), -EINVAL, NULL);
+}
+
+static void test_writer_overflow(void)
+{
+	int err;
+	struct json_writer w;
+
+	/* Every size short of the length plus NUL fails without writing
+	 * past the end of the buffer.
+	 */
+	for (size_t size = 0; size <= sizeof(document) - 1; size++) {
+		memset(buf, GUARD, sizeof(buf));
+
+		json_writer_init(&w, buf, size);
+		document_encode(&w, NULL);
+
+		err = json_writer_finish(&w);
+		zassert_equal(err, -ENOMEM, "Size %d not rejected", size);
+
+		for (size_t i = size; i < sizeof(buf); i++) {
+			zassert_equal((uint8_t)buf[i], GUARD,
+				      "Write past the end at %d", i);
+		}
+	}
+
+	json_writer_init(&w, buf, sizeof(document));
+	document_encode(&w, NULL);
+	zassert_equal(json_writer_finish(&w), sizeof(document) - 1, NULL);
+}
+
+static int unstable_encode(struct json_writer *w, void *ctx)
+{
+	encode_calls++;
+
+	json_writer_obj_start(w, NULL);
+	json_writer_int(w, "calls", encode_calls == 1 ? 1000 : 1);
+	json_writer_obj_end(w);
+
+	return 0;
+}
+
+static int failing_encode(struct json_writer *w, void *ctx)
+{
+	encode_calls++;
+
+	return -ENOTSUP;
+}
+
+static void test_writer_encode_alloc(void)
+{
+	int err;
+	char *out = NULL;
+	size_t len;
+
+	err = json_writer_encode_alloc(document_encode, NULL, &out, &len);
+	zassert_equal(err, 0, NULL);
+	zassert_equal(encode_calls, 2, NULL);
+	zassert_equal(len, sizeof(document) - 1, NULL);
+	zassert_mem_equal(out, document, sizeof(document), NULL);
+	k_free(out);
+
+	/* Output of the second pass differs from the first one */
+	encode_calls = 0;
+	out = NULL;
+	err = json_writer_encode_alloc(unstable_encode, NULL, &out, &len);
+	zassert_equal(err, -EIO, NULL);
+	zassert_is_null(out, NULL);
+
+	/* Encoder errors are passed on */
+	encode_calls = 0;
+	err = json_writer_encode_alloc(failing_encode, NULL, &out, &len);
+	zassert_equal(err, -ENOTSUP, NULL);
+	zassert_equal(encode_calls, 1, NULL);
+	zassert_is_null(out, NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(lib_json_writer_test,
+		ztest_unit_test_setup_teardown(test_writer_document,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_writer_measure,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_writer_escape,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_writer_nesting,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_writer_overflow,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_writer_encode_alloc,
+					       setup, teardown),
+		ztest_unit_test(test_benchmark_sample),
+		ztest_unit_test(test_benchmark_device_status)
+	);
+
+	ztest_run_test_suite(lib_json_writer_test);
+}
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <ztest.h>
+#include <string.h>
+#include <stdbool.h>
+#include <zephyr/types.h>
+#include <mbedtls/sha256.h>
+#include <dfu/dfu_target.h>
+
+#define FILE_SIZE 0x1000
+#define FRAGMENT_SIZE 100
+
+static uint8_t image[FILE_SIZE];
+static uint8_t digest[DFU_TARGET_HASH_LEN];
+
+static bool update_fail;
+
+static size_t written;
+static size_t resume_offset;
+static int done_calls;
+static bool done_successful;
+
+/* Linked in place of mbedtls_sha256_update_ret() for dfu_target.c */
+int __real_mbedtls_sha256_update_ret(mbedtls_sha256_context *ctx,
+				     const unsigned char *input, size_t ilen);
+
+int __wrap_mbedtls_sha256_update_ret(mbedtls_sha256_context *ctx,
+				     const unsigned char *input, size_t ilen)
+{
+	if (update_fail) {
+		return MBEDTLS_ERR_SHA256_HW_ACCEL_FAILED;
+	}
+
+	return __real_mbedtls_sha256_update_ret(ctx, input, ilen);
+}
+
+bool dfu_target_mcuboot_identify(const void *const buf)
+{
+	return true;
+}
+
+int dfu_target_mcuboot_init(size_t file_size, dfu_target_callback_t cb)
+{
+	return 0;
+}
+
+int dfu_target_mcuboot_offset_get(size_t *offset)
+{
+	*offset = resume_offset;
+	return 0;
+}
+
+int dfu_target_mcuboot_write(const void *const buf, size_t len)
+{
+	written += len;
+	return 0;
+}
+
+int dfu_target_mcuboot_done(bool successful)
+{
+	done_calls++;
+	done_successful = successful;
+	return 0;
+}
+
+static int download(size_t from)
+{
+	int err;
+
+	err = dfu_target_init(DFU_TARGET_IMAGE_TYPE_MCUBOOT, FILE_SIZE, NULL);
+	zassert_equal(err, 0, NULL);
+
+	for (size_t off = from; off < FILE_SIZE; off += FRAGMENT_SIZE) {
+		err = dfu_target_write(image + off,
+				       MIN(FRAGMENT_SIZE, FILE_SIZE - off));
+		zassert_equal(err, 0, NULL);
+	}
+
+	return dfu_target_done(true);
+}
+
+static void setup(void)
+{
+	for (size_t i = 0; i < sizeof(image); i++) {
+		image[i] = (uint8_t)(i * 7 + (i >> 8));
+	}
+
+	zassert_equal(mbedtls_sha256_ret(image, sizeof(image), digest, false),
+		      0, NULL);
+
+	(void)dfu_target_reset();
+	update_fail = false;
+	written = 0;
+	resume_offset = 0;
+	done_calls = 0;
+	done_successful = false;
+}
+
+static void teardown(void)
+{
+	(void)dfu_target_hash_expect(NULL);
+	(void)dfu_target_reset();
+}
+
+static void test_hash_match(void)
+{
+	int err;
+
+	err = dfu_target_hash_expect(digest);
+	zassert_equal(err, 0, NULL);
+
+	err = download(0);
+	zassert_equal(err, 0, NULL);
+	zassert_equal(written, FILE_SIZE, NULL);
+	zassert_true(done_successful, "Valid image rejected");
+}
+
+static void test_hash_mismatch(void)
+{
+	int err;
+
+	dfu_target_hash_expect(digest);
+
+	image[FILE_SIZE / 2] ^= 0x01;
+
+	err = download(0);
+	zassert_equal(err, -EBADMSG, NULL);
+	zassert_false(done_successful, "Corrupted image scheduled");
+
+	/* The target starts over on the next initialization */
+	err = dfu_target_offset_get(&resume_offset);
+	zassert_true(err < 0, "Target still initialized");
+}
+
+static void test_hash_not_set(void)
+{
+	int err;
+
+	image[0] ^= 0x01;
+
+	err = download(0);
+	zassert_equal(err, 0, NULL);
+	zassert_true(done_successful, NULL);
+}
+
+static void test_hash_restart(void)
+{
+	int err;
+
+	dfu_target_hash_expect(digest);
+
+	err = dfu_target_init(DFU_TARGET_IMAGE_TYPE_MCUBOOT, FILE_SIZE, NULL);
+	zassert_equal(err, 0, NULL);
+
+	/* Garbage is written before the transfer is aborted */
+	err = dfu_target_write(image + 10, FRAGMENT_SIZE);
+	zassert_equal(err, 0, NULL);
+
+	err = dfu_target_done(false);
+	zassert_equal(err, 0, NULL);
+
+	/* The download is then restarted from the beginning */
+	err = download(0);
+	zassert_equal(err, 0, NULL);
+	zassert_true(done_successful, "Restarted image rejected");
+}
+
+static void test_hash_resumed(void)
+{
+	int err;
+
+	dfu_target_hash_expect(digest);
+
+	/* Part of the image was written before a reset, so the digest can
+	 * not be computed and the image is left to the bootloader.
+	 */
+	resume_offset = FILE_SIZE / 2;
+
+	err = download(resume_offset);
+	zassert_equal(err, 0, NULL);
+	zassert_true(done_successful, NULL);
+}
+
+static void test_hash_update_fail(void)
+{
+	int err;
+
+	dfu_target_hash_expect(digest);
+
+	/* The image can not be verified, so it must not be scheduled */
+	update_fail = true;
+
+	err = download(0);
+	zassert_equal(err, -EIO, NULL);
+	zassert_false(done_successful, "Unverified image scheduled");
+
+	err = dfu_target_offset_get(&resume_offset);
+	zassert_true(err < 0, "Target still initialized");
+}
+
+void test_main(void)
+{
+	ztest_test_suite(dfu_target_hash_test,
+		ztest_unit_test_setup_teardown(test_hash_match,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_hash_mismatch,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_hash_not_set,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_hash_restart,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_hash_resumed,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_hash_update_fail,
+					       setup, teardown)
+	);
+
+	ztest_run_test_suite(dfu_target_hash_test);
+}
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <string.h>
+#include <zephyr/types.h>
+#include <stdbool.h>
+#include <ztest.h>
+#include <dfu_target.h>
+#include <dfu_target_mcuboot.h>
+#include <dfu_target_compressed.h>
+
+static const uint8_t payload[] = {
+#include "payload.inc"
+};
+
+static const uint8_t payload_lzss[] = {
+#include "payload_lzss.inc"
+};
+
+static uint8_t compressed[sizeof(payload_lzss)];
+
+/* Decompressed data as written to the MCUBoot target */
+static struct {
+	uint8_t buf[sizeof(payload) + 64];
+	size_t len;
+	size_t init_size;
+	int done_calls;
+	bool successful;
+} mcuboot;
+
+static uint32_t rand_state;
+
+static uint32_t rand_next(void)
+{
+	/* xorshift32, deterministic across runs */
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= rand_state << 5;
+	return rand_state;
+}
+
+/* Stubs and mocks */
+bool dfu_target_mcuboot_identify(const void *const buf)
+{
+	return true;
+}
+
+int dfu_target_mcuboot_init(size_t file_size, dfu_target_callback_t cb)
+{
+	mcuboot.init_size = file_size;
+	mcuboot.len = 0;
+	return 0;
+}
+
+int dfu_target_mcuboot_offset_get(size_t *offset)
+{
+	*offset = 0;
+	return 0;
+}
+
+int dfu_target_mcuboot_write(const void *const buf, size_t len)
+{
+	zassert_true(mcuboot.len + len <= sizeof(mcuboot.buf),
+		     "Too much data written");
+
+	memcpy(mcuboot.buf + mcuboot.len, buf, len);
+	mcuboot.len += len;
+	return 0;
+}
+
+int dfu_target_mcuboot_done(bool successful)
+{
+	mcuboot.done_calls++;
+	mcuboot.successful = successful;
+	return 0;
+}
+
+/* Feeds the compressed image in fragments of random size */
+static int write_image(void)
+{
+	int err;
+	size_t len;
+	size_t offset = 0;
+
+	err = dfu_target_compressed_init(sizeof(compressed), NULL);
+	if (err) {
+		return err;
+	}
+
+	while (offset < sizeof(compressed)) {
+		/* MIN() evaluates its arguments twice */
+		len = 1 + rand_next() % 300;
+		len = MIN(len, sizeof(compressed) - offset);
+
+		err = dfu_target_compressed_write(compressed + offset, len);
+		if (err) {
+			return err;
+		}
+
+		offset += len;
+	}
+
+	err = dfu_target_compressed_offset_get(&offset);
+	zassert_equal(err, 0, NULL);
+	zassert_equal(offset, sizeof(compressed), NULL);
+
+	return dfu_target_compressed_done(true);
+}
+
+static struct dfu_target_compressed_header *header(void)
+{
+	return (struct dfu_target_compressed_header *)compressed;
+}
+
+static void setup(void)
+{
+	memcpy(compressed, payload_lzss, sizeof(compressed));
+	memset(&mcuboot, 0, sizeof(mcuboot));
+	rand_state = 0x2545f491;
+}
+
+static void teardown(void)
+{
+}
+
+static void test_compressed_identify(void)
+{
+	zassert_true(dfu_target_compressed_identify(compressed), NULL);
+	zassert_false(dfu_target_compressed_identify(payload), NULL);
+	zassert_true(sizeof(compressed) < sizeof(payload),
+		     "Payload did not compress");
+}
+
+static void test_compressed_round_trip(void)
+{
+	int err;
+
+	for (int i = 0; i < 8; i++) {
+		err = write_image();
+		zassert_equal(err, 0, NULL);
+
+		zassert_equal(mcuboot.init_size, sizeof(payload), NULL);
+		zassert_equal(mcuboot.len, sizeof(payload), NULL);
+		zassert_mem_equal(mcuboot.buf, payload, sizeof(payload),
+				  "Round trip mismatch");
+		zassert_true(mcuboot.successful, NULL);
+	}
+}
+
+static void test_compressed_crc_mismatch(void)
+{
+	int err;
+
+	header()->crc ^= 0x01;
+
+	err = write_image();
+	zassert_equal(err, -EINVAL, NULL);
+	zassert_false(mcuboot.successful, "Corrupted image accepted");
+}
+
+static void test_compressed_truncated(void)
+{
+	int err;
+	size_t len = sizeof(compressed) / 2;
+
+	err = dfu_target_compressed_init(sizeof(compressed), NULL);
+	zassert_equal(err, 0, NULL);
+
+	err = dfu_target_compressed_write(compressed, len);
+	zassert_equal(err, 0, NULL);
+
+	err = dfu_target_compressed_done(true);
+	zassert_equal(err, -EINVAL, NULL);
+	zassert_false(mcuboot.successful, "Truncated image accepted");
+}
+
+static void test_compressed_abort(void)
+{
+	int err;
+	size_t offset;
+
+	err = dfu_target_compressed_init(sizeof(compressed), NULL);
+	zassert_equal(err, 0, NULL);
+
+	err = dfu_target_compressed_write(compressed, sizeof(compressed) / 2);
+	zassert_equal(err, 0, NULL);
+
+	err = dfu_target_compressed_done(false);
+	zassert_equal(err, 0, NULL);
+	zassert_false(mcuboot.successful, NULL);
+
+	/* A retry starts from the header */
+	err = dfu_target_compressed_offset_get(&offset);
+	zassert_equal(err, 0, NULL);
+	zassert_equal(offset, 0, NULL);
+
+	err = dfu_target_compressed_write(compressed, sizeof(compressed));
+	zassert_equal(err, 0, NULL);
+
+	err = dfu_target_compressed_done(true);
+	zassert_equal(err, 0, NULL);
+	zassert_mem_equal(mcuboot.buf, payload, sizeof(payload),
+			  "Retry after abort mismatch");
+}
+
+static void test_compressed_window_too_large(void)
+{
+	int err;
+
+	header()->window_bits = CONFIG_DFU_TARGET_COMPRESSED_WINDOW_BITS + 1;
+
+	err = dfu_target_compressed_init(sizeof(compressed), NULL);
+	zassert_equal(err, 0, NULL);
+
+	err = dfu_target_compressed_write(compressed, sizeof(compressed));
+	zassert_equal(err, -ENOTSUP, NULL);
+	zassert_equal(mcuboot.len, 0, NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(lib_dfu_target_compressed_test,
+		ztest_unit_test_setup_teardown(test_compressed_identify,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_compressed_round_trip,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_compressed_crc_mismatch,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_compressed_truncated,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_compressed_abort,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_compressed_window_too_large,
+					       setup, teardown)
+	);
+
+	ztest_run_test_suite(lib_dfu_target_compressed_test);
+}
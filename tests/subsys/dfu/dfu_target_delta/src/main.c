@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <string.h>
+#include <zephyr/types.h>
+#include <stdbool.h>
+#include <ztest.h>
+#include <storage/flash_map.h>
+#include <dfu_target.h>
+#include <dfu_target_mcuboot.h>
+#include <dfu_target_delta.h>
+#include <pm_config.h>
+
+static const uint8_t source[] = {
+#include "source.inc"
+};
+
+static const uint8_t target[] = {
+#include "target.inc"
+};
+
+static const uint8_t patch_orig[] = {
+#include "patch.inc"
+};
+
+BUILD_ASSERT(sizeof(source) <= PM_MCUBOOT_PRIMARY_SIZE);
+
+static uint8_t patch[sizeof(patch_orig)];
+
+/* Simulated primary slot, holding the running image */
+static struct {
+	struct flash_area area;
+	uint8_t slot[PM_MCUBOOT_PRIMARY_SIZE];
+	int reads;
+} primary;
+
+/* Simulated secondary slot, written through the MCUBoot target */
+static struct {
+	uint8_t slot[sizeof(target) + 64];
+	size_t len;
+	size_t init_size;
+	bool successful;
+} secondary;
+
+static uint32_t rand_state;
+
+static uint32_t rand_next(void)
+{
+	/* xorshift32, deterministic across runs */
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= rand_state << 5;
+	return rand_state;
+}
+
+/* Stubs and mocks */
+int flash_area_open(uint8_t id, const struct flash_area **fa)
+{
+	zassert_equal(id, PM_MCUBOOT_PRIMARY_ID, "Wrong slot opened");
+
+	primary.area.fa_id = id;
+	primary.area.fa_size = sizeof(primary.slot);
+	*fa = &primary.area;
+	return 0;
+}
+
+int flash_area_read(const struct flash_area *fa, off_t off, void *dst,
+		    size_t len)
+{
+	zassert_equal(fa, &primary.area, NULL);
+	zassert_true(off >= 0 && off + len <= sizeof(primary.slot),
+		     "Read outside of the primary slot");
+	zassert_true(len <= CONFIG_DFU_TARGET_DELTA_BUF_SIZE,
+		     "Read larger than the patching buffer");
+
+	memcpy(dst, primary.slot + off, len);
+	primary.reads++;
+	return 0;
+}
+
+bool dfu_target_mcuboot_identify(const void *const buf)
+{
+	return true;
+}
+
+int dfu_target_mcuboot_init(size_t file_size, dfu_target_callback_t cb)
+{
+	secondary.init_size = file_size;
+	secondary.len = 0;
+	return 0;
+}
+
+int dfu_target_mcuboot_offset_get(size_t *offset)
+{
+	*offset = 0;
+	return 0;
+}
+
+int dfu_target_mcuboot_write(const void *const buf, size_t len)
+{
+	zassert_true(secondary.len + len <= sizeof(secondary.slot),
+		     "Too much data written");
+
+	memcpy(secondary.slot + secondary.len, buf, len);
+	secondary.len += len;
+	return 0;
+}
+
+int dfu_target_mcuboot_done(bool successful)
+{
+	secondary.successful = successful;
+	return 0;
+}
+
+/* Feeds len bytes of the patch in fragments of random size */
+static int write_patch(size_t len)
+{
+	int err;
+	size_t chunk;
+	size_t offset = 0;
+
+	err = dfu_target_delta_init(sizeof(patch), NULL);
+	if (err) {
+		return err;
+	}
+
+	while (offset < len) {
+		/* MIN() evaluates its arguments twice */
+		chunk = 1 + rand_next() % 300;
+		chunk = MIN(chunk, len - offset);
+
+		err = dfu_target_delta_write(patch + offset, chunk);
+		if (err) {
+			return err;
+		}
+
+		offset += chunk;
+	}
+
+	return 0;
+}
+
+/* Returns the first command of the given type in the patch */
+static struct dfu_target_delta_cmd *cmd_find(uint8_t op)
+{
+	size_t pos = sizeof(struct dfu_target_delta_header);
+	struct dfu_target_delta_cmd *cmd;
+
+	while (pos < sizeof(patch)) {
+		cmd = (struct dfu_target_delta_cmd *)(patch + pos);
+		if (cmd->op == op) {
+			return cmd;
+		}
+
+		pos += sizeof(*cmd);
+		if (cmd->op == DFU_TARGET_DELTA_OP_INSERT) {
+			pos += cmd->len;
+		}
+	}
+
+	zassert_unreachable("No such command in patch");
+	return NULL;
+}
+
+static void setup(void)
+{
+	memcpy(patch, patch_orig, sizeof(patch));
+	memset(primary.slot, 0xff, sizeof(primary.slot));
+	memcpy(primary.slot, source, sizeof(source));
+	primary.reads = 0;
+	memset(&secondary, 0, sizeof(secondary));
+	rand_state = 0x2545f491;
+}
+
+static void teardown(void)
+{
+}
+
+static void test_delta_identify(void)
+{
+	zassert_true(dfu_target_delta_identify(patch), NULL);
+	zassert_false(dfu_target_delta_identify(source), NULL);
+	zassert_true(sizeof(patch) < sizeof(target) / 4, "Patch too large");
+}
+
+static void test_delta_round_trip(void)
+{
+	int err;
+	size_t offset;
+
+	for (int i = 0; i < 4; i++) {
+		err = write_patch(sizeof(patch));
+		zassert_equal(err, 0, NULL);
+
+		err = dfu_target_delta_offset_get(&offset);
+		zassert_equal(err, 0, NULL);
+		zassert_equal(offset, sizeof(patch), NULL);
+
+		err = dfu_target_delta_done(true);
+		zassert_equal(err, 0, NULL);
+
+		zassert_equal(secondary.init_size, sizeof(target), NULL);
+		zassert_equal(secondary.len, sizeof(target), NULL);
+		zassert_mem_equal(secondary.slot, target, sizeof(target),
+				  "Patched image mismatch");
+		zassert_true(secondary.successful, NULL);
+		zassert_true(primary.reads > 0, NULL);
+	}
+}
+
+static void test_delta_wrong_source(void)
+{
+	int err;
+
+	/* The device runs a different image than the patch was made for */
+	primary.slot[sizeof(source) / 2] ^= 0x01;
+
+	err = write_patch(sizeof(patch));
+	zassert_equal(err, -ENOTSUP, NULL);
+	zassert_equal(secondary.len, 0, "Data written for wrong source");
+}
+
+static void test_delta_corrupted(void)
+{
+	int err;
+	struct dfu_target_delta_cmd *cmd;
+
+	cmd = cmd_find(DFU_TARGET_DELTA_OP_INSERT);
+	((uint8_t *)(cmd + 1))[0] ^= 0x01;
+
+	err = write_patch(sizeof(patch));
+	zassert_equal(err, 0, NULL);
+
+	err = dfu_target_delta_done(true);
+	zassert_equal(err, -EINVAL, NULL);
+	zassert_false(secondary.successful, "Corrupted image accepted");
+}
+
+static void test_delta_out_of_bounds(void)
+{
+	int err;
+	struct dfu_target_delta_cmd *cmd;
+
+	cmd = cmd_find(DFU_TARGET_DELTA_OP_COPY);
+	cmd->offset = sizeof(source) - cmd->len + 1;
+
+	err = write_patch(sizeof(patch));
+	zassert_equal(err, -EINVAL, NULL);
+}
+
+static void test_delta_truncated(void)
+{
+	int err;
+
+	err = write_patch(sizeof(patch) / 2);
+	zassert_equal(err, 0, NULL);
+
+	err = dfu_target_delta_done(true);
+	zassert_equal(err, -EINVAL, NULL);
+	zassert_false(secondary.successful, "Truncated image accepted");
+}
+
+static void test_delta_abort(void)
+{
+	int err;
+	size_t offset;
+
+	err = write_patch(sizeof(patch) / 2);
+	zassert_equal(err, 0, NULL);
+
+	err = dfu_target_delta_done(false);
+	zassert_equal(err, 0, NULL);
+	zassert_false(secondary.successful, NULL);
+
+	/* A retry starts from the header */
+	err = dfu_target_delta_offset_get(&offset);
+	zassert_equal(err, 0, NULL);
+	zassert_equal(offset, 0, NULL);
+
+	err = dfu_target_delta_write(patch, sizeof(patch));
+	zassert_equal(err, 0, NULL);
+
+	err = dfu_target_delta_done(true);
+	zassert_equal(err, 0, NULL);
+	zassert_mem_equal(secondary.slot, target, sizeof(target),
+			  "Retry after abort mismatch");
+}
+
+void test_main(void)
+{
+	ztest_test_suite(lib_dfu_target_delta_test,
+		ztest_unit_test_setup_teardown(test_delta_identify,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_delta_round_trip,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_delta_wrong_source,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_delta_corrupted,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_delta_out_of_bounds,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_delta_truncated,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_delta_abort,
+					       setup, teardown)
+	);
+
+	ztest_run_test_suite(lib_dfu_target_delta_test);
+}
@@ -0,0 +1,335 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <string.h>
+#include <zephyr/types.h>
+#include <stdbool.h>
+#include <ztest.h>
+#include <drivers/flash.h>
+#include <dfu/mcuboot.h>
+#include <dfu/flash_img.h>
+#include <settings/settings.h>
+#include <dfu_target.h>
+#include <dfu_target_mcuboot.h>
+#include <pm_config.h>
+
+#define PAGE_SIZE 4096
+#define BUF_SIZE CONFIG_IMG_BLOCK_BUF_SIZE
+#define INTERVAL CONFIG_DFU_TARGET_MCUBOOT_SAVE_PROGRESS_INTERVAL
+#define IMAGE_SIZE (14 * PAGE_SIZE + 777)
+#define ERASED 0xff
+
+BUILD_ASSERT(IMAGE_SIZE <= PM_MCUBOOT_SECONDARY_SIZE);
+
+static uint8_t image[IMAGE_SIZE];
+
+/* Simulated secondary slot, written through a stream buffer like
+ * stream_flash does: the page holding the end of a buffer is erased when
+ * it is first written to after initialization.
+ */
+static struct {
+	uint8_t slot[PM_MCUBOOT_SECONDARY_SIZE];
+	uint8_t buf[BUF_SIZE];
+	size_t buf_bytes;
+	off_t last_erased;
+} flash;
+
+/* Simulated settings storage, holding a single value */
+static struct {
+	struct settings_handler *handler;
+	uint8_t val[32];
+	size_t len;
+	int saves;
+} storage;
+
+static uint32_t rand_state;
+
+static uint32_t rand_next(void)
+{
+	/* xorshift32, deterministic across runs */
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= rand_state << 5;
+	return rand_state;
+}
+
+/* Stubs and mocks */
+int flash_img_init(struct flash_img_context *ctx)
+{
+	memset(&ctx->stream, 0, sizeof(ctx->stream));
+	flash.buf_bytes = 0;
+	flash.last_erased = -1;
+	return 0;
+}
+
+size_t flash_img_bytes_written(struct flash_img_context *ctx)
+{
+	return ctx->stream.bytes_written;
+}
+
+static void flash_sync(struct flash_img_context *ctx)
+{
+	size_t off = ctx->stream.bytes_written;
+	off_t page;
+
+	if (!flash.buf_bytes) {
+		return;
+	}
+
+	page = ROUND_DOWN(off + flash.buf_bytes - 1, PAGE_SIZE);
+	if (page != flash.last_erased) {
+		memset(flash.slot + page, ERASED, PAGE_SIZE);
+		flash.last_erased = page;
+	}
+
+	memcpy(flash.slot + off, flash.buf, flash.buf_bytes);
+	ctx->stream.bytes_written += flash.buf_bytes;
+	flash.buf_bytes = 0;
+}
+
+int flash_img_buffered_write(struct flash_img_context *ctx,
+			     const uint8_t *data, size_t len, bool flush)
+{
+	size_t chunk;
+
+	while (len) {
+		chunk = MIN(len, BUF_SIZE - flash.buf_bytes);
+		memcpy(flash.buf + flash.buf_bytes, data, chunk);
+		flash.buf_bytes += chunk;
+		data += chunk;
+		len -= chunk;
+
+		if (flash.buf_bytes == BUF_SIZE) {
+			flash_sync(ctx);
+		}
+	}
+
+	if (flush) {
+		flash_sync(ctx);
+	}
+
+	return 0;
+}
+
+int z_impl_flash_get_page_info_by_offs(const struct device *dev, off_t offs,
+				       struct flash_pages_info *info)
+{
+	info->start_offset = ROUND_DOWN(offs, PAGE_SIZE);
+	info->size = PAGE_SIZE;
+	info->index = offs / PAGE_SIZE;
+	return 0;
+}
+
+int boot_request_upgrade(int permanent)
+{
+	return 0;
+}
+
+int settings_subsys_init(void)
+{
+	return 0;
+}
+
+int settings_register(struct settings_handler *handler)
+{
+	if (storage.handler) {
+		return -EEXIST;
+	}
+
+	storage.handler = handler;
+	return 0;
+}
+
+int settings_save_one(const char *name, const void *value, size_t val_len)
+{
+	zassert_equal(strcmp(name, "dfu/mcuboot/flash_img"), 0, NULL);
+	zassert_true(val_len <= sizeof(storage.val), "Record too large");
+
+	memcpy(storage.val, value, val_len);
+	storage.len = val_len;
+	storage.saves++;
+	return 0;
+}
+
+static ssize_t storage_read(void *cb_arg, void *data, size_t len)
+{
+	len = MIN(len, storage.len);
+	memcpy(data, storage.val, len);
+	return len;
+}
+
+int settings_load(void)
+{
+	if (storage.len) {
+		return storage.handler->h_set("mcuboot/flash_img", storage.len,
+					      storage_read, NULL);
+	}
+
+	return 0;
+}
+
+/* Simulates a boot followed by the start of a download */
+static size_t power_on(size_t file_size)
+{
+	int err;
+	size_t offset;
+
+	err = dfu_target_mcuboot_init(file_size, NULL);
+	zassert_equal(err, 0, NULL);
+
+	err = dfu_target_mcuboot_offset_get(&offset);
+	zassert_equal(err, 0, NULL);
+
+	return offset;
+}
+
+/* Writes the image from offset up to end, in fragments of random size */
+static void write_image(size_t offset, size_t end)
+{
+	int err;
+	size_t len;
+
+	while (offset < end) {
+		/* MIN() evaluates its arguments twice */
+		len = 1 + rand_next() % 1024;
+		len = MIN(len, end - offset);
+
+		err = dfu_target_mcuboot_write(image + offset, len);
+		zassert_equal(err, 0, NULL);
+
+		offset += len;
+	}
+}
+
+static void setup(void)
+{
+	for (size_t i = 0; i < IMAGE_SIZE; i++) {
+		image[i] = (uint8_t)(i ^ (i >> 9));
+	}
+
+	memset(flash.slot, ERASED, sizeof(flash.slot));
+	storage.len = 0;
+	storage.saves = 0;
+	rand_state = 0x2545f491;
+}
+
+static void teardown(void)
+{
+}
+
+static void test_progress_throttled(void)
+{
+	int err;
+	size_t offset;
+	size_t fragments = 0;
+
+	zassert_equal(power_on(IMAGE_SIZE), 0, NULL);
+
+	for (offset = 0; offset < IMAGE_SIZE; offset += 128) {
+		err = dfu_target_mcuboot_write(image + offset,
+					       MIN(128, IMAGE_SIZE - offset));
+		zassert_equal(err, 0, NULL);
+		fragments++;
+	}
+
+	zassert_true(storage.saves <= IMAGE_SIZE / INTERVAL,
+		     "%d checkpoints for %d fragments", storage.saves,
+		     fragments);
+
+	err = dfu_target_mcuboot_done(true);
+	zassert_equal(err, 0, NULL);
+	zassert_mem_equal(flash.slot, image, IMAGE_SIZE, "Image mismatch");
+
+	/* Progress is cleared once the image is complete */
+	zassert_equal(power_on(IMAGE_SIZE), 0, NULL);
+}
+
+static void test_progress_power_loss(void)
+{
+	int err;
+	int boots = 0;
+	size_t offset;
+	size_t flushed = 0;
+	size_t crash;
+
+	while (true) {
+		offset = power_on(IMAGE_SIZE);
+		boots++;
+
+		/* Never ahead of what reached flash before power was lost,
+		 * and never too far behind it.
+		 */
+		zassert_true(offset <= flushed, "Resumed past flash contents");
+		zassert_true(flushed - offset < INTERVAL + PAGE_SIZE,
+			     "Resumed %d bytes behind", flushed - offset);
+		zassert_equal(offset % PAGE_SIZE, 0, NULL);
+		zassert_mem_equal(flash.slot, image, offset,
+				  "Image corrupted before resume offset");
+
+		crash = offset + rand_next() % (IMAGE_SIZE / 3);
+		if (crash >= IMAGE_SIZE) {
+			break;
+		}
+
+		write_image(offset, crash);
+
+		/* Power is lost, whatever is left in the buffer is gone */
+		flushed = crash - flash.buf_bytes;
+	}
+
+	write_image(offset, IMAGE_SIZE);
+
+	err = dfu_target_mcuboot_done(true);
+	zassert_equal(err, 0, NULL);
+	zassert_mem_equal(flash.slot, image, IMAGE_SIZE, "Image mismatch");
+	zassert_true(boots > 2, "Too few simulated power failures");
+}
+
+static void test_progress_other_image(void)
+{
+	zassert_equal(power_on(IMAGE_SIZE), 0, NULL);
+	write_image(0, IMAGE_SIZE / 2);
+
+	/* A different image is downloaded after reboot */
+	zassert_equal(power_on(IMAGE_SIZE - 1), 0, NULL);
+}
+
+static void test_progress_corrupted(void)
+{
+	zassert_equal(power_on(IMAGE_SIZE), 0, NULL);
+	write_image(0, IMAGE_SIZE / 2);
+
+	storage.val[4] ^= 0x01;
+
+	zassert_equal(power_on(IMAGE_SIZE), 0, NULL);
+}
+
+static void test_progress_legacy_record(void)
+{
+	size_t offset = PAGE_SIZE + 100;
+
+	memcpy(flash.slot, image, offset);
+	settings_save_one("dfu/mcuboot/flash_img", &offset, sizeof(offset));
+
+	zassert_equal(power_on(IMAGE_SIZE), PAGE_SIZE, NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(lib_dfu_target_mcuboot_progress_test,
+		ztest_unit_test_setup_teardown(test_progress_throttled,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_progress_power_loss,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_progress_other_image,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_progress_corrupted,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_progress_legacy_record,
+					       setup, teardown)
+	);
+
+	ztest_run_test_suite(lib_dfu_target_mcuboot_progress_test);
+}
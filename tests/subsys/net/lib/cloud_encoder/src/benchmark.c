@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/* Compares the size and encoding time of typical asset tracker messages
+ * encoded as JSON and as CBOR.
+ */
+
+#include <ztest.h>
+#include <net/cloud_encoder.h>
+
+#define ITERATIONS 200
+
+/* Sensor sample, as sent by the asset tracker for every measurement */
+static int sample_encode(struct cloud_encoder *enc, void *ctx)
+{
+	cloud_encoder_obj_start(enc, NULL);
+	cloud_encoder_str(enc, "appId", "TEMP");
+	cloud_encoder_str(enc, "data", "23.5");
+	cloud_encoder_str(enc, "messageType", "DATA");
+	cloud_encoder_int(enc, "ts", 1602345678901LL);
+	cloud_encoder_obj_end(enc);
+
+	return 0;
+}
+
+static const char *const ui[] = { "GPS", "FLIP", "TEMP", "HUMID",
+				  "AIR_PRESS", "BUTTON", "RSRP" };
+static const char *const fota[] = { "APP", "MODEM" };
+
+static const struct {
+	const char *key;
+	const char *value;
+} info_str[] = {
+	{ "ipAddress", "10.160.33.51" },
+	{ "ueMode", "2" },
+	{ "iccid", "89450421180216216095" },
+	{ "imsi", "204080813516718" },
+	{ "modemFirmware", "mfw_nrf9160_1.2.1" },
+	{ "imei", "352656100367872" },
+	{ "board", "nrf9160dk_nrf9160" },
+	{ "appVersion", "v1.4.0" },
+	{ "appName", "asset_tracker" },
+};
+
+/* Device status, with modem and service information */
+static int device_status_encode(struct cloud_encoder *enc, void *ctx)
+{
+	cloud_encoder_obj_start(enc, NULL);
+
+	cloud_encoder_obj_start(enc, "networkInfo");
+	cloud_encoder_int(enc, "currentBand", 20);
+	cloud_encoder_str(enc, "supportedBands", "(1,2,3,4,5,8,12,13,18,19)");
+	cloud_encoder_int(enc, "areaCode", 2305);
+	cloud_encoder_str(enc, "mccmnc", "24201");
+	cloud_encoder_double(enc, "cellID", 33703711);
+	cloud_encoder_str(enc, "networkMode", "LTE-M GPS");
+	cloud_encoder_double(enc, "rsrp", -97.5);
+	cloud_encoder_obj_end(enc);
+
+	cloud_encoder_obj_start(enc, "deviceInfo");
+	for (int i = 0; i < ARRAY_SIZE(info_str); i++) {
+		cloud_encoder_str(enc, info_str[i].key, info_str[i].value);
+	}
+	cloud_encoder_int(enc, "batteryVoltage", 4401);
+	cloud_encoder_obj_end(enc);
+
+	cloud_encoder_obj_start(enc, "serviceInfo");
+	cloud_encoder_arr_start(enc, "ui");
+	for (int i = 0; i < ARRAY_SIZE(ui); i++) {
+		cloud_encoder_str(enc, NULL, ui[i]);
+	}
+	cloud_encoder_arr_end(enc);
+	cloud_encoder_arr_start(enc, "fota_v1");
+	for (int i = 0; i < ARRAY_SIZE(fota); i++) {
+		cloud_encoder_str(enc, NULL, fota[i]);
+	}
+	cloud_encoder_arr_end(enc);
+	cloud_encoder_obj_end(enc);
+
+	cloud_encoder_obj_end(enc);
+
+	return 0;
+}
+
+static int encode_into(enum cloud_encoding encoding,
+		       cloud_encoder_encode_t encode, void *buf, size_t size)
+{
+	struct cloud_encoder enc;
+
+	(void)cloud_encoder_init(&enc, encoding, buf, size);
+	(void)encode(&enc, NULL);
+
+	return cloud_encoder_finish(&enc);
+}
+
+static void bench_run(const char *name, cloud_encoder_encode_t encode)
+{
+	static uint8_t buf[1024];
+	int len[2];
+	uint32_t cycles[2];
+	uint32_t start;
+
+	for (int enc = CLOUD_ENCODING_JSON; enc <= CLOUD_ENCODING_CBOR; enc++) {
+		len[enc] = encode_into(enc, encode, buf, sizeof(buf));
+		zassert_true(len[enc] > 0, "Encoding %d failed", enc);
+
+		start = k_cycle_get_32();
+		for (int i = 0; i < ITERATIONS; i++) {
+			(void)encode_into(enc, encode, buf, sizeof(buf));
+		}
+		cycles[enc] = (k_cycle_get_32() - start) / ITERATIONS;
+	}
+
+	zassert_true(len[CLOUD_ENCODING_CBOR] < len[CLOUD_ENCODING_JSON],
+		     "CBOR is not smaller than JSON");
+
+	TC_PRINT("%s\n", name);
+	TC_PRINT("  JSON: %4d bytes, %7u cycles\n",
+		 len[CLOUD_ENCODING_JSON], cycles[CLOUD_ENCODING_JSON]);
+	TC_PRINT("  CBOR: %4d bytes, %7u cycles, %d%% of JSON\n",
+		 len[CLOUD_ENCODING_CBOR], cycles[CLOUD_ENCODING_CBOR],
+		 100 * len[CLOUD_ENCODING_CBOR] / len[CLOUD_ENCODING_JSON]);
+}
+
+void test_benchmark_sample(void)
+{
+	bench_run("Sensor sample", sample_encode);
+}
+
+void test_benchmark_device_status(void)
+{
+	bench_run("Device status", device_status_encode);
+}
@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <ztest.h>
+#include <string.h>
+#include <math.h>
+#include <net/cloud_encoder.h>
+
+#define GUARD 0xa5
+
+extern void test_benchmark_sample(void);
+extern void test_benchmark_device_status(void);
+
+static uint8_t buf[128];
+static struct cloud_encoder enc;
+static int encode_calls;
+
+static void setup(void)
+{
+	memset(buf, GUARD, sizeof(buf));
+	encode_calls = 0;
+}
+
+static void teardown(void)
+{
+}
+
+#define BYTES(...) { __VA_ARGS__ }
+
+/* Encodes a value with the given statement and compares the output with
+ * the expected bytes.
+ */
+#define assert_cbor(expected, statement)                                \
+	do {                                                            \
+		static const uint8_t exp[] = expected;                  \
+									\
+		cloud_encoder_init(&enc, CLOUD_ENCODING_CBOR, buf,      \
+				   sizeof(buf));                        \
+		statement;                                              \
+		zassert_equal(cloud_encoder_finish(&enc), sizeof(exp),  \
+			      "Wrong length, line %d", __LINE__);       \
+		zassert_mem_equal(buf, exp, sizeof(exp),                \
+				  "Wrong encoding, line %d", __LINE__); \
+	} while (0)
+
+/* Examples from RFC 8949, appendix A */
+static void test_cbor_int(void)
+{
+	assert_cbor(BYTES(0x00), cloud_encoder_int(&enc, NULL, 0));
+	assert_cbor(BYTES(0x17), cloud_encoder_int(&enc, NULL, 23));
+	assert_cbor(BYTES(0x18, 0x18), cloud_encoder_int(&enc, NULL, 24));
+	assert_cbor(BYTES(0x19, 0x03, 0xe8),
+		    cloud_encoder_int(&enc, NULL, 1000));
+	assert_cbor(BYTES(0x1a, 0x00, 0x0f, 0x42, 0x40),
+		    cloud_encoder_int(&enc, NULL, 1000000));
+	assert_cbor(BYTES(0x1b, 0x00, 0x00, 0x00, 0xe8, 0xd4, 0xa5, 0x10, 0x00),
+		    cloud_encoder_int(&enc, NULL, 1000000000000LL));
+	assert_cbor(BYTES(0x20), cloud_encoder_int(&enc, NULL, -1));
+	assert_cbor(BYTES(0x29), cloud_encoder_int(&enc, NULL, -10));
+	assert_cbor(BYTES(0x38, 0x63), cloud_encoder_int(&enc, NULL, -100));
+	assert_cbor(BYTES(0x39, 0x03, 0xe7),
+		    cloud_encoder_int(&enc, NULL, -1000));
+	assert_cbor(BYTES(0x3b, 0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff),
+		    cloud_encoder_int(&enc, NULL, INT64_MIN));
+}
+
+static void test_cbor_double(void)
+{
+	/* Integral values are integers, as in JSON */
+	assert_cbor(BYTES(0x1a, 0x00, 0x01, 0x86, 0xa0),
+		    cloud_encoder_double(&enc, NULL, 100000.0));
+	assert_cbor(BYTES(0x39, 0x03, 0xe7),
+		    cloud_encoder_double(&enc, NULL, -1000.0));
+	assert_cbor(BYTES(0xfa, 0x3f, 0xc0, 0x00, 0x00),
+		    cloud_encoder_double(&enc, NULL, 1.5));
+	assert_cbor(BYTES(0xfb, 0x3f, 0xf1, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9a),
+		    cloud_encoder_double(&enc, NULL, 1.1));
+	assert_cbor(BYTES(0xfb, 0xc0, 0x10, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66),
+		    cloud_encoder_double(&enc, NULL, -4.1));
+	assert_cbor(BYTES(0xf6), cloud_encoder_double(&enc, NULL, NAN));
+	assert_cbor(BYTES(0xf6), cloud_encoder_double(&enc, NULL, INFINITY));
+}
+
+static void test_cbor_simple(void)
+{
+	assert_cbor(BYTES(0xf4), cloud_encoder_bool(&enc, NULL, false));
+	assert_cbor(BYTES(0xf5), cloud_encoder_bool(&enc, NULL, true));
+	assert_cbor(BYTES(0xf6), cloud_encoder_null(&enc, NULL));
+	assert_cbor(BYTES(0x60), cloud_encoder_str(&enc, NULL, ""));
+	assert_cbor(BYTES(0x61, 0x61), cloud_encoder_str(&enc, NULL, "a"));
+	assert_cbor(BYTES(0x64, 0x49, 0x45, 0x54, 0x46),
+		    cloud_encoder_str(&enc, NULL, "IETF"));
+	assert_cbor(BYTES(0x62, 0x22, 0x5c),
+		    cloud_encoder_str(&enc, NULL, "\"\\"));
+	assert_cbor(BYTES(0xf6), cloud_encoder_str(&enc, NULL, NULL));
+}
+
+static int document_encode(struct cloud_encoder *e, void *ctx)
+{
+	encode_calls++;
+
+	/* {"a": 1, "b": [2, 3]} */
+	cloud_encoder_obj_start(e, NULL);
+	cloud_encoder_int(e, "a", 1);
+	cloud_encoder_arr_start(e, "b");
+	cloud_encoder_int(e, NULL, 2);
+	cloud_encoder_int(e, NULL, 3);
+	cloud_encoder_arr_end(e);
+	cloud_encoder_obj_end(e);
+
+	return 0;
+}
+
+static const uint8_t document_cbor[] = {
+	0xbf, 0x61, 0x61, 0x01, 0x61, 0x62, 0x9f, 0x02, 0x03, 0xff, 0xff
+};
+
+static const char document_json[] = "{\"a\":1,\"b\":[2,3]}";
+
+static void test_cbor_document(void)
+{
+	assert_cbor(BYTES(0xbf, 0x61, 0x61, 0x01, 0x61, 0x62, 0x9f, 0x02,
+			  0x03, 0xff, 0xff),
+		    document_encode(&enc, NULL));
+	assert_cbor(BYTES(0x9f, 0xbf, 0xff, 0x9f, 0xff, 0xff),
+		    {
+			    cloud_encoder_arr_start(&enc, NULL);
+			    cloud_encoder_obj_start(&enc, NULL);
+			    cloud_encoder_obj_end(&enc);
+			    cloud_encoder_arr_start(&enc, NULL);
+			    cloud_encoder_arr_end(&enc);
+			    cloud_encoder_arr_end(&enc);
+		    });
+}
+
+static void test_json_document(void)
+{
+	int err;
+
+	err = cloud_encoder_init(&enc, CLOUD_ENCODING_JSON, buf, sizeof(buf));
+	zassert_equal(err, 0, NULL);
+
+	document_encode(&enc, NULL);
+
+	zassert_equal(cloud_encoder_finish(&enc), sizeof(document_json) - 1,
+		      NULL);
+	zassert_mem_equal(buf, document_json, sizeof(document_json), NULL);
+}
+
+static void test_cbor_nesting(void)
+{
+	/* Member without a name */
+	cloud_encoder_init(&enc, CLOUD_ENCODING_CBOR, buf, sizeof(buf));
+	cloud_encoder_obj_start(&enc, NULL);
+	cloud_encoder_int(&enc, NULL, 1);
+	cloud_encoder_obj_end(&enc);
+	zassert_equal(cloud_encoder_finish(&enc), -EINVAL, NULL);
+
+	/* Array element with a name */
+	cloud_encoder_init(&enc, CLOUD_ENCODING_CBOR, buf, sizeof(buf));
+	cloud_encoder_arr_start(&enc, NULL);
+	cloud_encoder_str(&enc, "a", "b");
+	cloud_encoder_arr_end(&enc);
+	zassert_equal(cloud_encoder_finish(&enc), -EINVAL, NULL);
+
+	/* Mismatched end */
+	cloud_encoder_init(&enc, CLOUD_ENCODING_CBOR, buf, sizeof(buf));
+	cloud_encoder_arr_start(&enc, NULL);
+	cloud_encoder_obj_end(&enc);
+	zassert_equal(cloud_encoder_finish(&enc), -EINVAL, NULL);
+
+	/* Unterminated map */
+	cloud_encoder_init(&enc, CLOUD_ENCODING_CBOR, buf, sizeof(buf));
+	cloud_encoder_obj_start(&enc, NULL);
+	zassert_equal(cloud_encoder_finish(&enc), -EINVAL, NULL);
+
+	/* Too deep */
+	cloud_encoder_init(&enc, CLOUD_ENCODING_CBOR, NULL, 0);
+	for (int i = 0; i < JSON_WRITER_MAX_DEPTH; i++) {
+		cloud_encoder_arr_start(&enc, NULL);
+	}
+	zassert_equal(cloud_encoder_finish(&enc), -EINVAL, NULL);
+}
+
+static void test_cbor_overflow(void)
+{
+	/* Every size short of the length fails without writing past the end
+	 * of the buffer.
+	 */
+	for (size_t size = 0; size < sizeof(document_cbor); size++) {
+		memset(buf, GUARD, sizeof(buf));
+
+		cloud_encoder_init(&enc, CLOUD_ENCODING_CBOR, buf, size);
+		document_encode(&enc, NULL);
+		zassert_equal(cloud_encoder_finish(&enc), -ENOMEM,
+			      "Size %d not rejected", size);
+
+		for (size_t i = size; i < sizeof(buf); i++) {
+			zassert_equal(buf[i], GUARD,
+				      "Write past the end at %d", i);
+		}
+	}
+
+	/* CBOR needs no room for a NUL character */
+	cloud_encoder_init(&enc, CLOUD_ENCODING_CBOR, buf,
+			   sizeof(document_cbor));
+	document_encode(&enc, NULL);
+	zassert_equal(cloud_encoder_finish(&enc), sizeof(document_cbor), NULL);
+}
+
+static void test_encode_alloc(void)
+{
+	int err;
+	char *out = NULL;
+	size_t len;
+
+	err = cloud_encoder_encode_alloc(CLOUD_ENCODING_CBOR, document_encode,
+					 NULL, &out, &len);
+	zassert_equal(err, 0, NULL);
+	zassert_equal(encode_calls, 2, NULL);
+	zassert_equal(len, sizeof(document_cbor), NULL);
+	zassert_mem_equal(out, document_cbor, len, NULL);
+	k_free(out);
+
+	encode_calls = 0;
+	err = cloud_encoder_encode_alloc(CLOUD_ENCODING_JSON, document_encode,
+					 NULL, &out, &len);
+	zassert_equal(err, 0, NULL);
+	zassert_equal(encode_calls, 2, NULL);
+	zassert_equal(len, sizeof(document_json) - 1, NULL);
+	zassert_mem_equal(out, document_json, sizeof(document_json), NULL);
+	k_free(out);
+
+	/* Unknown encoding */
+	encode_calls = 0;
+	out = NULL;
+	err = cloud_encoder_encode_alloc(CLOUD_ENCODING_CBOR + 1,
+					 document_encode, NULL, &out, &len);
+	zassert_equal(err, -ENOTSUP, NULL);
+	zassert_equal(encode_calls, 0, NULL);
+	zassert_is_null(out, NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(net_lib_cloud_encoder_test,
+		ztest_unit_test_setup_teardown(test_cbor_int,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_cbor_double,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_cbor_simple,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_cbor_document,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_json_document,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_cbor_nesting,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_cbor_overflow,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_encode_alloc,
+					       setup, teardown),
+		ztest_unit_test(test_benchmark_sample),
+		ztest_unit_test(test_benchmark_device_status)
+	);
+
+	ztest_run_test_suite(net_lib_cloud_encoder_test);
+}
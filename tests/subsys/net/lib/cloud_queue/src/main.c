@@ -0,0 +1,404 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <ztest.h>
+#include <string.h>
+#include <stdio.h>
+#include <storage/flash_map.h>
+#include <net/cloud_queue.h>
+
+#define PUBLISH_MAX 64
+#define BATCH_SIZE CONFIG_CLOUD_QUEUE_BATCH_SIZE
+
+/* Publishes seen by the backend */
+static struct {
+	uint8_t buf[BATCH_SIZE];
+	size_t len;
+	enum cloud_endpoint_type endpoint;
+	enum cloud_qos qos;
+} publish[PUBLISH_MAX];
+static size_t publish_count;
+/* Number of publishes to accept before failing, or -1 */
+static int send_budget;
+
+static int mock_send(const struct cloud_backend *const backend,
+		     const struct cloud_msg *const msg)
+{
+	zassert_true(publish_count < PUBLISH_MAX, "Too many publishes");
+	zassert_true(msg->len <= BATCH_SIZE, "Publish too large");
+
+	if (send_budget == 0) {
+		return -EAGAIN;
+	} else if (send_budget > 0) {
+		send_budget--;
+	}
+
+	memcpy(publish[publish_count].buf, msg->buf, msg->len);
+	publish[publish_count].len = msg->len;
+	publish[publish_count].endpoint = msg->endpoint.type;
+	publish[publish_count].qos = msg->qos;
+	publish_count++;
+
+	return 0;
+}
+
+static const struct cloud_api mock_api = {
+	.send = mock_send,
+};
+
+static struct cloud_backend_config mock_config = {
+	.name = "mock",
+};
+
+static const struct cloud_backend backend = {
+	.api = &mock_api,
+	.config = &mock_config,
+};
+
+static char text[BATCH_SIZE];
+
+static void msg_send(const char *str, enum cloud_endpoint_type endpoint,
+		     enum cloud_qos qos)
+{
+	struct cloud_msg msg = {
+		.buf = (char *)str,
+		.len = strlen(str),
+		.qos = qos,
+		.endpoint.type = endpoint,
+	};
+
+	zassert_equal(cloud_queue_send(&msg), 0, "Could not queue %s", str);
+}
+
+static void sample_send(int n)
+{
+	snprintf(text, sizeof(text), "{\"n\":%d}", n);
+	msg_send(text, CLOUD_EP_MSG, CLOUD_QOS_AT_MOST_ONCE);
+}
+
+static void assert_publish(size_t i, const char *expected)
+{
+	zassert_true(i < publish_count, "Publish %d missing", i);
+	zassert_equal(publish[i].len, strlen(expected), "Publish %d length",
+		      i);
+	zassert_mem_equal(publish[i].buf, expected, publish[i].len,
+			  "Publish %d differs", i);
+}
+
+static uint32_t pending(void)
+{
+	struct cloud_queue_stats stats;
+
+	cloud_queue_stats_get(&stats);
+
+	return stats.pending;
+}
+
+static void setup(void)
+{
+	const struct flash_area *fap;
+
+	zassert_equal(flash_area_open(FLASH_AREA_ID(cloud_queue), &fap), 0, NULL);
+	zassert_equal(flash_area_erase(fap, 0, fap->fa_size), 0, NULL);
+	flash_area_close(fap);
+
+	memset(publish, 0, sizeof(publish));
+	publish_count = 0;
+	send_budget = -1;
+	mock_config.encoding = CLOUD_ENCODING_JSON;
+
+	zassert_equal(cloud_queue_init(&backend), 0, NULL);
+}
+
+static void teardown(void)
+{
+	cloud_queue_link_set(false);
+}
+
+static void test_queue_direct(void)
+{
+	struct cloud_queue_stats stats;
+
+	cloud_queue_link_set(true);
+	sample_send(1);
+
+	assert_publish(0, "{\"n\":1}");
+
+	cloud_queue_stats_get(&stats);
+	zassert_equal(stats.stored, 0, "Message stored while link was up");
+	zassert_equal(stats.pending, 0, NULL);
+}
+
+static void test_queue_batch(void)
+{
+	struct cloud_queue_stats stats;
+
+	for (int i = 0; i < 5; i++) {
+		sample_send(i);
+	}
+
+	zassert_equal(publish_count, 0, "Sent while link was down");
+	zassert_equal(pending(), 5, NULL);
+	zassert_equal(cloud_queue_flush(), -ENOTCONN, NULL);
+
+	cloud_queue_link_set(true);
+	zassert_equal(cloud_queue_flush(), 0, NULL);
+
+	zassert_equal(publish_count, 1, "Messages not combined");
+	assert_publish(0, "[{\"n\":0},{\"n\":1},{\"n\":2},{\"n\":3},"
+			  "{\"n\":4}]");
+	zassert_equal(publish[0].endpoint, CLOUD_EP_MSG, NULL);
+
+	cloud_queue_stats_get(&stats);
+	zassert_equal(stats.pending, 0, NULL);
+	zassert_equal(stats.stored, 5, NULL);
+	zassert_equal(stats.sent, 5, NULL);
+	zassert_equal(stats.publishes, 1, NULL);
+
+	/* Sent messages are not sent again */
+	zassert_equal(cloud_queue_flush(), 0, NULL);
+	zassert_equal(publish_count, 1, NULL);
+}
+
+static void test_queue_batch_split(void)
+{
+	sample_send(0);
+	sample_send(1);
+	msg_send("{\"state\":{}}", CLOUD_EP_STATE, CLOUD_QOS_AT_MOST_ONCE);
+	sample_send(2);
+	msg_send("{\"n\":3}", CLOUD_EP_MSG, CLOUD_QOS_AT_LEAST_ONCE);
+	msg_send("{\"n\":4}", CLOUD_EP_MSG, CLOUD_QOS_AT_LEAST_ONCE);
+
+	cloud_queue_link_set(true);
+	zassert_equal(cloud_queue_flush(), 0, NULL);
+
+	/* Order is kept, state updates are not combined, and a batch has
+	 * a single quality of service.
+	 */
+	zassert_equal(publish_count, 4, NULL);
+	assert_publish(0, "[{\"n\":0},{\"n\":1}]");
+	assert_publish(1, "{\"state\":{}}");
+	zassert_equal(publish[1].endpoint, CLOUD_EP_STATE, NULL);
+	assert_publish(2, "{\"n\":2}");
+	assert_publish(3, "[{\"n\":3},{\"n\":4}]");
+	zassert_equal(publish[3].qos, CLOUD_QOS_AT_LEAST_ONCE, NULL);
+}
+
+static void test_queue_batch_cbor(void)
+{
+	/* {"n": 1} and {"n": 2} */
+	static const char first[] = "\xa1\x61n\x01";
+	static const char second[] = "\xa1\x61n\x02";
+
+	mock_config.encoding = CLOUD_ENCODING_CBOR;
+
+	msg_send(first, CLOUD_EP_MSG, CLOUD_QOS_AT_MOST_ONCE);
+	msg_send(second, CLOUD_EP_MSG, CLOUD_QOS_AT_MOST_ONCE);
+
+	cloud_queue_link_set(true);
+	zassert_equal(cloud_queue_flush(), 0, NULL);
+
+	zassert_equal(publish_count, 1, NULL);
+	assert_publish(0, "\x9f\xa1\x61n\x01\xa1\x61n\x02\xff");
+}
+
+static void test_queue_batch_size(void)
+{
+	const size_t count = 40;
+	size_t received = 0;
+
+	for (int i = 0; i < count; i++) {
+		sample_send(i);
+	}
+
+	cloud_queue_link_set(true);
+	zassert_equal(cloud_queue_flush(), 0, NULL);
+
+	zassert_true(publish_count > 1, NULL);
+	zassert_true(publish_count < count / 4, "Batches not filled");
+
+	for (size_t i = 0; i < publish_count; i++) {
+		zassert_equal(publish[i].buf[0], '[', NULL);
+		zassert_equal(publish[i].buf[publish[i].len - 1], ']', NULL);
+
+		for (size_t j = 0; j < publish[i].len; j++) {
+			if (publish[i].buf[j] == '{') {
+				received++;
+			}
+		}
+	}
+
+	zassert_equal(received, count, NULL);
+}
+
+static void test_queue_send_failure(void)
+{
+	send_budget = 0;
+	cloud_queue_link_set(true);
+
+	/* Stored when sending fails, and the next message waits for it */
+	sample_send(0);
+	sample_send(1);
+
+	zassert_equal(publish_count, 0, NULL);
+	zassert_equal(pending(), 2, NULL);
+
+	send_budget = -1;
+	zassert_equal(cloud_queue_flush(), 0, NULL);
+	assert_publish(0, "[{\"n\":0},{\"n\":1}]");
+}
+
+static void test_queue_partial_flush(void)
+{
+	sample_send(0);
+	msg_send("{\"state\":{}}", CLOUD_EP_STATE, CLOUD_QOS_AT_MOST_ONCE);
+	sample_send(1);
+	sample_send(2);
+
+	send_budget = 1;
+	cloud_queue_link_set(true);
+	zassert_equal(cloud_queue_flush(), -EAGAIN, NULL);
+	zassert_equal(pending(), 3, NULL);
+
+	/* What was sent is remembered across a reset */
+	zassert_equal(cloud_queue_init(&backend), 0, NULL);
+	zassert_equal(pending(), 3, NULL);
+
+	send_budget = -1;
+	cloud_queue_link_set(true);
+	zassert_equal(cloud_queue_flush(), 0, NULL);
+
+	zassert_equal(publish_count, 3, NULL);
+	assert_publish(0, "{\"n\":0}");
+	assert_publish(1, "{\"state\":{}}");
+	assert_publish(2, "[{\"n\":1},{\"n\":2}]");
+}
+
+static void test_queue_reset(void)
+{
+	for (int i = 0; i < 3; i++) {
+		sample_send(i);
+	}
+
+	zassert_equal(cloud_queue_init(&backend), 0, NULL);
+	zassert_equal(pending(), 3, "Messages lost in reset");
+
+	cloud_queue_link_set(true);
+	zassert_equal(cloud_queue_flush(), 0, NULL);
+	assert_publish(0, "[{\"n\":0},{\"n\":1},{\"n\":2}]");
+
+	zassert_equal(cloud_queue_init(&backend), 0, NULL);
+	zassert_equal(pending(), 0, "Sent messages recovered");
+
+	/* New messages continue the sequence */
+	sample_send(3);
+	zassert_equal(cloud_queue_init(&backend), 0, NULL);
+	zassert_equal(pending(), 1, NULL);
+}
+
+static void test_queue_full(void)
+{
+	const struct flash_area *fap;
+	struct cloud_queue_stats stats;
+	size_t count;
+	int last = -1;
+	int n;
+
+	zassert_equal(flash_area_open(FLASH_AREA_ID(cloud_queue), &fap), 0, NULL);
+	count = 2 * fap->fa_size / 16;
+	flash_area_close(fap);
+
+	/* More messages than fit, the oldest are dropped */
+	for (int i = 0; i < count; i++) {
+		sample_send(i);
+	}
+
+	cloud_queue_stats_get(&stats);
+	zassert_true(stats.dropped > 0, NULL);
+	zassert_equal(stats.pending + stats.dropped, count, NULL);
+
+	cloud_queue_link_set(true);
+	while (pending() > 0) {
+		publish_count = 0;
+		zassert_equal(cloud_queue_flush(), 0, NULL);
+	}
+
+	/* The newest message is delivered last */
+	for (size_t i = 0; i < publish[publish_count - 1].len; i++) {
+		if (sscanf((char *)&publish[publish_count - 1].buf[i],
+			   "{\"n\":%d}", &n) == 1) {
+			last = n;
+		}
+	}
+
+	zassert_equal(last, count - 1, NULL);
+}
+
+static void test_queue_reuse(void)
+{
+	struct cloud_queue_stats stats;
+
+	/* Storage is reused once the messages are sent */
+	for (int round = 0; round < 50; round++) {
+		cloud_queue_link_set(false);
+
+		for (int i = 0; i < 10; i++) {
+			sample_send(i);
+		}
+
+		publish_count = 0;
+		cloud_queue_link_set(true);
+		zassert_equal(cloud_queue_flush(), 0, NULL);
+	}
+
+	cloud_queue_stats_get(&stats);
+	zassert_equal(stats.dropped, 0, "Sent messages kept in storage");
+	zassert_equal(stats.sent, 500, NULL);
+}
+
+static void test_queue_invalid(void)
+{
+	struct cloud_msg msg = {
+		.buf = text,
+		.len = BATCH_SIZE,
+		.endpoint.type = CLOUD_EP_MSG,
+	};
+
+	zassert_equal(cloud_queue_send(&msg), -EMSGSIZE, NULL);
+
+	msg.len = 1;
+	msg.endpoint.str = "custom/topic";
+	zassert_equal(cloud_queue_send(&msg), -EINVAL, NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(cloud_queue_test,
+		ztest_unit_test_setup_teardown(test_queue_direct,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_queue_batch,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_queue_batch_split,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_queue_batch_cbor,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_queue_batch_size,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_queue_send_failure,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_queue_partial_flush,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_queue_reset,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_queue_full,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_queue_reuse,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_queue_invalid,
+					       setup, teardown)
+	);
+
+	ztest_run_test_suite(cloud_queue_test);
+}
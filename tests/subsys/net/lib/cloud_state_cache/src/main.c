@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <string.h>
+#include <net/cloud_state_cache.h>
+
+CLOUD_STATE_CACHE_DEFINE(cache, 16);
+
+static char buf[512];
+
+/* Device status as sent by the asset tracker */
+#define STATUS(_voltage, _band)						\
+	"{\"state\":{\"reported\":{\"DEVICE\":null,\"device\":{"	\
+	"\"networkInfo\":{\"currentBand\":" #_band ","			\
+	"\"networkMode\":\"LTE-M\",\"ipAddress\":\"10.0.0.2\"},"	\
+	"\"deviceInfo\":{\"modemFirmware\":\"mfw_nrf9160_1.2.0\","	\
+	"\"batteryVoltage\":" #_voltage ",\"imei\":\"352656100123456\"},"\
+	"\"serviceInfo\":{\"ui\":[\"GPS\",\"FLIP\",\"TEMP\"]}}}}}"
+
+static int delta(const char *json)
+{
+	return cloud_state_cache_delta(&cache, json, strlen(json), buf,
+				       sizeof(buf));
+}
+
+static void setup(void)
+{
+	cloud_state_cache_reset(&cache);
+}
+
+static void teardown(void)
+{
+}
+
+static void test_first_is_full(void)
+{
+	const char *doc = STATUS(4200, 20);
+
+	zassert_equal(delta(doc), strlen(doc), NULL);
+	zassert_equal(strcmp(buf, doc), 0, NULL);
+
+	/* Not acknowledged, so the next one is full too */
+	zassert_equal(delta(doc), strlen(doc), NULL);
+}
+
+static void test_unchanged(void)
+{
+	zassert_true(delta(STATUS(4200, 20)) > 0, NULL);
+	cloud_state_cache_ack(&cache);
+
+	zassert_equal(delta(STATUS(4200, 20)), 0, NULL);
+	zassert_equal(buf[0], '\0', NULL);
+}
+
+static void test_changed_members(void)
+{
+	const char *expect =
+		"{\"state\":{\"reported\":{\"device\":{"
+		"\"deviceInfo\":{\"batteryVoltage\":4100}}}}}";
+
+	zassert_true(delta(STATUS(4200, 20)) > 0, NULL);
+	cloud_state_cache_ack(&cache);
+
+	zassert_equal(delta(STATUS(4100, 20)), strlen(expect), NULL);
+	zassert_equal(strcmp(buf, expect), 0, "%s", buf);
+
+	/* Until acknowledged, changes are relative to the first document */
+	expect = "{\"state\":{\"reported\":{\"device\":{"
+		 "\"networkInfo\":{\"currentBand\":3},"
+		 "\"deviceInfo\":{\"batteryVoltage\":4100}}}}}";
+
+	zassert_equal(delta(STATUS(4100, 3)), strlen(expect), NULL);
+	zassert_equal(strcmp(buf, expect), 0, "%s", buf);
+	cloud_state_cache_ack(&cache);
+
+	zassert_equal(delta(STATUS(4100, 3)), 0, NULL);
+}
+
+static void test_arrays_whole(void)
+{
+	const char *expect = "{\"a\":[1,2,4]}";
+
+	zassert_true(delta("{\"a\":[1,2,3],\"b\":1}") > 0, NULL);
+	cloud_state_cache_ack(&cache);
+
+	zassert_equal(delta("{\"a\":[1,2,4],\"b\":1}"), strlen(expect), NULL);
+	zassert_equal(strcmp(buf, expect), 0, "%s", buf);
+}
+
+static void test_new_and_moved_members(void)
+{
+	const char *expect = "{\"c\":{\"x\":true}}";
+
+	zassert_true(delta("{\"a\":1,\"b\":{\"x\":true}}") > 0, NULL);
+	cloud_state_cache_ack(&cache);
+
+	/* Same name and value, different path */
+	zassert_equal(delta("{\"b\":{\"x\":true},\"c\":{\"x\":true},\"a\":1}"),
+		      strlen(expect), NULL);
+	zassert_equal(strcmp(buf, expect), 0, "%s", buf);
+}
+
+static void test_whitespace(void)
+{
+	const char *doc = " { \"a\" : { \"b\" : [ 1 , 2 ] , \"c\" : null } } ";
+
+	zassert_true(delta(doc) > 0, NULL);
+	zassert_equal(strcmp(buf, "{\"a\":{\"b\":[ 1 , 2 ],\"c\":null}}"), 0,
+		      "%s", buf);
+}
+
+static void test_in_place(void)
+{
+	static char doc[] = STATUS(4200, 20);
+	const char *expect =
+		"{\"state\":{\"reported\":{\"device\":{"
+		"\"networkInfo\":{\"currentBand\":3}}}}}";
+
+	zassert_true(delta(STATUS(4200, 20)) > 0, NULL);
+	cloud_state_cache_ack(&cache);
+
+	strcpy(doc, STATUS(4200, 3));
+	zassert_equal(cloud_state_cache_delta(&cache, doc, strlen(doc), doc,
+					      strlen(doc) + 1),
+		      strlen(expect), NULL);
+	zassert_equal(strcmp(doc, expect), 0, "%s", doc);
+}
+
+static void test_capacity(void)
+{
+	CLOUD_STATE_CACHE_DEFINE(small, 2);
+	const char *doc = "{\"a\":1,\"b\":2,\"c\":3}";
+
+	zassert_equal(cloud_state_cache_delta(&small, doc, strlen(doc), buf,
+					      sizeof(buf)),
+		      strlen(doc), NULL);
+	cloud_state_cache_ack(&small);
+
+	/* Untracked members are always sent */
+	zassert_equal(cloud_state_cache_delta(&small, doc, strlen(doc), buf,
+					      sizeof(buf)),
+		      strlen("{\"c\":3}"), NULL);
+	zassert_equal(strcmp(buf, "{\"c\":3}"), 0, "%s", buf);
+}
+
+static void test_resync(void)
+{
+	const char *doc = STATUS(4200, 20);
+
+	zassert_true(delta(doc) > 0, NULL);
+	cloud_state_cache_ack(&cache);
+	zassert_equal(delta(doc), 0, NULL);
+
+	k_sleep(K_MSEC(CONFIG_CLOUD_STATE_CACHE_RESYNC_INTERVAL *
+		       MSEC_PER_SEC));
+
+	zassert_equal(delta(doc), strlen(doc), NULL);
+	cloud_state_cache_ack(&cache);
+	zassert_equal(delta(doc), 0, NULL);
+}
+
+static void test_errors(void)
+{
+	static const char *const invalid[] = {
+		"",
+		"[1,2]",
+		"{\"a\":1",
+		"{\"a\" 1}",
+		"{\"a\":1,}",
+		"{\"a\":tru}",
+		"{\"a\":\"b}",
+		"{\"a\":[1,2}",
+		"{a:1}",
+		"{\"a\":{\"a\":{\"a\":{\"a\":{\"a\":{\"a\":{\"a\":{\"a\":{"
+		"\"a\":{\"a\":{\"a\":{\"a\":{\"a\":{\"a\":{\"a\":{\"a\":{"
+		"\"a\":1}}}}}}}}}}}}}}}}}",
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(invalid); i++) {
+		zassert_equal(delta(invalid[i]), -EBADMSG, "%s", invalid[i]);
+	}
+
+	zassert_equal(cloud_state_cache_delta(&cache, "{\"a\":1}", 7, buf, 7),
+		      -ENOMEM, NULL);
+
+	/* Nothing is pending after an error */
+	cloud_state_cache_ack(&cache);
+	zassert_false(cache.valid, NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(cloud_state_cache_test,
+		ztest_unit_test_setup_teardown(test_first_is_full, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_unchanged, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_changed_members, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_arrays_whole, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_new_and_moved_members,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_whitespace, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_in_place, setup, teardown),
+		ztest_unit_test(test_capacity),
+		ztest_unit_test_setup_teardown(test_resync, setup, teardown),
+		ztest_unit_test_setup_teardown(test_errors, setup, teardown)
+	);
+
+	ztest_run_test_suite(cloud_state_cache_test);
+}
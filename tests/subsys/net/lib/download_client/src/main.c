@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <string.h>
+#include <zephyr/types.h>
+#include <stdbool.h>
+#include <ztest.h>
+#include <net/coap.h>
+#include <download_client.h>
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(download_client, CONFIG_DOWNLOAD_CLIENT_LOG_LEVEL);
+
+/* Functions under test, from coap.c */
+int coap_block_init(struct download_client *client, size_t from);
+int coap_parse(struct download_client *client, size_t len);
+int coap_request_send(struct download_client *client);
+int coap_recv_timeout_get(const struct download_client *client);
+
+#define IMAGE_SIZE 9001
+#define QUEUE_LEN 16
+#define DGRAM_SIZE 600
+
+static struct download_client client;
+static uint8_t image[IMAGE_SIZE];
+static uint8_t received[IMAGE_SIZE];
+static size_t received_len;
+
+/* CoAP server stand-in. Requests sent by the client are answered
+ * immediately, and the responses are queued until the test "receives"
+ * them, so that loss and reordering can be simulated.
+ */
+static struct {
+	/* Largest block size the server is willing to use */
+	enum coap_block_size max_szx;
+	/* Drop every n-th response, zero to disable */
+	int drop_every;
+	/* Drop the first responses carrying this offset */
+	size_t lose_off;
+	int lose_count;
+	/* Deliver queued responses newest first */
+	bool reorder;
+
+	int requests;
+	int responses;
+	enum coap_block_size min_szx;
+	int max_queued;
+	struct {
+		uint8_t buf[DGRAM_SIZE];
+		size_t len;
+	} queue[QUEUE_LEN];
+	size_t queued;
+} server;
+
+int url_parse_file(const char *url, char *file, size_t len)
+{
+	strncpy(file, url, len);
+	return 0;
+}
+
+int socket_send(const struct download_client *dl, size_t len)
+{
+	int err;
+	int opt;
+	size_t off;
+	size_t bytes;
+	uint32_t num;
+	uint8_t tkl;
+	enum coap_block_size szx;
+	uint8_t token[COAP_TOKEN_MAX_LEN];
+	struct coap_packet request;
+	struct coap_packet response;
+
+	server.requests++;
+
+	err = coap_packet_parse(&request, (uint8_t *)dl->buf, len, NULL, 0);
+	zassert_equal(err, 0, "Client sent a malformed request");
+
+	opt = coap_get_option_int(&request, COAP_OPTION_BLOCK2);
+	zassert_true(opt >= 0, "Request without block2 option");
+
+	szx = opt & 0x07;
+	num = opt >> 4;
+	server.min_szx = MIN(server.min_szx, szx);
+	off = num * coap_block_size_to_bytes(szx);
+	zassert_true(off < IMAGE_SIZE, "Request past the end of the file");
+
+	/* Block size negotiation, RFC 7959 section 2.4 */
+	if (szx > server.max_szx) {
+		num = off / coap_block_size_to_bytes(server.max_szx);
+		szx = server.max_szx;
+	}
+	bytes = coap_block_size_to_bytes(szx);
+	off = num * bytes;
+
+	if (server.drop_every && (++server.responses % server.drop_every) == 0) {
+		return 0;
+	}
+
+	if (server.lose_count && off == server.lose_off) {
+		server.lose_count--;
+		return 0;
+	}
+
+	zassert_true(server.queued < QUEUE_LEN, "Too many outstanding requests");
+
+	tkl = coap_header_get_token(&request, token);
+
+	err = coap_packet_init(&response, server.queue[server.queued].buf,
+			       DGRAM_SIZE, 1, COAP_TYPE_ACK, tkl, token,
+			       COAP_RESPONSE_CODE_CONTENT,
+			       coap_header_get_id(&request));
+	zassert_equal(err, 0, NULL);
+
+	err = coap_append_option_int(&response, COAP_OPTION_BLOCK2,
+				     (num << 4) |
+				     ((off + bytes < IMAGE_SIZE) << 3) | szx);
+	zassert_equal(err, 0, NULL);
+
+	err = coap_append_option_int(&response, COAP_OPTION_SIZE2, IMAGE_SIZE);
+	zassert_equal(err, 0, NULL);
+
+	err = coap_packet_append_payload_marker(&response);
+	zassert_equal(err, 0, NULL);
+
+	err = coap_packet_append_payload(&response, image + off,
+					 MIN(bytes, IMAGE_SIZE - off));
+	zassert_equal(err, 0, NULL);
+
+	server.queue[server.queued++].len = response.offset;
+	server.max_queued = MAX(server.max_queued, server.queued);
+
+	return 0;
+}
+
+static size_t server_dequeue(uint8_t *buf)
+{
+	size_t i;
+	size_t len;
+
+	i = server.reorder ? server.queued - 1 : 0;
+	len = server.queue[i].len;
+	memcpy(buf, server.queue[i].buf, len);
+
+	memmove(&server.queue[i], &server.queue[i + 1],
+		(server.queued - i - 1) * sizeof(server.queue[0]));
+	server.queued--;
+
+	return len;
+}
+
+/* Mimics the receive loop of the download thread */
+static void download(size_t from)
+{
+	int err;
+	size_t len;
+
+	received_len = from;
+
+	client.file = "fw.bin";
+	client.file_size = 0;
+	client.progress = from;
+	client.offset = 0;
+
+	coap_block_init(&client, from);
+
+	err = coap_request_send(&client);
+	zassert_equal(err, 0, NULL);
+
+	while (client.progress != client.file_size) {
+		if (!server.queued) {
+			/* Socket timeout */
+			k_sleep(K_MSEC(coap_recv_timeout_get(&client)));
+		} else {
+			len = server_dequeue(client.buf);
+
+			err = coap_parse(&client, len);
+			zassert_true(err >= 0, "Failed to parse response");
+
+			if (err == 0) {
+				zassert_true(received_len + client.offset <=
+					     IMAGE_SIZE, "Too much data");
+				memcpy(received + received_len, client.buf,
+				       client.offset);
+				received_len += client.offset;
+			}
+		}
+
+		client.offset = 0;
+
+		err = coap_request_send(&client);
+		zassert_equal(err, 0, NULL);
+	}
+
+	zassert_equal(client.file_size, IMAGE_SIZE, NULL);
+	zassert_equal(received_len, IMAGE_SIZE, NULL);
+	zassert_mem_equal(received, image, IMAGE_SIZE, "Image mismatch");
+}
+
+static void setup(void)
+{
+	for (size_t i = 0; i < IMAGE_SIZE; i++) {
+		image[i] = (uint8_t)(i * 31 + (i >> 8));
+	}
+
+	memset(received, 0, sizeof(received));
+	memset(&server, 0, sizeof(server));
+	server.max_szx = COAP_BLOCK_1024;
+	server.min_szx = COAP_BLOCK_1024;
+}
+
+static void teardown(void)
+{
+}
+
+static void test_download_windowed(void)
+{
+	const size_t blocks = DIV_ROUND_UP(IMAGE_SIZE, 512);
+
+	download(0);
+
+	zassert_equal(server.requests, blocks, "Unexpected retransmissions");
+	zassert_equal(server.max_queued, DOWNLOAD_CLIENT_COAP_WINDOW,
+		      "Window not filled");
+}
+
+static void test_download_reordered(void)
+{
+	server.reorder = true;
+
+	download(0);
+
+	zassert_equal(server.requests, DIV_ROUND_UP(IMAGE_SIZE, 512),
+		      "Unexpected retransmissions");
+}
+
+static void test_download_resume(void)
+{
+	/* Resume in the middle of a block */
+	memcpy(received, image, 1000);
+
+	download(1000);
+}
+
+static void test_download_server_block_size(void)
+{
+	server.max_szx = COAP_BLOCK_128;
+
+	download(0);
+
+	zassert_equal(client.coap.block_ctx.block_size, COAP_BLOCK_128,
+		      "Block size not negotiated");
+}
+
+static void test_download_lossy(void)
+{
+	server.drop_every = 5;
+
+	download(0);
+
+	zassert_true(server.requests > DIV_ROUND_UP(IMAGE_SIZE, 512),
+		     "Lost blocks were not requested again");
+}
+
+static void test_download_block_size_adapt(void)
+{
+	/* The next expected block times out twice */
+	server.lose_off = 4096;
+	server.lose_count = 2;
+
+	download(0);
+
+	zassert_equal(server.min_szx, COAP_BLOCK_256,
+		      "Block size did not adapt to losses");
+}
+
+static void test_rtt_estimation(void)
+{
+	download(0);
+
+	/* Responses are immediate, the timeout must converge to the floor */
+	zassert_equal(client.coap.rto, CONFIG_DOWNLOAD_CLIENT_COAP_RTO_MIN_MS,
+		      NULL);
+	zassert_true(coap_recv_timeout_get(&client) <=
+		     CONFIG_DOWNLOAD_CLIENT_COAP_RTO_MAX_MS, NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(download_client_coap,
+		ztest_unit_test_setup_teardown(test_download_windowed,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_download_reordered,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_download_resume,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_download_server_block_size,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_download_lossy,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_download_block_size_adapt,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_rtt_estimation,
+					       setup, teardown)
+	);
+
+	ztest_run_test_suite(download_client_coap);
+}
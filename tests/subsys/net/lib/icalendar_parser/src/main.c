@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <string.h>
+#include <net/icalendar_parser.h>
+
+#define MAX_EVTS	8
+
+static const char calendar[] =
+	"BEGIN:VCALENDAR\r\n"
+	"VERSION:2.0\r\n"
+	"PRODID:-//hacksw/handcal//NONSGML v1.0//EN\r\n"
+	"BEGIN:VTIMEZONE\r\n"
+	"TZID:Europe/Oslo\r\n"
+	"BEGIN:STANDARD\r\n"
+	"DTSTART:19701025T030000\r\n"
+	"END:STANDARD\r\n"
+	"END:VTIMEZONE\r\n"
+	"BEGIN:VEVENT\r\n"
+	"UID:19970610T172345Z-AF23B2@example.com\r\n"
+	"DTSTART;TZID=\"Europe/Oslo\":19970714T170000\r\n"
+	"DTEND:19970715T040000Z\r\n"
+	"SUMMARY:Bastille Day Party\r\n"
+	"LOCATION:Paris\r\n"
+	"DESCRIPTION:A long description that is folded over\r\n"
+	"  more than one line\r\n"
+	"BEGIN:VALARM\r\n"
+	"DESCRIPTION:Not the event description\r\n"
+	"END:VALARM\r\n"
+	"END:VEVENT\r\n"
+	"BEGIN:VTODO\r\n"
+	"SUMMARY:Not parsed\r\n"
+	"END:VTODO\r\n"
+	"BEGIN:VEVENT\r\n"
+	"SUMMARY;LANGUAGE=en:Parameter not supported\r\n"
+	"LOCATION:Skipped after an error\r\n"
+	"END:VEVENT\r\n"
+	"END:VCALENDAR\r\n";
+
+static struct icalendar_parser ical;
+static struct ical_parser_evt evts[MAX_EVTS];
+static int evt_count;
+static int stop_at;
+
+static int ical_callback(const struct ical_parser_evt *evt)
+{
+	zassert_true(evt_count < MAX_EVTS, "Too many events");
+	evts[evt_count++] = *evt;
+
+	return (evt_count == stop_at) ? 1 : 0;
+}
+
+static void parser_reset(void)
+{
+	memset(evts, 0, sizeof(evts));
+	evt_count = 0;
+	stop_at = 0;
+	zassert_equal(ical_parser_init(&ical, ical_callback), 0, NULL);
+}
+
+/* Parses the calendar in chunks of the given size */
+static void parse_chunked(size_t chunk)
+{
+	size_t len = sizeof(calendar) - 1;
+	size_t ret;
+
+	parser_reset();
+	for (size_t offset = 0; offset < len; offset += chunk) {
+		ret = ical_parser_parse(&ical, calendar + offset,
+					MIN(chunk, len - offset));
+		zassert_equal(ret, MIN(chunk, len - offset), NULL);
+	}
+}
+
+static void check_evts(void)
+{
+	zassert_equal(evt_count, 4, "%d events", evt_count);
+
+	zassert_equal(evts[0].id, ICAL_EVT_VTIMEZONE, NULL);
+	zassert_equal(evts[0].error, ICAL_ERROR_COM_NOT_SUPPORTED, NULL);
+
+	zassert_equal(evts[1].id, ICAL_EVT_VEVENT, NULL);
+	zassert_equal(evts[1].error, ICAL_ERROR_NONE, NULL);
+	zassert_true(!strcmp(evts[1].ical_com.summary, "Bastille Day Party"),
+		     NULL);
+	zassert_true(!strcmp(evts[1].ical_com.location, "Paris"), NULL);
+	zassert_true(!strcmp(evts[1].ical_com.description,
+			     "A long description that is folded over"
+			     " more than one line"), NULL);
+	zassert_true(!strcmp(evts[1].ical_com.dtstart, "19970714T170000"),
+		     NULL);
+	zassert_true(!strcmp(evts[1].ical_com.dtend, "19970715T040000Z"),
+		     NULL);
+
+	zassert_equal(evts[2].id, ICAL_EVT_VTODO, NULL);
+	zassert_equal(evts[2].error, ICAL_ERROR_COM_NOT_SUPPORTED, NULL);
+
+	zassert_equal(evts[3].id, ICAL_EVT_VEVENT, NULL);
+	zassert_equal(evts[3].error, ICAL_ERROR_SUMMARY, NULL);
+	zassert_equal(evts[3].ical_com.summary[0], '\0', NULL);
+	zassert_equal(evts[3].ical_com.location[0], '\0', NULL);
+}
+
+static void test_whole(void)
+{
+	parse_chunked(sizeof(calendar));
+	check_evts();
+}
+
+/* Any split of the data gives the same events */
+static void test_chunks(void)
+{
+	for (size_t chunk = 1; chunk < 64; chunk++) {
+		parse_chunked(chunk);
+		check_evts();
+	}
+}
+
+/* A component is reported as soon as its END line is parsed */
+static void test_event_on_end(void)
+{
+	const char *end = strstr(calendar, "END:VTIMEZONE\r\n") +
+			  strlen("END:VTIMEZONE\r\n");
+
+	parser_reset();
+	(void)ical_parser_parse(&ical, calendar, end - calendar);
+	zassert_equal(evt_count, 1, NULL);
+	zassert_equal(evts[0].id, ICAL_EVT_VTIMEZONE, NULL);
+}
+
+/* Parsing stops after the component the callback returns non-zero for,
+ * and goes on with the rest of the data
+ */
+static void test_stop(void)
+{
+	size_t len = sizeof(calendar) - 1;
+	const char *end = strstr(calendar, "END:VTIMEZONE\r\n") +
+			  strlen("END:VTIMEZONE\r\n");
+	size_t ret;
+
+	parser_reset();
+	stop_at = 1;
+	ret = ical_parser_parse(&ical, calendar, len);
+	zassert_equal(ret, end - calendar, NULL);
+	zassert_equal(evt_count, 1, NULL);
+
+	ret = ical_parser_parse(&ical, calendar + ret, len - ret);
+	zassert_equal(ret, len - (end - calendar), NULL);
+	check_evts();
+}
+
+static void test_overflow(void)
+{
+	char summary[CONFIG_ICAL_PARSER_SUMMARY_SIZE + 2];
+	static const char begin[] =
+		"BEGIN:VCALENDAR\r\nBEGIN:VEVENT\r\nSUMMARY:";
+	static const char end[] = "\r\nEND:VEVENT\r\nEND:VCALENDAR\r\n";
+
+	memset(summary, 'a', sizeof(summary));
+
+	/* Fits */
+	parser_reset();
+	(void)ical_parser_parse(&ical, begin, sizeof(begin) - 1);
+	(void)ical_parser_parse(&ical, summary, sizeof(summary) - 2);
+	(void)ical_parser_parse(&ical, end, sizeof(end) - 1);
+	zassert_equal(evt_count, 1, NULL);
+	zassert_equal(evts[0].error, ICAL_ERROR_NONE, NULL);
+	zassert_equal(strlen(evts[0].ical_com.summary),
+		      CONFIG_ICAL_PARSER_SUMMARY_SIZE, NULL);
+
+	/* One character too long */
+	parser_reset();
+	(void)ical_parser_parse(&ical, begin, sizeof(begin) - 1);
+	(void)ical_parser_parse(&ical, summary, sizeof(summary) - 1);
+	(void)ical_parser_parse(&ical, end, sizeof(end) - 1);
+	zassert_equal(evt_count, 1, NULL);
+	zassert_equal(evts[0].error, ICAL_ERROR_SUMMARY, NULL);
+	zassert_equal(evts[0].ical_com.summary[0], '\0', NULL);
+}
+
+/* Data before the calendar object is ignored */
+static void test_no_calendar(void)
+{
+	static const char data[] =
+		"HTTP/1.1 200 OK\r\n\r\n"
+		"BEGIN:VEVENT\r\nSUMMARY:Outside\r\nEND:VEVENT\r\n";
+
+	parser_reset();
+	zassert_equal(ical_parser_parse(&ical, data, sizeof(data) - 1),
+		      sizeof(data) - 1, NULL);
+	zassert_equal(evt_count, 0, NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(icalendar_parser_test,
+		ztest_unit_test(test_whole),
+		ztest_unit_test(test_chunks),
+		ztest_unit_test(test_event_on_end),
+		ztest_unit_test(test_stop),
+		ztest_unit_test(test_overflow),
+		ztest_unit_test(test_no_calendar)
+	);
+
+	ztest_run_test_suite(icalendar_parser_test);
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/* Compares routing received topics by comparing them with every topic of a
+ * backend in turn, as the backends used to, with the topic trie.
+ */
+
+#include <ztest.h>
+#include <string.h>
+#include <net/mqtt_topic_trie.h>
+
+#define ITERATIONS 1000
+
+struct bench {
+	const char *name;
+	/* Topics, or topic prefixes, as compared by the linear scan */
+	const char *const *topics;
+	/* The same topics as filters, for the trie */
+	const char *const *filters;
+	size_t count;
+	/* Received topics, matching the topics in order */
+	const char *const *received;
+};
+
+/* Returns the index of the first topic that is a prefix of the received
+ * topic.
+ */
+static int linear_match(const struct bench *bench, const char *topic,
+			size_t len)
+{
+	for (size_t i = 0; i < bench->count; i++) {
+		size_t n = strlen(bench->topics[i]);
+
+		if (len >= n && strncmp(bench->topics[i], topic, n) == 0) {
+			return i;
+		}
+	}
+
+	return -ENOENT;
+}
+
+static void bench_run(const struct bench *bench)
+{
+	MQTT_TOPIC_TRIE_DEFINE(trie, 32);
+	uint32_t linear_cycles;
+	uint32_t trie_cycles;
+	uint32_t start;
+	size_t len[16];
+	int sum;
+
+	zassert_true(bench->count <= ARRAY_SIZE(len), NULL);
+
+	mqtt_topic_trie_clear(&trie);
+
+	for (size_t i = 0; i < bench->count; i++) {
+		zassert_equal(mqtt_topic_trie_add(&trie, bench->filters[i],
+						  strlen(bench->filters[i]),
+						  i), 0, "Filter not added");
+	}
+
+	for (size_t i = 0; i < bench->count; i++) {
+		len[i] = strlen(bench->received[i]);
+
+		zassert_equal(linear_match(bench, bench->received[i], len[i]),
+			      (int)i, "Linear scan did not match");
+		zassert_equal(mqtt_topic_trie_match(&trie, bench->received[i],
+						    len[i]),
+			      (int)i, "Trie did not match");
+	}
+
+	sum = 0;
+	start = k_cycle_get_32();
+	for (int i = 0; i < ITERATIONS; i++) {
+		for (size_t j = 0; j < bench->count; j++) {
+			sum += linear_match(bench, bench->received[j], len[j]);
+		}
+	}
+	linear_cycles = (k_cycle_get_32() - start) / ITERATIONS;
+
+	start = k_cycle_get_32();
+	for (int i = 0; i < ITERATIONS; i++) {
+		for (size_t j = 0; j < bench->count; j++) {
+			sum -= mqtt_topic_trie_match(&trie, bench->received[j],
+						     len[j]);
+		}
+	}
+	trie_cycles = (k_cycle_get_32() - start) / ITERATIONS;
+
+	zassert_equal(sum, 0, NULL);
+
+	TC_PRINT("%s, %d topics, %d trie nodes\n", bench->name,
+		 (int)bench->count, trie.count);
+	TC_PRINT("  linear: %7u cycles\n", linear_cycles);
+	TC_PRINT("  trie:   %7u cycles\n", trie_cycles);
+}
+
+#define NRF_CLOUD_PREFIX "prod/a0b1c2d3-e4f5-a6b7-c8d9-e0f1a2b3c4d5/m"
+
+/* Control channel topics of nRF Cloud */
+void test_benchmark_nrf_cloud(void)
+{
+	static const char *const topics[] = {
+		"nrf-352656100123456/shadow/get/accepted",
+		"nrf-352656100123456/shadow/get/rejected",
+		"$aws/things/nrf-352656100123456/shadow/update/delta",
+		"nrf-352656100123456/shadow/update/accepted",
+		"nrf-352656100123456/shadow/update/rejected",
+		NRF_CLOUD_PREFIX "/d/nrf-352656100123456/c2d",
+	};
+	static const struct bench bench = {
+		.name = "nRF Cloud",
+		.topics = topics,
+		.filters = topics,
+		.count = ARRAY_SIZE(topics),
+		.received = topics,
+	};
+
+	bench_run(&bench);
+}
+
+#define SHADOW "$aws/things/asset-tracker-0123456789/shadow"
+
+/* Shadow topics of AWS IoT */
+void test_benchmark_aws_iot(void)
+{
+	static const char *const topics[] = {
+		SHADOW "/get/accepted",
+		SHADOW "/get/rejected",
+		SHADOW "/update/accepted",
+		SHADOW "/update/rejected",
+		SHADOW "/update/delta",
+		SHADOW "/delete/accepted",
+		SHADOW "/delete/rejected",
+		"$aws/things/asset-tracker-0123456789/jobs/notify-next",
+	};
+	static const struct bench bench = {
+		.name = "AWS IoT",
+		.topics = topics,
+		.filters = topics,
+		.count = ARRAY_SIZE(topics),
+		.received = topics,
+	};
+
+	bench_run(&bench);
+}
+
+/* Topics of Azure IoT Hub, which carry properties after the prefix */
+void test_benchmark_azure_iot_hub(void)
+{
+	static const char *const topics[] = {
+		"devices/",
+		"$iothub/twin/PATCH/properties/desired/",
+		"$iothub/twin/res/",
+		"$dps/registrations/res/",
+		"$iothub/methods/POST/",
+	};
+	static const char *const filters[] = {
+		"devices/+/messages/devicebound/#",
+		"$iothub/twin/PATCH/properties/desired/#",
+		"$iothub/twin/res/#",
+		"$dps/registrations/res/#",
+		"$iothub/methods/POST/#",
+	};
+	static const char *const received[] = {
+		"devices/my-device/messages/devicebound/%24.to=%2Fdevices"
+		"%2Fmy-device%2Fmessages%2FdeviceBound&prop=value",
+		"$iothub/twin/PATCH/properties/desired/?$version=12",
+		"$iothub/twin/res/200/?$rid=1&$version=12",
+		"$dps/registrations/res/202/?$rid=dps_request_id"
+		"&retry-after=3",
+		"$iothub/methods/POST/reboot/?$rid=1",
+	};
+	static const struct bench bench = {
+		.name = "Azure IoT Hub",
+		.topics = topics,
+		.filters = filters,
+		.count = ARRAY_SIZE(topics),
+		.received = received,
+	};
+
+	bench_run(&bench);
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <string.h>
+#include <net/mqtt_topic_trie.h>
+
+extern void test_benchmark_nrf_cloud(void);
+extern void test_benchmark_aws_iot(void);
+extern void test_benchmark_azure_iot_hub(void);
+
+MQTT_TOPIC_TRIE_DEFINE(trie, 32);
+
+static int add(const char *filter, int value)
+{
+	return mqtt_topic_trie_add(&trie, filter, strlen(filter), value);
+}
+
+static int match(const char *topic)
+{
+	return mqtt_topic_trie_match(&trie, topic, strlen(topic));
+}
+
+static void setup(void)
+{
+	mqtt_topic_trie_clear(&trie);
+}
+
+static void teardown(void)
+{
+}
+
+static void test_exact(void)
+{
+	zassert_equal(add("a/b/c", 1), 0, NULL);
+	zassert_equal(add("a/b", 2), 0, NULL);
+	zassert_equal(add("a/bc", 3), 0, NULL);
+	zassert_equal(add("/a", 4), 0, NULL);
+
+	zassert_equal(match("a/b/c"), 1, NULL);
+	zassert_equal(match("a/b"), 2, NULL);
+	zassert_equal(match("a/bc"), 3, NULL);
+	zassert_equal(match("/a"), 4, NULL);
+
+	/* Prefixes and longer topics do not match */
+	zassert_equal(match("a"), -ENOENT, NULL);
+	zassert_equal(match("a/"), -ENOENT, NULL);
+	zassert_equal(match("a/b/c/d"), -ENOENT, NULL);
+	zassert_equal(match("a/b/"), -ENOENT, NULL);
+	zassert_equal(match("a/bcd"), -ENOENT, NULL);
+	zassert_equal(match("a"), -ENOENT, NULL);
+	zassert_equal(match(""), -ENOENT, NULL);
+}
+
+static void test_single_level(void)
+{
+	zassert_equal(add("a/+/c", 1), 0, NULL);
+	zassert_equal(add("+", 2), 0, NULL);
+	zassert_equal(add("a/+", 3), 0, NULL);
+
+	zassert_equal(match("a/b/c"), 1, NULL);
+	zassert_equal(match("a//c"), 1, NULL);
+	zassert_equal(match("x"), 2, NULL);
+	zassert_equal(match("a/x"), 3, NULL);
+	zassert_equal(match("a/"), 3, NULL);
+
+	zassert_equal(match("a/b/d"), -ENOENT, NULL);
+	zassert_equal(match("a/b/c/d"), -ENOENT, NULL);
+	zassert_equal(match("x/y"), -ENOENT, NULL);
+}
+
+static void test_multi_level(void)
+{
+	zassert_equal(add("a/b/#", 1), 0, NULL);
+	zassert_equal(add("#", 2), 0, NULL);
+
+	zassert_equal(match("a/b/c"), 1, NULL);
+	zassert_equal(match("a/b/c/d/e"), 1, NULL);
+	zassert_equal(match("a/b/"), 1, NULL);
+	/* The parent level is matched too */
+	zassert_equal(match("a/b"), 1, NULL);
+
+	zassert_equal(match("a"), 2, NULL);
+	zassert_equal(match("a/c"), 2, NULL);
+	zassert_equal(match("/"), 2, NULL);
+}
+
+static void test_most_specific(void)
+{
+	zassert_equal(add("a/#", 1), 0, NULL);
+	zassert_equal(add("a/+/c", 2), 0, NULL);
+	zassert_equal(add("a/b/c", 3), 0, NULL);
+	zassert_equal(add("a/+/+", 4), 0, NULL);
+
+	zassert_equal(match("a/b/c"), 3, NULL);
+	zassert_equal(match("a/x/c"), 2, NULL);
+	zassert_equal(match("a/x/y"), 4, NULL);
+	zassert_equal(match("a/x/y/z"), 1, NULL);
+
+	/* A literal level that leads nowhere falls back to the wildcards */
+	zassert_equal(match("a/b/y"), 4, NULL);
+	zassert_equal(match("a/b/c/d"), 1, NULL);
+}
+
+static void test_system_topics(void)
+{
+	zassert_equal(add("#", 1), 0, NULL);
+	zassert_equal(add("+/things", 2), 0, NULL);
+	zassert_equal(add("$aws/things/+/shadow/get/accepted", 3), 0, NULL);
+
+	zassert_equal(match("$aws/things"), -ENOENT, NULL);
+	zassert_equal(match("$aws/things/dev/shadow/get/accepted"), 3, NULL);
+	zassert_equal(match("$aws/things/dev/shadow/get/rejected"), -ENOENT,
+		      NULL);
+
+	zassert_equal(match("aws/things"), 2, NULL);
+	zassert_equal(match("aws/other"), 1, NULL);
+}
+
+static void test_invalid_filter(void)
+{
+	zassert_equal(add("", 1), -EINVAL, NULL);
+	zassert_equal(add("a/#/b", 1), -EINVAL, NULL);
+	zassert_equal(add("a/b#", 1), -EINVAL, NULL);
+	zassert_equal(add("a/+b", 1), -EINVAL, NULL);
+	zassert_equal(add("a/b", -1), -EINVAL, NULL);
+	zassert_equal(add("a/b", INT16_MAX + 1), -EINVAL, NULL);
+
+	/* Nothing was added */
+	zassert_equal(trie.count, 1, NULL);
+
+	zassert_equal(add("a/b", 1), 0, NULL);
+	zassert_equal(add("a/b", 2), -EEXIST, NULL);
+	zassert_equal(match("a/b"), 1, NULL);
+}
+
+static void test_not_terminated(void)
+{
+	static const char topics[] = "a/b/c/d";
+
+	zassert_equal(add("a/b", 1), 0, NULL);
+	zassert_equal(add("a/b/c", 2), 0, NULL);
+
+	zassert_equal(mqtt_topic_trie_match(&trie, topics, 3), 1, NULL);
+	zassert_equal(mqtt_topic_trie_match(&trie, topics, 5), 2, NULL);
+	zassert_equal(mqtt_topic_trie_match(&trie, topics, 4), -ENOENT,
+		      NULL);
+}
+
+static void test_no_memory(void)
+{
+	MQTT_TOPIC_TRIE_DEFINE(small, 4);
+
+	zassert_equal(mqtt_topic_trie_add(&small, "a/b/c", 5, 1), 0, NULL);
+	/* Needs two nodes, one is left */
+	zassert_equal(mqtt_topic_trie_add(&small, "a/x/y", 5, 2), -ENOMEM,
+		      NULL);
+	zassert_equal(small.count, 4, NULL);
+
+	/* Shared levels need no new nodes */
+	zassert_equal(mqtt_topic_trie_add(&small, "a/b", 3, 3), 0, NULL);
+	zassert_equal(mqtt_topic_trie_match(&small, "a/b", 3), 3, NULL);
+	zassert_equal(mqtt_topic_trie_match(&small, "a/b/c", 5), 1, NULL);
+	zassert_equal(mqtt_topic_trie_match(&small, "a/x/y", 5), -ENOENT,
+		      NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(net_lib_mqtt_topic_trie_test,
+		ztest_unit_test_setup_teardown(test_exact, setup, teardown),
+		ztest_unit_test_setup_teardown(test_single_level, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_multi_level, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_most_specific, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_system_topics, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_invalid_filter, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_not_terminated, setup,
+					       teardown),
+		ztest_unit_test(test_no_memory),
+		ztest_unit_test(test_benchmark_nrf_cloud),
+		ztest_unit_test(test_benchmark_aws_iot),
+		ztest_unit_test(test_benchmark_azure_iot_hub)
+	);
+
+	ztest_run_test_suite(net_lib_mqtt_topic_trie_test);
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <string.h>
+#include <net/nrf_cloud.h>
+
+#include "nrf_cloud_codec.h"
+#include "nrf_cloud_fsm.h"
+#include "nrf_cloud_transport.h"
+
+/* Three of them do not fit in CONFIG_NRF_CLOUD_BATCH_SIZE */
+#define MSG_1 "{\"appId\":\"TEMP\",\"1\"}"
+#define MSG_2 "{\"appId\":\"TEMP\",\"2\"}"
+#define MSG_3 "{\"appId\":\"TEMP\",\"3\"}"
+
+static enum nfsm_state state;
+
+/* Messages given to the stubbed nct_dc_send() */
+static char sent[CONFIG_NRF_CLOUD_BATCH_SIZE + 1];
+static size_t send_count;
+static int send_err;
+
+enum nfsm_state nfsm_get_current_state(void)
+{
+	return state;
+}
+
+/* Copies the data, the encoding is tested with the codec */
+int nrf_cloud_encode_sensor_data_buf(const struct nrf_cloud_sensor_data *sensor,
+				     void *buf, size_t size)
+{
+	if (sensor->data.len >= size) {
+		return -ENOMEM;
+	}
+
+	memcpy(buf, sensor->data.ptr, sensor->data.len);
+
+	return sensor->data.len;
+}
+
+int nct_dc_send(const struct nct_dc_data *dc)
+{
+	send_count++;
+
+	if (send_err) {
+		return send_err;
+	}
+
+	zassert_true(dc->data.len < sizeof(sent), "Batch too long");
+
+	memcpy(sent, dc->data.ptr, dc->data.len);
+	sent[dc->data.len] = '\0';
+
+	return 0;
+}
+
+int nct_dc_stream(const struct nct_dc_data *dc)
+{
+	zassert_unreachable("Batches are sent reliably");
+
+	return -EINVAL;
+}
+
+static int batch(const char *msg)
+{
+	struct nrf_cloud_sensor_data sensor = {
+		.type = NRF_CLOUD_SENSOR_TEMP,
+		.data.ptr = msg,
+		.data.len = strlen(msg),
+	};
+
+	return nrf_cloud_sensor_data_batch(&sensor);
+}
+
+static void setup(void)
+{
+	state = STATE_DC_CONNECTED;
+	send_err = 0;
+
+	/* Empty the batch of the previous test */
+	zassert_equal(nrf_cloud_sensor_data_batch_flush(), 0, "Flush failed");
+
+	memset(sent, 0, sizeof(sent));
+	send_count = 0;
+}
+
+static void teardown(void)
+{
+}
+
+static void test_flush(void)
+{
+	zassert_equal(batch(MSG_1), 0, "Batch failed");
+	zassert_equal(batch(MSG_2), 0, "Batch failed");
+	zassert_equal(send_count, 0, "Sent before flush");
+
+	zassert_equal(nrf_cloud_sensor_data_batch_flush(), 0, "Flush failed");
+	zassert_equal(send_count, 1, "Not sent once");
+	zassert_equal(strcmp(sent, "[" MSG_1 "," MSG_2 "]"), 0,
+		      "Wrong batch: %s", sent);
+
+	/* Nothing left */
+	zassert_equal(nrf_cloud_sensor_data_batch_flush(), 0, "Flush failed");
+	zassert_equal(send_count, 1, "Empty batch sent");
+}
+
+static void test_flush_on_size(void)
+{
+	zassert_equal(batch(MSG_1), 0, "Batch failed");
+	zassert_equal(batch(MSG_2), 0, "Batch failed");
+	zassert_equal(send_count, 0, "Sent before full");
+
+	zassert_equal(batch(MSG_3), 0, "Batch failed");
+	zassert_equal(send_count, 1, "Not sent when full");
+	zassert_equal(strcmp(sent, "[" MSG_1 "," MSG_2 "]"), 0,
+		      "Wrong batch: %s", sent);
+
+	/* The message that did not fit starts the next batch */
+	zassert_equal(nrf_cloud_sensor_data_batch_flush(), 0, "Flush failed");
+	zassert_equal(send_count, 2, "Not sent");
+	zassert_equal(strcmp(sent, "[" MSG_3 "]"), 0, "Wrong batch: %s",
+		      sent);
+}
+
+static void test_flush_on_timeout(void)
+{
+	zassert_equal(batch(MSG_1), 0, "Batch failed");
+
+	k_sleep(K_MSEC(CONFIG_NRF_CLOUD_BATCH_LATENCY / 2));
+	zassert_equal(send_count, 0, "Sent before the latency");
+	zassert_equal(batch(MSG_2), 0, "Batch failed");
+
+	/* Counted from the first message of the batch */
+	k_sleep(K_MSEC(CONFIG_NRF_CLOUD_BATCH_LATENCY));
+	zassert_equal(send_count, 1, "Not sent after the latency");
+	zassert_equal(strcmp(sent, "[" MSG_1 "," MSG_2 "]"), 0,
+		      "Wrong batch: %s", sent);
+}
+
+static void test_send_error(void)
+{
+	send_err = -EAGAIN;
+
+	zassert_equal(batch(MSG_1), 0, "Batch failed");
+	zassert_equal(nrf_cloud_sensor_data_batch_flush(), -EAGAIN,
+		      "Error not returned");
+
+	/* Kept, and sent with the next batch */
+	send_err = 0;
+	zassert_equal(batch(MSG_2), 0, "Batch failed");
+	zassert_equal(nrf_cloud_sensor_data_batch_flush(), 0, "Flush failed");
+	zassert_equal(send_count, 2, "Not sent again");
+	zassert_equal(strcmp(sent, "[" MSG_1 "," MSG_2 "]"), 0,
+		      "Wrong batch: %s", sent);
+}
+
+static void test_send_error_on_timeout(void)
+{
+	send_err = -EAGAIN;
+
+	zassert_equal(batch(MSG_1), 0, "Batch failed");
+	k_sleep(K_MSEC(2 * CONFIG_NRF_CLOUD_BATCH_LATENCY));
+	zassert_equal(send_count, 1, "Not sent after the latency");
+
+	/* The timer is restarted by the next message */
+	send_err = 0;
+	zassert_equal(batch(MSG_2), 0, "Batch failed");
+	k_sleep(K_MSEC(2 * CONFIG_NRF_CLOUD_BATCH_LATENCY));
+	zassert_equal(send_count, 2, "Not sent again");
+	zassert_equal(strcmp(sent, "[" MSG_1 "," MSG_2 "]"), 0,
+		      "Wrong batch: %s", sent);
+}
+
+static void test_send_error_on_size(void)
+{
+	zassert_equal(batch(MSG_1), 0, "Batch failed");
+	zassert_equal(batch(MSG_2), 0, "Batch failed");
+
+	send_err = -EAGAIN;
+	zassert_equal(batch(MSG_3), -EAGAIN, "Error not returned");
+
+	send_err = 0;
+	zassert_equal(nrf_cloud_sensor_data_batch_flush(), 0, "Flush failed");
+	zassert_equal(strcmp(sent, "[" MSG_1 "," MSG_2 "]"), 0,
+		      "Wrong batch: %s", sent);
+}
+
+static void test_too_large(void)
+{
+	static const char msg[CONFIG_NRF_CLOUD_BATCH_SIZE] = {
+		[0 ... CONFIG_NRF_CLOUD_BATCH_SIZE - 2] = 'x'
+	};
+
+	zassert_equal(batch(msg), -EMSGSIZE, "Too large accepted");
+
+	zassert_equal(nrf_cloud_sensor_data_batch_flush(), 0, "Flush failed");
+	zassert_equal(send_count, 0, "Sent");
+}
+
+static void test_disconnecting(void)
+{
+	zassert_equal(batch(MSG_1), 0, "Batch failed");
+
+	state = STATE_DISCONNECTING;
+	zassert_equal(batch(MSG_2), -EACCES, "Batch not rejected");
+	zassert_equal(nrf_cloud_sensor_data_batch_flush(), -EACCES,
+		      "Flush not rejected");
+	zassert_equal(send_count, 0, "Sent");
+
+	state = STATE_DC_CONNECTED;
+	zassert_equal(nrf_cloud_sensor_data_batch_flush(), 0, "Flush failed");
+	zassert_equal(strcmp(sent, "[" MSG_1 "]"), 0, "Wrong batch: %s",
+		      sent);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(nrf_cloud_batch_test,
+		ztest_unit_test_setup_teardown(test_flush, setup, teardown),
+		ztest_unit_test_setup_teardown(test_flush_on_size, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_flush_on_timeout, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_send_error, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_send_error_on_timeout,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_send_error_on_size, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_too_large, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_disconnecting, setup,
+					       teardown)
+	);
+
+	ztest_run_test_suite(nrf_cloud_batch_test);
+}
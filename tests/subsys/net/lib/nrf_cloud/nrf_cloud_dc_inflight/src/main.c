@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <string.h>
+#include <net/mqtt.h>
+
+#include "nrf_cloud_dc_inflight.h"
+#include "nrf_cloud_transport.h"
+
+#define TOPIC "prod/1234/m/d/nrf-352656100123456/d2c"
+
+static struct mqtt_client client;
+
+/* Messages given to the mocked mqtt_publish() */
+static struct {
+	uint16_t id;
+	uint8_t dup;
+	char payload[16];
+} published[CONFIG_NRF_CLOUD_DC_INFLIGHT_MAX + 1];
+static size_t publish_count;
+static int publish_err;
+
+int mqtt_publish(struct mqtt_client *c, const struct mqtt_publish_param *param)
+{
+	zassert_equal_ptr(c, &client, "Wrong client");
+	zassert_equal(param->message.topic.topic.size, strlen(TOPIC),
+		      "Wrong topic length");
+	zassert_mem_equal(param->message.topic.topic.utf8, TOPIC,
+			  strlen(TOPIC), "Wrong topic");
+
+	if (publish_err) {
+		return publish_err;
+	}
+
+	zassert_true(publish_count < ARRAY_SIZE(published), "Too many");
+	zassert_true(param->message.payload.len <
+		     sizeof(published[0].payload), "Payload too long");
+
+	published[publish_count].id = param->message_id;
+	published[publish_count].dup = param->dup_flag;
+	memcpy(published[publish_count].payload, param->message.payload.data,
+	       param->message.payload.len);
+	published[publish_count].payload[param->message.payload.len] = '\0';
+	publish_count++;
+
+	return 0;
+}
+
+static int add(uint16_t id, const char *payload, uint16_t *assigned)
+{
+	struct mqtt_publish_param publish = {
+		.message.topic.qos = MQTT_QOS_1_AT_LEAST_ONCE,
+		.message.topic.topic.utf8 = (uint8_t *)TOPIC,
+		.message.topic.topic.size = strlen(TOPIC),
+		.message.payload.data = (uint8_t *)payload,
+		.message.payload.len = strlen(payload),
+		.message_id = id,
+	};
+	int err = nct_dc_inflight_add(&publish);
+
+	if (assigned != NULL) {
+		*assigned = publish.message_id;
+	}
+
+	return err;
+}
+
+static void setup(void)
+{
+	(void)nct_dc_inflight_clear();
+	memset(published, 0, sizeof(published));
+	publish_count = 0;
+	publish_err = 0;
+}
+
+static void teardown(void)
+{
+}
+
+static void test_reserved_ids(void)
+{
+	static const uint16_t reserved[] = {
+		NCT_DEFAULT_REPORT_ID, NCT_CC_SUBSCRIBE_ID,
+		NCT_CLOUD_STATE_REQ_ID, NCT_PAIRING_STATUS_REPORT_ID,
+		NCT_DC_SUBSCRIBE_ID, NCT_CC_UA_DATA_ID,
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(reserved); i++) {
+		zassert_true(nct_message_id_reserved(reserved[i]),
+			     "%d not reserved", reserved[i]);
+	}
+
+	zassert_false(nct_message_id_reserved(2), "2 reserved");
+	zassert_false(nct_message_id_reserved(UINT16_MAX), "Max reserved");
+}
+
+static void test_next_id_skips(void)
+{
+	uint16_t inflight;
+
+	zassert_equal(add(0, "a", &inflight), 0, "Add failed");
+
+	/* Twice around the id space, including the wrap to zero */
+	for (uint32_t i = 0; i < 2 * (UINT16_MAX + 1); i++) {
+		uint16_t id = nct_message_id_next();
+
+		zassert_not_equal(id, 0, "Zero id");
+		zassert_false(nct_message_id_reserved(id), "Reserved id %d",
+			      id);
+		zassert_not_equal(id, inflight, "Id %d in flight", id);
+	}
+}
+
+static void test_add_assigns_id(void)
+{
+	uint16_t a, b;
+
+	zassert_equal(add(0, "a", &a), 0, "Add failed");
+	zassert_equal(add(0, "b", &b), 0, "Add failed");
+
+	zassert_not_equal(a, 0, "No id");
+	zassert_not_equal(a, b, "Same id");
+	zassert_false(nct_message_id_reserved(a), "Reserved id");
+	zassert_false(nct_message_id_reserved(b), "Reserved id");
+}
+
+static void test_add_same_id(void)
+{
+	zassert_equal(add(42, "a", NULL), 0, "Add failed");
+	zassert_equal(add(42, "b", NULL), -EALREADY, "Same id accepted");
+}
+
+static void test_window_full(void)
+{
+	for (int i = 0; i < CONFIG_NRF_CLOUD_DC_INFLIGHT_MAX; i++) {
+		zassert_equal(add(100 + i, "a", NULL), 0, "Add failed");
+	}
+
+	zassert_equal(add(200, "a", NULL), -EAGAIN, "Window not full");
+
+	zassert_true(nct_dc_inflight_ack(100), "Not in flight");
+	zassert_equal(add(200, "a", NULL), 0, "Slot not released");
+}
+
+static void test_ack(void)
+{
+	zassert_equal(add(42, "a", NULL), 0, "Add failed");
+
+	zassert_false(nct_dc_inflight_ack(43), "Unknown id acked");
+	zassert_true(nct_dc_inflight_ack(42), "Not in flight");
+	zassert_false(nct_dc_inflight_ack(42), "Acked twice");
+}
+
+static void test_release(void)
+{
+	zassert_equal(add(42, "a", NULL), 0, "Add failed");
+
+	/* Unknown ids are ignored */
+	nct_dc_inflight_release(43);
+	nct_dc_inflight_release(42);
+
+	zassert_false(nct_dc_inflight_ack(42), "Not released");
+	zassert_equal(add(42, "b", NULL), 0, "Id not free");
+}
+
+static void test_retransmit(void)
+{
+	zassert_equal(add(42, "first", NULL), 0, "Add failed");
+	zassert_equal(add(43, "second", NULL), 0, "Add failed");
+	zassert_equal(add(44, "third", NULL), 0, "Add failed");
+	zassert_true(nct_dc_inflight_ack(43), "Not in flight");
+
+	zassert_equal(nct_dc_inflight_retransmit(&client), 0,
+		      "Retransmit failed");
+
+	zassert_equal(publish_count, 2, "Wrong number sent");
+	zassert_equal(published[0].id, 42, "Wrong id");
+	zassert_equal(published[0].dup, 1, "No DUP flag");
+	zassert_equal(strcmp(published[0].payload, "first"), 0,
+		      "Wrong payload");
+	zassert_equal(published[1].id, 44, "Wrong id");
+	zassert_equal(published[1].dup, 1, "No DUP flag");
+	zassert_equal(strcmp(published[1].payload, "third"), 0,
+		      "Wrong payload");
+
+	/* Still waiting for the PUBACK */
+	zassert_true(nct_dc_inflight_ack(42), "Not in flight");
+	zassert_true(nct_dc_inflight_ack(44), "Not in flight");
+}
+
+static void test_retransmit_error_keeps(void)
+{
+	zassert_equal(add(42, "a", NULL), 0, "Add failed");
+
+	publish_err = -ENOTCONN;
+	zassert_equal(nct_dc_inflight_retransmit(&client), -ENOTCONN,
+		      "Error not returned");
+
+	publish_err = 0;
+	zassert_equal(nct_dc_inflight_retransmit(&client), 0,
+		      "Retransmit failed");
+	zassert_equal(publish_count, 1, "Not kept for the next reconnect");
+	zassert_equal(published[0].id, 42, "Wrong id");
+}
+
+static void test_clear(void)
+{
+	zassert_equal(add(42, "a", NULL), 0, "Add failed");
+	zassert_equal(add(43, "b", NULL), 0, "Add failed");
+
+	zassert_equal(nct_dc_inflight_clear(), 2, "Wrong number cleared");
+	zassert_equal(nct_dc_inflight_clear(), 0, "Not cleared");
+
+	zassert_equal(nct_dc_inflight_retransmit(&client), 0,
+		      "Retransmit failed");
+	zassert_equal(publish_count, 0, "Cleared message sent");
+	zassert_false(nct_dc_inflight_ack(42), "Not cleared");
+}
+
+void test_main(void)
+{
+	ztest_test_suite(nrf_cloud_dc_inflight_test,
+		ztest_unit_test(test_reserved_ids),
+		ztest_unit_test_setup_teardown(test_next_id_skips, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_add_assigns_id, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_add_same_id, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_window_full, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_ack, setup, teardown),
+		ztest_unit_test_setup_teardown(test_release, setup, teardown),
+		ztest_unit_test_setup_teardown(test_retransmit, setup,
+					       teardown),
+		ztest_unit_test_setup_teardown(test_retransmit_error_keeps,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_clear, setup, teardown)
+	);
+
+	ztest_run_test_suite(nrf_cloud_dc_inflight_test);
+}